@@ -0,0 +1,961 @@
+#include "benchmark.h"
+#include "renderer.h"
+#include "commandpool.h"
+#include "commandbuffer.h"
+#include "pipeline.h"
+#include "pipelinecache.h"
+#include "pipelinelibrary.h"
+#include "renderpass.h"
+#include "swapchain.h"
+#include "buffer.h"
+#include "memorypool.h"
+#include "descriptorpool.h"
+#include "descriptorset.h"
+#include "descriptorallocator.h"
+#include "descriptorsetcache.h"
+#include "renderqueue.h"
+#include "rendergraph.h"
+#include "profiler.h"
+#include "cpuculler.h"
+#include "frustum.h"
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+
+bool Benchmark::run( Renderer& renderer, const std::string& name )
+{
+	if( name == "record" )
+	{
+		return recordDraws( renderer, 100000 );
+	}
+	else if( name == "sort" )
+	{
+		return sortKeys( 1000000 );
+	}
+	else if( name == "cull" )
+	{
+		return cullObjects( renderer, 1000000 );
+	}
+	else if( name == "jobs" )
+	{
+		return runJobs( renderer, 1000000 );
+	}
+	else if( name == "pipelines" )
+	{
+		return compilePipelines( renderer, 500 );
+	}
+	else if( name == "descriptors" )
+	{
+		return allocateDescriptorSets( renderer, 10000 );
+	}
+	else if( name == "rendergraph" )
+	{
+		return compileRenderGraph( renderer );
+	}
+
+	log_error( "Unknown benchmark: " + name );
+	return false;
+}
+
+bool Benchmark::recordDraws( Renderer& renderer, uint32_t numDraws )
+{
+	static const char* const modeNames[] = {
+	    "record.vector",
+	    "record.pointer",
+	    "record.tracked"
+	};
+
+	// commands are recorded into a secondary command buffer continuing the render
+	// pass, so no framebuffer is required and nothing has to be submitted
+	CommandPool commandPool( renderer,
+	                         renderer.getQueueFamilies()[ QueueFamily::Graphics ].index,
+	                         VK_COMMAND_POOL_CREATE_TRANSIENT_BIT );
+
+	if( !commandPool.isValid() )
+		return false;
+
+	CommandBuffer commandBuffer( commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY );
+
+	if( !commandBuffer.isValid() )
+		return false;
+
+	log_info( "Recording " + std::to_string( numDraws ) + " draws per iteration." );
+
+	for( auto mode = 0; mode < 3; ++mode )
+	{
+		double   best         = 0.0;
+		uint32_t skippedBinds = 0;
+
+		for( auto i = 0; i < NUM_ITERATIONS; ++i )
+		{
+			if( !commandPool.reset() ||
+			    !commandBuffer.begin( VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			                          renderer.getRenderPass(),
+			                          0,
+			                          VK_NULL_HANDLE ) )
+			{
+				return false;
+			}
+
+			auto start = Profiler::clock_type::now();
+
+			recordDrawsWithMode( renderer, commandBuffer, (RecordMode)mode, numDraws );
+
+			double elapsed = Profiler::millisecondsSince( start );
+
+			commandBuffer.end();
+
+			Profiler::addTime( std::string( "benchmark." ) + modeNames[ mode ], elapsed );
+
+			best         = ( i == 0 ? elapsed : std::min( best, elapsed ) );
+			skippedBinds = commandBuffer.getNumSkippedBinds();
+		}
+
+		// every draw issues 8 recording calls, skipped ones included
+		reportRate( modeNames[ mode ], best, 8 * (uint64_t)numDraws, "commands" );
+
+		if( skippedBinds > 0 )
+		{
+			log_info( "  skipped " + std::to_string( skippedBinds ) + " redundant binds" );
+		}
+	}
+
+	commandPool.reset();
+	return true;
+}
+
+bool Benchmark::sortKeys( uint32_t numKeys )
+{
+	// a plausible scene: few pipelines, more materials and meshes, arbitrary depths
+	std::mt19937                            generator( 1234 );
+	std::uniform_int_distribution<uint32_t> pipelines( 0, 15 );
+	std::uniform_int_distribution<uint32_t> sets( 0, 255 );
+	std::uniform_int_distribution<uint32_t> meshes( 0, 4095 );
+	std::uniform_real_distribution<float>   depths( 0.1f, 1000.0f );
+
+	std::vector<uint64_t> sourceKeys( numKeys );
+	for( auto& key : sourceKeys )
+	{
+		RenderQueue::DrawItem item{};
+		item.pipeline      = pipelines( generator );
+		item.descriptorSet = sets( generator );
+		item.mesh          = meshes( generator );
+		item.depth         = depths( generator );
+
+		key = RenderQueue::encodeKey( item );
+	}
+
+	std::vector<uint64_t> keys( numKeys );
+	std::vector<uint32_t> values( numKeys );
+	std::vector<uint64_t> tempKeys( numKeys );
+	std::vector<uint32_t> tempValues( numKeys );
+
+	log_info( "Sorting " + std::to_string( numKeys ) + " keys per iteration." );
+
+	for( auto mode = 0; mode < 2; ++mode )
+	{
+		double best = 0.0;
+
+		for( auto i = 0; i < NUM_ITERATIONS; ++i )
+		{
+			keys = sourceKeys;
+			for( auto j = 0; j < numKeys; ++j )
+			{
+				values[ j ] = j;
+			}
+
+			auto start = Profiler::clock_type::now();
+
+			if( mode == 0 )
+			{
+				RenderQueue::radixSort( keys.data(),
+				                        values.data(),
+				                        tempKeys.data(),
+				                        tempValues.data(),
+				                        numKeys );
+			}
+			else
+			{
+				std::sort( keys.begin(), keys.end() );
+			}
+
+			double elapsed = Profiler::millisecondsSince( start );
+
+			best = ( i == 0 ? elapsed : std::min( best, elapsed ) );
+		}
+
+		reportRate( mode == 0 ? "sort.radix" : "sort.std", best, numKeys, "keys" );
+
+		if( !std::is_sorted( keys.begin(), keys.end() ) )
+		{
+			log_error( "Sorted keys are out of order." );
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Benchmark::cullObjects( Renderer& renderer, uint32_t numObjects )
+{
+	static const char* const boundsNames[] = {
+	    "sphere",
+	    "box"
+	};
+
+	// objects scattered around the origin, the camera only sees a part of them
+	std::mt19937                          generator( 1234 );
+	std::uniform_real_distribution<float> positions( -10.0f, 10.0f );
+	std::uniform_real_distribution<float> sizes( 0.05f, 0.5f );
+
+	CpuCuller culler;
+	culler.reserve( numObjects );
+	for( auto i = 0; i < numObjects; ++i )
+	{
+		glm::vec3 center( positions( generator ), positions( generator ), positions( generator ) );
+		glm::vec3 extent( sizes( generator ), sizes( generator ), sizes( generator ) );
+
+		culler.add( center, glm::length( extent ), center - extent, center + extent );
+	}
+
+	Frustum frustum = Frustum::fromViewProjection( renderer.computeProjectionMatrix() *
+	                                               renderer.computeViewMatrix() );
+
+	std::vector<uint32_t> visible( numObjects );
+
+	log_info( "Culling " + std::to_string( numObjects ) + " objects per iteration." );
+
+	CpuCuller::InstructionSet bestSet = CpuCuller::detectInstructionSet();
+
+	for( auto bounds = 0; bounds < 2; ++bounds )
+	{
+		uint32_t referenceVisible = 0;
+
+		for( auto set = 0; set <= (int)bestSet; ++set )
+		{
+			culler.setInstructionSet( (CpuCuller::InstructionSet)set );
+
+			double   best       = 0.0;
+			uint32_t numVisible = 0;
+
+			for( auto i = 0; i < NUM_ITERATIONS; ++i )
+			{
+				auto start = Profiler::clock_type::now();
+
+				numVisible = culler.cull( frustum,
+				                          (CpuCuller::Bounds)bounds,
+				                          0,
+				                          numObjects,
+				                          visible.data() );
+
+				double elapsed = Profiler::millisecondsSince( start );
+
+				best = ( i == 0 ? elapsed : std::min( best, elapsed ) );
+			}
+
+			std::string name = std::string( "cull." ) + boundsNames[ bounds ] + "." +
+			                   CpuCuller::getInstructionSetName( culler.getInstructionSet() );
+			reportRate( name.c_str(), best, numObjects, "objects" );
+
+			// all instruction sets evaluate the same expressions in the same order
+			if( set == 0 )
+			{
+				referenceVisible = numVisible;
+				log_info( "  " + std::to_string( numVisible ) + " objects visible" );
+			}
+			else if( numVisible != referenceVisible )
+			{
+				log_error( "Culling results differ between instruction sets." );
+				return false;
+			}
+		}
+
+		uint32_t maxThreads = std::max( std::thread::hardware_concurrency(), 1u );
+		for( uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2 )
+		{
+			double   best       = 0.0;
+			uint32_t numVisible = 0;
+
+			for( auto i = 0; i < NUM_ITERATIONS; ++i )
+			{
+				double elapsed = cullParallel( culler,
+				                               frustum,
+				                               (CpuCuller::Bounds)bounds,
+				                               numThreads,
+				                               visible.data(),
+				                               numVisible );
+
+				best = ( i == 0 ? elapsed : std::min( best, elapsed ) );
+			}
+
+			std::string name = std::string( "cull." ) + boundsNames[ bounds ] +
+			                   ".threads." + std::to_string( numThreads );
+			reportRate( name.c_str(), best, numObjects, "objects" );
+			reportRate( "  per core", best * numThreads, numObjects, "objects" );
+
+			if( numVisible != referenceVisible )
+			{
+				log_error( "Parallel culling results differ from serial culling." );
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+double Benchmark::cullParallel( const CpuCuller& culler,
+                                const Frustum& frustum,
+                                CpuCuller::Bounds bounds,
+                                uint32_t numThreads,
+                                uint32_t* visible,
+                                uint32_t& numVisible )
+{
+	uint32_t numObjects = culler.getNumObjects();
+
+	std::vector<std::thread> threads( numThreads );
+	std::vector<uint32_t>    counts( numThreads );
+
+	auto start = Profiler::clock_type::now();
+
+	// every thread writes its compacted indices to the start of its own range
+	for( auto t = 0; t < numThreads; ++t )
+	{
+		uint32_t first = (uint64_t)numObjects * t / numThreads;
+		uint32_t last  = (uint64_t)numObjects * ( t + 1 ) / numThreads;
+
+		threads[ t ] = std::thread( [ &, t, first, last ]() {
+			counts[ t ] = culler.cull( frustum, bounds, first, last - first, visible + first );
+		} );
+	}
+
+	numVisible = 0;
+	for( auto t = 0; t < numThreads; ++t )
+	{
+		threads[ t ].join();
+
+		uint32_t first = (uint64_t)numObjects * t / numThreads;
+
+		// merge into one compacted list, moving left only; ranges preceded by fully visible
+		// ones are in place already, copying onto themselves would be undefined
+		if( first != numVisible )
+		{
+			std::copy( visible + first, visible + first + counts[ t ], visible + numVisible );
+		}
+		numVisible += counts[ t ];
+	}
+
+	return Profiler::millisecondsSince( start );
+}
+
+bool Benchmark::runJobs( Renderer& renderer, uint32_t numObjects )
+{
+	std::mt19937                          generator( 1234 );
+	std::uniform_real_distribution<float> positions( -10.0f, 10.0f );
+	std::uniform_real_distribution<float> sizes( 0.05f, 0.5f );
+
+	glm::mat4 view = renderer.computeViewMatrix();
+
+	CpuCuller culler;
+	JobFrame  frame;
+
+	culler.reserve( numObjects );
+	frame.depths.resize( numObjects );
+	for( auto i = 0; i < numObjects; ++i )
+	{
+		glm::vec3 center( positions( generator ), positions( generator ), positions( generator ) );
+		glm::vec3 extent( sizes( generator ), sizes( generator ), sizes( generator ) );
+
+		culler.add( center, glm::length( extent ), center - extent, center + extent );
+		frame.depths[ i ] = -( view * glm::vec4( center, 1.0f ) ).z;
+	}
+
+	frame.pCuller = &culler;
+	frame.frustum = Frustum::fromViewProjection( renderer.computeProjectionMatrix() * view );
+	frame.instances.resize( numObjects );
+	frame.culled.resize( numObjects );
+	frame.visible.resize( numObjects );
+	frame.keys.resize( numObjects );
+	frame.values.resize( numObjects );
+	frame.tempKeys.resize( numObjects );
+	frame.tempValues.resize( numObjects );
+
+	log_info( "Running frames of " + std::to_string( numObjects ) + " objects as jobs." );
+
+	uint32_t maxThreads       = std::max( std::thread::hardware_concurrency(), 1u );
+	double   singleThreaded   = 0.0;
+	uint32_t referenceVisible = 0;
+
+	// powers of two, always ending with all hardware threads
+	for( uint32_t numThreads = 1; ; numThreads = std::min( numThreads * 2, maxThreads ) )
+	{
+		JobSystem jobSystem( numThreads );
+
+		double best = 0.0;
+		for( auto i = 0; i < NUM_ITERATIONS; ++i )
+		{
+			double elapsed = runJobFrame( jobSystem, frame );
+
+			best = ( i == 0 ? elapsed : std::min( best, elapsed ) );
+		}
+
+		if( numThreads == 1 )
+		{
+			singleThreaded   = best;
+			referenceVisible = frame.numVisible;
+		}
+
+		std::string name = "jobs.threads." + std::to_string( numThreads );
+		reportRate( name.c_str(), best, numObjects, "objects" );
+
+		char line[ 128 ];
+		std::snprintf( line, sizeof( line ), "  %.2fx speedup", singleThreaded / best );
+		log_info( line );
+
+		if( frame.numVisible != referenceVisible ||
+		    !std::is_sorted( frame.keys.begin(), frame.keys.begin() + frame.numVisible ) )
+		{
+			log_error( "Job results differ from single threaded results." );
+			return false;
+		}
+
+		if( numThreads == maxThreads )
+			break;
+	}
+	return true;
+}
+
+double Benchmark::runJobFrame( JobSystem& jobSystem, JobFrame& frame )
+{
+	frame.pJobSystem = &jobSystem;
+	frame.numVisible = 0;
+
+	auto start = Profiler::clock_type::now();
+
+	JobSystem::Counter culled;
+	JobSystem::Counter done;
+
+	jobSystem.run( updateInstancesJob, &frame, &done );
+	jobSystem.run( cullJob, &frame, &culled );
+	jobSystem.run( sortJob, &frame, &done, &culled );
+
+	jobSystem.wait( done );
+
+	return Profiler::millisecondsSince( start );
+}
+
+void Benchmark::updateInstancesJob( void* userData )
+{
+	JobFrame& frame = *reinterpret_cast<JobFrame*>( userData );
+	frame.pJobSystem->parallelFor( frame.instances.size(), 4096, updateInstancesRange, userData );
+}
+
+void Benchmark::updateInstancesRange( uint32_t first, uint32_t count, void* userData )
+{
+	JobFrame& frame        = *reinterpret_cast<JobFrame*>( userData );
+	uint32_t  numInstances = frame.instances.size();
+
+	for( auto i = first; i < first + count; ++i )
+	{
+		frame.instances[ i ] = Renderer::computeGridInstance( i, numInstances );
+	}
+}
+
+void Benchmark::cullJob( void* userData )
+{
+	JobFrame& frame = *reinterpret_cast<JobFrame*>( userData );
+	frame.pJobSystem->parallelFor( frame.culled.size(), 16384, cullRange, userData );
+}
+
+void Benchmark::cullRange( uint32_t first, uint32_t count, void* userData )
+{
+	JobFrame& frame = *reinterpret_cast<JobFrame*>( userData );
+
+	uint32_t numVisible = frame.pCuller->cull( frame.frustum,
+	                                           CpuCuller::Bounds::Sphere,
+	                                           first,
+	                                           count,
+	                                           frame.culled.data() + first );
+
+	// batches finish in any order, the sort restores a deterministic order
+	uint32_t offset = frame.numVisible.fetch_add( numVisible );
+	std::copy( frame.culled.data() + first,
+	           frame.culled.data() + first + numVisible,
+	           frame.visible.data() + offset );
+}
+
+void Benchmark::sortJob( void* userData )
+{
+	JobFrame& frame      = *reinterpret_cast<JobFrame*>( userData );
+	uint32_t  numVisible = frame.numVisible;
+
+	for( auto i = 0; i < numVisible; ++i )
+	{
+		uint32_t object = frame.visible[ i ];
+
+		RenderQueue::DrawItem item{};
+		item.mesh  = object & 0xfff;
+		item.depth = frame.depths[ object ];
+
+		frame.keys[ i ]   = RenderQueue::encodeKey( item );
+		frame.values[ i ] = object;
+	}
+
+	RenderQueue::radixSort( frame.keys.data(),
+	                        frame.values.data(),
+	                        frame.tempKeys.data(),
+	                        frame.tempValues.data(),
+	                        numVisible );
+}
+
+bool Benchmark::compilePipelines( Renderer& renderer, uint32_t numPipelines )
+{
+	static const VkPrimitiveTopology topologies[] = {
+	    VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+	    VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+	    VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN
+	};
+	static const VkCullModeFlags cullModes[] = {
+	    VK_CULL_MODE_NONE,
+	    VK_CULL_MODE_FRONT_BIT,
+	    VK_CULL_MODE_BACK_BIT,
+	    VK_CULL_MODE_FRONT_AND_BACK
+	};
+
+	// 48 fixed function states, repeated with a specialization constant the vertex shader
+	// does not declare to reach the requested number of distinct pipelines; the layouts
+	// are reflected from the shaders and cannot vary anymore
+	std::vector<PipelineLibrary::Desc> descs( numPipelines );
+	for( auto i = 0; i < numPipelines; ++i )
+	{
+		uint32_t state   = i % 48;
+		uint32_t variant = i / 48;
+
+		PipelineLibrary::Desc& desc = descs[ i ];
+		desc.pRenderPass     = &renderer.getRenderPass();
+		desc.shaders         = {
+		    &renderer.getShaderCache().getVertexShader( "vert" ),
+		    &renderer.getShaderCache().getFragmentShader( "frag" )
+		};
+		desc.vertexBindings  = {
+		    { sizeof( Vertex ), VK_VERTEX_INPUT_RATE_VERTEX, Vertex::getAttributeDescriptions() },
+		    { sizeof( Instance ), VK_VERTEX_INPUT_RATE_INSTANCE, Instance::getAttributeDescriptions() }
+		};
+		desc.specializations = { SpecializationConstants{ { 0, variant } } };
+		desc.state.topology    = topologies[ state % 3 ];
+		desc.state.cullMode    = cullModes[ state / 3 % 4 ];
+		desc.state.frontFace   = ( state / 12 % 2 == 0 ? VK_FRONT_FACE_COUNTER_CLOCKWISE
+		                                               : VK_FRONT_FACE_CLOCKWISE );
+		desc.state.blendEnable = ( state / 24 % 2 != 0 );
+	}
+
+	log_info( "Compiling " + std::to_string( numPipelines ) + " pipelines per iteration." );
+
+	uint32_t maxThreads     = std::max( std::thread::hardware_concurrency(), 1u );
+	double   singleThreaded = 0.0;
+
+	// powers of two, always ending with all hardware threads; a single iteration each,
+	// as drivers may keep compiled shaders in caches of their own
+	for( uint32_t numThreads = 1; ; numThreads = std::min( numThreads * 2, maxThreads ) )
+	{
+		JobSystem       jobSystem( numThreads );
+		PipelineCache   pipelineCache( renderer );
+		PipelineLibrary library( renderer, pipelineCache );
+
+		auto start = Profiler::clock_type::now();
+
+		bool success = library.compile( descs, jobSystem );
+
+		double elapsed = Profiler::millisecondsSince( start );
+
+		if( !success || library.getNumPipelines() != numPipelines )
+		{
+			log_error( "Cannot compile benchmark pipelines." );
+			return false;
+		}
+
+		if( numThreads == 1 )
+		{
+			singleThreaded = elapsed;
+		}
+
+		std::string name = "pipelines.threads." + std::to_string( numThreads );
+		reportRate( name.c_str(), elapsed, numPipelines, "pipelines" );
+
+		char line[ 128 ];
+		std::snprintf( line, sizeof( line ), "  %.2fx speedup", singleThreaded / elapsed );
+		log_info( line );
+
+		if( numThreads == maxThreads )
+			break;
+	}
+	return true;
+}
+
+bool Benchmark::allocateDescriptorSets( Renderer& renderer, uint32_t numSets )
+{
+	DescriptorSetLayout& layout        = renderer.getSceneDescriptorSetLayout();
+	Buffer&              uniformBuffer = renderer.getUniformBuffer( 0 );
+
+	log_info( "Allocating " + std::to_string( numSets ) + " descriptor sets per iteration." );
+
+	DescriptorPool pool( renderer, { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, numSets } }, numSets );
+
+	if( !pool.isValid() )
+		return false;
+
+	std::vector<DescriptorSet*> sets( numSets, nullptr );
+
+	double best = 0.0;
+	for( auto i = 0; i < NUM_ITERATIONS; ++i )
+	{
+		auto start = Profiler::clock_type::now();
+
+		bool success = true;
+		for( auto& set : sets )
+		{
+			set = new DescriptorSet( pool, { &layout } );
+
+			if( !set->isValid() )
+			{
+				success = false;
+				continue;
+			}
+
+			DescriptorSet::Writer setWriter( *set );
+			setWriter.uniformBuffer( 0, uniformBuffer, 0, sizeof( CameraUBO ) );
+			set->update( setWriter );
+		}
+
+		for( auto& set : sets )
+		{
+			safe_delete( set );
+		}
+
+		double elapsed = Profiler::millisecondsSince( start );
+
+		if( !success )
+		{
+			log_error( "Cannot allocate benchmark descriptor sets." );
+			return false;
+		}
+
+		Profiler::addTime( "benchmark.descriptors.individual", elapsed );
+		best = ( i == 0 ? elapsed : std::min( best, elapsed ) );
+	}
+	reportRate( "descriptors.individual", best, numSets, "sets" );
+
+	// starts with no pools, the first iteration grows them to fit
+	DescriptorAllocator allocator( renderer,
+	                               { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f } },
+	                               Renderer::FRAME_DESCRIPTOR_SETS_PER_POOL );
+
+	for( auto i = 0; i < NUM_ITERATIONS; ++i )
+	{
+		auto start = Profiler::clock_type::now();
+
+		allocator.reset();
+
+		bool success = true;
+		for( auto j = 0; j < numSets; ++j )
+		{
+			VkDescriptorSet set = allocator.allocate( layout );
+
+			if( set == VK_NULL_HANDLE )
+			{
+				success = false;
+				break;
+			}
+
+			DescriptorSet::Writer setWriter( set );
+			setWriter.uniformBuffer( 0, uniformBuffer, 0, sizeof( CameraUBO ) );
+			allocator.update( setWriter );
+		}
+
+		double elapsed = Profiler::millisecondsSince( start );
+
+		if( !success )
+		{
+			log_error( "Cannot allocate benchmark descriptor sets." );
+			return false;
+		}
+
+		Profiler::addTime( "benchmark.descriptors.allocator", elapsed );
+		best = ( i == 0 ? elapsed : std::min( best, elapsed ) );
+	}
+	reportRate( "descriptors.allocator", best, numSets, "sets" );
+
+	log_info( "  allocator grew to " + std::to_string( allocator.getNumPools() ) + " pools" );
+
+	allocator.reset();
+
+	// a window of keys slides through more keys than the cache holds: every frame hits
+	// most of its sets and replaces the rest by evicting sets of retired frames
+	static const uint32_t CACHE_SETS = 256;
+	static const uint32_t NUM_KEYS   = 1024;
+	static const uint32_t FRAME_KEYS = 96;
+	static const uint32_t KEY_STEP   = 64;
+	static const uint32_t NUM_FRAMES = 32;
+
+	// keys differ by their offset into a single uniform buffer
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties( renderer.getNativePhysicalDeviceHandle(), &properties );
+
+	uint64_t alignment = properties.limits.minUniformBufferOffsetAlignment;
+	uint64_t stride    = ( sizeof( CameraUBO ) + alignment - 1 ) / alignment * alignment;
+
+	Buffer*     keyBuffer = new Buffer( renderer, NUM_KEYS * stride, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT );
+	MemoryPool* keyMemory = nullptr;
+
+	bool success = keyBuffer->isValid();
+	if( success )
+	{
+		uint32_t typeFilter;
+		uint64_t requiredSize;
+		keyBuffer->getMemoryRequirements( nullptr, &typeFilter, &requiredSize );
+
+		keyMemory = new MemoryPool( renderer,
+		                            requiredSize,
+		                            typeFilter,
+		                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+		success   = keyMemory->isValid() && keyBuffer->allocateMemoryFromPool( *keyMemory );
+	}
+
+	DescriptorSetCache cache( renderer,
+	                          { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f } },
+	                          CACHE_SETS,
+	                          Renderer::FRAMES_IN_FLIGHT );
+
+	success = success && cache.isValid();
+
+	for( auto frame = 0; success && frame < NUM_FRAMES; ++frame )
+	{
+		auto start = Profiler::clock_type::now();
+
+		cache.setFrame( frame );
+
+		uint32_t firstKey = frame * KEY_STEP;
+		for( auto j = 0; j < numSets; ++j )
+		{
+			uint32_t key = ( firstKey + j % FRAME_KEYS ) % NUM_KEYS;
+
+			DescriptorSet::Writer setWriter;
+			setWriter.uniformBuffer( 0, *keyBuffer, key * stride, sizeof( CameraUBO ) );
+
+			if( cache.get( layout, setWriter ) == VK_NULL_HANDLE )
+			{
+				success = false;
+				break;
+			}
+		}
+
+		double elapsed = Profiler::millisecondsSince( start );
+
+		Profiler::addTime( "benchmark.descriptors.cached", elapsed );
+		best = ( frame == 0 ? elapsed : std::min( best, elapsed ) );
+	}
+
+	cache.destroy();
+	safe_delete( keyBuffer );
+	safe_delete( keyMemory );
+
+	if( !success )
+	{
+		log_error( "Cannot get cached benchmark descriptor sets." );
+		return false;
+	}
+
+	reportRate( "descriptors.cached", best, numSets, "sets" );
+
+	char line[ 128 ];
+	std::snprintf( line,
+	               sizeof( line ),
+	               "  cache hit rate %.2f %%, %llu evictions",
+	               cache.getHitRate() * 100.0,
+	               (unsigned long long)cache.getNumEvictions() );
+	log_info( line );
+
+	return true;
+}
+
+bool Benchmark::compileRenderGraph( Renderer& renderer )
+{
+	static const VkClearColorValue        clearColor{ { 0.0f, 0.0f, 0.0f, 1.0f } };
+	static const VkClearDepthStencilValue clearDepth{ 1.0f, 0 };
+	static const VkExtent2D               extent{ 1920, 1080 };
+
+	// nothing is executed, so the output needs no view and the passes no callbacks
+	RenderGraph graph( renderer );
+
+	RenderGraph::Handle output = graph.importImage( "output",
+	                                                VK_FORMAT_R8G8B8A8_UNORM,
+	                                                VK_IMAGE_LAYOUT_UNDEFINED,
+	                                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL );
+	RenderGraph::Handle albedo = graph.createImage( "albedo", VK_FORMAT_R8G8B8A8_UNORM );
+	RenderGraph::Handle depth  = graph.createImage( "depth", VK_FORMAT_D32_SFLOAT );
+	RenderGraph::Handle lit    = graph.createImage( "lit", VK_FORMAT_R16G16B16A16_SFLOAT );
+	RenderGraph::Handle bloom  = graph.createImage( "bloom", VK_FORMAT_R16G16B16A16_SFLOAT );
+	RenderGraph::Handle debug  = graph.createImage( "debug", VK_FORMAT_R8G8B8A8_UNORM );
+	graph.setOutput( output );
+
+	// lighting reads the geometry through input attachments and shares its render pass;
+	// bloom samples the lit image and starts a new one, after which albedo and depth are
+	// dead and their memory can be reused
+	RenderGraph::Handle geometryPass = graph.addPass( "geometry", nullptr, nullptr )
+	                                       .colorAttachment( albedo, clearColor )
+	                                       .depthAttachment( depth, clearDepth )
+	                                       .getHandle();
+	RenderGraph::Handle lightingPass = graph.addPass( "lighting", nullptr, nullptr )
+	                                       .inputAttachment( albedo )
+	                                       .inputAttachment( depth )
+	                                       .colorAttachment( lit, clearColor )
+	                                       .getHandle();
+	RenderGraph::Handle debugPass    = graph.addPass( "debug", nullptr, nullptr )
+	                                       .sampledImage( depth )
+	                                       .colorAttachment( debug, clearColor )
+	                                       .getHandle();
+	RenderGraph::Handle bloomPass    = graph.addPass( "bloom", nullptr, nullptr )
+	                                       .sampledImage( lit )
+	                                       .colorAttachment( bloom, clearColor )
+	                                       .getHandle();
+	graph.addPass( "tonemap", nullptr, nullptr )
+	     .sampledImage( lit )
+	     .sampledImage( bloom )
+	     .colorAttachment( output );
+
+	double best = 0.0;
+	for( auto i = 0; i < NUM_ITERATIONS; ++i )
+	{
+		auto start = Profiler::clock_type::now();
+
+		if( !graph.compile( extent ) )
+		{
+			log_error( "Cannot compile benchmark render graph." );
+			return false;
+		}
+
+		double elapsed = Profiler::millisecondsSince( start );
+
+		Profiler::addTime( "benchmark.rendergraph.compile", elapsed );
+		best = ( i == 0 ? elapsed : std::min( best, elapsed ) );
+	}
+	reportRate( "rendergraph.compile", best, 5, "passes" );
+
+	bool culled = !graph.isPassActive( debugPass );
+	bool merged = ( &graph.getRenderPass( geometryPass ) == &graph.getRenderPass( lightingPass ) &&
+	                graph.getSubpass( lightingPass ) == 1 );
+	bool split  = ( &graph.getRenderPass( bloomPass ) != &graph.getRenderPass( lightingPass ) );
+
+	if( !culled || !merged || !split )
+	{
+		log_error( "Benchmark render graph was not culled and merged as expected." );
+		return false;
+	}
+
+	// both subpasses of the merged render pass, the geometry one depth tested
+	std::vector<Shader*> shaders = {
+	    &renderer.getShaderCache().getVertexShader( "vert" ),
+	    &renderer.getShaderCache().getFragmentShader( "frag" )
+	};
+	std::vector<Pipeline::VertexBinding> vertexBindings = {
+	    { sizeof( Vertex ), VK_VERTEX_INPUT_RATE_VERTEX, Vertex::getAttributeDescriptions() },
+	    { sizeof( Instance ), VK_VERTEX_INPUT_RATE_INSTANCE, Instance::getAttributeDescriptions() }
+	};
+
+	Pipeline::State geometryState;
+	geometryState.depthTestEnable  = true;
+	geometryState.depthWriteEnable = true;
+	geometryState.subpass          = graph.getSubpass( geometryPass );
+
+	Pipeline::State lightingState;
+	lightingState.subpass = graph.getSubpass( lightingPass );
+
+	Pipeline geometryPipeline( graph.getRenderPass( geometryPass ), shaders, vertexBindings, geometryState );
+	Pipeline lightingPipeline( graph.getRenderPass( lightingPass ), shaders, vertexBindings, lightingState );
+
+	if( !geometryPipeline.isValid() || !lightingPipeline.isValid() )
+	{
+		log_error( "Cannot compile pipelines for the benchmark render graph's subpasses." );
+		return false;
+	}
+	return true;
+}
+
+void Benchmark::recordDrawsWithMode( Renderer& renderer,
+                                     CommandBuffer& commandBuffer,
+                                     RecordMode mode,
+                                     uint32_t numDraws )
+{
+	Pipeline&   pipeline = renderer.getPipeline();
+	const Mesh& mesh     = renderer.getQuadMesh();
+
+	VkRect2D renderArea = { { 0, 0 }, renderer.getSwapChain().getExtent() };
+
+	VkViewport viewport{};
+	viewport.x        = 0.0f;
+	viewport.y        = 0.0f;
+	viewport.width    = renderArea.extent.width;
+	viewport.height   = renderArea.extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	ModelPushConstants model{ glm::mat4( 1.0f ) };
+
+	VkDescriptorSet sets[ Renderer::FRAMES_IN_FLIGHT ];
+	for( auto i = 0; i < Renderer::FRAMES_IN_FLIGHT; ++i )
+	{
+		sets[ i ] = renderer.getSceneDescriptorSet( i );
+	}
+
+	commandBuffer.setStateTracking( mode == RecordMode::Tracked );
+
+	for( auto i = 0; i < numDraws; ++i )
+	{
+		// alternate descriptor sets in runs, as a material change would
+		VkDescriptorSet set = sets[ ( i / 64 ) % Renderer::FRAMES_IN_FLIGHT ];
+
+		commandBuffer.bindPipeline( VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline );
+		commandBuffer.bindDescriptorSet( set, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline );
+
+		if( mode == RecordMode::Vector )
+		{
+			commandBuffer.bindVertexBuffers( 0,
+			                                 { mesh.pVertexBuffer, mesh.pInstanceBuffer },
+			                                 { mesh.vertexOffset, mesh.instanceOffset } );
+			commandBuffer.bindIndexBuffer( *mesh.pIndexBuffer, mesh.indexOffset, mesh.indexType );
+			commandBuffer.setViewports( 0, { viewport } );
+			commandBuffer.setScissors( 0, { renderArea } );
+		}
+		else
+		{
+			commandBuffer.bindMesh( mesh );
+			commandBuffer.setViewport( 0, viewport );
+			commandBuffer.setScissor( 0, renderArea );
+		}
+
+		commandBuffer.pushConstants( pipeline,
+		                             VK_SHADER_STAGE_VERTEX_BIT,
+		                             0,
+		                             sizeof( ModelPushConstants ),
+		                             &model );
+
+		commandBuffer.drawIndexed( 0, mesh.numIndices, 0, 0, 1 );
+	}
+}
+
+void Benchmark::reportRate( const char* name,
+                            double milliseconds,
+                            uint64_t numItems,
+                            const char* unit )
+{
+	char line[ 256 ];
+	std::snprintf( line,
+	               sizeof( line ),
+	               "  %-32s %10.3f ms (%.2f M %s/s)",
+	               name,
+	               milliseconds,
+	               ( milliseconds > 0.0 ? numItems / milliseconds / 1000.0 : 0.0 ),
+	               unit );
+	log_info( line );
+}
@@ -0,0 +1,104 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "common.h"
+#include "cpuculler.h"
+#include "vertex.h"
+#include "jobsystem.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+class Renderer;
+class CommandBuffer;
+
+// Micro-benchmarks of CPU-side rendering paths, run instead of the main loop.
+class Benchmark
+{
+public:
+	static constexpr uint32_t NUM_ITERATIONS = 5;
+
+	// runs the benchmark with the given name, returns false if the name is unknown
+	static bool run( Renderer& renderer, const std::string& name );
+
+	// records draws with per-draw state binds through the std::vector API, the
+	// allocation-free API and the allocation-free API with redundant state filtering
+	static bool recordDraws( Renderer& renderer, uint32_t numDraws );
+
+	// sorts random render queue keys with the radix sort and std::sort for reference
+	static bool sortKeys( uint32_t numKeys );
+
+	// culls random bounds against the renderer's view frustum with every supported
+	// instruction set, then with the best one across increasing thread counts
+	static bool cullObjects( Renderer& renderer, uint32_t numObjects );
+
+	// runs a frame of CPU work as jobs: instance transform updates in parallel with
+	// culling, followed by sorting the visible objects; across increasing thread counts
+	static bool runJobs( Renderer& renderer, uint32_t numObjects );
+
+	// compiles pipelines differing in fixed function state and specialization
+	// through an empty pipeline cache, across increasing thread counts
+	static bool compilePipelines( Renderer& renderer, uint32_t numPipelines );
+
+	// allocates and writes transient descriptor sets, freed one by one from a pool with
+	// FREE_DESCRIPTOR_SET_BIT, recycled at once through a DescriptorAllocator and shared
+	// through a DescriptorSetCache
+	static bool allocateDescriptorSets( Renderer& renderer, uint32_t numSets );
+
+	// compiles a deferred shading graph with a merged geometry and lighting pass, an
+	// unused debug pass and transient images with disjoint lifetimes, checks the culled
+	// and merged passes and compiles depth tested pipelines for both subpasses
+	static bool compileRenderGraph( Renderer& renderer );
+
+private:
+	enum class RecordMode
+	{
+		Vector,
+		Pointer,
+		Tracked
+	};
+
+	static void recordDrawsWithMode( Renderer& renderer,
+	                                 CommandBuffer& commandBuffer,
+	                                 RecordMode mode,
+	                                 uint32_t numDraws );
+
+	static double cullParallel( const CpuCuller& culler,
+	                            const Frustum& frustum,
+	                            CpuCuller::Bounds bounds,
+	                            uint32_t numThreads,
+	                            uint32_t* visible,
+	                            uint32_t& numVisible );
+
+	struct JobFrame
+	{
+		JobSystem*            pJobSystem;
+		const CpuCuller*      pCuller;
+		Frustum               frustum;
+		std::vector<float>    depths;
+		std::vector<Instance> instances;
+		std::vector<uint32_t> culled;
+		std::vector<uint32_t> visible;
+		std::atomic<uint32_t> numVisible;
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> values;
+		std::vector<uint64_t> tempKeys;
+		std::vector<uint32_t> tempValues;
+	};
+
+	static double runJobFrame( JobSystem& jobSystem, JobFrame& frame );
+
+	static void   updateInstancesJob( void* userData );
+	static void   updateInstancesRange( uint32_t first, uint32_t count, void* userData );
+	static void   cullJob( void* userData );
+	static void   cullRange( uint32_t first, uint32_t count, void* userData );
+	static void   sortJob( void* userData );
+
+	static void reportRate( const char* name,
+	                        double milliseconds,
+	                        uint64_t numItems,
+	                        const char* unit );
+};
+
+#endif // BENCHMARK_H
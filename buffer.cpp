@@ -2,6 +2,8 @@
 #include "memorypool.h"
 #include "renderer.h"
 
+std::atomic<uint64_t> Buffer::s_NextId( 1 );
+
 Buffer::Buffer( Renderer& renderer, uint64_t size, VkBufferUsageFlags usage )
     : Buffer( renderer, size, usage, {} )
 {
@@ -14,7 +16,8 @@ Buffer::Buffer( Renderer& renderer,
     : wrapper_type( renderer.getNativeDeviceHandle() ),
       m_pRenderer( &renderer ),
       m_pMemoryPool( nullptr ),
-      m_uSize( 0 )
+      m_uSize( 0 ),
+      m_uId( s_NextId++ )
 {
 	if( !createBuffer( size, usage, queues ) )
 	{
@@ -110,6 +113,26 @@ void Buffer::unmap()
 	m_pMemoryPool->unmap();
 }
 
+bool Buffer::invalidate()
+{
+	return invalidate( 0, m_uSize );
+}
+
+bool Buffer::invalidate( uint64_t offset, uint64_t length )
+{
+	return m_pMemoryPool->invalidate( *this, offset, length );
+}
+
+bool Buffer::flush()
+{
+	return flush( 0, m_uSize );
+}
+
+bool Buffer::flush( uint64_t offset, uint64_t length )
+{
+	return m_pMemoryPool->flush( *this, offset, length );
+}
+
 bool Buffer::createBuffer( uint64_t size,
                            VkBufferUsageFlags usage,
                            const std::vector<uint32_t>& queues )
@@ -6,6 +6,7 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <atomic>
 
 class Renderer;
 class MemoryPool;
@@ -34,6 +35,13 @@ public:
 		return m_uSize;
 	}
 
+	// unique for the application's lifetime, unlike handles, which the driver reuses
+	// once a buffer is destroyed
+	uint64_t getId()
+	{
+		return m_uId;
+	}
+
 	void     getMemoryRequirements( uint64_t* alignment, uint32_t* typeFilter, uint64_t* size );
 
 	bool     allocateMemoryFromPool( MemoryPool& pool );
@@ -43,8 +51,10 @@ public:
 	void*    map( uint64_t offset, uint64_t length );
 	void     unmap();
 
-	void     invalidate( Buffer&, uint64_t offset, uint64_t length ); // TODO: implement
-	void     flush( Buffer&, uint64_t offset, uint64_t length );      // TODO: implement
+	bool     invalidate();
+	bool     invalidate( uint64_t offset, uint64_t length );
+	bool     flush();
+	bool     flush( uint64_t offset, uint64_t length );
 
 private:
 	bool     createBuffer( uint64_t size,
@@ -52,9 +62,12 @@ private:
 	                       const std::vector<uint32_t>& queues );
 
 private:
+	static std::atomic<uint64_t> s_NextId;
+
 	Renderer*   m_pRenderer;
 	MemoryPool* m_pMemoryPool;
 	uint64_t    m_uSize;
+	uint64_t    m_uId;
 };
 
 #endif // BUFFER_H
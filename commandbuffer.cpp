@@ -2,20 +2,34 @@
 #include "commandpool.h"
 #include "renderer.h"
 #include "pipeline.h"
+#include "computepipeline.h"
 #include "buffer.h"
 #include "renderpass.h"
 #include "descriptorset.h"
+#include "mesh.h"
+
+#include <algorithm>
 
 CommandBuffer::CommandBuffer()
     : m_vkCommandBuffer( VK_NULL_HANDLE ),
-      m_pPool( nullptr )
+      m_vkLevel( VK_COMMAND_BUFFER_LEVEL_PRIMARY ),
+      m_pPool( nullptr ),
+      m_bTrackState( false ),
+      m_uNumSkippedBinds( 0 )
 {
+	resetTrackedState();
 }
 
 CommandBuffer::CommandBuffer( CommandPool& pool )
+    : CommandBuffer( pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY )
+{
+}
+
+CommandBuffer::CommandBuffer( CommandPool& pool, VkCommandBufferLevel level )
     : CommandBuffer()
 {
-	m_pPool = &pool;
+	m_pPool   = &pool;
+	m_vkLevel = level;
 
 	if( !allocateBuffer() )
 	{
@@ -23,6 +37,16 @@ CommandBuffer::CommandBuffer( CommandPool& pool )
 	}
 }
 
+CommandBuffer::CommandBuffer( CommandPool& pool,
+                              VkCommandBufferLevel level,
+                              VkCommandBuffer handle )
+    : CommandBuffer()
+{
+	m_vkCommandBuffer = handle;
+	m_vkLevel         = level;
+	m_pPool           = &pool;
+}
+
 CommandBuffer::~CommandBuffer()
 {
 	destroy();
@@ -42,6 +66,12 @@ void CommandBuffer::destroy()
 	m_pPool = nullptr;
 }
 
+void CommandBuffer::release()
+{
+	m_vkCommandBuffer = VK_NULL_HANDLE;
+	m_pPool           = nullptr;
+}
+
 bool CommandBuffer::begin( VkCommandBufferUsageFlags usage )
 {
 	VkCommandBufferBeginInfo beginInfo{};
@@ -50,6 +80,9 @@ bool CommandBuffer::begin( VkCommandBufferUsageFlags usage )
 	beginInfo.flags            = usage;
 	beginInfo.pInheritanceInfo = nullptr;
 
+	resetTrackedState();
+	m_uNumSkippedBinds = 0;
+
 	VkResult res = vkBeginCommandBuffer( m_vkCommandBuffer, &beginInfo );
 
 	if( res != VK_SUCCESS )
@@ -60,6 +93,41 @@ bool CommandBuffer::begin( VkCommandBufferUsageFlags usage )
 	return true;
 }
 
+bool CommandBuffer::begin( VkCommandBufferUsageFlags usage,
+                           RenderPass& renderPass,
+                           uint32_t subpass,
+                           VkFramebuffer framebuffer )
+{
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType                = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext                = nullptr;
+	inheritanceInfo.renderPass           = renderPass.getNativeHandle();
+	inheritanceInfo.subpass              = subpass;
+	inheritanceInfo.framebuffer          = framebuffer;
+	inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+	inheritanceInfo.queryFlags           = 0;
+	inheritanceInfo.pipelineStatistics   = 0;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.pNext            = nullptr;
+	beginInfo.flags            = usage | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	// secondary command buffers never inherit bindings
+	resetTrackedState();
+	m_uNumSkippedBinds = 0;
+
+	VkResult res = vkBeginCommandBuffer( m_vkCommandBuffer, &beginInfo );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot begin secondary command buffer recording." );
+		return false;
+	}
+	return true;
+}
+
 bool CommandBuffer::end()
 {
 	VkResult res = vkEndCommandBuffer( m_vkCommandBuffer );
@@ -69,7 +137,36 @@ bool CommandBuffer::end()
 void CommandBuffer::beginRenderPass( RenderPass& renderPass,
                                      VkFramebuffer frambuffer,
                                      VkRect2D renderArea,
-                                     std::vector<VkClearValue> clearValues )
+                                     const std::vector<VkClearValue>& clearValues )
+{
+	beginRenderPass( renderPass,
+	                 frambuffer,
+	                 renderArea,
+	                 clearValues.size(),
+	                 clearValues.data(),
+	                 VK_SUBPASS_CONTENTS_INLINE );
+}
+
+void CommandBuffer::beginRenderPass( RenderPass& renderPass,
+                                     VkFramebuffer frambuffer,
+                                     VkRect2D renderArea,
+                                     const std::vector<VkClearValue>& clearValues,
+                                     VkSubpassContents contents )
+{
+	beginRenderPass( renderPass,
+	                 frambuffer,
+	                 renderArea,
+	                 clearValues.size(),
+	                 clearValues.data(),
+	                 contents );
+}
+
+void CommandBuffer::beginRenderPass( RenderPass& renderPass,
+                                     VkFramebuffer frambuffer,
+                                     VkRect2D renderArea,
+                                     uint32_t numClearValues,
+                                     const VkClearValue* clearValues,
+                                     VkSubpassContents contents )
 {
 	    VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -77,13 +174,17 @@ void CommandBuffer::beginRenderPass( RenderPass& renderPass,
 		renderPassInfo.renderPass        = renderPass.getNativeHandle();
 		renderPassInfo.framebuffer       = frambuffer;
 		renderPassInfo.renderArea        = renderArea;
-		renderPassInfo.clearValueCount   = clearValues.size();
-		renderPassInfo.pClearValues      = clearValues.data();
+		renderPassInfo.clearValueCount   = numClearValues;
+		renderPassInfo.pClearValues      = clearValues;
 
-		// TODO: subpass contents selection
 		vkCmdBeginRenderPass( m_vkCommandBuffer,
 		                      &renderPassInfo,
-		                      VK_SUBPASS_CONTENTS_INLINE );
+		                      contents );
+}
+
+void CommandBuffer::nextSubpass( VkSubpassContents contents )
+{
+	vkCmdNextSubpass( m_vkCommandBuffer, contents );
 }
 
 void CommandBuffer::endRenderPass()
@@ -91,57 +192,240 @@ void CommandBuffer::endRenderPass()
 	vkCmdEndRenderPass( m_vkCommandBuffer );
 }
 
+void CommandBuffer::executeCommands( const std::vector<CommandBuffer*>& commandBuffers )
+{
+	std::vector<VkCommandBuffer> handles( commandBuffers.size() );
+	for( auto i = 0; i < handles.size(); ++i )
+	{
+		handles[ i ] = commandBuffers[ i ]->getNativeHandle();
+	}
+
+	if( !handles.empty() )
+	{
+		vkCmdExecuteCommands( m_vkCommandBuffer, handles.size(), handles.data() );
+	}
+
+	// bound state is undefined after executing secondary command buffers
+	resetTrackedState();
+}
+
 void CommandBuffer::bindPipeline( VkPipelineBindPoint bindPoint, Pipeline& pipeline )
 {
-	vkCmdBindPipeline( m_vkCommandBuffer, bindPoint, pipeline.getNativeHandle() );
+	bindPipeline( bindPoint, pipeline.getNativeHandle() );
+}
+
+void CommandBuffer::bindPipeline( ComputePipeline& pipeline )
+{
+	bindPipeline( VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.getNativeHandle() );
+}
+
+void CommandBuffer::bindPipeline( VkPipelineBindPoint bindPoint, VkPipeline handle )
+{
+	if( m_bTrackState && handle == m_vkBoundPipeline )
+	{
+		++m_uNumSkippedBinds;
+		return;
+	}
+
+	vkCmdBindPipeline( m_vkCommandBuffer, bindPoint, handle );
+
+	m_vkBoundPipeline = handle;
+}
+
+void CommandBuffer::bindVertexBuffers( uint32_t firstIndex,
+                                       const std::vector<Buffer*>& buffers,
+                                       const std::vector<uint64_t>& offsets )
+{
+	bindVertexBuffers( firstIndex, buffers.size(), buffers.data(), offsets.data() );
 }
 
 void CommandBuffer::bindVertexBuffers( uint32_t firstIndex,
-                                       std::vector<Buffer*> buffers,
-                                       std::vector<uint64_t> offsets )
+                                       uint32_t numBuffers,
+                                       Buffer* const* buffers,
+                                       const uint64_t* offsets )
 {
-	std::vector<VkBuffer> bufferHandles( buffers.size() );
-	for( auto i = 0; i < bufferHandles.size(); ++i )
+	if( firstIndex + numBuffers > MAX_VERTEX_BUFFERS )
+	{
+		log_error( "Cannot bind more than MAX_VERTEX_BUFFERS vertex buffers." );
+		return;
+	}
+
+	VkBuffer bufferHandles[ MAX_VERTEX_BUFFERS ];
+
+	bool redundant = m_bTrackState;
+	for( auto i = 0; i < numBuffers; ++i )
 	{
 		bufferHandles[ i ] = buffers[ i ]->getNativeHandle();
+
+		redundant = redundant &&
+		            bufferHandles[ i ] == m_vkBoundVertexBuffers[ firstIndex + i ] &&
+		            offsets[ i ] == m_uBoundVertexOffsets[ firstIndex + i ];
+	}
+
+	if( redundant )
+	{
+		++m_uNumSkippedBinds;
+		return;
 	}
 
 	vkCmdBindVertexBuffers( m_vkCommandBuffer,
 	                        firstIndex,
-	                        buffers.size(),
-	                        bufferHandles.data(),
-	                        offsets.data() );
+	                        numBuffers,
+	                        bufferHandles,
+	                        offsets );
+
+	for( auto i = 0; i < numBuffers; ++i )
+	{
+		m_vkBoundVertexBuffers[ firstIndex + i ] = bufferHandles[ i ];
+		m_uBoundVertexOffsets[ firstIndex + i ]  = offsets[ i ];
+	}
+}
+
+void CommandBuffer::bindVertexBuffer( uint32_t index, Buffer& buffer, uint64_t offset )
+{
+	Buffer* pBuffer = &buffer;
+	bindVertexBuffers( index, 1, &pBuffer, &offset );
 }
 
 void CommandBuffer::bindIndexBuffer( Buffer& buffer, uint64_t offset, VkIndexType indexType )
 {
-	vkCmdBindIndexBuffer( m_vkCommandBuffer, buffer.getNativeHandle(), offset, indexType );
+	VkBuffer handle = buffer.getNativeHandle();
+
+	if( m_bTrackState &&
+	    handle == m_vkBoundIndexBuffer &&
+	    offset == m_uBoundIndexOffset &&
+	    indexType == m_vkBoundIndexType )
+	{
+		++m_uNumSkippedBinds;
+		return;
+	}
+
+	vkCmdBindIndexBuffer( m_vkCommandBuffer, handle, offset, indexType );
+
+	m_vkBoundIndexBuffer = handle;
+	m_uBoundIndexOffset  = offset;
+	m_vkBoundIndexType   = indexType;
+}
+
+void CommandBuffer::bindMesh( const Mesh& mesh )
+{
+	if( mesh.pInstanceBuffer != nullptr )
+	{
+		Buffer* const  buffers[] = { mesh.pVertexBuffer, mesh.pInstanceBuffer };
+		const uint64_t offsets[] = { mesh.vertexOffset, mesh.instanceOffset };
+
+		bindVertexBuffers( 0, 2, buffers, offsets );
+	}
+	else
+	{
+		bindVertexBuffer( 0, *mesh.pVertexBuffer, mesh.vertexOffset );
+	}
+
+	bindIndexBuffer( *mesh.pIndexBuffer, mesh.indexOffset, mesh.indexType );
 }
 
 void CommandBuffer::bindDescriptorSet( DescriptorSet& set,
                                        VkPipelineBindPoint bindPoint,
                                        Pipeline& pipeline )
 {
-	VkDescriptorSet setHandle = set.getNativeHandle();
+	bindDescriptorSet( set.getNativeHandle(), bindPoint, pipeline.getLayout() );
+}
+
+void CommandBuffer::bindDescriptorSet( DescriptorSet& set, ComputePipeline& pipeline )
+{
+	bindDescriptorSet( set.getNativeHandle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.getLayout() );
+}
+
+void CommandBuffer::bindDescriptorSet( VkDescriptorSet set,
+                                       VkPipelineBindPoint bindPoint,
+                                       Pipeline& pipeline )
+{
+	bindDescriptorSet( set, bindPoint, pipeline.getLayout() );
+}
+
+void CommandBuffer::bindDescriptorSet( VkDescriptorSet set, ComputePipeline& pipeline )
+{
+	bindDescriptorSet( set, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.getLayout() );
+}
+
+void CommandBuffer::bindDescriptorSet( VkDescriptorSet setHandle,
+                                       VkPipelineBindPoint bindPoint,
+                                       VkPipelineLayout layout )
+{
+	// sets stay bound across pipelines with the same layout
+	if( m_bTrackState &&
+	    setHandle == m_vkBoundDescriptorSet &&
+	    layout == m_vkBoundLayout &&
+	    bindPoint == m_vkBoundSetBindPoint )
+	{
+		++m_uNumSkippedBinds;
+		return;
+	}
 
 	vkCmdBindDescriptorSets( m_vkCommandBuffer,
 	                         bindPoint,
-	                         pipeline.getLayout(),
+	                         layout,
 	                         0,
 	                         1,
 	                         &setHandle,
 	                         0,
 	                         nullptr );
+
+	m_vkBoundDescriptorSet = setHandle;
+	m_vkBoundLayout        = layout;
+	m_vkBoundSetBindPoint  = bindPoint;
+}
+
+void CommandBuffer::pushConstants( Pipeline& pipeline,
+                                   VkShaderStageFlags stages,
+                                   uint32_t offset,
+                                   uint32_t size,
+                                   const void* data )
+{
+	pushConstants( pipeline.getLayout(), stages, offset, size, data );
+}
+
+void CommandBuffer::pushConstants( VkPipelineLayout layout,
+                                   VkShaderStageFlags stages,
+                                   uint32_t offset,
+                                   uint32_t size,
+                                   const void* data )
+{
+	vkCmdPushConstants( m_vkCommandBuffer, layout, stages, offset, size, data );
+}
+
+void CommandBuffer::setViewports( uint32_t firstIndex, const std::vector<VkViewport>& viewports )
+{
+	setViewports( firstIndex, viewports.size(), viewports.data() );
+}
+
+void CommandBuffer::setViewports( uint32_t firstIndex,
+                                  uint32_t numViewports,
+                                  const VkViewport* viewports )
+{
+	vkCmdSetViewport( m_vkCommandBuffer, firstIndex, numViewports, viewports );
 }
 
-void CommandBuffer::setViewports( uint32_t firstIndex, std::vector<VkViewport> viewports )
+void CommandBuffer::setViewport( uint32_t index, const VkViewport& viewport )
 {
-	vkCmdSetViewport( m_vkCommandBuffer, firstIndex, viewports.size(), viewports.data() );
+	setViewports( index, 1, &viewport );
 }
 
-void CommandBuffer::setScissors( uint32_t firstIndex, std::vector<VkRect2D> scissors )
+void CommandBuffer::setScissors( uint32_t firstIndex, const std::vector<VkRect2D>& scissors )
 {
-	vkCmdSetScissor( m_vkCommandBuffer, firstIndex, scissors.size(), scissors.data() );
+	setScissors( firstIndex, scissors.size(), scissors.data() );
+}
+
+void CommandBuffer::setScissors( uint32_t firstIndex,
+                                 uint32_t numScissors,
+                                 const VkRect2D* scissors )
+{
+	vkCmdSetScissor( m_vkCommandBuffer, firstIndex, numScissors, scissors );
+}
+
+void CommandBuffer::setScissor( uint32_t index, const VkRect2D& scissor )
+{
+	setScissors( index, 1, &scissor );
 }
 
 void CommandBuffer::draw( uint32_t firstVertex,
@@ -170,23 +454,146 @@ void CommandBuffer::drawIndexed( uint32_t firstIndex,
 	                  firstInstance );
 }
 
-void CommandBuffer::copyBuffer( Buffer& dst, Buffer& src, std::vector<VkBufferCopy> regions )
+void CommandBuffer::drawIndirect( Buffer& buffer,
+                                  uint64_t offset,
+                                  uint32_t drawCount,
+                                  uint32_t stride )
+{
+	uint32_t maxDrawCount = getMaxDrawIndirectCount();
+
+	for( uint32_t first = 0; first < drawCount; first += maxDrawCount )
+	{
+		vkCmdDrawIndirect( m_vkCommandBuffer,
+		                   buffer.getNativeHandle(),
+		                   offset + (uint64_t)first * stride,
+		                   std::min( drawCount - first, maxDrawCount ),
+		                   stride );
+	}
+}
+
+void CommandBuffer::drawIndexedIndirect( Buffer& buffer,
+                                         uint64_t offset,
+                                         uint32_t drawCount,
+                                         uint32_t stride )
+{
+	uint32_t maxDrawCount = getMaxDrawIndirectCount();
+
+	for( uint32_t first = 0; first < drawCount; first += maxDrawCount )
+	{
+		vkCmdDrawIndexedIndirect( m_vkCommandBuffer,
+		                          buffer.getNativeHandle(),
+		                          offset + (uint64_t)first * stride,
+		                          std::min( drawCount - first, maxDrawCount ),
+		                          stride );
+	}
+}
+
+uint32_t CommandBuffer::getMaxDrawIndirectCount()
+{
+	Renderer& renderer = m_pPool->getRenderer();
+
+	if( !renderer.getEnabledFeatures().multiDrawIndirect )
+		return 1;
+
+	return std::max( renderer.getLimits().maxDrawIndirectCount, 1u );
+}
+
+void CommandBuffer::drawIndirectCount( Buffer& buffer,
+                                       uint64_t offset,
+                                       Buffer& countBuffer,
+                                       uint64_t countOffset,
+                                       uint32_t maxDrawCount,
+                                       uint32_t stride )
+{
+	m_pPool->getRenderer().getCmdDrawIndirectCount()( m_vkCommandBuffer,
+	                                                  buffer.getNativeHandle(),
+	                                                  offset,
+	                                                  countBuffer.getNativeHandle(),
+	                                                  countOffset,
+	                                                  maxDrawCount,
+	                                                  stride );
+}
+
+void CommandBuffer::drawIndexedIndirectCount( Buffer& buffer,
+                                              uint64_t offset,
+                                              Buffer& countBuffer,
+                                              uint64_t countOffset,
+                                              uint32_t maxDrawCount,
+                                              uint32_t stride )
+{
+	m_pPool->getRenderer().getCmdDrawIndexedIndirectCount()( m_vkCommandBuffer,
+	                                                         buffer.getNativeHandle(),
+	                                                         offset,
+	                                                         countBuffer.getNativeHandle(),
+	                                                         countOffset,
+	                                                         maxDrawCount,
+	                                                         stride );
+}
+
+void CommandBuffer::dispatch( uint32_t numGroupsX, uint32_t numGroupsY, uint32_t numGroupsZ )
+{
+	vkCmdDispatch( m_vkCommandBuffer, numGroupsX, numGroupsY, numGroupsZ );
+}
+
+void CommandBuffer::fillBuffer( Buffer& dst, uint64_t offset, uint64_t length, uint32_t data )
+{
+	vkCmdFillBuffer( m_vkCommandBuffer, dst.getNativeHandle(), offset, length, data );
+}
+
+void CommandBuffer::copyBuffer( Buffer& dst, Buffer& src, const std::vector<VkBufferCopy>& regions )
+{
+	copyBuffer( dst, src, regions.size(), regions.data() );
+}
+
+void CommandBuffer::copyBuffer( Buffer& dst,
+                                Buffer& src,
+                                uint32_t numRegions,
+                                const VkBufferCopy* regions )
 {
 	vkCmdCopyBuffer( m_vkCommandBuffer,
 	                 src.getNativeHandle(),
 	                 dst.getNativeHandle(),
-	                 regions.size(),
-	                 regions.data() );
+	                 numRegions,
+	                 regions );
+}
+
+void CommandBuffer::copyImageToBuffer( Buffer& dst,
+                                       VkImage src,
+                                       VkImageLayout srcLayout,
+                                       const std::vector<VkBufferImageCopy>& regions )
+{
+	vkCmdCopyImageToBuffer( m_vkCommandBuffer,
+	                        src,
+	                        srcLayout,
+	                        dst.getNativeHandle(),
+	                        regions.size(),
+	                        regions.data() );
+}
+
+void CommandBuffer::pipelineBarrier( VkPipelineStageFlags srcStages,
+                                     VkPipelineStageFlags dstStages,
+                                     const std::vector<VkBufferMemoryBarrier>& bufferBarriers,
+                                     const std::vector<VkImageMemoryBarrier>& imageBarriers )
+{
+	vkCmdPipelineBarrier( m_vkCommandBuffer,
+	                      srcStages,
+	                      dstStages,
+	                      0,
+	                      0,
+	                      nullptr,
+	                      bufferBarriers.size(),
+	                      ( bufferBarriers.empty() ? nullptr : bufferBarriers.data() ),
+	                      imageBarriers.size(),
+	                      ( imageBarriers.empty() ? nullptr : imageBarriers.data() ) );
 }
 
 bool CommandBuffer::allocateBuffer()
 {
-	// TODO: buffer level selection
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.pNext              = nullptr;
 	allocInfo.commandPool        = m_pPool->getNativeHandle();
-	allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.level              = m_vkLevel;
 	allocInfo.commandBufferCount = 1;
 
 	VkResult res = vkAllocateCommandBuffers( m_pPool->getRenderer().getNativeDeviceHandle(),
@@ -199,3 +606,20 @@ bool CommandBuffer::allocateBuffer()
 	}
 	return true;
 }
+
+void CommandBuffer::resetTrackedState()
+{
+	m_vkBoundPipeline      = VK_NULL_HANDLE;
+	m_vkBoundLayout        = VK_NULL_HANDLE;
+	m_vkBoundSetBindPoint  = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	m_vkBoundDescriptorSet = VK_NULL_HANDLE;
+	m_vkBoundIndexBuffer   = VK_NULL_HANDLE;
+	m_uBoundIndexOffset    = 0;
+	m_vkBoundIndexType     = VK_INDEX_TYPE_UINT32;
+
+	for( auto i = 0; i < MAX_VERTEX_BUFFERS; ++i )
+	{
+		m_vkBoundVertexBuffers[ i ] = VK_NULL_HANDLE;
+		m_uBoundVertexOffsets[ i ]  = 0;
+	}
+}
@@ -8,19 +8,30 @@
 
 class CommandPool;
 class Pipeline;
+class ComputePipeline;
 class Buffer;
 class RenderPass;
 class DescriptorSet;
+struct Mesh;
 
 class CommandBuffer
 {
+public:
+	static constexpr uint32_t MAX_VERTEX_BUFFERS = 16;
+
 public:
 	CommandBuffer();
 	CommandBuffer( CommandPool& pool );
+	CommandBuffer( CommandPool& pool, VkCommandBufferLevel level );
+	// takes ownership of a command buffer already allocated from the pool
+	CommandBuffer( CommandPool& pool, VkCommandBufferLevel level, VkCommandBuffer handle );
 	~CommandBuffer();
 
 	void destroy();
 
+	// gives up ownership without freeing, e.g. after the pool freed the buffer in bulk
+	void release();
+
 	VkCommandBuffer getNativeHandle()
 	{
 		return m_vkCommandBuffer;
@@ -30,27 +41,90 @@ public:
 		return ( m_vkCommandBuffer != VK_NULL_HANDLE );
 	}
 
+	VkCommandBufferLevel getLevel()
+	{
+		return m_vkLevel;
+	}
+
+	// skips binds of pipelines, descriptor sets and vertex/index buffers that are
+	// already bound, the tracked state is reset whenever recording begins
+	void            setStateTracking( bool enable )
+	{
+		m_bTrackState = enable;
+	}
+	uint32_t        getNumSkippedBinds()
+	{
+		return m_uNumSkippedBinds;
+	}
+
 	bool begin( VkCommandBufferUsageFlags usage );
+	// begins a secondary command buffer continuing the given render pass subpass
+	bool begin( VkCommandBufferUsageFlags usage,
+	            RenderPass& renderPass,
+	            uint32_t subpass,
+	            VkFramebuffer framebuffer );
 	bool end();
 
+	// the overloads taking a pointer and count never allocate and should be preferred
+	// for per-frame recording, the std::vector overloads forward to them
+
 	// TODO: replace framebuffer with wrapper classes
 	void beginRenderPass( RenderPass& renderPass,
 	                      VkFramebuffer frambuffer,
 	                      VkRect2D renderArea,
-	                      std::vector<VkClearValue> clearValues );
+	                      const std::vector<VkClearValue>& clearValues );
+	void beginRenderPass( RenderPass& renderPass,
+	                      VkFramebuffer frambuffer,
+	                      VkRect2D renderArea,
+	                      const std::vector<VkClearValue>& clearValues,
+	                      VkSubpassContents contents );
+	void beginRenderPass( RenderPass& renderPass,
+	                      VkFramebuffer frambuffer,
+	                      VkRect2D renderArea,
+	                      uint32_t numClearValues,
+	                      const VkClearValue* clearValues,
+	                      VkSubpassContents contents );
+	void nextSubpass( VkSubpassContents contents );
 	void endRenderPass();
 
+	void executeCommands( const std::vector<CommandBuffer*>& commandBuffers );
+
 	void bindPipeline( VkPipelineBindPoint bindPoint, Pipeline& pipeline );
+	void bindPipeline( ComputePipeline& pipeline );
+	void bindVertexBuffers( uint32_t firstIndex,
+	                        const std::vector<Buffer*>& buffers,
+	                        const std::vector<uint64_t>& offsets );
 	void bindVertexBuffers( uint32_t firstIndex,
-	                        std::vector<Buffer*> buffers,
-	                        std::vector<uint64_t> offsets );
+	                        uint32_t numBuffers,
+	                        Buffer* const* buffers,
+	                        const uint64_t* offsets );
+	void bindVertexBuffer( uint32_t index, Buffer& buffer, uint64_t offset );
 	void bindIndexBuffer( Buffer& buffer, uint64_t offset, VkIndexType indexType );
+	// binds the vertex stream (and instance stream if present) and the index buffer
+	void bindMesh( const Mesh& mesh );
 	void bindDescriptorSet( DescriptorSet& set,
 	                        VkPipelineBindPoint bindPoint,
 	                        Pipeline& pipeline );
-
-	void setViewports( uint32_t firstIndex, std::vector<VkViewport> viewports );
-	void setScissors( uint32_t firstIndex, std::vector<VkRect2D> scissors );
+	void bindDescriptorSet( DescriptorSet& set, ComputePipeline& pipeline );
+	// transient sets of a DescriptorAllocator
+	void bindDescriptorSet( VkDescriptorSet set,
+	                        VkPipelineBindPoint bindPoint,
+	                        Pipeline& pipeline );
+	void bindDescriptorSet( VkDescriptorSet set, ComputePipeline& pipeline );
+
+	// updates push constants within a range declared on the pipeline layout
+	void pushConstants( Pipeline& pipeline,
+	                    VkShaderStageFlags stages,
+	                    uint32_t offset,
+	                    uint32_t size,
+	                    const void* data );
+
+	void setViewports( uint32_t firstIndex, const std::vector<VkViewport>& viewports );
+	void setViewports( uint32_t firstIndex, uint32_t numViewports, const VkViewport* viewports );
+	void setViewport( uint32_t index, const VkViewport& viewport );
+	void setScissors( uint32_t firstIndex, const std::vector<VkRect2D>& scissors );
+	void setScissors( uint32_t firstIndex, uint32_t numScissors, const VkRect2D* scissors );
+	void setScissor( uint32_t index, const VkRect2D& scissor );
 
 	void draw( uint32_t firstVertex,
 	           uint32_t numVertices,
@@ -62,15 +136,79 @@ public:
 	                  uint32_t firstInstance,
 	                  uint32_t numInstances );
 
-	void copyBuffer( Buffer& dst, Buffer& src, std::vector<VkBufferCopy> regions );
+	// issues drawCount draws from VkDraw(Indexed)IndirectCommand structures, split into
+	// calls of at most maxDrawIndirectCount draws, single draws if the multiDrawIndirect
+	// feature is not enabled
+	void drawIndirect( Buffer& buffer, uint64_t offset, uint32_t drawCount, uint32_t stride );
+	void drawIndexedIndirect( Buffer& buffer,
+	                          uint64_t offset,
+	                          uint32_t drawCount,
+	                          uint32_t stride );
+	// reads the draw count from countBuffer, requires Renderer::supportsDrawIndirectCount()
+	void drawIndirectCount( Buffer& buffer,
+	                        uint64_t offset,
+	                        Buffer& countBuffer,
+	                        uint64_t countOffset,
+	                        uint32_t maxDrawCount,
+	                        uint32_t stride );
+	void drawIndexedIndirectCount( Buffer& buffer,
+	                               uint64_t offset,
+	                               Buffer& countBuffer,
+	                               uint64_t countOffset,
+	                               uint32_t maxDrawCount,
+	                               uint32_t stride );
+
+	void dispatch( uint32_t numGroupsX, uint32_t numGroupsY, uint32_t numGroupsZ );
+
+	void fillBuffer( Buffer& dst, uint64_t offset, uint64_t length, uint32_t data );
+
+	void copyBuffer( Buffer& dst, Buffer& src, const std::vector<VkBufferCopy>& regions );
+	void copyBuffer( Buffer& dst, Buffer& src, uint32_t numRegions, const VkBufferCopy* regions );
+	void copyImageToBuffer( Buffer& dst,
+	                        VkImage src,
+	                        VkImageLayout srcLayout,
+	                        const std::vector<VkBufferImageCopy>& regions );
+
+	void pipelineBarrier( VkPipelineStageFlags srcStages,
+	                      VkPipelineStageFlags dstStages,
+	                      const std::vector<VkBufferMemoryBarrier>& bufferBarriers,
+	                      const std::vector<VkImageMemoryBarrier>& imageBarriers );
 
 private:
 	bool allocateBuffer();
 
-private:
-	VkCommandBuffer m_vkCommandBuffer;
+	// draws per indirect call
+	uint32_t getMaxDrawIndirectCount();
 
-	CommandPool*    m_pPool;
+	void bindPipeline( VkPipelineBindPoint bindPoint, VkPipeline pipeline );
+	void bindDescriptorSet( VkDescriptorSet set,
+	                        VkPipelineBindPoint bindPoint,
+	                        VkPipelineLayout layout );
+	void pushConstants( VkPipelineLayout layout,
+	                    VkShaderStageFlags stages,
+	                    uint32_t offset,
+	                    uint32_t size,
+	                    const void* data );
+
+	void resetTrackedState();
+
+private:
+	VkCommandBuffer      m_vkCommandBuffer;
+	VkCommandBufferLevel m_vkLevel;
+
+	CommandPool*         m_pPool;
+
+	bool                 m_bTrackState;
+	uint32_t             m_uNumSkippedBinds;
+	VkPipeline           m_vkBoundPipeline;
+	VkPipelineLayout     m_vkBoundLayout;
+	VkPipelineBindPoint  m_vkBoundSetBindPoint;
+	VkDescriptorSet      m_vkBoundDescriptorSet;
+	VkBuffer             m_vkBoundVertexBuffers[ MAX_VERTEX_BUFFERS ];
+	uint64_t             m_uBoundVertexOffsets[ MAX_VERTEX_BUFFERS ];
+	VkBuffer             m_vkBoundIndexBuffer;
+	uint64_t             m_uBoundIndexOffset;
+	VkIndexType          m_vkBoundIndexType;
 };
 
 #endif // COMMANDBUFFER_H
@@ -1,14 +1,22 @@
 #include "commandpool.h"
 #include "renderer.h"
+#include "commandbuffer.h"
 
 CommandPool::CommandPool( Renderer& renderer, uint32_t queueFamily )
+    : CommandPool( renderer, queueFamily, 0 )
+{
+}
+
+CommandPool::CommandPool( Renderer& renderer,
+                          uint32_t queueFamily,
+                          VkCommandPoolCreateFlags flags )
     : wrapper_type( renderer.getNativeDeviceHandle() ),
       m_pRenderer( &renderer )
 {
 	VkCommandPoolCreateInfo createInfo{};
 	createInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	createInfo.pNext            = nullptr;
-	createInfo.flags            = 0;
+	createInfo.flags            = flags;
 	createInfo.queueFamilyIndex = queueFamily;
 
 	VkResult res = vkCreateCommandPool( m_vkDevice,
@@ -22,3 +30,66 @@ CommandPool::CommandPool( Renderer& renderer, uint32_t queueFamily )
 		destroy();
 	}
 }
+
+bool CommandPool::reset()
+{
+	VkResult res = vkResetCommandPool( m_vkDevice, m_vkHandle, 0 );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot reset command pool." );
+		return false;
+	}
+	return true;
+}
+
+bool CommandPool::allocateBuffers( VkCommandBufferLevel level,
+                                   uint32_t count,
+                                   std::vector<CommandBuffer*>& commandBuffers )
+{
+	std::vector<VkCommandBuffer> handles( count );
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.pNext              = nullptr;
+	allocInfo.commandPool        = m_vkHandle;
+	allocInfo.level              = level;
+	allocInfo.commandBufferCount = count;
+
+	VkResult res = vkAllocateCommandBuffers( m_vkDevice, &allocInfo, handles.data() );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot allocate command buffers." );
+		return false;
+	}
+
+	commandBuffers.reserve( commandBuffers.size() + count );
+	for( auto handle : handles )
+	{
+		commandBuffers.push_back( new CommandBuffer( *this, level, handle ) );
+	}
+	return true;
+}
+
+void CommandPool::freeBuffers( std::vector<CommandBuffer*>& commandBuffers )
+{
+	std::vector<VkCommandBuffer> handles;
+	handles.reserve( commandBuffers.size() );
+
+	for( auto commandBuffer : commandBuffers )
+	{
+		if( commandBuffer->isValid() )
+		{
+			handles.push_back( commandBuffer->getNativeHandle() );
+		}
+		commandBuffer->release();
+		delete commandBuffer;
+	}
+	commandBuffers.clear();
+
+	if( !handles.empty() )
+	{
+		vkFreeCommandBuffers( m_vkDevice, m_vkHandle, handles.size(), handles.data() );
+	}
+}
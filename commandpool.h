@@ -5,20 +5,33 @@
 #include "vulkanobjectwrapper.h"
 
 #include <vulkan/vulkan.h>
+#include <vector>
 
 class Renderer;
+class CommandBuffer;
 
 class CommandPool : public VulkanObjectWrapper<VkCommandPool, vkDestroyCommandPool>
 {
 public:
 	CommandPool() = default;
 	CommandPool( Renderer& renderer, uint32_t queueFamily );
+	CommandPool( Renderer& renderer, uint32_t queueFamily, VkCommandPoolCreateFlags flags );
 
 	Renderer&      getRenderer()
 	{
 		return *m_pRenderer;
 	}
 
+	// recycles all command buffers allocated from the pool at once
+	bool           reset();
+
+	// allocates command buffers with a single call, appending them to the given list
+	bool           allocateBuffers( VkCommandBufferLevel level,
+	                                uint32_t count,
+	                                std::vector<CommandBuffer*>& commandBuffers );
+	// frees command buffers with a single call and deletes them
+	void           freeBuffers( std::vector<CommandBuffer*>& commandBuffers );
+
 private:
 	Renderer*     m_pRenderer;
 };
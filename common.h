@@ -2,6 +2,8 @@
 #define COMMON_H
 
 #include <iostream>
+#include <cstdint>
+#include <cstddef>
 
 template<typename T>
 void log_info( const T& val )
@@ -37,6 +39,17 @@ void safe_delete( T*& ptr )
 	}
 }
 
+// FNV-1a, chained through the seed to hash several fields
+inline uint64_t hash_bytes( const void* data, size_t size, uint64_t seed = 14695981039346656037ull )
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>( data );
+	for( size_t i = 0; i < size; ++i )
+	{
+		seed = ( seed ^ bytes[ i ] ) * 1099511628211ull;
+	}
+	return seed;
+}
+
 template<typename PAY, typename RET, typename... PAR>
 class PayloadCallback
 {
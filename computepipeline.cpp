@@ -0,0 +1,105 @@
+#include "computepipeline.h"
+#include "renderer.h"
+#include "shader.h"
+#include "pipelinecache.h"
+#include "descriptorsetlayout.h"
+#include "layoutcache.h"
+
+ComputePipeline::ComputePipeline()
+    : m_vkPipeline( VK_NULL_HANDLE ),
+      m_vkLayout( VK_NULL_HANDLE ),
+      m_pRenderer( nullptr ),
+      m_DescriptorLayouts(),
+      m_uWorkgroupSize{ 1, 1, 1 }
+{
+}
+
+ComputePipeline::ComputePipeline( Renderer& renderer,
+                                  Shader& shader,
+                                  const SpecializationConstants& specialization )
+    : ComputePipeline()
+{
+	m_pRenderer = &renderer;
+
+	if( !createLayout( shader ) ||
+	    !createPipeline( shader, specialization ) )
+	{
+		destroy();
+		return;
+	}
+
+	shader.getReflection().getWorkgroupSize( specialization, m_uWorkgroupSize );
+}
+
+ComputePipeline::~ComputePipeline()
+{
+	destroy();
+}
+
+void ComputePipeline::destroy()
+{
+	if( m_pRenderer == nullptr )
+		return;
+
+	VkDevice device = m_pRenderer->getNativeDeviceHandle();
+
+	if( m_vkPipeline != VK_NULL_HANDLE )
+	{
+		vkDestroyPipeline( device, m_vkPipeline, nullptr );
+		m_vkPipeline = VK_NULL_HANDLE;
+	}
+
+	m_vkLayout = VK_NULL_HANDLE;
+	m_DescriptorLayouts.clear();
+}
+
+bool ComputePipeline::createLayout( Shader& shader )
+{
+	LayoutCache::Layout layout;
+	if( !m_pRenderer->getLayoutCache().getLayout( { &shader }, layout ) )
+	{
+		log_error( "Cannot create compute pipeline layout." );
+		return false;
+	}
+
+	m_vkLayout          = layout.vkPipelineLayout;
+	m_DescriptorLayouts = layout.descriptorLayouts;
+	return true;
+}
+
+bool ComputePipeline::createPipeline( Shader& shader, const SpecializationConstants& specialization )
+{
+	VkSpecializationInfo specializationInfo = specialization.getInfo();
+
+	VkPipelineShaderStageCreateInfo stageInfo{};
+	stageInfo.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo.pNext               = nullptr;
+	stageInfo.flags               = 0;
+	stageInfo.stage               = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageInfo.module              = shader.getNativeHandle();
+	stageInfo.pName               = shader.getEntryFunction().c_str();
+	stageInfo.pSpecializationInfo = specialization.isEmpty() ? nullptr : &specializationInfo;
+
+	VkComputePipelineCreateInfo createInfo{};
+	createInfo.sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	createInfo.pNext              = nullptr;
+	createInfo.flags              = 0;
+	createInfo.stage              = stageInfo;
+	createInfo.layout             = m_vkLayout;
+	createInfo.basePipelineHandle = VK_NULL_HANDLE;
+	createInfo.basePipelineIndex  = -1;
+
+	VkResult res = vkCreateComputePipelines( m_pRenderer->getNativeDeviceHandle(),
+	                                         m_pRenderer->getPipelineCache().getNativeHandle(),
+	                                         1,
+	                                         &createInfo,
+	                                         nullptr,
+	                                         &m_vkPipeline );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot create compute pipeline." );
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,68 @@
+#ifndef COMPUTEPIPELINE_H
+#define COMPUTEPIPELINE_H
+
+#include "common.h"
+#include "specializationconstants.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+class Renderer;
+class Shader;
+class DescriptorSetLayout;
+
+class ComputePipeline
+{
+public:
+	ComputePipeline();
+	// the layout is derived from the shader's reflection and shared through the
+	// renderer's cache
+	ComputePipeline( Renderer& renderer,
+	                 Shader& shader,
+	                 const SpecializationConstants& specialization = SpecializationConstants() );
+	~ComputePipeline();
+
+	void             destroy();
+
+	VkPipeline       getNativeHandle()
+	{
+		return m_vkPipeline;
+	}
+	bool             isValid()
+	{
+		return ( m_vkPipeline != VK_NULL_HANDLE );
+	}
+
+	VkPipelineLayout getLayout()
+	{
+		return m_vkLayout;
+	}
+
+	// nullptr for sets the shader does not use
+	DescriptorSetLayout* getDescriptorSetLayout( uint32_t set )
+	{
+		return ( set < m_DescriptorLayouts.size() ? m_DescriptorLayouts[ set ] : nullptr );
+	}
+
+	// local size as specialized for this pipeline
+	const uint32_t*  getWorkgroupSize()
+	{
+		return m_uWorkgroupSize;
+	}
+
+private:
+	bool createLayout( Shader& shader );
+	bool createPipeline( Shader& shader, const SpecializationConstants& specialization );
+
+private:
+	VkPipeline       m_vkPipeline;
+	// owned by the renderer's layout cache
+	VkPipelineLayout m_vkLayout;
+
+	Renderer*        m_pRenderer;
+
+	std::vector<DescriptorSetLayout*> m_DescriptorLayouts;
+	uint32_t                          m_uWorkgroupSize[ 3 ];
+};
+
+#endif // COMPUTEPIPELINE_H
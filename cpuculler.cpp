@@ -0,0 +1,358 @@
+#include "cpuculler.h"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define CPUCULLER_X86
+#include <immintrin.h>
+#endif
+
+#define CPUCULLER_TARGET_SSE  __attribute__(( target( "sse2" ) ))
+#define CPUCULLER_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+
+namespace
+{
+
+// appends first + the index of every set bit in mask to visible
+inline uint32_t appendVisible( uint32_t mask, uint32_t first, uint32_t* visible )
+{
+	uint32_t numVisible = 0;
+	while( mask != 0 )
+	{
+		visible[ numVisible++ ] = first + __builtin_ctz( mask );
+		mask &= mask - 1;
+	}
+	return numVisible;
+}
+
+} // namespace
+
+CpuCuller::CpuCuller()
+    : m_InstructionSet( detectInstructionSet() ),
+      m_CenterX(),
+      m_CenterY(),
+      m_CenterZ(),
+      m_Radius(),
+      m_MinX(),
+      m_MinY(),
+      m_MinZ(),
+      m_MaxX(),
+      m_MaxY(),
+      m_MaxZ()
+{
+}
+
+CpuCuller::InstructionSet CpuCuller::detectInstructionSet()
+{
+#ifdef CPUCULLER_X86
+	__builtin_cpu_init();
+
+	if( __builtin_cpu_supports( "avx2" ) )
+	{
+		return InstructionSet::Avx2;
+	}
+	else if( __builtin_cpu_supports( "sse2" ) )
+	{
+		return InstructionSet::Sse;
+	}
+#endif
+	return InstructionSet::Scalar;
+}
+
+const char* CpuCuller::getInstructionSetName( InstructionSet instructionSet )
+{
+	switch( instructionSet )
+	{
+	case InstructionSet::Avx2:
+		return "avx2";
+	case InstructionSet::Sse:
+		return "sse";
+	default:
+		return "scalar";
+	}
+}
+
+void CpuCuller::setInstructionSet( InstructionSet instructionSet )
+{
+	InstructionSet supported = detectInstructionSet();
+
+	m_InstructionSet = ( (int)instructionSet <= (int)supported ? instructionSet : supported );
+}
+
+void CpuCuller::clear()
+{
+	for( auto array : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius,
+	                    &m_MinX, &m_MinY, &m_MinZ, &m_MaxX, &m_MaxY, &m_MaxZ } )
+	{
+		array->clear();
+	}
+}
+
+void CpuCuller::reserve( uint32_t numObjects )
+{
+	for( auto array : { &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius,
+	                    &m_MinX, &m_MinY, &m_MinZ, &m_MaxX, &m_MaxY, &m_MaxZ } )
+	{
+		array->reserve( numObjects );
+	}
+}
+
+uint32_t CpuCuller::add( const glm::vec3& center,
+                         float radius,
+                         const glm::vec3& boxMin,
+                         const glm::vec3& boxMax )
+{
+	m_CenterX.push_back( center.x );
+	m_CenterY.push_back( center.y );
+	m_CenterZ.push_back( center.z );
+	m_Radius.push_back( radius );
+
+	m_MinX.push_back( boxMin.x );
+	m_MinY.push_back( boxMin.y );
+	m_MinZ.push_back( boxMin.z );
+	m_MaxX.push_back( boxMax.x );
+	m_MaxY.push_back( boxMax.y );
+	m_MaxZ.push_back( boxMax.z );
+
+	return m_CenterX.size() - 1;
+}
+
+uint32_t CpuCuller::cull( const Frustum& frustum,
+                          Bounds bounds,
+                          uint32_t first,
+                          uint32_t count,
+                          uint32_t* visible ) const
+{
+	uint32_t last = first + count;
+
+	switch( m_InstructionSet )
+	{
+#ifdef CPUCULLER_X86
+	case InstructionSet::Avx2:
+		return ( bounds == Bounds::Sphere ? cullSpheresAvx2( frustum, first, last, visible )
+		                                  : cullBoxesAvx2( frustum, first, last, visible ) );
+	case InstructionSet::Sse:
+		return ( bounds == Bounds::Sphere ? cullSpheresSse( frustum, first, last, visible )
+		                                  : cullBoxesSse( frustum, first, last, visible ) );
+#endif
+	default:
+		return ( bounds == Bounds::Sphere ? cullSpheresScalar( frustum, first, last, visible )
+		                                  : cullBoxesScalar( frustum, first, last, visible ) );
+	}
+}
+
+uint32_t CpuCuller::cullSpheresScalar( const Frustum& frustum,
+                                       uint32_t first,
+                                       uint32_t last,
+                                       uint32_t* visible ) const
+{
+	uint32_t numVisible = 0;
+	for( auto i = first; i < last; ++i )
+	{
+		bool inside = true;
+		for( const auto& plane : frustum.planes )
+		{
+			float distance = plane.x * m_CenterX[ i ] +
+			                 plane.y * m_CenterY[ i ] +
+			                 plane.z * m_CenterZ[ i ] +
+			                 plane.w +
+			                 m_Radius[ i ];
+			inside = inside && ( distance >= 0.0f );
+		}
+
+		if( inside )
+		{
+			visible[ numVisible++ ] = i;
+		}
+	}
+	return numVisible;
+}
+
+uint32_t CpuCuller::cullBoxesScalar( const Frustum& frustum,
+                                     uint32_t first,
+                                     uint32_t last,
+                                     uint32_t* visible ) const
+{
+	uint32_t numVisible = 0;
+	for( auto i = first; i < last; ++i )
+	{
+		bool inside = true;
+		for( const auto& plane : frustum.planes )
+		{
+			// the box corner furthest along the plane normal
+			float distance = plane.x * ( plane.x > 0.0f ? m_MaxX[ i ] : m_MinX[ i ] ) +
+			                 plane.y * ( plane.y > 0.0f ? m_MaxY[ i ] : m_MinY[ i ] ) +
+			                 plane.z * ( plane.z > 0.0f ? m_MaxZ[ i ] : m_MinZ[ i ] ) +
+			                 plane.w;
+			inside = inside && ( distance >= 0.0f );
+		}
+
+		if( inside )
+		{
+			visible[ numVisible++ ] = i;
+		}
+	}
+	return numVisible;
+}
+
+#ifdef CPUCULLER_X86
+
+// the vector paths test one plane against a batch of objects at a time and finish
+// the objects not filling a whole batch with the scalar path
+
+CPUCULLER_TARGET_SSE
+uint32_t CpuCuller::cullSpheresSse( const Frustum& frustum,
+                                    uint32_t first,
+                                    uint32_t last,
+                                    uint32_t* visible ) const
+{
+	uint32_t numVisible = 0;
+	uint32_t i          = first;
+
+	for( ; i + 4 <= last; i += 4 )
+	{
+		__m128 x      = _mm_loadu_ps( &m_CenterX[ i ] );
+		__m128 y      = _mm_loadu_ps( &m_CenterY[ i ] );
+		__m128 z      = _mm_loadu_ps( &m_CenterZ[ i ] );
+		__m128 radius = _mm_loadu_ps( &m_Radius[ i ] );
+		__m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+
+		for( const auto& plane : frustum.planes )
+		{
+			__m128 distance = _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( plane.x ) ),
+			                              _mm_mul_ps( y, _mm_set1_ps( plane.y ) ) );
+			distance = _mm_add_ps( distance, _mm_mul_ps( z, _mm_set1_ps( plane.z ) ) );
+			distance = _mm_add_ps( distance, _mm_set1_ps( plane.w ) );
+			distance = _mm_add_ps( distance, radius );
+			inside = _mm_and_ps( inside, _mm_cmpge_ps( distance, _mm_setzero_ps() ) );
+		}
+
+		numVisible += appendVisible( _mm_movemask_ps( inside ), i, visible + numVisible );
+	}
+
+	return numVisible + cullSpheresScalar( frustum, i, last, visible + numVisible );
+}
+
+CPUCULLER_TARGET_SSE
+uint32_t CpuCuller::cullBoxesSse( const Frustum& frustum,
+                                  uint32_t first,
+                                  uint32_t last,
+                                  uint32_t* visible ) const
+{
+	// per plane, pick the box bounds that make up the corner furthest along the normal
+	const float* cornerX[ Frustum::COUNT ];
+	const float* cornerY[ Frustum::COUNT ];
+	const float* cornerZ[ Frustum::COUNT ];
+	for( auto p = 0; p < Frustum::COUNT; ++p )
+	{
+		cornerX[ p ] = ( frustum.planes[ p ].x > 0.0f ? m_MaxX.data() : m_MinX.data() );
+		cornerY[ p ] = ( frustum.planes[ p ].y > 0.0f ? m_MaxY.data() : m_MinY.data() );
+		cornerZ[ p ] = ( frustum.planes[ p ].z > 0.0f ? m_MaxZ.data() : m_MinZ.data() );
+	}
+
+	uint32_t numVisible = 0;
+	uint32_t i          = first;
+
+	for( ; i + 4 <= last; i += 4 )
+	{
+		__m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+
+		for( auto p = 0; p < Frustum::COUNT; ++p )
+		{
+			const glm::vec4& plane = frustum.planes[ p ];
+
+			__m128 x = _mm_loadu_ps( cornerX[ p ] + i );
+			__m128 y = _mm_loadu_ps( cornerY[ p ] + i );
+			__m128 z = _mm_loadu_ps( cornerZ[ p ] + i );
+
+			__m128 distance = _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( plane.x ) ),
+			                              _mm_mul_ps( y, _mm_set1_ps( plane.y ) ) );
+			distance = _mm_add_ps( distance, _mm_mul_ps( z, _mm_set1_ps( plane.z ) ) );
+			distance = _mm_add_ps( distance, _mm_set1_ps( plane.w ) );
+			inside = _mm_and_ps( inside, _mm_cmpge_ps( distance, _mm_setzero_ps() ) );
+		}
+
+		numVisible += appendVisible( _mm_movemask_ps( inside ), i, visible + numVisible );
+	}
+
+	return numVisible + cullBoxesScalar( frustum, i, last, visible + numVisible );
+}
+
+CPUCULLER_TARGET_AVX2
+uint32_t CpuCuller::cullSpheresAvx2( const Frustum& frustum,
+                                     uint32_t first,
+                                     uint32_t last,
+                                     uint32_t* visible ) const
+{
+	uint32_t numVisible = 0;
+	uint32_t i          = first;
+
+	for( ; i + 8 <= last; i += 8 )
+	{
+		__m256 x      = _mm256_loadu_ps( &m_CenterX[ i ] );
+		__m256 y      = _mm256_loadu_ps( &m_CenterY[ i ] );
+		__m256 z      = _mm256_loadu_ps( &m_CenterZ[ i ] );
+		__m256 radius = _mm256_loadu_ps( &m_Radius[ i ] );
+		__m256 inside = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+
+		for( const auto& plane : frustum.planes )
+		{
+			__m256 distance = _mm256_add_ps( _mm256_mul_ps( x, _mm256_set1_ps( plane.x ) ),
+			                                 _mm256_mul_ps( y, _mm256_set1_ps( plane.y ) ) );
+			distance = _mm256_add_ps( distance, _mm256_mul_ps( z, _mm256_set1_ps( plane.z ) ) );
+			distance = _mm256_add_ps( distance, _mm256_set1_ps( plane.w ) );
+			distance = _mm256_add_ps( distance, radius );
+			inside = _mm256_and_ps( inside,
+			                        _mm256_cmp_ps( distance, _mm256_setzero_ps(), _CMP_GE_OQ ) );
+		}
+
+		numVisible += appendVisible( _mm256_movemask_ps( inside ), i, visible + numVisible );
+	}
+
+	return numVisible + cullSpheresScalar( frustum, i, last, visible + numVisible );
+}
+
+CPUCULLER_TARGET_AVX2
+uint32_t CpuCuller::cullBoxesAvx2( const Frustum& frustum,
+                                   uint32_t first,
+                                   uint32_t last,
+                                   uint32_t* visible ) const
+{
+	const float* cornerX[ Frustum::COUNT ];
+	const float* cornerY[ Frustum::COUNT ];
+	const float* cornerZ[ Frustum::COUNT ];
+	for( auto p = 0; p < Frustum::COUNT; ++p )
+	{
+		cornerX[ p ] = ( frustum.planes[ p ].x > 0.0f ? m_MaxX.data() : m_MinX.data() );
+		cornerY[ p ] = ( frustum.planes[ p ].y > 0.0f ? m_MaxY.data() : m_MinY.data() );
+		cornerZ[ p ] = ( frustum.planes[ p ].z > 0.0f ? m_MaxZ.data() : m_MinZ.data() );
+	}
+
+	uint32_t numVisible = 0;
+	uint32_t i          = first;
+
+	for( ; i + 8 <= last; i += 8 )
+	{
+		__m256 inside = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+
+		for( auto p = 0; p < Frustum::COUNT; ++p )
+		{
+			const glm::vec4& plane = frustum.planes[ p ];
+
+			__m256 x = _mm256_loadu_ps( cornerX[ p ] + i );
+			__m256 y = _mm256_loadu_ps( cornerY[ p ] + i );
+			__m256 z = _mm256_loadu_ps( cornerZ[ p ] + i );
+
+			__m256 distance = _mm256_add_ps( _mm256_mul_ps( x, _mm256_set1_ps( plane.x ) ),
+			                                 _mm256_mul_ps( y, _mm256_set1_ps( plane.y ) ) );
+			distance = _mm256_add_ps( distance, _mm256_mul_ps( z, _mm256_set1_ps( plane.z ) ) );
+			distance = _mm256_add_ps( distance, _mm256_set1_ps( plane.w ) );
+			inside = _mm256_and_ps( inside,
+			                        _mm256_cmp_ps( distance, _mm256_setzero_ps(), _CMP_GE_OQ ) );
+		}
+
+		numVisible += appendVisible( _mm256_movemask_ps( inside ), i, visible + numVisible );
+	}
+
+	return numVisible + cullBoxesScalar( frustum, i, last, visible + numVisible );
+}
+
+#endif // CPUCULLER_X86
@@ -0,0 +1,109 @@
+#ifndef CPUCULLER_H
+#define CPUCULLER_H
+
+#include "common.h"
+#include "frustum.h"
+
+#include <vector>
+
+// Frustum culls object bounds on the CPU. Bounding spheres and axis aligned boxes are
+// kept in structure-of-arrays form, so a plane is tested against 8 (AVX2) or 4 (SSE)
+// objects per iteration. Culling writes a compacted list of visible object indices.
+class CpuCuller
+{
+public:
+	enum class Bounds
+	{
+		Sphere,
+		Box
+	};
+
+	enum class InstructionSet
+	{
+		Scalar,
+		Sse,
+		Avx2
+	};
+
+public:
+	CpuCuller();
+
+	// best instruction set supported by the executing CPU
+	static InstructionSet detectInstructionSet();
+	static const char*    getInstructionSetName( InstructionSet instructionSet );
+
+	// defaults to detectInstructionSet(), sets not supported by the CPU fall back to it
+	void           setInstructionSet( InstructionSet instructionSet );
+	InstructionSet getInstructionSet() const
+	{
+		return m_InstructionSet;
+	}
+
+	void     clear();
+	void     reserve( uint32_t numObjects );
+
+	// adds an object and returns its index
+	uint32_t add( const glm::vec3& center,
+	              float radius,
+	              const glm::vec3& boxMin,
+	              const glm::vec3& boxMax );
+
+	uint32_t getNumObjects() const
+	{
+		return m_CenterX.size();
+	}
+
+	// tests the objects [first, first + count) against the frustum and writes the indices
+	// of the visible ones to visible, which has to hold count entries; returns the number
+	// of visible objects. Safe to call concurrently for disjoint output ranges.
+	uint32_t cull( const Frustum& frustum,
+	               Bounds bounds,
+	               uint32_t first,
+	               uint32_t count,
+	               uint32_t* visible ) const;
+
+private:
+	uint32_t cullSpheresScalar( const Frustum& frustum,
+	                            uint32_t first,
+	                            uint32_t last,
+	                            uint32_t* visible ) const;
+	uint32_t cullBoxesScalar( const Frustum& frustum,
+	                          uint32_t first,
+	                          uint32_t last,
+	                          uint32_t* visible ) const;
+
+	uint32_t cullSpheresSse( const Frustum& frustum,
+	                         uint32_t first,
+	                         uint32_t last,
+	                         uint32_t* visible ) const;
+	uint32_t cullBoxesSse( const Frustum& frustum,
+	                       uint32_t first,
+	                       uint32_t last,
+	                       uint32_t* visible ) const;
+
+	uint32_t cullSpheresAvx2( const Frustum& frustum,
+	                          uint32_t first,
+	                          uint32_t last,
+	                          uint32_t* visible ) const;
+	uint32_t cullBoxesAvx2( const Frustum& frustum,
+	                        uint32_t first,
+	                        uint32_t last,
+	                        uint32_t* visible ) const;
+
+private:
+	InstructionSet     m_InstructionSet;
+
+	std::vector<float> m_CenterX;
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_Radius;
+
+	std::vector<float> m_MinX;
+	std::vector<float> m_MinY;
+	std::vector<float> m_MinZ;
+	std::vector<float> m_MaxX;
+	std::vector<float> m_MaxY;
+	std::vector<float> m_MaxZ;
+};
+
+#endif // CPUCULLER_H
@@ -0,0 +1,128 @@
+#include "descriptorallocator.h"
+#include "descriptorpool.h"
+#include "descriptorsetlayout.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+DescriptorAllocator::DescriptorAllocator()
+    : m_pRenderer( nullptr ),
+      m_PoolSizes(),
+      m_uSetsPerPool( 0 ),
+      m_Pools(),
+      m_uCurrentPool( 0 ),
+      m_uNumAllocated( 0 )
+{
+}
+
+DescriptorAllocator::DescriptorAllocator( Renderer& renderer,
+                                          const std::vector<PoolRatio>& ratios,
+                                          uint32_t setsPerPool )
+    : DescriptorAllocator()
+{
+	m_pRenderer    = &renderer;
+	m_uSetsPerPool = setsPerPool;
+
+	for( const auto& ratio : ratios )
+	{
+		uint32_t count = (uint32_t)std::ceil( ratio.ratio * setsPerPool );
+		m_PoolSizes.push_back( { ratio.type, std::max( count, 1u ) } );
+	}
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+	destroy();
+}
+
+void DescriptorAllocator::destroy()
+{
+	for( DescriptorPool* pool : m_Pools )
+	{
+		delete pool;
+	}
+	m_Pools.clear();
+
+	m_uCurrentPool  = 0;
+	m_uNumAllocated = 0;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate( DescriptorSetLayout& layout )
+{
+	VkDescriptorSetLayout layoutHandle = layout.getNativeHandle();
+
+	while( true )
+	{
+		bool created = false;
+		if( m_uCurrentPool == m_Pools.size() )
+		{
+			if( !createPool() )
+				return VK_NULL_HANDLE;
+
+			created = true;
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext              = nullptr;
+		allocInfo.descriptorPool     = m_Pools[ m_uCurrentPool ]->getNativeHandle();
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts        = &layoutHandle;
+
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		VkResult        res = vkAllocateDescriptorSets( m_pRenderer->getNativeDeviceHandle(),
+		                                                &allocInfo,
+		                                                &set );
+
+		if( res == VK_SUCCESS )
+		{
+			++m_uNumAllocated;
+			return set;
+		}
+
+		// exhausted pools report VK_ERROR_OUT_OF_POOL_MEMORY, or any error before
+		// VK_KHR_maintenance1; a new pool failing as well can never hold the set
+		if( created )
+		{
+			log_error( "Cannot allocate descriptor set, the layout exceeds the pool sizes." );
+			return VK_NULL_HANDLE;
+		}
+		++m_uCurrentPool;
+	}
+}
+
+void DescriptorAllocator::update( DescriptorSet::Writer& writer )
+{
+	vkUpdateDescriptorSets( m_pRenderer->getNativeDeviceHandle(),
+	                        writer.getWrites().size(),
+	                        ( writer.getWrites().empty() ? nullptr : writer.getWrites().data() ),
+	                        writer.getCopies().size(),
+	                        ( writer.getCopies().empty() ? nullptr : writer.getCopies().data() ) );
+}
+
+void DescriptorAllocator::reset()
+{
+	// only the pools used since the last reset hold sets
+	for( auto i = 0; i < m_Pools.size() && i <= m_uCurrentPool; ++i )
+	{
+		m_Pools[ i ]->reset();
+	}
+
+	m_uCurrentPool  = 0;
+	m_uNumAllocated = 0;
+}
+
+bool DescriptorAllocator::createPool()
+{
+	DescriptorPool* pool = new DescriptorPool( *m_pRenderer, m_PoolSizes, m_uSetsPerPool, 0 );
+
+	if( !pool->isValid() )
+	{
+		delete pool;
+		return false;
+	}
+
+	m_Pools.push_back( pool );
+	return true;
+}
@@ -0,0 +1,75 @@
+#ifndef DESCRIPTORALLOCATOR_H
+#define DESCRIPTORALLOCATOR_H
+
+#include "common.h"
+#include "descriptorset.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+class Renderer;
+class DescriptorPool;
+class DescriptorSetLayout;
+
+// Allocates transient descriptor sets from a growing list of pools. Every pool holds the
+// same number of sets with descriptors per type sized by ratios per set; once the pools
+// run out another one is created. Sets are never freed individually, reset() recycles
+// all pools at once, which keeps thousands of allocations per frame cheap.
+class DescriptorAllocator
+{
+public:
+	struct PoolRatio
+	{
+		VkDescriptorType type;
+		// average number of descriptors of the type per set
+		float            ratio;
+	};
+
+public:
+	DescriptorAllocator();
+	DescriptorAllocator( Renderer& renderer,
+	                     const std::vector<PoolRatio>& ratios,
+	                     uint32_t setsPerPool );
+	~DescriptorAllocator();
+
+	void            destroy();
+
+	bool            isValid()
+	{
+		return ( m_pRenderer != nullptr );
+	}
+
+	// VK_NULL_HANDLE on failure; the set is valid until the next reset()
+	VkDescriptorSet allocate( DescriptorSetLayout& layout );
+
+	// writes descriptors of a set allocated from this allocator
+	void            update( DescriptorSet::Writer& writer );
+
+	// invalidates all allocated sets, none may be used by pending command buffers; the
+	// pools are kept for the following allocations
+	void            reset();
+
+	uint32_t        getNumPools()
+	{
+		return m_Pools.size();
+	}
+	uint32_t        getNumAllocated()
+	{
+		return m_uNumAllocated;
+	}
+
+private:
+	bool            createPool();
+
+private:
+	Renderer*                         m_pRenderer;
+	std::vector<VkDescriptorPoolSize> m_PoolSizes;
+	uint32_t                          m_uSetsPerPool;
+
+	std::vector<DescriptorPool*>      m_Pools;
+	// pools before the current one are exhausted until the next reset
+	uint32_t                          m_uCurrentPool;
+	uint32_t                          m_uNumAllocated;
+};
+
+#endif // DESCRIPTORALLOCATOR_H
@@ -3,9 +3,11 @@
 
 DescriptorPool::DescriptorPool( Renderer& renderer,
                                 std::vector<VkDescriptorPoolSize> poolSizes,
-                                uint32_t maxSets )
+                                uint32_t maxSets,
+                                VkDescriptorPoolCreateFlags flags )
     : wrapper_type( renderer.getNativeDeviceHandle() ),
       m_pRenderer( &renderer ),
+      m_vkFlags( flags ),
       m_PoolSizes()
 {
 	for( const auto& size : poolSizes )
@@ -16,7 +18,7 @@ DescriptorPool::DescriptorPool( Renderer& renderer,
 	VkDescriptorPoolCreateInfo createInfo{};
 	createInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	createInfo.pNext         = nullptr;
-	createInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT; // TODO: make configurable
+	createInfo.flags         = flags;
 	createInfo.poolSizeCount = poolSizes.size();
 	createInfo.pPoolSizes    = poolSizes.data();
 	createInfo.maxSets       = maxSets;
@@ -32,3 +34,8 @@ DescriptorPool::DescriptorPool( Renderer& renderer,
 		destroy();
 	}
 }
+
+void DescriptorPool::reset()
+{
+	vkResetDescriptorPool( m_vkDevice, m_vkHandle, 0 );
+}
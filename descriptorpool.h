@@ -14,17 +14,28 @@ class DescriptorPool : public VulkanObjectWrapper<VkDescriptorPool, vkDestroyDes
 {
 public:
 	DescriptorPool() = default;
+	// without FREE_DESCRIPTOR_SET_BIT sets are only released all at once by reset()
 	DescriptorPool( Renderer& renderer,
 	                std::vector<VkDescriptorPoolSize> poolSizes,
-	                uint32_t maxSets );
+	                uint32_t maxSets,
+	                VkDescriptorPoolCreateFlags flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT );
 
 	Renderer& getRenderer()
 	{
 		return *m_pRenderer;
 	}
 
+	bool      canFreeSets()
+	{
+		return ( ( m_vkFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT ) != 0 );
+	}
+
+	// releases all sets allocated from the pool, none may be in use anymore
+	void      reset();
+
 private:
-	Renderer* m_pRenderer;
+	Renderer*                   m_pRenderer;
+	VkDescriptorPoolCreateFlags m_vkFlags;
 
 	std::unordered_map<VkDescriptorType, uint32_t> m_PoolSizes;
 };
@@ -5,9 +5,15 @@
 #include "buffer.h"
 
 DescriptorSet::Writer::Writer( DescriptorSet& set )
-    : m_pSet( &set ),
+    : Writer( set.getNativeHandle() )
+{
+}
+
+DescriptorSet::Writer::Writer( VkDescriptorSet set )
+    : m_vkSet( set ),
       m_uCurrentBinding( INVALID_BINDING ),
       m_Buffers(),
+      m_BufferIds(),
       m_Writes()
 {
 }
@@ -16,6 +22,35 @@ DescriptorSet::Writer& DescriptorSet::Writer::uniformBuffer( uint32_t binding,
                                                              Buffer&  buffer,
                                                              uint64_t offset,
                                                              uint64_t length )
+{
+	return this->buffer( binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer, offset, length );
+}
+
+DescriptorSet::Writer& DescriptorSet::Writer::storageBuffer( uint32_t binding,
+                                                             Buffer&  buffer,
+                                                             uint64_t offset,
+                                                             uint64_t length )
+{
+	return this->buffer( binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer, offset, length );
+}
+
+const std::vector<VkWriteDescriptorSet>& DescriptorSet::Writer::getWrites()
+{
+	// buffer infos may have moved while more writes were added, the target may have
+	// changed since
+	for( auto i = 0; i < m_Writes.size(); ++i )
+	{
+		m_Writes[ i ].dstSet      = m_vkSet;
+		m_Writes[ i ].pBufferInfo = &m_Buffers[ i ];
+	}
+	return m_Writes;
+}
+
+DescriptorSet::Writer& DescriptorSet::Writer::buffer( uint32_t         binding,
+                                                      VkDescriptorType type,
+                                                      Buffer&          buffer,
+                                                      uint64_t         offset,
+                                                      uint64_t         length )
 {
 	m_uCurrentBinding = binding;
 
@@ -25,14 +60,15 @@ DescriptorSet::Writer& DescriptorSet::Writer::uniformBuffer( uint32_t binding,
 	bufferInfo.range  = length;
 
 	m_Buffers.emplace_back( bufferInfo );
+	m_BufferIds.push_back( buffer.getId() );
 
 	VkWriteDescriptorSet descriptorWrite{};
 	descriptorWrite.sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	descriptorWrite.pNext            = nullptr;
-	descriptorWrite.dstSet           = m_pSet->getNativeHandle();
+	descriptorWrite.dstSet           = m_vkSet;
 	descriptorWrite.dstBinding       = m_uCurrentBinding;
 	descriptorWrite.dstArrayElement  = 0;
-	descriptorWrite.descriptorType   = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorWrite.descriptorType   = type;
 	descriptorWrite.descriptorCount  = 1;
 	descriptorWrite.pBufferInfo      = &m_Buffers.back();
 	descriptorWrite.pImageInfo       = nullptr;
@@ -80,7 +116,11 @@ void DescriptorSet::destroy()
 {
 	if( m_vkHandle != VK_NULL_HANDLE )
 	{
-		vkFreeDescriptorSets( m_vkDevice, m_pPool->getNativeHandle(), 1, &m_vkHandle );
+		// sets of other pools are released when their pool is reset or destroyed
+		if( m_pPool->canFreeSets() )
+		{
+			vkFreeDescriptorSets( m_vkDevice, m_pPool->getNativeHandle(), 1, &m_vkHandle );
+		}
 		m_vkHandle = VK_NULL_HANDLE;
 	}
 }
@@ -18,27 +18,47 @@ public:
 	{
 	public:
 		Writer( DescriptorSet& set );
+		// without a set the writes can be collected before one is chosen, e.g. as the
+		// key of a DescriptorSetCache lookup
+		Writer( VkDescriptorSet set = VK_NULL_HANDLE );
 
-		Writer& uniformBuffer( uint32_t binding, Buffer& buffer, uint64_t offset, uint64_t length );
-
-		const std::vector<VkWriteDescriptorSet>& getWrites()
+		// redirects all writes, including the ones already added
+		void    setTarget( VkDescriptorSet set )
 		{
-			return m_Writes;
+			m_vkSet = set;
 		}
 
+		Writer& uniformBuffer( uint32_t binding, Buffer& buffer, uint64_t offset, uint64_t length );
+		Writer& storageBuffer( uint32_t binding, Buffer& buffer, uint64_t offset, uint64_t length );
+
+		const std::vector<VkWriteDescriptorSet>& getWrites();
+
 		const std::vector<VkCopyDescriptorSet>&  getCopies()
 		{
 			return m_Copies;
 		}
 
+		// Buffer::getId() of each write's buffer, in the order of the writes
+		const std::vector<uint64_t>&             getBufferIds()
+		{
+			return m_BufferIds;
+		}
+
 	private:
 		static constexpr uint32_t INVALID_BINDING = ~(uint32_t)0;
 
-		DescriptorSet* m_pSet;
+		Writer& buffer( uint32_t binding,
+		                VkDescriptorType type,
+		                Buffer& buffer,
+		                uint64_t offset,
+		                uint64_t length );
+
+		VkDescriptorSet m_vkSet;
 
-		uint32_t       m_uCurrentBinding;
+		uint32_t        m_uCurrentBinding;
 
 		std::vector<VkDescriptorBufferInfo> m_Buffers;
+		std::vector<uint64_t>               m_BufferIds;
 		std::vector<VkWriteDescriptorSet>   m_Writes;
 		std::vector<VkCopyDescriptorSet>    m_Copies;
 	};
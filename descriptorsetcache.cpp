@@ -0,0 +1,215 @@
+#include "descriptorsetcache.h"
+#include "descriptorpool.h"
+#include "descriptorsetlayout.h"
+#include "renderer.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+DescriptorSetCache::DescriptorSetCache()
+    : m_pRenderer( nullptr ),
+      m_pPool( nullptr ),
+      m_uFramesInFlight( 0 ),
+      m_Mutex(),
+      m_uFrameNumber( 0 ),
+      m_Entries(),
+      m_Lookup(),
+      m_uNumHits( 0 ),
+      m_uNumMisses( 0 ),
+      m_uNumEvictions( 0 ),
+      m_uFrameHits( 0 ),
+      m_uFrameMisses( 0 ),
+      m_uFrameEvictions( 0 )
+{
+}
+
+DescriptorSetCache::DescriptorSetCache( Renderer& renderer,
+                                        const std::vector<PoolRatio>& ratios,
+                                        uint32_t maxSets,
+                                        uint32_t framesInFlight )
+    : DescriptorSetCache()
+{
+	m_pRenderer       = &renderer;
+	m_uFramesInFlight = framesInFlight;
+
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for( const auto& ratio : ratios )
+	{
+		uint32_t count = (uint32_t)std::ceil( ratio.ratio * maxSets );
+		poolSizes.push_back( { ratio.type, std::max( count, 1u ) } );
+	}
+
+	// evicted sets are freed individually
+	m_pPool = new DescriptorPool( renderer, poolSizes, maxSets );
+
+	if( !m_pPool->isValid() )
+	{
+		destroy();
+	}
+}
+
+DescriptorSetCache::~DescriptorSetCache()
+{
+	destroy();
+}
+
+void DescriptorSetCache::destroy()
+{
+	// the sets are released with the pool
+	m_Lookup.clear();
+	m_Entries.clear();
+
+	safe_delete( m_pPool );
+}
+
+void DescriptorSetCache::setFrame( uint64_t frameNumber )
+{
+	std::lock_guard<std::mutex> lock( m_Mutex );
+
+	m_uFrameNumber = frameNumber;
+
+	Profiler::addCount( "descriptorsetcache.hits", m_uFrameHits );
+	Profiler::addCount( "descriptorsetcache.misses", m_uFrameMisses );
+	Profiler::addCount( "descriptorsetcache.evictions", m_uFrameEvictions );
+
+	m_uFrameHits      = 0;
+	m_uFrameMisses    = 0;
+	m_uFrameEvictions = 0;
+}
+
+VkDescriptorSet DescriptorSetCache::get( DescriptorSetLayout& layout, DescriptorSet::Writer& writer )
+{
+	VkDescriptorSetLayout layoutHandle = layout.getNativeHandle();
+
+	Key key = computeKey( layoutHandle, writer );
+
+	std::lock_guard<std::mutex> lock( m_Mutex );
+
+	auto it = m_Lookup.find( key );
+	if( it != m_Lookup.end() )
+	{
+		m_Entries.splice( m_Entries.begin(), m_Entries, it->second );
+		m_Entries.front().lastUsedFrame = m_uFrameNumber;
+
+		++m_uNumHits;
+		++m_uFrameHits;
+		return m_Entries.front().vkSet;
+	}
+
+	++m_uNumMisses;
+	++m_uFrameMisses;
+
+	VkDescriptorSet set = allocate( layoutHandle );
+	if( set == VK_NULL_HANDLE )
+		return VK_NULL_HANDLE;
+
+	writer.setTarget( set );
+	vkUpdateDescriptorSets( m_pRenderer->getNativeDeviceHandle(),
+	                        writer.getWrites().size(),
+	                        ( writer.getWrites().empty() ? nullptr : writer.getWrites().data() ),
+	                        writer.getCopies().size(),
+	                        ( writer.getCopies().empty() ? nullptr : writer.getCopies().data() ) );
+
+	m_Entries.push_front( Entry{ nullptr, set, m_uFrameNumber } );
+
+	auto inserted = m_Lookup.emplace( std::move( key ), m_Entries.begin() ).first;
+	m_Entries.front().pKey = &inserted->first;
+
+	return set;
+}
+
+double DescriptorSetCache::getHitRate()
+{
+	std::lock_guard<std::mutex> lock( m_Mutex );
+
+	uint64_t numLookups = m_uNumHits + m_uNumMisses;
+	return ( numLookups > 0 ? (double)m_uNumHits / numLookups : 0.0 );
+}
+
+DescriptorSetCache::Key DescriptorSetCache::computeKey( VkDescriptorSetLayout layout,
+                                                        DescriptorSet::Writer& writer )
+{
+	const auto& writes    = writer.getWrites();
+	const auto& bufferIds = writer.getBufferIds();
+
+	Key key;
+	key.reserve( 2 + 5 * writes.size() );
+
+	key.push_back( (uint64_t)layout );
+	key.push_back( writes.size() );
+
+	for( auto i = 0; i < writes.size(); ++i )
+	{
+		const VkWriteDescriptorSet& write = writes[ i ];
+
+		key.push_back( ( (uint64_t)write.dstBinding << 32 ) | write.dstArrayElement );
+		key.push_back( ( (uint64_t)write.descriptorType << 32 ) | write.descriptorCount );
+
+		// the writer only produces single buffer descriptors; buffers are identified by
+		// their id, a handle may belong to a destroyed buffer's successor
+		key.push_back( bufferIds[ i ] );
+		key.push_back( write.pBufferInfo->offset );
+		key.push_back( write.pBufferInfo->range );
+	}
+	return key;
+}
+
+VkDescriptorSet DescriptorSetCache::allocate( VkDescriptorSetLayout layout )
+{
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.pNext              = nullptr;
+	allocInfo.descriptorPool     = m_pPool->getNativeHandle();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts        = &layout;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	VkResult        res;
+
+	while( ( res = vkAllocateDescriptorSets( m_pRenderer->getNativeDeviceHandle(),
+	                                         &allocInfo,
+	                                         &set ) ) != VK_SUCCESS )
+	{
+		// evicting only helps if the pool is out of sets or descriptors, possibly
+		// fragmented; other failures, e.g. descriptor types the pool lacks, persist
+		if( res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL )
+		{
+			log_error( "Cannot allocate cached descriptor set." );
+			return VK_NULL_HANDLE;
+		}
+
+		if( !evictLeastRecentlyUsed() )
+		{
+			log_warning( "Descriptor set cache is exhausted by sets in flight." );
+			return VK_NULL_HANDLE;
+		}
+	}
+	return set;
+}
+
+bool DescriptorSetCache::evictLeastRecentlyUsed()
+{
+	if( m_Entries.empty() )
+		return false;
+
+	Entry& entry = m_Entries.back();
+
+	// command buffers of frames in flight may still bind the set
+	if( entry.lastUsedFrame + m_uFramesInFlight > m_uFrameNumber )
+		return false;
+
+	vkFreeDescriptorSets( m_pRenderer->getNativeDeviceHandle(),
+	                      m_pPool->getNativeHandle(),
+	                      1,
+	                      &entry.vkSet );
+
+	// the key is owned by the erased node
+	Key key = *entry.pKey;
+	m_Lookup.erase( key );
+	m_Entries.pop_back();
+
+	++m_uNumEvictions;
+	++m_uFrameEvictions;
+	return true;
+}
@@ -0,0 +1,114 @@
+#ifndef DESCRIPTORSETCACHE_H
+#define DESCRIPTORSETCACHE_H
+
+#include "common.h"
+#include "descriptorset.h"
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <vector>
+#include <list>
+#include <mutex>
+
+class Renderer;
+class DescriptorPool;
+class DescriptorSetLayout;
+
+// Shares descriptor sets between draws binding the same resources. Sets are keyed by the
+// layout and the writes collected by a DescriptorSet::Writer, so a hit skips both the
+// allocation and the update. Once the pool is exhausted the least recently used sets are
+// evicted, but only after the frames that used them have retired. Buffers are keyed by
+// their id, sets of destroyed buffers are never hit again and age out. Thread safe.
+class DescriptorSetCache
+{
+public:
+	struct PoolRatio
+	{
+		VkDescriptorType type;
+		// average number of descriptors of the type per set
+		float            ratio;
+	};
+
+public:
+	DescriptorSetCache();
+	DescriptorSetCache( Renderer& renderer,
+	                    const std::vector<PoolRatio>& ratios,
+	                    uint32_t maxSets,
+	                    uint32_t framesInFlight );
+	~DescriptorSetCache();
+
+	void            destroy();
+
+	bool            isValid()
+	{
+		return ( m_pPool != nullptr );
+	}
+
+	// starts recording the given frame; sets last used by frames at least framesInFlight
+	// older are no longer in use and may be evicted; flushes the hit counts to the profiler
+	void            setFrame( uint64_t frameNumber );
+
+	// returns a set holding the writer's descriptors, writes issued in a different order
+	// result in a different set; VK_NULL_HANDLE if all sets are still in flight
+	VkDescriptorSet get( DescriptorSetLayout& layout, DescriptorSet::Writer& writer );
+
+	uint32_t        getNumSets()
+	{
+		return m_Entries.size();
+	}
+	// over all lookups since creation
+	double          getHitRate();
+	uint64_t        getNumEvictions()
+	{
+		return m_uNumEvictions;
+	}
+
+private:
+	typedef std::vector<uint64_t> Key;
+
+	struct KeyHash
+	{
+		size_t operator()( const Key& key ) const
+		{
+			return hash_bytes( key.data(), key.size() * sizeof( uint64_t ) );
+		}
+	};
+
+	struct Entry
+	{
+		// owned by the map
+		const Key*      pKey;
+		VkDescriptorSet vkSet;
+		uint64_t        lastUsedFrame;
+	};
+
+	typedef std::list<Entry> EntryList;
+
+private:
+	static Key      computeKey( VkDescriptorSetLayout layout, DescriptorSet::Writer& writer );
+
+	// require the mutex
+	VkDescriptorSet allocate( VkDescriptorSetLayout layout );
+	bool            evictLeastRecentlyUsed();
+
+private:
+	Renderer*       m_pRenderer;
+	DescriptorPool* m_pPool;
+	uint32_t        m_uFramesInFlight;
+
+	std::mutex      m_Mutex;
+	uint64_t        m_uFrameNumber;
+	// most recently used first
+	EntryList       m_Entries;
+	std::unordered_map<Key, EntryList::iterator, KeyHash> m_Lookup;
+
+	uint64_t        m_uNumHits;
+	uint64_t        m_uNumMisses;
+	uint64_t        m_uNumEvictions;
+	// not yet reported to the profiler
+	uint64_t        m_uFrameHits;
+	uint64_t        m_uFrameMisses;
+	uint64_t        m_uFrameEvictions;
+};
+
+#endif // DESCRIPTORSETCACHE_H
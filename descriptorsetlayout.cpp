@@ -14,10 +14,27 @@ DescriptorSetLayout::Composer& DescriptorSetLayout::Composer::uniformBuffer()
 
 DescriptorSetLayout::Composer& DescriptorSetLayout::Composer::uniformBuffer(
         uint32_t numDescriptors )
+{
+	return binding( VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, numDescriptors );
+}
+
+DescriptorSetLayout::Composer& DescriptorSetLayout::Composer::storageBuffer()
+{
+	return storageBuffer( 1 );
+}
+
+DescriptorSetLayout::Composer& DescriptorSetLayout::Composer::storageBuffer(
+        uint32_t numDescriptors )
+{
+	return binding( VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, numDescriptors );
+}
+
+DescriptorSetLayout::Composer& DescriptorSetLayout::Composer::binding( VkDescriptorType type,
+                                                                      uint32_t numDescriptors )
 {
 	VkDescriptorSetLayoutBinding binding{};
 	binding.binding            = m_vkBindings.size();
-	binding.descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	binding.descriptorType     = type;
 	binding.descriptorCount    = numDescriptors;
 	binding.stageFlags         = m_vkCurrentStage;
 	binding.pImmutableSamplers = nullptr;
@@ -29,16 +46,21 @@ DescriptorSetLayout::Composer& DescriptorSetLayout::Composer::uniformBuffer(
 
 
 DescriptorSetLayout::DescriptorSetLayout( Renderer& renderer, Composer& composer )
-    : wrapper_type( renderer.getNativeDeviceHandle() )
+    : DescriptorSetLayout( renderer, composer.getBindings() )
 {
-	const auto& bindings = composer.getBindings();
+}
 
+DescriptorSetLayout::DescriptorSetLayout(
+        Renderer& renderer,
+        const std::vector<VkDescriptorSetLayoutBinding>& bindings )
+    : wrapper_type( renderer.getNativeDeviceHandle() )
+{
 	VkDescriptorSetLayoutCreateInfo createInfo{};
 	createInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	createInfo.pNext        = nullptr;
 	createInfo.flags        = 0;
 	createInfo.bindingCount = bindings.size();
-	createInfo.pBindings    = bindings.data();
+	createInfo.pBindings    = ( bindings.empty() ? nullptr : bindings.data() );
 
 	VkResult res = vkCreateDescriptorSetLayout( m_vkDevice,
 	                                            &createInfo,
@@ -21,11 +21,17 @@ public:
 		Composer& uniformBuffer();
 		Composer& uniformBuffer( uint32_t numDescriptors );
 
+		Composer& storageBuffer();
+		Composer& storageBuffer( uint32_t numDescriptors );
+
 		const std::vector<VkDescriptorSetLayoutBinding>& getBindings()
 		{
 			return m_vkBindings;
 		}
 
+	private:
+		Composer& binding( VkDescriptorType type, uint32_t numDescriptors );
+
 	private:
 		VkShaderStageFlagBits                     m_vkCurrentStage;
 		std::vector<VkDescriptorSetLayoutBinding> m_vkBindings;
@@ -34,6 +40,8 @@ public:
 public:
 	DescriptorSetLayout() = default;
 	DescriptorSetLayout( Renderer& renderer, Composer& composer );
+	DescriptorSetLayout( Renderer& renderer,
+	                     const std::vector<VkDescriptorSetLayoutBinding>& bindings );
 
 	static Composer compose();
 };
@@ -0,0 +1,553 @@
+#include "framecapture.h"
+#include "renderer.h"
+#include "swapchain.h"
+#include "memorypool.h"
+#include "buffer.h"
+#include "commandpool.h"
+#include "commandbuffer.h"
+#include "profiler.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static uint32_t crc32( const uint8_t* data, size_t length, uint32_t crc = 0 )
+{
+	static uint32_t table[ 256 ] = {};
+	if( table[ 1 ] == 0 )
+	{
+		for( uint32_t i = 0; i < 256; ++i )
+		{
+			uint32_t c = i;
+			for( auto k = 0; k < 8; ++k )
+			{
+				c = ( ( c & 1 ) != 0 ? 0xedb88320u ^ ( c >> 1 ) : c >> 1 );
+			}
+			table[ i ] = c;
+		}
+	}
+
+	crc = ~crc;
+	for( size_t i = 0; i < length; ++i )
+	{
+		crc = table[ ( crc ^ data[ i ] ) & 0xff ] ^ ( crc >> 8 );
+	}
+	return ~crc;
+}
+
+static void appendBigEndian( std::vector<uint8_t>& out, uint32_t value )
+{
+	out.push_back( ( value >> 24 ) & 0xff );
+	out.push_back( ( value >> 16 ) & 0xff );
+	out.push_back( ( value >>  8 ) & 0xff );
+	out.push_back( ( value       ) & 0xff );
+}
+
+static void writePngChunk( std::ofstream& file, const char* type, const std::vector<uint8_t>& data )
+{
+	std::vector<uint8_t> chunk;
+	chunk.reserve( data.size() + 12 );
+
+	appendBigEndian( chunk, data.size() );
+	chunk.insert( chunk.end(), type, type + 4 );
+	chunk.insert( chunk.end(), data.begin(), data.end() );
+	appendBigEndian( chunk, crc32( chunk.data() + 4, data.size() + 4 ) );
+
+	file.write( reinterpret_cast<const char*>( chunk.data() ), chunk.size() );
+}
+
+FrameCapture::FrameCapture( Renderer& renderer,
+                            const std::string& directory,
+                            Format format,
+                            uint32_t numSlots )
+    : m_pRenderer( &renderer ),
+      m_pCommandPool( nullptr ),
+      m_strDirectory( directory ),
+      m_Format( format ),
+      m_uNumSlots( numSlots ),
+      m_uNextSlot( 0 ),
+      m_uFrameNumber( 0 ),
+      m_Slots(),
+      m_WriterThread(),
+      m_WriteQueue(),
+      m_bStopWriter( false )
+{
+	m_pCommandPool = new CommandPool( renderer,
+	                                  renderer.getQueueFamilies()[ QueueFamily::Graphics ].index,
+	                                  VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+	                                  VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT );
+
+	if( !m_pCommandPool->isValid() || !createSlots() )
+	{
+		destroy();
+		return;
+	}
+
+	m_WriterThread = std::thread( &FrameCapture::writerLoop, this );
+}
+
+FrameCapture::~FrameCapture()
+{
+	destroy();
+}
+
+void FrameCapture::destroy()
+{
+	if( m_WriterThread.joinable() )
+	{
+		// flush readbacks that are still in flight, the writer drains its queue before exiting
+		waitForPendingSlots();
+
+		{
+			std::lock_guard<std::mutex> lock( m_Mutex );
+			m_bStopWriter = true;
+		}
+		m_WriteCondition.notify_all();
+		m_WriterThread.join();
+	}
+
+	destroySlots();
+	safe_delete( m_pCommandPool );
+}
+
+void FrameCapture::poll()
+{
+	VkDevice device = m_pRenderer->getNativeDeviceHandle();
+
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+
+		for( auto& slot : m_Slots )
+		{
+			if( slot.state == SlotState::InFlight &&
+			    vkGetFenceStatus( device, slot.vkFence ) == VK_SUCCESS )
+			{
+				slot.pBuffer->invalidate();
+
+				slot.state = SlotState::Writing;
+				m_WriteQueue.push_back( &slot );
+				queued = true;
+			}
+		}
+	}
+
+	if( queued )
+	{
+		m_WriteCondition.notify_one();
+	}
+}
+
+CommandBuffer* FrameCapture::capture( uint32_t imageIndex, VkFence& fence )
+{
+	uint64_t frameNumber = m_uFrameNumber++;
+
+	Slot& slot = m_Slots[ m_uNextSlot ];
+
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		if( slot.state != SlotState::Free )
+		{
+			Profiler::addCount( "capture.frames_dropped" );
+			return nullptr;
+		}
+	}
+
+	if( !recordCopy( slot, m_pRenderer->getSwapChain().getImages()[ imageIndex ] ) )
+	{
+		return nullptr;
+	}
+
+	vkResetFences( m_pRenderer->getNativeDeviceHandle(), 1, &slot.vkFence );
+
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		slot.state       = SlotState::InFlight;
+		slot.frameNumber = frameNumber;
+	}
+
+	m_uNextSlot = ( m_uNextSlot + 1 ) % m_uNumSlots;
+
+	Profiler::addCount( "capture.frames_submitted" );
+
+	fence = slot.vkFence;
+	return slot.pCommandBuffer;
+}
+
+bool FrameCapture::resize()
+{
+	waitForPendingSlots();
+	destroySlots();
+
+	if( !createSlots() )
+	{
+		log_error( "Cannot recreate frame capture buffers." );
+		return false;
+	}
+	return true;
+}
+
+bool FrameCapture::isFormatSupported( VkFormat format )
+{
+	switch( format )
+	{
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool FrameCapture::writeRaw( const std::string& filename, const Slot& slot )
+{
+	std::ofstream file( filename, std::ios::binary );
+
+	if( !file.is_open() )
+	{
+		log_error( "Cannot open file: " + filename );
+		return false;
+	}
+
+	file.write( reinterpret_cast<const char*>( slot.pMappedData ),
+	            4 * slot.extent.width * slot.extent.height );
+
+	return file.good();
+}
+
+bool FrameCapture::writePng( const std::string& filename, const Slot& slot )
+{
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	std::ofstream file( filename, std::ios::binary );
+
+	if( !file.is_open() )
+	{
+		log_error( "Cannot open file: " + filename );
+		return false;
+	}
+
+	const uint32_t width    = slot.extent.width;
+	const uint32_t height   = slot.extent.height;
+	const bool     swizzle  = ( slot.format == VK_FORMAT_B8G8R8A8_UNORM ||
+	                            slot.format == VK_FORMAT_B8G8R8A8_SRGB );
+	const uint8_t* pixels   = reinterpret_cast<const uint8_t*>( slot.pMappedData );
+
+	// 8 bit RGB, filter type 0 per scanline
+	const size_t   rowSize  = 1 + 3 * width;
+	std::vector<uint8_t> scanlines( rowSize * height );
+	for( uint32_t y = 0; y < height; ++y )
+	{
+		uint8_t*       dst = &scanlines[ y * rowSize ];
+		const uint8_t* src = pixels + 4 * width * y;
+
+		*dst++ = 0;
+		for( uint32_t x = 0; x < width; ++x, src += 4 )
+		{
+			*dst++ = src[ swizzle ? 2 : 0 ];
+			*dst++ = src[ 1 ];
+			*dst++ = src[ swizzle ? 0 : 2 ];
+		}
+	}
+
+	// zlib stream made of stored deflate blocks, trading file size for encoding speed
+	std::vector<uint8_t> idat;
+	idat.reserve( scanlines.size() + scanlines.size() / 65535 * 5 + 16 );
+	idat.push_back( 0x78 );
+	idat.push_back( 0x01 );
+
+	uint32_t adlerA = 1, adlerB = 0;
+	for( size_t offset = 0; offset < scanlines.size(); offset += 65535 )
+	{
+		uint16_t blockSize = std::min<size_t>( 65535, scanlines.size() - offset );
+		bool     final     = ( offset + blockSize == scanlines.size() );
+
+		idat.push_back( final ? 1 : 0 );
+		idat.push_back( blockSize & 0xff );
+		idat.push_back( blockSize >> 8 );
+		idat.push_back( ~blockSize & 0xff );
+		idat.push_back( ( ~blockSize >> 8 ) & 0xff );
+		idat.insert( idat.end(),
+		             scanlines.begin() + offset,
+		             scanlines.begin() + offset + blockSize );
+
+		for( size_t i = offset; i < offset + blockSize; ++i )
+		{
+			adlerA = ( adlerA + scanlines[ i ] ) % 65521;
+			adlerB = ( adlerB + adlerA ) % 65521;
+		}
+	}
+	appendBigEndian( idat, ( adlerB << 16 ) | adlerA );
+
+	std::vector<uint8_t> ihdr;
+	appendBigEndian( ihdr, width );
+	appendBigEndian( ihdr, height );
+	ihdr.push_back( 8 ); // bit depth
+	ihdr.push_back( 2 ); // color type RGB
+	ihdr.push_back( 0 ); // compression
+	ihdr.push_back( 0 ); // filter
+	ihdr.push_back( 0 ); // interlace
+
+	file.write( reinterpret_cast<const char*>( signature ), sizeof( signature ) );
+	writePngChunk( file, "IHDR", ihdr );
+	writePngChunk( file, "IDAT", idat );
+	writePngChunk( file, "IEND", {} );
+
+	return file.good();
+}
+
+bool FrameCapture::createSlots()
+{
+	SwapChain& swapchain = m_pRenderer->getSwapChain();
+
+	if( ( swapchain.getImageUsage() & VK_IMAGE_USAGE_TRANSFER_SRC_BIT ) == 0 )
+	{
+		log_error( "Swap chain images do not support frame capture." );
+		return false;
+	}
+	if( !isFormatSupported( swapchain.getFormat() ) )
+	{
+		log_error( "Swap chain format is not supported by frame capture." );
+		return false;
+	}
+
+	VkDevice device = m_pRenderer->getNativeDeviceHandle();
+
+	VkExtent2D extent = swapchain.getExtent();
+	uint64_t   size   = 4 * (uint64_t)extent.width * extent.height;
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.pNext = nullptr;
+	fenceInfo.flags = 0;
+
+	m_Slots.resize( m_uNumSlots );
+	for( auto& slot : m_Slots )
+	{
+		slot.state          = SlotState::Free;
+		slot.frameNumber    = 0;
+		slot.extent         = extent;
+		slot.format         = swapchain.getFormat();
+		slot.pMemoryPool    = nullptr;
+		slot.pBuffer        = nullptr;
+		slot.pMappedData    = nullptr;
+		slot.pCommandBuffer = nullptr;
+		slot.vkFence        = VK_NULL_HANDLE;
+	}
+
+	for( auto& slot : m_Slots )
+	{
+		if( !createSlotBuffer( slot, size ) )
+			return false;
+
+		slot.pCommandBuffer = new CommandBuffer( *m_pCommandPool );
+		if( !slot.pCommandBuffer->isValid() )
+			return false;
+
+		if( vkCreateFence( device, &fenceInfo, nullptr, &slot.vkFence ) != VK_SUCCESS )
+		{
+			log_error( "Cannot create frame capture fence." );
+			return false;
+		}
+	}
+
+	m_uNextSlot = 0;
+
+	return true;
+}
+
+void FrameCapture::destroySlots()
+{
+	for( auto& slot : m_Slots )
+	{
+		if( slot.pMappedData != nullptr )
+		{
+			slot.pBuffer->unmap();
+		}
+		if( slot.vkFence != VK_NULL_HANDLE )
+		{
+			vkDestroyFence( m_pRenderer->getNativeDeviceHandle(), slot.vkFence, nullptr );
+		}
+
+		safe_delete( slot.pCommandBuffer );
+		safe_delete( slot.pBuffer );
+		safe_delete( slot.pMemoryPool );
+	}
+	m_Slots.clear();
+}
+
+bool FrameCapture::createSlotBuffer( Slot& slot, uint64_t size )
+{
+	slot.pBuffer = new Buffer( *m_pRenderer, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT );
+
+	if( !slot.pBuffer->isValid() )
+		return false;
+
+	uint32_t typeFilter;
+	uint64_t requiredSize;
+	slot.pBuffer->getMemoryRequirements( nullptr, &typeFilter, &requiredSize );
+
+	// every slot gets its own allocation so all of them can stay mapped persistently
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+	                                   VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+	if( !MemoryPool::hasCompatibleMemoryType( *m_pRenderer, typeFilter, properties ) )
+	{
+		log_warning( "Cannot find host cached memory for frame capture, reads will be slow." );
+		properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		             VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
+
+	slot.pMemoryPool = new MemoryPool( *m_pRenderer, requiredSize, typeFilter, properties );
+
+	if( !slot.pMemoryPool->isValid() ||
+	    !slot.pBuffer->allocateMemoryFromPool( *slot.pMemoryPool ) )
+	{
+		return false;
+	}
+
+	slot.pMappedData = slot.pBuffer->map();
+	return ( slot.pMappedData != nullptr );
+}
+
+bool FrameCapture::recordCopy( Slot& slot, VkImage image )
+{
+	CommandBuffer& commandBuffer = *slot.pCommandBuffer;
+
+	if( !commandBuffer.begin( VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT ) )
+		return false;
+
+	VkImageMemoryBarrier imageBarrier{};
+	imageBarrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrier.pNext                           = nullptr;
+	imageBarrier.srcAccessMask                   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	imageBarrier.dstAccessMask                   = VK_ACCESS_TRANSFER_READ_BIT;
+	imageBarrier.oldLayout                       = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	imageBarrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image                           = image;
+	imageBarrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.baseMipLevel   = 0;
+	imageBarrier.subresourceRange.levelCount     = 1;
+	imageBarrier.subresourceRange.baseArrayLayer = 0;
+	imageBarrier.subresourceRange.layerCount     = 1;
+
+	commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+	                               VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                               {},
+	                               { imageBarrier } );
+
+	VkBufferImageCopy region{};
+	region.bufferOffset                    = 0;
+	region.bufferRowLength                 = 0;
+	region.bufferImageHeight               = 0;
+	region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel       = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount     = 1;
+	region.imageOffset                     = { 0, 0, 0 };
+	region.imageExtent                     = { slot.extent.width, slot.extent.height, 1 };
+
+	commandBuffer.copyImageToBuffer( *slot.pBuffer,
+	                                 image,
+	                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                                 { region } );
+
+	imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	imageBarrier.dstAccessMask = 0;
+	imageBarrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.newLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkBufferMemoryBarrier bufferBarrier{};
+	bufferBarrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.pNext               = nullptr;
+	bufferBarrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask       = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer              = slot.pBuffer->getNativeHandle();
+	bufferBarrier.offset              = 0;
+	bufferBarrier.size                = VK_WHOLE_SIZE;
+
+	commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                               VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT |
+	                               VK_PIPELINE_STAGE_HOST_BIT,
+	                               { bufferBarrier },
+	                               { imageBarrier } );
+
+	return commandBuffer.end();
+}
+
+void FrameCapture::waitForPendingSlots()
+{
+	VkDevice device = m_pRenderer->getNativeDeviceHandle();
+
+	for( auto& slot : m_Slots )
+	{
+		if( slot.state == SlotState::InFlight )
+		{
+			vkWaitForFences( device, 1, &slot.vkFence, VK_TRUE, ~(uint64_t)0 );
+		}
+	}
+
+	poll();
+
+	std::unique_lock<std::mutex> lock( m_Mutex );
+	m_IdleCondition.wait( lock, [ this ]() {
+		for( const auto& slot : m_Slots )
+		{
+			if( slot.state == SlotState::Writing )
+				return false;
+		}
+		return true;
+	} );
+}
+
+void FrameCapture::writerLoop()
+{
+	static const char* const extensions[] = { "raw", "png" };
+
+	char filename[ 32 ];
+
+	std::unique_lock<std::mutex> lock( m_Mutex );
+	while( true )
+	{
+		m_WriteCondition.wait( lock, [ this ]() {
+			return ( m_bStopWriter || !m_WriteQueue.empty() );
+		} );
+
+		if( m_WriteQueue.empty() ) // stop requested and nothing left to write
+			break;
+
+		Slot* slot = m_WriteQueue.front();
+		m_WriteQueue.pop_front();
+
+		lock.unlock();
+
+		Profiler::clock_type::time_point start = Profiler::clock_type::now();
+
+		std::snprintf( filename,
+		               sizeof( filename ),
+		               "frame_%06llu.%s",
+		               (unsigned long long)slot->frameNumber,
+		               extensions[ (size_t)m_Format ] );
+
+		std::string path = m_strDirectory + "/" + filename;
+		bool written = ( m_Format == Format::Png ? writePng( path, *slot )
+		                                         : writeRaw( path, *slot ) );
+
+		Profiler::addTime( "capture.encode", Profiler::millisecondsSince( start ) );
+		if( written )
+		{
+			Profiler::addCount( "capture.frames_written" );
+		}
+
+		lock.lock();
+		slot->state = SlotState::Free;
+		m_IdleCondition.notify_all();
+	}
+}
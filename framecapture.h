@@ -0,0 +1,115 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include "common.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class Renderer;
+class MemoryPool;
+class Buffer;
+class CommandPool;
+class CommandBuffer;
+
+// Reads back presented swap chain images through a ring of host cached buffers.
+// Readbacks are polled via fences on later frames and written to disk by a
+// background thread, so neither capture nor encoding ever blocks the render loop.
+class FrameCapture
+{
+public:
+	enum class Format
+	{
+		Raw,
+		Png
+	};
+
+private:
+	enum class SlotState
+	{
+		Free,
+		InFlight,
+		Writing
+	};
+
+	struct Slot
+	{
+		SlotState      state;
+		uint64_t       frameNumber;
+		VkExtent2D     extent;
+		VkFormat       format;
+
+		MemoryPool*    pMemoryPool;
+		Buffer*        pBuffer;
+		void*          pMappedData;
+		CommandBuffer* pCommandBuffer;
+		VkFence        vkFence;
+	};
+
+public:
+	FrameCapture( Renderer& renderer,
+	              const std::string& directory,
+	              Format format,
+	              uint32_t numSlots );
+	~FrameCapture();
+
+	void           destroy();
+
+	bool           isValid()
+	{
+		return ( m_pCommandPool != nullptr );
+	}
+
+	// hands finished readbacks over to the writer thread, never waits
+	void           poll();
+
+	// records a copy of the given swap chain image into a free ring slot and returns
+	// the command buffer to submit with the returned fence, or nullptr if all slots
+	// are busy and the frame has to be dropped
+	CommandBuffer* capture( uint32_t imageIndex, VkFence& fence );
+
+	// reallocates the readback buffers after the swap chain was recreated
+	bool           resize();
+
+private:
+	static bool    isFormatSupported( VkFormat format );
+
+	static bool    writeRaw( const std::string& filename, const Slot& slot );
+	static bool    writePng( const std::string& filename, const Slot& slot );
+
+	bool           createSlots();
+	void           destroySlots();
+
+	bool           createSlotBuffer( Slot& slot, uint64_t size );
+	bool           recordCopy( Slot& slot, VkImage image );
+
+	void           waitForPendingSlots();
+
+	void           writerLoop();
+
+private:
+	Renderer*          m_pRenderer;
+	CommandPool*       m_pCommandPool;
+
+	std::string        m_strDirectory;
+	Format             m_Format;
+	uint32_t           m_uNumSlots;
+	uint32_t           m_uNextSlot;
+	uint64_t           m_uFrameNumber;
+
+	std::vector<Slot>  m_Slots;
+
+	std::thread             m_WriterThread;
+	std::mutex              m_Mutex;
+	std::condition_variable m_WriteCondition;
+	std::condition_variable m_IdleCondition;
+	std::deque<Slot*>       m_WriteQueue;
+	bool                    m_bStopWriter;
+};
+
+#endif // FRAMECAPTURE_H
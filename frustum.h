@@ -0,0 +1,51 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+// View frustum as six normalized planes (xyz normal pointing inwards, w distance),
+// a point p is inside a plane if dot( plane.xyz, p ) + plane.w >= 0.
+struct Frustum
+{
+public:
+	enum Plane
+	{
+		Left = 0,
+		Right,
+		Bottom,
+		Top,
+		Near,
+		Far,
+		COUNT
+	};
+
+public:
+	glm::vec4 planes[ COUNT ];
+
+public:
+	// extracts the planes from a view projection matrix with a [0, 1] clip space depth
+	// range, as built by Renderer::updateUniforms
+	static Frustum fromViewProjection( const glm::mat4& viewProj )
+	{
+		glm::mat4 rows = glm::transpose( viewProj );
+
+		Frustum frustum;
+		frustum.planes[ Left ]   = rows[ 3 ] + rows[ 0 ];
+		frustum.planes[ Right ]  = rows[ 3 ] - rows[ 0 ];
+		frustum.planes[ Bottom ] = rows[ 3 ] + rows[ 1 ];
+		frustum.planes[ Top ]    = rows[ 3 ] - rows[ 1 ];
+		frustum.planes[ Near ]   = rows[ 2 ];
+		frustum.planes[ Far ]    = rows[ 3 ] - rows[ 2 ];
+
+		for( auto& plane : frustum.planes )
+		{
+			plane = plane * ( 1.0f / glm::length( glm::vec3( plane ) ) );
+		}
+		return frustum;
+	}
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,238 @@
+#include "gpuculler.h"
+#include "renderer.h"
+#include "memorypool.h"
+#include "buffer.h"
+#include "commandbuffer.h"
+#include "descriptorsetlayout.h"
+#include "descriptorset.h"
+#include "descriptorallocator.h"
+#include "computepipeline.h"
+
+#include <algorithm>
+#include <cstring>
+
+GpuCuller::GpuCuller( Renderer& renderer,
+                      Shader& shader,
+                      uint32_t numContexts,
+                      uint32_t maxObjects )
+    : m_pRenderer( &renderer ),
+      m_uMaxObjects( maxObjects ),
+      m_uNumObjects( 0 ),
+      m_bCompact( renderer.supportsDrawIndirectCount() ),
+      m_Objects(),
+      m_Transforms(),
+      m_Contexts( numContexts, Context{} ),
+      m_pPipeline( nullptr )
+{
+	static const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+	                                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	bool success = createAllocation( m_Objects,
+	                                 maxObjects * sizeof( Object ),
+	                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	                                 hostVisible ) &&
+	               createAllocation( m_Transforms,
+	                                 maxObjects * sizeof( glm::mat4 ),
+	                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+	                                 hostVisible );
+
+	for( auto& context : m_Contexts )
+	{
+		success = success &&
+		          createAllocation( context.uniforms,
+		                            sizeof( Uniforms ),
+		                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		                            hostVisible ) &&
+		          createAllocation( context.drawCommands,
+		                            maxObjects * sizeof( VkDrawIndexedIndirectCommand ),
+		                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		                            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT ) &&
+		          createAllocation( context.drawCount,
+		                            sizeof( uint32_t ),
+		                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		                            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+		                            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+	}
+
+	if( !success )
+	{
+		destroy();
+		return;
+	}
+
+	// compaction is fixed per device, the driver drops the unused path
+	SpecializationConstants specialization = {
+	    { 0, WORKGROUP_SIZE },
+	    { 1, m_bCompact }
+	};
+
+	// the descriptor set layout is reflected from the shader
+	m_pPipeline = new ComputePipeline( renderer, shader, specialization );
+
+	if( !m_pPipeline->isValid() )
+	{
+		destroy();
+	}
+	else if( m_pPipeline->getDescriptorSetLayout( 0 ) == nullptr )
+	{
+		log_error( "Culling shader declares no descriptor set." );
+		destroy();
+	}
+}
+
+GpuCuller::~GpuCuller()
+{
+	destroy();
+}
+
+void GpuCuller::destroy()
+{
+	safe_delete( m_pPipeline );
+
+	for( auto& context : m_Contexts )
+	{
+		destroyAllocation( context.drawCount );
+		destroyAllocation( context.drawCommands );
+		destroyAllocation( context.uniforms );
+	}
+
+	destroyAllocation( m_Transforms );
+	destroyAllocation( m_Objects );
+}
+
+void GpuCuller::setNumObjects( uint32_t numObjects )
+{
+	m_uNumObjects = std::min( numObjects, m_uMaxObjects );
+}
+
+bool GpuCuller::cull( CommandBuffer& commandBuffer,
+                      uint32_t context,
+                      const Frustum& frustum,
+                      DescriptorAllocator& descriptorAllocator )
+{
+	Context& ctx = m_Contexts[ context ];
+
+	// transient, recycled with the allocator instead of being kept per context
+	VkDescriptorSet set = descriptorAllocator.allocate( *m_pPipeline->getDescriptorSetLayout( 0 ) );
+
+	if( set == VK_NULL_HANDLE )
+		return false;
+
+	DescriptorSet::Writer setWriter( set );
+	setWriter.uniformBuffer( 0, *ctx.uniforms.pBuffer, 0, sizeof( Uniforms ) )
+	         .storageBuffer( 1, *m_Objects.pBuffer, 0, VK_WHOLE_SIZE )
+	         .storageBuffer( 2, *m_Transforms.pBuffer, 0, VK_WHOLE_SIZE )
+	         .storageBuffer( 3, *ctx.drawCommands.pBuffer, 0, VK_WHOLE_SIZE )
+	         .storageBuffer( 4, *ctx.drawCount.pBuffer, 0, VK_WHOLE_SIZE );
+
+	descriptorAllocator.update( setWriter );
+
+	Uniforms uniforms{};
+	std::memcpy( uniforms.planes, frustum.planes, sizeof( uniforms.planes ) );
+	uniforms.numObjects = m_uNumObjects;
+
+	std::memcpy( ctx.uniforms.pMappedData, &uniforms, sizeof( Uniforms ) );
+
+	VkBufferMemoryBarrier countBarrier{};
+	countBarrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	countBarrier.pNext               = nullptr;
+	countBarrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+	countBarrier.dstAccessMask       = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	countBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	countBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	countBarrier.buffer              = ctx.drawCount.pBuffer->getNativeHandle();
+	countBarrier.offset              = 0;
+	countBarrier.size                = VK_WHOLE_SIZE;
+
+	commandBuffer.fillBuffer( *ctx.drawCount.pBuffer, 0, sizeof( uint32_t ), 0 );
+	commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                               { countBarrier },
+	                               {} );
+
+	commandBuffer.bindPipeline( *m_pPipeline );
+	commandBuffer.bindDescriptorSet( set, *m_pPipeline );
+	uint32_t workgroupSize = m_pPipeline->getWorkgroupSize()[ 0 ];
+	commandBuffer.dispatch( ( m_uNumObjects + workgroupSize - 1 ) / workgroupSize, 1, 1 );
+
+	// the draw commands and count are consumed as indirect arguments
+	VkBufferMemoryBarrier indirectBarriers[ 2 ] = { countBarrier, countBarrier };
+	for( auto& barrier : indirectBarriers )
+	{
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	}
+	indirectBarriers[ 0 ].buffer = ctx.drawCommands.pBuffer->getNativeHandle();
+
+	commandBuffer.pipelineBarrier( VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                               VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+	                               { indirectBarriers[ 0 ], indirectBarriers[ 1 ] },
+	                               {} );
+	return true;
+}
+
+void GpuCuller::draw( CommandBuffer& commandBuffer, uint32_t context )
+{
+	Context& ctx = m_Contexts[ context ];
+
+	if( m_bCompact )
+	{
+		commandBuffer.drawIndexedIndirectCount( *ctx.drawCommands.pBuffer,
+		                                        0,
+		                                        *ctx.drawCount.pBuffer,
+		                                        0,
+		                                        m_uNumObjects,
+		                                        sizeof( VkDrawIndexedIndirectCommand ) );
+	}
+	else
+	{
+		commandBuffer.drawIndexedIndirect( *ctx.drawCommands.pBuffer,
+		                                   0,
+		                                   m_uNumObjects,
+		                                   sizeof( VkDrawIndexedIndirectCommand ) );
+	}
+}
+
+bool GpuCuller::createAllocation( Allocation& allocation,
+                                  uint64_t size,
+                                  VkBufferUsageFlags usage,
+                                  VkMemoryPropertyFlags properties )
+{
+	allocation.pBuffer = new Buffer( *m_pRenderer, size, usage );
+
+	if( !allocation.pBuffer->isValid() )
+		return false;
+
+	uint32_t typeFilter;
+	uint64_t requiredSize;
+	allocation.pBuffer->getMemoryRequirements( nullptr, &typeFilter, &requiredSize );
+
+	// host visible buffers get their own allocation so they can stay mapped
+	allocation.pMemoryPool = new MemoryPool( *m_pRenderer, requiredSize, typeFilter, properties );
+
+	if( !allocation.pMemoryPool->isValid() ||
+	    !allocation.pBuffer->allocateMemoryFromPool( *allocation.pMemoryPool ) )
+	{
+		return false;
+	}
+
+	if( ( properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT ) != 0 )
+	{
+		allocation.pMappedData = allocation.pBuffer->map();
+		return ( allocation.pMappedData != nullptr );
+	}
+	return true;
+}
+
+void GpuCuller::destroyAllocation( Allocation& allocation )
+{
+	if( allocation.pMappedData != nullptr )
+	{
+		allocation.pBuffer->unmap();
+		allocation.pMappedData = nullptr;
+	}
+	safe_delete( allocation.pBuffer );
+	safe_delete( allocation.pMemoryPool );
+}
@@ -0,0 +1,128 @@
+#ifndef GPUCULLER_H
+#define GPUCULLER_H
+
+#include "common.h"
+#include "frustum.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+class Renderer;
+class Shader;
+class MemoryPool;
+class Buffer;
+class CommandBuffer;
+class DescriptorAllocator;
+class ComputePipeline;
+
+// Frustum culls objects in a compute pass and writes the surviving draws as indexed
+// indirect commands. With VK_KHR_draw_indirect_count the survivors are compacted and
+// counted on the GPU; otherwise culled objects keep their slot with zero instances.
+// Per-context (frame in flight) resources allow culling while earlier frames draw.
+class GpuCuller
+{
+public:
+	// matches the std430 layout in cull.comp
+	struct Object
+	{
+		glm::vec4 boundingSphere;
+		uint32_t  indexCount;
+		uint32_t  firstIndex;
+		int32_t   vertexOffset;
+		uint32_t  padding;
+	};
+
+private:
+	// matches the std140 layout in cull.comp
+	struct Uniforms
+	{
+		glm::vec4 planes[ Frustum::COUNT ];
+		uint32_t  numObjects;
+	};
+
+	struct Allocation
+	{
+		MemoryPool* pMemoryPool;
+		Buffer*     pBuffer;
+		void*       pMappedData;
+	};
+
+	struct Context
+	{
+		Allocation uniforms;
+		Allocation drawCommands;
+		Allocation drawCount;
+	};
+
+public:
+	// specialized into cull.comp, dispatches use the size reflected from the pipeline
+	static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+public:
+	GpuCuller( Renderer& renderer, Shader& shader, uint32_t numContexts, uint32_t maxObjects );
+	~GpuCuller();
+
+	void       destroy();
+
+	bool       isValid()
+	{
+		return ( m_pPipeline != nullptr );
+	}
+
+	// host visible object data, written by the caller while no frame using it is in flight
+	Object*    getObjects()
+	{
+		return reinterpret_cast<Object*>( m_Objects.pMappedData );
+	}
+	glm::mat4* getTransforms()
+	{
+		return reinterpret_cast<glm::mat4*>( m_Transforms.pMappedData );
+	}
+
+	uint32_t   getMaxObjects()
+	{
+		return m_uMaxObjects;
+	}
+	uint32_t   getNumObjects()
+	{
+		return m_uNumObjects;
+	}
+	void       setNumObjects( uint32_t numObjects );
+
+	bool       isCompacting()
+	{
+		return m_bCompact;
+	}
+
+	// records the culling dispatch, has to be called outside of a render pass; the
+	// descriptor set is allocated from the given allocator, which has to keep it until
+	// the command buffer has executed
+	bool       cull( CommandBuffer& commandBuffer,
+	                 uint32_t context,
+	                 const Frustum& frustum,
+	                 DescriptorAllocator& descriptorAllocator );
+
+	// records the draws written by the last cull() of the context
+	void       draw( CommandBuffer& commandBuffer, uint32_t context );
+
+private:
+	bool       createAllocation( Allocation& allocation,
+	                             uint64_t size,
+	                             VkBufferUsageFlags usage,
+	                             VkMemoryPropertyFlags properties );
+	void       destroyAllocation( Allocation& allocation );
+
+private:
+	Renderer*            m_pRenderer;
+	uint32_t             m_uMaxObjects;
+	uint32_t             m_uNumObjects;
+	bool                 m_bCompact;
+
+	Allocation           m_Objects;
+	Allocation           m_Transforms;
+	std::vector<Context> m_Contexts;
+
+	ComputePipeline*     m_pPipeline;
+};
+
+#endif // GPUCULLER_H
@@ -0,0 +1,144 @@
+#include "image.h"
+#include "memorypool.h"
+#include "renderer.h"
+
+Image::Image( Renderer& renderer, VkFormat format, VkExtent2D extent, VkImageUsageFlags usage )
+    : wrapper_type( renderer.getNativeDeviceHandle() ),
+      m_pRenderer( &renderer ),
+      m_vkFormat( format ),
+      m_vkExtent( extent ),
+      m_vkView( VK_NULL_HANDLE )
+{
+	if( !createImage( usage ) )
+	{
+		destroy();
+	}
+}
+
+Image::~Image()
+{
+	destroy();
+}
+
+void Image::destroy()
+{
+	if( m_vkView != VK_NULL_HANDLE )
+	{
+		vkDestroyImageView( m_vkDevice, m_vkView, nullptr );
+		m_vkView = VK_NULL_HANDLE;
+	}
+	wrapper_type::destroy();
+}
+
+bool Image::isDepthFormat( VkFormat format )
+{
+	switch( format )
+	{
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool Image::hasStencil( VkFormat format )
+{
+	return ( format == VK_FORMAT_D16_UNORM_S8_UINT ||
+	         format == VK_FORMAT_D24_UNORM_S8_UINT ||
+	         format == VK_FORMAT_D32_SFLOAT_S8_UINT );
+}
+
+VkImageAspectFlags Image::getAspect()
+{
+	if( !isDepthFormat( m_vkFormat ) )
+	{
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+	return ( hasStencil( m_vkFormat ) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT
+	                                  : VK_IMAGE_ASPECT_DEPTH_BIT );
+}
+
+void Image::getMemoryRequirements( uint64_t* alignment, uint32_t* typeFilter, uint64_t* size )
+{
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements( m_vkDevice, m_vkHandle, &requirements );
+
+	if( alignment  != nullptr ) *alignment  = requirements.alignment;
+	if( typeFilter != nullptr ) *typeFilter = requirements.memoryTypeBits;
+	if( size       != nullptr ) *size       = requirements.size;
+}
+
+bool Image::bindMemory( MemoryPool& pool, uint64_t offset )
+{
+	VkResult res = vkBindImageMemory( m_vkDevice, m_vkHandle, pool.getNativeHandle(), offset );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot bind image memory." );
+		return false;
+	}
+	return createView();
+}
+
+bool Image::createImage( VkImageUsageFlags usage )
+{
+	VkImageCreateInfo createInfo{};
+	createInfo.sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	createInfo.pNext                 = nullptr;
+	createInfo.flags                 = 0;
+	createInfo.imageType             = VK_IMAGE_TYPE_2D;
+	createInfo.format                = m_vkFormat;
+	createInfo.extent                = { m_vkExtent.width, m_vkExtent.height, 1 };
+	createInfo.mipLevels             = 1;
+	createInfo.arrayLayers           = 1;
+	createInfo.samples               = VK_SAMPLE_COUNT_1_BIT;
+	createInfo.tiling                = VK_IMAGE_TILING_OPTIMAL;
+	createInfo.usage                 = usage;
+	createInfo.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
+	createInfo.queueFamilyIndexCount = 0;
+	createInfo.pQueueFamilyIndices   = nullptr;
+	createInfo.initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkResult res = vkCreateImage( m_vkDevice, &createInfo, nullptr, &m_vkHandle );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot create image." );
+		return false;
+	}
+	return true;
+}
+
+bool Image::createView()
+{
+	VkImageViewCreateInfo createInfo{};
+	createInfo.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	createInfo.pNext                           = nullptr;
+	createInfo.flags                           = 0;
+	createInfo.image                           = m_vkHandle;
+	createInfo.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+	createInfo.format                          = m_vkFormat;
+	createInfo.components.r                    = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.components.g                    = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.components.b                    = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.components.a                    = VK_COMPONENT_SWIZZLE_IDENTITY;
+	createInfo.subresourceRange.aspectMask     = getAspect();
+	createInfo.subresourceRange.baseMipLevel   = 0;
+	createInfo.subresourceRange.levelCount     = 1;
+	createInfo.subresourceRange.baseArrayLayer = 0;
+	createInfo.subresourceRange.layerCount     = 1;
+
+	VkResult res = vkCreateImageView( m_vkDevice, &createInfo, nullptr, &m_vkView );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot create image view." );
+		return false;
+	}
+	return true;
+}
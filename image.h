@@ -0,0 +1,60 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "common.h"
+#include "vulkanobjectwrapper.h"
+
+#include <vulkan/vulkan.h>
+
+class Renderer;
+class MemoryPool;
+
+// Single mip, single layer 2D image with a view covering all of it. Memory is bound at
+// an explicit offset, so images that are never used at the same time may alias.
+class Image : public VulkanObjectWrapper<VkImage, vkDestroyImage>
+{
+public:
+	Image() = default;
+	Image( Renderer& renderer, VkFormat format, VkExtent2D extent, VkImageUsageFlags usage );
+
+	virtual ~Image();
+
+	void               destroy();
+
+	static bool        isDepthFormat( VkFormat format );
+	static bool        hasStencil( VkFormat format );
+
+	VkImageView        getView()
+	{
+		return m_vkView;
+	}
+	VkFormat           getFormat()
+	{
+		return m_vkFormat;
+	}
+	VkExtent2D         getExtent()
+	{
+		return m_vkExtent;
+	}
+	VkImageAspectFlags getAspect();
+
+	void               getMemoryRequirements( uint64_t* alignment,
+	                                          uint32_t* typeFilter,
+	                                          uint64_t* size );
+
+	// binds the image to the pool's memory at the given offset, bypassing the pool's
+	// allocator, and creates the view
+	bool               bindMemory( MemoryPool& pool, uint64_t offset );
+
+private:
+	bool               createImage( VkImageUsageFlags usage );
+	bool               createView();
+
+private:
+	Renderer*   m_pRenderer;
+	VkFormat    m_vkFormat;
+	VkExtent2D  m_vkExtent;
+	VkImageView m_vkView;
+};
+
+#endif // IMAGE_H
@@ -0,0 +1,426 @@
+#include "jobsystem.h"
+
+#include <algorithm>
+
+namespace
+{
+
+struct CurrentWorker
+{
+	const JobSystem* pSystem;
+	uint32_t         index;
+};
+
+thread_local CurrentWorker t_CurrentWorker = { nullptr, 0 };
+
+struct ParallelRange
+{
+	JobSystem::RangeCallback callback;
+	uint32_t                 first;
+	uint32_t                 count;
+};
+
+void parallelRangeJob( void* userData )
+{
+	ParallelRange& range = *reinterpret_cast<ParallelRange*>( userData );
+	range.callback( range.first, range.count );
+}
+
+} // namespace
+
+JobSystem::Counter::Counter()
+    : m_uValue( 0 ),
+      m_Mutex(),
+      m_Dependents()
+{
+}
+
+JobSystem::Deque::Deque()
+    : m_iTop( 0 ),
+      m_iBottom( 0 )
+{
+	for( auto& job : m_Jobs )
+	{
+		job.store( nullptr, std::memory_order_relaxed );
+	}
+}
+
+bool JobSystem::Deque::push( Job* job )
+{
+	int64_t bottom = m_iBottom.load( std::memory_order_relaxed );
+	int64_t top    = m_iTop.load( std::memory_order_acquire );
+
+	if( bottom - top >= DEQUE_CAPACITY )
+		return false;
+
+	// the release store publishes the job to thieves acquiring bottom
+	m_Jobs[ bottom % DEQUE_CAPACITY ].store( job, std::memory_order_relaxed );
+	m_iBottom.store( bottom + 1, std::memory_order_release );
+
+	return true;
+}
+
+JobSystem::Job* JobSystem::Deque::pop()
+{
+	int64_t bottom = m_iBottom.load( std::memory_order_relaxed ) - 1;
+	m_iBottom.store( bottom, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	int64_t top = m_iTop.load( std::memory_order_relaxed );
+
+	if( top > bottom )
+	{
+		// empty
+		m_iBottom.store( bottom + 1, std::memory_order_relaxed );
+		return nullptr;
+	}
+
+	Job* job = m_Jobs[ bottom % DEQUE_CAPACITY ].load( std::memory_order_relaxed );
+
+	if( top == bottom )
+	{
+		// last job, race thieves for it
+		if( !m_iTop.compare_exchange_strong( top,
+		                                     top + 1,
+		                                     std::memory_order_seq_cst,
+		                                     std::memory_order_relaxed ) )
+		{
+			job = nullptr;
+		}
+		m_iBottom.store( bottom + 1, std::memory_order_relaxed );
+	}
+	return job;
+}
+
+JobSystem::Job* JobSystem::Deque::steal()
+{
+	int64_t top = m_iTop.load( std::memory_order_acquire );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	int64_t bottom = m_iBottom.load( std::memory_order_acquire );
+
+	if( top >= bottom )
+		return nullptr;
+
+	Job* job = m_Jobs[ top % DEQUE_CAPACITY ].load( std::memory_order_acquire );
+
+	if( !m_iTop.compare_exchange_strong( top,
+	                                     top + 1,
+	                                     std::memory_order_seq_cst,
+	                                     std::memory_order_relaxed ) )
+	{
+		// lost against the owner or another thief
+		return nullptr;
+	}
+	return job;
+}
+
+JobSystem::JobSystem( uint32_t numThreads )
+    : m_Workers(),
+      m_Queue(),
+      m_uNumQueued( 0 ),
+      m_uNumSleeping( 0 ),
+      m_bStop( false )
+{
+	if( numThreads == 0 )
+	{
+		numThreads = std::max( std::thread::hardware_concurrency(), 1u );
+	}
+
+	m_Workers.resize( numThreads );
+	for( auto& worker : m_Workers )
+	{
+		worker = new Worker();
+		worker->jobs    = std::vector<Job>( JOB_POOL_SIZE );
+		worker->nextJob = 0;
+
+		for( auto& job : worker->jobs )
+		{
+			job.free.store( true, std::memory_order_relaxed );
+		}
+	}
+
+	t_CurrentWorker = { this, 0 };
+
+	for( auto i = 1; i < numThreads; ++i )
+	{
+		m_Workers[ i ]->thread = std::thread( &JobSystem::workerLoop, this, i );
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	destroy();
+}
+
+void JobSystem::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_WakeMutex );
+		m_bStop = true;
+	}
+	m_WakeCondition.notify_all();
+
+	// all threads have to stop before any deque goes away, they steal from each other
+	for( auto& worker : m_Workers )
+	{
+		if( worker->thread.joinable() )
+		{
+			worker->thread.join();
+		}
+	}
+	for( auto& worker : m_Workers )
+	{
+		safe_delete( worker );
+	}
+	m_Workers.clear();
+
+	for( Job* job : m_Queue )
+	{
+		if( !job->pooled )
+		{
+			delete job;
+		}
+	}
+	m_Queue.clear();
+
+	if( t_CurrentWorker.pSystem == this )
+	{
+		t_CurrentWorker = { nullptr, 0 };
+	}
+}
+
+void JobSystem::run( JobCallback::FunctionPtr callback,
+                     void* userData,
+                     Counter* counter,
+                     Counter* dependency )
+{
+	uint32_t worker = getWorkerIndex();
+
+	if( counter != nullptr )
+	{
+		counter->m_uValue.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	Job* job = allocateJob( worker );
+	job->callback = { callback, userData };
+	job->pCounter = counter;
+
+	if( dependency != nullptr )
+	{
+		std::lock_guard<std::mutex> lock( dependency->m_Mutex );
+
+		if( dependency->m_uValue.load( std::memory_order_acquire ) != 0 )
+		{
+			dependency->m_Dependents.push_back( job );
+			return;
+		}
+	}
+
+	schedule( job, worker );
+}
+
+void JobSystem::wait( Counter& counter )
+{
+	uint32_t worker = getWorkerIndex();
+
+	while( !counter.isDone() )
+	{
+		if( !executeNext( worker ) )
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// the last job may still hold the lock after decrementing, the counter must outlive it
+	std::lock_guard<std::mutex> lock( counter.m_Mutex );
+}
+
+void JobSystem::parallelFor( uint32_t count,
+                             uint32_t minBatchSize,
+                             RangeCallback::FunctionPtr callback,
+                             void* userData )
+{
+	// a few batches per thread even out uneven batch costs through stealing
+	uint32_t numBatches = std::min( count / std::max( minBatchSize, 1u ),
+	                                (uint32_t)m_Workers.size() * 4 );
+
+	if( numBatches <= 1 )
+	{
+		if( count > 0 )
+		{
+			callback( 0, count, userData );
+		}
+		return;
+	}
+
+	std::vector<ParallelRange> ranges( numBatches );
+	Counter                    counter;
+
+	for( auto i = 0; i < numBatches; ++i )
+	{
+		uint32_t first = (uint64_t)count * i / numBatches;
+		uint32_t last  = (uint64_t)count * ( i + 1 ) / numBatches;
+
+		ranges[ i ] = { { callback, userData }, first, last - first };
+
+		run( parallelRangeJob, &ranges[ i ], &counter );
+	}
+
+	wait( counter );
+}
+
+void JobSystem::workerLoop( uint32_t index )
+{
+	t_CurrentWorker = { this, index };
+
+	while( !m_bStop )
+	{
+		if( executeNext( index ) )
+			continue;
+
+		std::unique_lock<std::mutex> lock( m_WakeMutex );
+
+		// the scheduling thread checks for sleepers after queueing, so either it sees
+		// this worker sleeping or this worker sees the queued job
+		++m_uNumSleeping;
+		m_WakeCondition.wait( lock, [ this ]() {
+			return ( m_bStop || m_uNumQueued.load() > 0 );
+		} );
+		--m_uNumSleeping;
+	}
+}
+
+uint32_t JobSystem::getWorkerIndex() const
+{
+	return ( t_CurrentWorker.pSystem == this ? t_CurrentWorker.index : NO_WORKER );
+}
+
+JobSystem::Job* JobSystem::allocateJob( uint32_t worker )
+{
+	if( worker == NO_WORKER )
+	{
+		Job* job = new Job();
+		job->pooled = false;
+		return job;
+	}
+
+	Worker& owner = *m_Workers[ worker ];
+	Job&    job   = owner.jobs[ owner.nextJob++ % JOB_POOL_SIZE ];
+
+	// the pool wrapped around onto a job still queued, help until it started
+	while( !job.free.load( std::memory_order_acquire ) )
+	{
+		if( !executeNext( worker ) )
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	job.free.store( false, std::memory_order_relaxed );
+	job.pooled = true;
+	return &job;
+}
+
+void JobSystem::schedule( Job* job, uint32_t worker )
+{
+	if( worker == NO_WORKER || !m_Workers[ worker ]->deque.push( job ) )
+	{
+		std::lock_guard<std::mutex> lock( m_QueueMutex );
+		m_Queue.push_back( job );
+	}
+
+	++m_uNumQueued;
+
+	if( m_uNumSleeping.load() > 0 )
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_WakeMutex );
+		}
+		m_WakeCondition.notify_one();
+	}
+}
+
+JobSystem::Job* JobSystem::findJob( uint32_t worker )
+{
+	Job* job = nullptr;
+
+	if( worker != NO_WORKER )
+	{
+		job = m_Workers[ worker ]->deque.pop();
+	}
+
+	uint32_t numWorkers = m_Workers.size();
+	uint32_t first      = ( worker != NO_WORKER ? worker + 1 : 0 );
+
+	for( auto i = 0; job == nullptr && i < numWorkers; ++i )
+	{
+		uint32_t victim = ( first + i ) % numWorkers;
+		if( victim != worker )
+		{
+			job = m_Workers[ victim ]->deque.steal();
+		}
+	}
+
+	if( job == nullptr )
+	{
+		std::lock_guard<std::mutex> lock( m_QueueMutex );
+		if( !m_Queue.empty() )
+		{
+			job = m_Queue.front();
+			m_Queue.pop_front();
+		}
+	}
+
+	if( job != nullptr )
+	{
+		--m_uNumQueued;
+	}
+	return job;
+}
+
+bool JobSystem::executeNext( uint32_t worker )
+{
+	Job* job = findJob( worker );
+	if( job == nullptr )
+		return false;
+
+	execute( job, worker );
+	return true;
+}
+
+void JobSystem::execute( Job* job, uint32_t worker )
+{
+	JobCallback callback = job->callback;
+	Counter*    counter  = job->pCounter;
+
+	// release the slot before running, jobs scheduling more jobs than the pool holds
+	// would otherwise wait for their own slot
+	if( job->pooled )
+	{
+		job->free.store( true, std::memory_order_release );
+	}
+	else
+	{
+		delete job;
+	}
+
+	callback();
+
+	if( counter == nullptr )
+		return;
+
+	std::vector<Job*> dependents;
+	{
+		// decremented under the lock, so dependents cannot be added after the swap
+		std::lock_guard<std::mutex> lock( counter->m_Mutex );
+
+		if( counter->m_uValue.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+		{
+			dependents.swap( counter->m_Dependents );
+		}
+	}
+
+	for( Job* dependent : dependents )
+	{
+		schedule( dependent, worker );
+	}
+}
@@ -0,0 +1,141 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <deque>
+
+// Work-stealing job scheduler. Every worker owns a Chase-Lev deque: the owner pushes and
+// pops at the bottom without locks, idle workers steal from the top with a single CAS.
+// The thread constructing the scheduler is worker 0 and executes jobs while it waits.
+// Jobs scheduled from other threads go through a locked queue.
+class JobSystem
+{
+public:
+	typedef PayloadCallback<void*, void> JobCallback;
+
+	// processes [first, first + count) of a parallel loop
+	typedef PayloadCallback<void*, void, uint32_t, uint32_t> RangeCallback;
+
+private:
+	struct Job;
+
+public:
+	// Counts unfinished jobs. Jobs can depend on a counter, they are scheduled once it
+	// reaches zero.
+	class Counter
+	{
+	friend class JobSystem;
+
+	public:
+		Counter();
+
+		bool isDone() const
+		{
+			return ( m_uValue.load( std::memory_order_acquire ) == 0 );
+		}
+
+	private:
+		std::atomic<uint32_t> m_uValue;
+		std::mutex            m_Mutex;
+		std::vector<Job*>     m_Dependents;
+	};
+
+public:
+	// numThreads includes the calling thread, 0 uses all hardware threads
+	JobSystem( uint32_t numThreads = 0 );
+	~JobSystem();
+
+	void     destroy();
+
+	uint32_t getNumThreads() const
+	{
+		return m_Workers.size();
+	}
+
+	// increments counter until the job finished; the job is held back until dependency
+	// reaches zero, which requires the jobs it counts to be scheduled already
+	void     run( JobCallback::FunctionPtr callback,
+	              void* userData,
+	              Counter* counter = nullptr,
+	              Counter* dependency = nullptr );
+
+	// executes jobs until the counter reaches zero
+	void     wait( Counter& counter );
+
+	// splits the range into batches of at least minBatchSize and blocks until all are done
+	void     parallelFor( uint32_t count,
+	                      uint32_t minBatchSize,
+	                      RangeCallback::FunctionPtr callback,
+	                      void* userData );
+
+private:
+	static constexpr uint32_t DEQUE_CAPACITY = 4096;
+	static constexpr uint32_t JOB_POOL_SIZE  = 4096;
+	static constexpr uint32_t NO_WORKER      = ~0u;
+
+	struct Job
+	{
+		JobCallback       callback;
+		Counter*          pCounter;
+		bool              pooled;
+		std::atomic<bool> free;
+	};
+
+	// fixed capacity Chase-Lev deque, see Lê et al., "Correct and Efficient Work-Stealing
+	// for Weak Memory Models"
+	class Deque
+	{
+	public:
+		Deque();
+
+		// owner only, fails if the deque is full
+		bool push( Job* job );
+		Job* pop();
+
+		// any thread
+		Job* steal();
+
+	private:
+		std::atomic<int64_t> m_iTop;
+		std::atomic<int64_t> m_iBottom;
+		std::atomic<Job*>    m_Jobs[ DEQUE_CAPACITY ];
+	};
+
+	struct Worker
+	{
+		std::thread      thread;
+		Deque            deque;
+		std::vector<Job> jobs;
+		uint32_t         nextJob;
+	};
+
+private:
+	void     workerLoop( uint32_t index );
+
+	uint32_t getWorkerIndex() const;
+	Job*     allocateJob( uint32_t worker );
+	void     schedule( Job* job, uint32_t worker );
+	Job*     findJob( uint32_t worker );
+	bool     executeNext( uint32_t worker );
+	void     execute( Job* job, uint32_t worker );
+
+private:
+	std::vector<Worker*>    m_Workers;
+
+	std::mutex              m_QueueMutex;
+	std::deque<Job*>        m_Queue;
+
+	std::mutex              m_WakeMutex;
+	std::condition_variable m_WakeCondition;
+	std::atomic<uint32_t>   m_uNumQueued;
+	std::atomic<uint32_t>   m_uNumSleeping;
+	std::atomic<bool>       m_bStop;
+};
+
+#endif // JOBSYSTEM_H
@@ -0,0 +1,206 @@
+#include "layoutcache.h"
+#include "renderer.h"
+#include "shader.h"
+#include "descriptorsetlayout.h"
+
+#include <algorithm>
+
+LayoutCache::LayoutCache( Renderer& renderer )
+    : m_pRenderer( &renderer ),
+      m_Mutex(),
+      m_DescriptorSetLayouts(),
+      m_PipelineLayouts()
+{
+}
+
+LayoutCache::~LayoutCache()
+{
+	destroy();
+}
+
+void LayoutCache::destroy()
+{
+	for( auto& pair : m_PipelineLayouts )
+	{
+		vkDestroyPipelineLayout( m_pRenderer->getNativeDeviceHandle(), pair.second, nullptr );
+	}
+	m_PipelineLayouts.clear();
+
+	for( auto& pair : m_DescriptorSetLayouts )
+	{
+		delete pair.second;
+	}
+	m_DescriptorSetLayouts.clear();
+}
+
+bool LayoutCache::getLayout( const std::vector<Shader*>& shaders, Layout& layout )
+{
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+	std::vector<VkPushConstantRange>                       ranges;
+
+	for( auto shader : shaders )
+	{
+		const ShaderReflection& reflection = shader->getReflection();
+
+		for( const auto& binding : reflection.getDescriptorBindings() )
+		{
+			if( binding.set >= sets.size() )
+			{
+				sets.resize( binding.set + 1 );
+			}
+
+			auto& bindings = sets[ binding.set ];
+			auto  it       = std::find_if( bindings.begin(),
+			                               bindings.end(),
+			                               [ &binding ]( const VkDescriptorSetLayoutBinding& b ) {
+				return ( b.binding == binding.binding );
+			} );
+
+			if( it == bindings.end() )
+			{
+				bindings.push_back( { binding.binding,
+				                      binding.type,
+				                      binding.count,
+				                      (VkShaderStageFlags)shader->getStage(),
+				                      nullptr } );
+			}
+			else if( it->descriptorType == binding.type && it->descriptorCount == binding.count )
+			{
+				it->stageFlags |= shader->getStage();
+			}
+			else
+			{
+				log_error( "Conflicting declarations of descriptor set " +
+				           std::to_string( binding.set ) + ", binding " +
+				           std::to_string( binding.binding ) + "." );
+				return false;
+			}
+		}
+
+		// stages sharing a block get a single range
+		VkPushConstantRange range = reflection.getPushConstantRange();
+		if( range.size > 0 )
+		{
+			auto it = std::find_if( ranges.begin(),
+			                        ranges.end(),
+			                        [ &range ]( const VkPushConstantRange& r ) {
+				return ( r.offset == range.offset && r.size == range.size );
+			} );
+
+			if( it != ranges.end() )
+			{
+				it->stageFlags |= range.stageFlags;
+			}
+			else
+			{
+				ranges.push_back( range );
+			}
+		}
+	}
+
+	// stages may declare bindings in any order, equal sets have to hash equally
+	for( auto& bindings : sets )
+	{
+		std::sort( bindings.begin(),
+		           bindings.end(),
+		           []( const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b ) {
+			return ( a.binding < b.binding );
+		} );
+	}
+
+	std::lock_guard<std::mutex> lock( m_Mutex );
+
+	layout.descriptorLayouts.resize( sets.size() );
+	for( auto i = 0; i < sets.size(); ++i )
+	{
+		layout.descriptorLayouts[ i ] = getDescriptorSetLayout( sets[ i ] );
+
+		if( layout.descriptorLayouts[ i ] == nullptr )
+			return false;
+	}
+
+	layout.pushConstantRanges = ranges;
+	layout.vkPipelineLayout   = getPipelineLayout( layout.descriptorLayouts, ranges );
+
+	return ( layout.vkPipelineLayout != VK_NULL_HANDLE );
+}
+
+DescriptorSetLayout* LayoutCache::getDescriptorSetLayout(
+        const std::vector<VkDescriptorSetLayoutBinding>& bindings )
+{
+	uint64_t hash = hash_bytes( nullptr, 0 );
+	for( const auto& binding : bindings )
+	{
+		uint32_t fields[] = {
+		    binding.binding,
+		    (uint32_t)binding.descriptorType,
+		    binding.descriptorCount,
+		    binding.stageFlags
+		};
+		hash = hash_bytes( fields, sizeof( fields ), hash );
+	}
+
+	DescriptorSetLayout*& layout = m_DescriptorSetLayouts[ hash ];
+	if( layout == nullptr )
+	{
+		layout = new DescriptorSetLayout( *m_pRenderer, bindings );
+
+		if( !layout->isValid() )
+		{
+			safe_delete( layout );
+			m_DescriptorSetLayouts.erase( hash );
+		}
+	}
+	return layout;
+}
+
+VkPipelineLayout LayoutCache::getPipelineLayout(
+        const std::vector<DescriptorSetLayout*>& descriptorLayouts,
+        const std::vector<VkPushConstantRange>& pushConstantRanges )
+{
+	std::vector<VkDescriptorSetLayout> layouts( descriptorLayouts.size() );
+	for( auto i = 0; i < descriptorLayouts.size(); ++i )
+	{
+		layouts[ i ] = descriptorLayouts[ i ]->getNativeHandle();
+	}
+
+	// counts precede the lists, so differently split lists never hash equally
+	uint64_t numLayouts = layouts.size();
+	uint64_t numRanges  = pushConstantRanges.size();
+
+	uint64_t hash = hash_bytes( &numLayouts, sizeof( numLayouts ) );
+	hash = hash_bytes( layouts.data(), layouts.size() * sizeof( VkDescriptorSetLayout ), hash );
+	hash = hash_bytes( &numRanges, sizeof( numRanges ), hash );
+	hash = hash_bytes( pushConstantRanges.data(),
+	                   pushConstantRanges.size() * sizeof( VkPushConstantRange ),
+	                   hash );
+
+	auto it = m_PipelineLayouts.find( hash );
+	if( it != m_PipelineLayouts.end() )
+		return it->second;
+
+	VkPipelineLayoutCreateInfo createInfo{};
+	createInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	createInfo.pNext                  = nullptr;
+	createInfo.flags                  = 0;
+	createInfo.setLayoutCount         = layouts.size();
+	createInfo.pSetLayouts            = ( layouts.empty() ? nullptr : layouts.data() );
+	createInfo.pushConstantRangeCount = pushConstantRanges.size();
+	createInfo.pPushConstantRanges    = ( pushConstantRanges.empty() ? nullptr
+	                                                                 : pushConstantRanges.data() );
+
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkResult         res    = vkCreatePipelineLayout( m_pRenderer->getNativeDeviceHandle(),
+	                                                  &createInfo,
+	                                                  nullptr,
+	                                                  &layout );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot create pipeline layout." );
+		return VK_NULL_HANDLE;
+	}
+
+	m_PipelineLayouts[ hash ] = layout;
+	return layout;
+}
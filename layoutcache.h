@@ -0,0 +1,56 @@
+#ifndef LAYOUTCACHE_H
+#define LAYOUTCACHE_H
+
+#include "common.h"
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+
+class Renderer;
+class Shader;
+class DescriptorSetLayout;
+
+// Creates descriptor set and pipeline layouts from the reflection of a pipeline's shader
+// stages, merged across stages. Layouts are deduplicated by their contents, so pipelines
+// declaring equal resources share them and sets bound for one pipeline stay valid after
+// switching to another. Thread safe, pipelines are compiled on several threads.
+class LayoutCache
+{
+public:
+	struct Layout
+	{
+		// one per set up to the highest one used, skipped sets get empty layouts
+		std::vector<DescriptorSetLayout*> descriptorLayouts;
+		std::vector<VkPushConstantRange>  pushConstantRanges;
+		VkPipelineLayout                  vkPipelineLayout;
+	};
+
+public:
+	LayoutCache( Renderer& renderer );
+	~LayoutCache();
+
+	void destroy();
+
+	// the layouts are owned by the cache; false if the stages declare a binding with
+	// different types or counts or a layout cannot be created
+	bool getLayout( const std::vector<Shader*>& shaders, Layout& layout );
+
+private:
+	// require the mutex
+	DescriptorSetLayout* getDescriptorSetLayout(
+	        const std::vector<VkDescriptorSetLayoutBinding>& bindings );
+	VkPipelineLayout     getPipelineLayout(
+	        const std::vector<DescriptorSetLayout*>& descriptorLayouts,
+	        const std::vector<VkPushConstantRange>& pushConstantRanges );
+
+private:
+	Renderer*  m_pRenderer;
+
+	std::mutex m_Mutex;
+	std::unordered_map<uint64_t, DescriptorSetLayout*> m_DescriptorSetLayouts;
+	std::unordered_map<uint64_t, VkPipelineLayout>     m_PipelineLayouts;
+};
+
+#endif // LAYOUTCACHE_H
@@ -0,0 +1,68 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "common.h"
+
+#include <atomic>
+
+// Lock-free triple buffer handing values from one producer to one consumer. The producer
+// writes to its own slot and swaps it with the shared slot on publish; the consumer swaps
+// its slot with the shared one when a newer value was published. Neither side waits for
+// the other, values the consumer did not pick up in time are overwritten.
+template<typename T>
+class Mailbox
+{
+public:
+	Mailbox()
+	    : m_Slots(),
+	      m_uWrite( 0 ),
+	      m_uShared( 1 ),
+	      m_uRead( 2 )
+	{
+	}
+
+	// producer: slot to fill before publish(), contents are stale
+	T&       getWriteSlot()
+	{
+		return m_Slots[ m_uWrite ];
+	}
+
+	void     publish()
+	{
+		m_uWrite = m_uShared.exchange( m_uWrite | FRESH_BIT, std::memory_order_acq_rel ) & INDEX_MASK;
+	}
+
+	// consumer: true if a value was published since the last acquire()
+	bool     hasFresh() const
+	{
+		return ( ( m_uShared.load( std::memory_order_relaxed ) & FRESH_BIT ) != 0 );
+	}
+
+	// takes the latest published value, returns false and keeps the current one if there
+	// is none
+	bool     acquire()
+	{
+		if( !hasFresh() )
+			return false;
+
+		m_uRead = m_uShared.exchange( m_uRead, std::memory_order_acq_rel ) & INDEX_MASK;
+		return true;
+	}
+
+	const T& getReadSlot() const
+	{
+		return m_Slots[ m_uRead ];
+	}
+
+private:
+	static constexpr uint32_t INDEX_MASK = 0x3;
+	static constexpr uint32_t FRESH_BIT  = 0x4;
+
+private:
+	T                     m_Slots[ 3 ];
+	uint32_t              m_uWrite;
+	std::atomic<uint32_t> m_uShared;
+	uint32_t              m_uRead;
+};
+
+#endif // MAILBOX_H
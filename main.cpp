@@ -2,12 +2,43 @@
 #include "window.h"
 #include "windowsurface.h"
 #include "renderer.h"
+#include "profiler.h"
+#include "benchmark.h"
+#include "renderthread.h"
 
 #include <string>
+#include <cstring>
+#include <cstdlib>
+
+struct Options
+{
+	uint64_t             benchmarkFrames;
+	std::string          microBenchmark;
+	uint32_t             numDraws;
+	uint32_t             numInstances;
+	bool                 directDraws;
+	bool                 parallelRecording;
+	bool                 renderThread;
+	uint32_t             cullingObjects;
+	std::string          captureDirectory;
+	FrameCapture::Format captureFormat;
+	bool                 hotReload;
+};
+
+struct MainLoopData
+{
+	Renderer*     pRenderer;
+	RenderThread* pRenderThread;
+	uint64_t      frameLimit;
+	uint64_t      numFrames;
+};
 
 void renderCallback( Window& window, void* userData )
 {
-	Renderer& renderer = *reinterpret_cast<Renderer*>( userData );
+	MainLoopData& data     = *reinterpret_cast<MainLoopData*>( userData );
+	Renderer&     renderer = *data.pRenderer;
+
+	Profiler::ScopedTimer frameTimer( "frame" );
 
 	uint32_t imageIndex = renderer.renderFrame();
 
@@ -20,9 +51,28 @@ void renderCallback( Window& window, void* userData )
 		log_warning( "Dropping invalid frame." );
 	}
 
-	renderer.waitForIdle(); // TODO: remove?
+	if( data.frameLimit > 0 && ++data.numFrames >= data.frameLimit )
+	{
+		window.close();
+	}
+}
 
-	renderer.updateUniforms();
+void publishCallback( Window& window, void* userData )
+{
+	MainLoopData& data         = *reinterpret_cast<MainLoopData*>( userData );
+	RenderThread& renderThread = *data.pRenderThread;
+
+	FrameSnapshot& snapshot = renderThread.beginSnapshot();
+	snapshot = data.pRenderer->createSnapshot();
+	renderThread.publishSnapshot();
+
+	// stay at most one frame ahead, but keep polling events if rendering stalls
+	renderThread.waitForConsumption( std::chrono::milliseconds( 100 ) );
+
+	if( data.frameLimit > 0 && renderThread.getNumFrames() >= data.frameLimit )
+	{
+		window.close();
+	}
 }
 
 void resizeCallback( Window& window, uint32_t width, uint32_t height, void* userData )
@@ -42,8 +92,98 @@ void resizeCallback( Window& window, uint32_t width, uint32_t height, void* user
 	}
 }
 
-int main()
+bool parseOptions( int argc, char* argv[], Options& options )
+{
+	options.benchmarkFrames   = 0;
+	options.numDraws          = 1;
+	options.numInstances      = 1;
+	options.directDraws       = false;
+	options.parallelRecording = false;
+	options.renderThread      = false;
+	options.cullingObjects    = 0;
+	options.captureFormat     = FrameCapture::Format::Png;
+	options.hotReload         = false;
+
+	for( auto i = 1; i < argc; ++i )
+	{
+		bool hasValue = ( i + 1 < argc );
+
+		if( std::strcmp( argv[ i ], "--benchmark" ) == 0 && hasValue )
+		{
+			options.benchmarkFrames = std::strtoull( argv[ ++i ], nullptr, 10 );
+		}
+		else if( std::strcmp( argv[ i ], "--micro-benchmark" ) == 0 && hasValue )
+		{
+			options.microBenchmark = argv[ ++i ];
+		}
+		else if( std::strcmp( argv[ i ], "--draws" ) == 0 && hasValue )
+		{
+			options.numDraws = std::strtoul( argv[ ++i ], nullptr, 10 );
+		}
+		else if( std::strcmp( argv[ i ], "--instances" ) == 0 && hasValue )
+		{
+			options.numInstances = std::strtoul( argv[ ++i ], nullptr, 10 );
+		}
+		else if( std::strcmp( argv[ i ], "--direct-draws" ) == 0 )
+		{
+			options.directDraws = true;
+		}
+		else if( std::strcmp( argv[ i ], "--parallel-recording" ) == 0 )
+		{
+			// draws are only recorded in parallel without indirect commands
+			options.directDraws       = true;
+			options.parallelRecording = true;
+		}
+		else if( std::strcmp( argv[ i ], "--render-thread" ) == 0 )
+		{
+			options.renderThread = true;
+		}
+		else if( std::strcmp( argv[ i ], "--gpu-culling" ) == 0 && hasValue )
+		{
+			options.cullingObjects = std::strtoul( argv[ ++i ], nullptr, 10 );
+		}
+		else if( std::strcmp( argv[ i ], "--hot-reload" ) == 0 )
+		{
+			options.hotReload = true;
+		}
+		else if( std::strcmp( argv[ i ], "--capture" ) == 0 && hasValue )
+		{
+			options.captureDirectory = argv[ ++i ];
+		}
+		else if( std::strcmp( argv[ i ], "--capture-format" ) == 0 && hasValue )
+		{
+			std::string format = argv[ ++i ];
+			if( format == "raw" )
+			{
+				options.captureFormat = FrameCapture::Format::Raw;
+			}
+			else if( format != "png" )
+			{
+				log_error( "Unknown capture format: " + format );
+				return false;
+			}
+		}
+		else
+		{
+			log_error( std::string( "Unknown or incomplete option: " ) + argv[ i ] );
+			log_info( "Usage: vulkan-test [--benchmark <frames>] [--micro-benchmark record|sort|cull|jobs|pipelines|descriptors|rendergraph]"
+			          " [--draws <count>] [--instances <count>] [--direct-draws] [--parallel-recording]"
+			          " [--gpu-culling <objects>] [--render-thread] [--hot-reload]"
+			          " [--capture <directory>] [--capture-format png|raw]" );
+			return false;
+		}
+	}
+	return true;
+}
+
+int main( int argc, char* argv[] )
 {
+	Options options;
+	if( !parseOptions( argc, argv, options ) )
+	{
+		return 1;
+	}
+
 	if( Window::initializeWindowSystem() &&
 	    Renderer::initializeRenderingSystem( Window::queryRequiredRendererExtensions() ) )
 	{
@@ -53,12 +193,77 @@ int main()
 			WindowSurface windowSurface( window );
 			Renderer renderer( windowSurface );
 
-			window.setMainLoopCallback( renderCallback, &renderer );
-			window.setResizeCallback( resizeCallback, &renderer );
+			if( renderer.isValid() )
+			{
+				renderer.setNumDraws( options.numDraws );
+				renderer.setIndirectDraws( !options.directDraws );
+				renderer.setParallelRecording( options.parallelRecording );
+
+				if( options.numInstances > 1 &&
+				    !renderer.setNumInstances( options.numInstances ) )
+				{
+					log_error( "Cannot set number of instances." );
+				}
+
+				if( options.cullingObjects > 0 &&
+				    !renderer.enableGpuCulling( options.cullingObjects ) )
+				{
+					log_error( "Cannot enable GPU culling." );
+				}
+
+				if( !options.microBenchmark.empty() )
+				{
+					Benchmark::run( renderer, options.microBenchmark );
+				}
+				else
+				{
+					if( !options.captureDirectory.empty() &&
+					    !renderer.enableFrameCapture( options.captureDirectory,
+					                                  options.captureFormat,
+					                                  3 ) )
+					{
+						log_error( "Cannot enable frame capture." );
+					}
+
+					if( options.hotReload && !renderer.enableShaderHotReload() )
+					{
+						log_error( "Cannot enable shader hot reload." );
+					}
+
+					MainLoopData loopData{ &renderer, nullptr, options.benchmarkFrames, 0 };
 
-			window.startMainLoop();
+					window.setResizeCallback( resizeCallback, &renderer );
 
-			renderer.waitForIdle();
+					Profiler::reset();
+
+					if( options.renderThread )
+					{
+						RenderThread renderThread( renderer );
+						loopData.pRenderThread = &renderThread;
+
+						window.setMainLoopCallback( publishCallback, &loopData );
+						window.startMainLoop();
+
+						renderThread.stop();
+					}
+					else
+					{
+						window.setMainLoopCallback( renderCallback, &loopData );
+						window.startMainLoop();
+					}
+				}
+
+				renderer.waitForIdle();
+			}
+			else
+			{
+				log_error( "Cannot initialize renderer." );
+			}
+		}
+
+		if( options.benchmarkFrames > 0 || !options.captureDirectory.empty() )
+		{
+			Profiler::report();
 		}
 
 		Renderer::terminateRenderingSystem();
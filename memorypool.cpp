@@ -7,6 +7,9 @@ MemoryPool::MemoryPool( Renderer& renderer,
                         uint32_t typeFilter,
                         VkMemoryPropertyFlags properties )
     : wrapper_type( renderer.getNativeDeviceHandle() ),
+      m_vkType( INVALID_TYPE ),
+      m_vkTypeProperties( 0 ),
+      m_uNonCoherentAtomSize( 1 ),
       m_pRenderer( &renderer ),
       m_uSize( 0 ),
       m_Chunks(),
@@ -19,6 +22,13 @@ MemoryPool::MemoryPool( Renderer& renderer,
 	}
 }
 
+bool MemoryPool::hasCompatibleMemoryType( Renderer& renderer,
+                                          uint32_t filter,
+                                          VkMemoryPropertyFlags properties )
+{
+	return ( findMemoryType( renderer, filter, properties, nullptr ) != INVALID_TYPE );
+}
+
 bool MemoryPool::allocateBufferMemory( Buffer& buffer )
 {
 	uint64_t alignment, size;
@@ -110,11 +120,49 @@ void MemoryPool::unmap()
 	vkUnmapMemory( m_vkDevice, m_vkHandle );
 }
 
-bool MemoryPool::determineCompatibleMemoryType( uint32_t filter,
-                                                VkMemoryPropertyFlags properties )
+bool MemoryPool::invalidate( Buffer& buffer, uint64_t offset, uint64_t length )
+{
+	if( ( m_vkTypeProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ) != 0 )
+	{
+		return true;
+	}
+
+	VkMappedMemoryRange range = getMappedRange( buffer, offset, length );
+
+	VkResult res = vkInvalidateMappedMemoryRanges( m_vkDevice, 1, &range );
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot invalidate mapped buffer memory." );
+		return false;
+	}
+	return true;
+}
+
+bool MemoryPool::flush( Buffer& buffer, uint64_t offset, uint64_t length )
+{
+	if( ( m_vkTypeProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT ) != 0 )
+	{
+		return true;
+	}
+
+	VkMappedMemoryRange range = getMappedRange( buffer, offset, length );
+
+	VkResult res = vkFlushMappedMemoryRanges( m_vkDevice, 1, &range );
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot flush mapped buffer memory." );
+		return false;
+	}
+	return true;
+}
+
+uint32_t MemoryPool::findMemoryType( Renderer& renderer,
+                                     uint32_t filter,
+                                     VkMemoryPropertyFlags properties,
+                                     VkMemoryPropertyFlags* typeProperties )
 {
 	VkPhysicalDeviceMemoryProperties deviceMemory;
-	vkGetPhysicalDeviceMemoryProperties( m_pRenderer->getNativePhysicalDeviceHandle(),
+	vkGetPhysicalDeviceMemoryProperties( renderer.getNativePhysicalDeviceHandle(),
 	                                     &deviceMemory );
 
 	for( auto i = 0; i < deviceMemory.memoryTypeCount; ++i )
@@ -122,13 +170,34 @@ bool MemoryPool::determineCompatibleMemoryType( uint32_t filter,
 		if( ( filter & ( 1 << i ) ) != 0 &&
 		    ( deviceMemory.memoryTypes[ i ].propertyFlags & properties ) == properties )
 		{
-			m_vkType = i;
-			return true;
+			if( typeProperties != nullptr )
+			{
+				*typeProperties = deviceMemory.memoryTypes[ i ].propertyFlags;
+			}
+			return i;
 		}
 	}
 
-	log_error( "Cannot find suitable memory type." );
-	return false;
+	return INVALID_TYPE;
+}
+
+bool MemoryPool::determineCompatibleMemoryType( uint32_t filter,
+                                                VkMemoryPropertyFlags properties )
+{
+	m_vkType = findMemoryType( *m_pRenderer, filter, properties, &m_vkTypeProperties );
+
+	if( m_vkType == INVALID_TYPE )
+	{
+		log_error( "Cannot find suitable memory type." );
+		return false;
+	}
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties( m_pRenderer->getNativePhysicalDeviceHandle(),
+	                               &deviceProperties );
+	m_uNonCoherentAtomSize = deviceProperties.limits.nonCoherentAtomSize;
+
+	return true;
 }
 
 bool MemoryPool::allocateMemory( uint64_t size )
@@ -155,3 +224,27 @@ bool MemoryPool::allocateMemory( uint64_t size )
 		return true;
 	}
 }
+
+VkMappedMemoryRange MemoryPool::getMappedRange( Buffer& buffer, uint64_t offset, uint64_t length )
+{
+	const Chunk& chunk = *m_BufferChunkMap[ &buffer ];
+
+	// non-coherent ranges must be aligned to the atom size or reach the end of the allocation
+	uint64_t begin = chunk.offset + offset;
+	uint64_t end   = begin + length;
+
+	begin -= begin % m_uNonCoherentAtomSize;
+	if( end % m_uNonCoherentAtomSize != 0 )
+	{
+		end += ( m_uNonCoherentAtomSize - end % m_uNonCoherentAtomSize );
+	}
+
+	VkMappedMemoryRange range{};
+	range.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.pNext  = nullptr;
+	range.memory = m_vkHandle;
+	range.offset = begin;
+	range.size   = ( end >= m_uSize ? VK_WHOLE_SIZE : end - begin );
+
+	return range;
+}
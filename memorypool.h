@@ -30,6 +30,10 @@ public:
 	            uint32_t typeFilter,
 	            VkMemoryPropertyFlags properties );
 
+	static bool    hasCompatibleMemoryType( Renderer& renderer,
+	                                        uint32_t filter,
+	                                        VkMemoryPropertyFlags properties );
+
 	Renderer&      getRenderer()
 	{
 		return *m_pRenderer;
@@ -41,14 +45,26 @@ public:
 	void*          map( Buffer& buffer, uint64_t offset, uint64_t length );
 	void           unmap();
 
+	bool           invalidate( Buffer& buffer, uint64_t offset, uint64_t length );
+	bool           flush( Buffer& buffer, uint64_t offset, uint64_t length );
+
 private:
+	static uint32_t findMemoryType( Renderer& renderer,
+	                                uint32_t filter,
+	                                VkMemoryPropertyFlags properties,
+	                                VkMemoryPropertyFlags* typeProperties );
+
 	bool determineCompatibleMemoryType( uint32_t filter,
 	                                    VkMemoryPropertyFlags properties );
 
 	bool allocateMemory( uint64_t size );
 
+	VkMappedMemoryRange getMappedRange( Buffer& buffer, uint64_t offset, uint64_t length );
+
 private:
 	uint32_t                            m_vkType;
+	VkMemoryPropertyFlags               m_vkTypeProperties;
+	uint64_t                            m_uNonCoherentAtomSize;
 
 	Renderer*                           m_pRenderer;
 	uint64_t                            m_uSize;
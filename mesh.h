@@ -0,0 +1,22 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <vulkan/vulkan.h>
+
+class Buffer;
+
+// Location of an indexed mesh within vertex and index buffers. Instanced meshes
+// additionally reference a per-instance stream bound after the vertex stream.
+struct Mesh
+{
+	Buffer*     pVertexBuffer;
+	uint64_t    vertexOffset;
+	Buffer*     pInstanceBuffer;
+	uint64_t    instanceOffset;
+	Buffer*     pIndexBuffer;
+	uint64_t    indexOffset;
+	VkIndexType indexType;
+	uint32_t    numIndices;
+};
+
+#endif // MESH_H
@@ -0,0 +1,212 @@
+#include "parallelrecorder.h"
+#include "renderer.h"
+#include "commandpool.h"
+#include "commandbuffer.h"
+#include "profiler.h"
+
+#include <algorithm>
+
+ParallelRecorder::ParallelRecorder( Renderer& renderer,
+                                    uint32_t numContexts,
+                                    uint32_t numThreads,
+                                    uint32_t minDrawsPerThread )
+    : m_pRenderer( &renderer ),
+      m_uMinDrawsPerThread( std::max( minDrawsPerThread, 1u ) ),
+      m_Workers(),
+      m_uGeneration( 0 ),
+      m_uPendingWorkers( 0 ),
+      m_bStop( false ),
+      m_uContext( 0 ),
+      m_vkUsage( 0 ),
+      m_pRenderPass( nullptr ),
+      m_uSubpass( 0 ),
+      m_vkFramebuffer( VK_NULL_HANDLE ),
+      m_uNumDraws( 0 ),
+      m_uNumChunks( 0 ),
+      m_Callback()
+{
+	if( numThreads == 0 )
+	{
+		numThreads = std::max( std::thread::hardware_concurrency(), 1u );
+	}
+
+	uint32_t queueFamily = renderer.getQueueFamilies()[ QueueFamily::Graphics ].index;
+
+	m_Workers.resize( numThreads );
+	for( auto& worker : m_Workers )
+	{
+		worker.commandPools.resize( numContexts, nullptr );
+		worker.commandBuffers.resize( numContexts, nullptr );
+		worker.recorded = false;
+	}
+
+	for( auto& worker : m_Workers )
+	{
+		for( auto i = 0; i < numContexts; ++i )
+		{
+			// one transient pool per thread, command pools are externally synchronized
+			worker.commandPools[ i ] = new CommandPool( renderer,
+			                                            queueFamily,
+			                                            VK_COMMAND_POOL_CREATE_TRANSIENT_BIT );
+			if( !worker.commandPools[ i ]->isValid() )
+			{
+				destroy();
+				return;
+			}
+
+			worker.commandBuffers[ i ] = new CommandBuffer( *worker.commandPools[ i ],
+			                                                VK_COMMAND_BUFFER_LEVEL_SECONDARY );
+			if( !worker.commandBuffers[ i ]->isValid() )
+			{
+				destroy();
+				return;
+			}
+			worker.commandBuffers[ i ]->setStateTracking( true );
+		}
+	}
+
+	for( auto i = 0; i < m_Workers.size(); ++i )
+	{
+		m_Workers[ i ].thread = std::thread( &ParallelRecorder::workerLoop, this, i );
+	}
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+	destroy();
+}
+
+void ParallelRecorder::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		m_bStop = true;
+	}
+	m_StartCondition.notify_all();
+
+	for( auto& worker : m_Workers )
+	{
+		if( worker.thread.joinable() )
+		{
+			worker.thread.join();
+		}
+
+		for( auto i = 0; i < worker.commandPools.size(); ++i )
+		{
+			safe_delete( worker.commandBuffers[ i ] );
+			safe_delete( worker.commandPools[ i ] );
+		}
+	}
+	m_Workers.clear();
+}
+
+bool ParallelRecorder::record( uint32_t context,
+                               VkCommandBufferUsageFlags usage,
+                               CommandBuffer& primary,
+                               RenderPass& renderPass,
+                               uint32_t subpass,
+                               VkFramebuffer framebuffer,
+                               uint32_t numDraws,
+                               RecordCallback::FunctionPtr callback,
+                               void* userData )
+{
+	if( numDraws == 0 )
+	{
+		return true;
+	}
+
+	Profiler::ScopedTimer timer( "record.parallel" );
+
+	uint32_t numChunks = std::min<uint32_t>( m_Workers.size(),
+	                                         std::max( numDraws / m_uMinDrawsPerThread, 1u ) );
+
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+
+		m_uContext        = context;
+		m_vkUsage         = usage;
+		m_pRenderPass     = &renderPass;
+		m_uSubpass        = subpass;
+		m_vkFramebuffer   = framebuffer;
+		m_uNumDraws       = numDraws;
+		m_uNumChunks      = numChunks;
+		m_Callback        = { callback, userData };
+		m_uPendingWorkers = numChunks;
+		++m_uGeneration;
+	}
+	m_StartCondition.notify_all();
+
+	std::vector<CommandBuffer*> secondaries( numChunks );
+	{
+		std::unique_lock<std::mutex> lock( m_Mutex );
+		m_DoneCondition.wait( lock, [ this ]() {
+			return ( m_uPendingWorkers == 0 );
+		} );
+
+		for( auto i = 0; i < numChunks; ++i )
+		{
+			if( !m_Workers[ i ].recorded )
+			{
+				log_error( "Cannot record secondary command buffers." );
+				return false;
+			}
+			secondaries[ i ] = m_Workers[ i ].commandBuffers[ context ];
+		}
+	}
+
+	primary.executeCommands( secondaries );
+	return true;
+}
+
+void ParallelRecorder::workerLoop( uint32_t index )
+{
+	Worker&  worker     = m_Workers[ index ];
+	uint64_t generation = 0;
+
+	std::unique_lock<std::mutex> lock( m_Mutex );
+	while( true )
+	{
+		m_StartCondition.wait( lock, [ this, generation ]() {
+			return ( m_bStop || m_uGeneration != generation );
+		} );
+
+		if( m_bStop )
+			break;
+
+		generation = m_uGeneration;
+
+		if( index >= m_uNumChunks )
+			continue;
+
+		uint32_t first = (uint64_t)m_uNumDraws * index / m_uNumChunks;
+		uint32_t last  = (uint64_t)m_uNumDraws * ( index + 1 ) / m_uNumChunks;
+
+		lock.unlock();
+		bool recorded = recordChunk( worker, first, last - first );
+		lock.lock();
+
+		worker.recorded = recorded;
+		if( --m_uPendingWorkers == 0 )
+		{
+			m_DoneCondition.notify_one();
+		}
+	}
+}
+
+bool ParallelRecorder::recordChunk( Worker& worker, uint32_t first, uint32_t count )
+{
+	CommandBuffer& commandBuffer = *worker.commandBuffers[ m_uContext ];
+
+	if( !worker.commandPools[ m_uContext ]->reset() ||
+	    !commandBuffer.begin( m_vkUsage,
+	                          *m_pRenderPass,
+	                          m_uSubpass,
+	                          m_vkFramebuffer ) )
+	{
+		return false;
+	}
+
+	m_Callback( commandBuffer, first, count );
+
+	return commandBuffer.end();
+}
@@ -0,0 +1,98 @@
+#ifndef PARALLELRECORDER_H
+#define PARALLELRECORDER_H
+
+#include "common.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class Renderer;
+class CommandPool;
+class CommandBuffer;
+class RenderPass;
+
+// Splits a draw list across worker threads, each recording into a secondary command
+// buffer allocated from its own command pool, and executes the results in a primary
+// command buffer. Every worker keeps one pool per context (e.g. per primary command
+// buffer in use), so recording for one context never recycles another's buffers.
+class ParallelRecorder
+{
+public:
+	// records draws [first, first + count) into the given secondary command buffer,
+	// secondary command buffers do not inherit state, so bindings have to be recorded
+	typedef PayloadCallback<void*, void, CommandBuffer&, uint32_t, uint32_t> RecordCallback;
+
+private:
+	struct Worker
+	{
+		std::thread                 thread;
+		std::vector<CommandPool*>   commandPools;
+		std::vector<CommandBuffer*> commandBuffers;
+		bool                        recorded;
+	};
+
+public:
+	ParallelRecorder( Renderer& renderer,
+	                  uint32_t numContexts,
+	                  uint32_t numThreads,
+	                  uint32_t minDrawsPerThread );
+	~ParallelRecorder();
+
+	void     destroy();
+
+	bool     isValid()
+	{
+		return !m_Workers.empty();
+	}
+
+	uint32_t getNumThreads()
+	{
+		return m_Workers.size();
+	}
+
+	// the primary command buffer has to be inside the given render pass subpass, begun with
+	// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, and command buffers recorded by an earlier
+	// call for the same context must not be pending execution anymore since its pools are reset
+	bool     record( uint32_t context,
+	                 VkCommandBufferUsageFlags usage,
+	                 CommandBuffer& primary,
+	                 RenderPass& renderPass,
+	                 uint32_t subpass,
+	                 VkFramebuffer framebuffer,
+	                 uint32_t numDraws,
+	                 RecordCallback::FunctionPtr callback,
+	                 void* userData );
+
+private:
+	void     workerLoop( uint32_t index );
+
+	bool     recordChunk( Worker& worker, uint32_t first, uint32_t count );
+
+private:
+	Renderer*               m_pRenderer;
+	uint32_t                m_uMinDrawsPerThread;
+
+	std::vector<Worker>     m_Workers;
+
+	std::mutex              m_Mutex;
+	std::condition_variable m_StartCondition;
+	std::condition_variable m_DoneCondition;
+	uint64_t                m_uGeneration;
+	uint32_t                m_uPendingWorkers;
+	bool                    m_bStop;
+
+	// current task, written by record() before workers are woken up
+	uint32_t                  m_uContext;
+	VkCommandBufferUsageFlags m_vkUsage;
+	RenderPass*             m_pRenderPass;
+	uint32_t                m_uSubpass;
+	VkFramebuffer           m_vkFramebuffer;
+	uint32_t                m_uNumDraws;
+	uint32_t                m_uNumChunks;
+	RecordCallback          m_Callback;
+};
+
+#endif // PARALLELRECORDER_H
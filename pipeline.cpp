@@ -1,29 +1,55 @@
 #include "pipeline.h"
 #include "renderer.h"
 #include "swapchain.h"
-#include "vertex.h"
 #include "shader.h"
 #include "renderpass.h"
+#include "pipelinecache.h"
 #include "descriptorsetlayout.h"
+#include "layoutcache.h"
 
 #include <fstream>
 
+Pipeline::State::State()
+    : topology( VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST ),
+      cullMode( VK_CULL_MODE_BACK_BIT ),
+      frontFace( VK_FRONT_FACE_COUNTER_CLOCKWISE ),
+      blendEnable( false ),
+      depthTestEnable( false ),
+      depthWriteEnable( false ),
+      depthCompareOp( VK_COMPARE_OP_LESS ),
+      subpass( 0 )
+{
+}
+
 Pipeline::Pipeline()
     : m_vkPipeline( VK_NULL_HANDLE ),
       m_vkLayout( VK_NULL_HANDLE ),
-      m_pRenderPass( nullptr )
+      m_pRenderer( nullptr ),
+      m_DescriptorLayouts(),
+      m_VertexBindings(),
+      m_State()
 {
 }
 
 Pipeline::Pipeline( RenderPass& renderPass,
                     const std::vector<Shader*>& shaders,
-                    const std::vector<DescriptorSetLayout*>& descriptorLayouts )
+                    const std::vector<VertexBinding>& vertexBindings,
+                    const State& state,
+                    const std::vector<SpecializationConstants>& specializations,
+                    PipelineCache* pipelineCache )
     : Pipeline()
 {
-	m_pRenderPass = &renderPass;
+	m_pRenderer      = &renderPass.getRenderer();
+	m_VertexBindings = vertexBindings;
+	m_State          = state;
 
-	if( !createLayout( descriptorLayouts ) ||
-	    !createPipeline( shaders ) )
+	if( pipelineCache == nullptr )
+	{
+		pipelineCache = &m_pRenderer->getPipelineCache();
+	}
+
+	if( !createLayout( shaders ) ||
+	    !createPipeline( renderPass, shaders, specializations, *pipelineCache ) )
 	{
 		destroy();
 	}
@@ -36,7 +62,10 @@ Pipeline::~Pipeline()
 
 void Pipeline::destroy()
 {
-	VkDevice device = m_pRenderPass->getRenderer().getNativeDeviceHandle();
+	if( m_pRenderer == nullptr )
+		return;
+
+	VkDevice device = m_pRenderer->getNativeDeviceHandle();
 
 	if( m_vkPipeline != VK_NULL_HANDLE )
 	{
@@ -44,14 +73,13 @@ void Pipeline::destroy()
 		m_vkPipeline = VK_NULL_HANDLE;
 	}
 
-	if( m_vkLayout != VK_NULL_HANDLE )
-	{
-		vkDestroyPipelineLayout( device, m_vkLayout, nullptr );
-		m_vkLayout = VK_NULL_HANDLE;
-	}
+	m_vkLayout = VK_NULL_HANDLE;
+	m_DescriptorLayouts.clear();
 }
 
-VkPipelineShaderStageCreateInfo Pipeline::createShaderStageCreateInfo( Shader& shader )
+VkPipelineShaderStageCreateInfo Pipeline::createShaderStageCreateInfo(
+        Shader& shader,
+        const VkSpecializationInfo* specialization )
 {
 	VkPipelineShaderStageCreateInfo createInfo{};
 	createInfo.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -60,27 +88,75 @@ VkPipelineShaderStageCreateInfo Pipeline::createShaderStageCreateInfo( Shader& s
 	createInfo.stage               = shader.getStage();
 	createInfo.module              = shader.getNativeHandle();
 	createInfo.pName               = shader.getEntryFunction().c_str();
-	createInfo.pSpecializationInfo = nullptr;
+	createInfo.pSpecializationInfo = specialization;
 
 	return createInfo;
 }
 
-void Pipeline::populateFixedFunctionSetup( FixedFunctionSetup& ffs )
+bool Pipeline::populateFixedFunctionSetup( FixedFunctionSetup& ffs,
+                                           const std::vector<Shader*>& shaders )
 {
-	ffs.vertexInputBindings.resize( 1 );
-	ffs.vertexInputBindings[ 0 ].binding   = 0;
-	ffs.vertexInputBindings[ 0 ].stride    = sizeof( Vertex );
-	ffs.vertexInputBindings[ 0 ].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	const std::vector<ShaderReflection::VertexInput>* inputs = nullptr;
+	for( auto shader : shaders )
+	{
+		if( shader->getStage() == VK_SHADER_STAGE_VERTEX_BIT )
+		{
+			inputs = &shader->getReflection().getVertexInputs();
+		}
+	}
+
+	if( inputs == nullptr )
+	{
+		log_error( "Pipeline has no vertex shader." );
+		return false;
+	}
+
+	ffs.vertexInputBindings.resize( m_VertexBindings.size() );
+	ffs.vertexInputAttributes.clear();
+
+	auto     input    = inputs->begin();
+	uint32_t location = 0;
 
-	const auto& vertexAttributes = Vertex::getAttributeDescriptions();
+	for( auto binding = 0; binding < m_VertexBindings.size(); ++binding )
+	{
+		ffs.vertexInputBindings[ binding ].binding   = binding;
+		ffs.vertexInputBindings[ binding ].stride    = m_VertexBindings[ binding ].stride;
+		ffs.vertexInputBindings[ binding ].inputRate = m_VertexBindings[ binding ].inputRate;
+
+		for( const auto& attribute : m_VertexBindings[ binding ].attributes )
+		{
+			// inputs are sorted by location, so are the declared attributes
+			if( input == inputs->end() || input->location != location )
+			{
+				++location;
+				continue;
+			}
+
+			if( !ShaderReflection::isCompatibleFormat( attribute.format, input->format ) )
+			{
+				log_error( "Vertex attribute format does not match shader input at location " +
+				           std::to_string( location ) + "." );
+				return false;
+			}
+
+			VkVertexInputAttributeDescription desc{};
+			desc.binding  = binding;
+			desc.location = location;
+			desc.format   = attribute.format;
+			desc.offset   = attribute.offset;
+
+			ffs.vertexInputAttributes.push_back( desc );
+
+			++input;
+			++location;
+		}
+	}
 
-	ffs.vertexInputAttributes.resize( vertexAttributes.size() );
-	for( auto i = 0; i < vertexAttributes.size(); ++i )
+	if( input != inputs->end() )
 	{
-		ffs.vertexInputAttributes[ i ].binding  = 0;
-		ffs.vertexInputAttributes[ i ].location = i;
-		ffs.vertexInputAttributes[ i ].format   = vertexAttributes[ i ].format;
-		ffs.vertexInputAttributes[ i ].offset   = vertexAttributes[ i ].offset;
+		log_error( "No vertex attribute for shader input at location " +
+		           std::to_string( input->location ) + "." );
+		return false;
 	}
 
 	ffs.vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -94,7 +170,7 @@ void Pipeline::populateFixedFunctionSetup( FixedFunctionSetup& ffs )
 	ffs.inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 	ffs.inputAssembly.pNext                  = nullptr;
 	ffs.inputAssembly.flags                  = 0;
-	ffs.inputAssembly.topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	ffs.inputAssembly.topology               = m_State.topology;
 	ffs.inputAssembly.primitiveRestartEnable = VK_FALSE;
 
 //	uint32_t viewportWidth, viewportHeight;
@@ -131,8 +207,8 @@ void Pipeline::populateFixedFunctionSetup( FixedFunctionSetup& ffs )
 	ffs.rasterization.rasterizerDiscardEnable = VK_FALSE;
 	ffs.rasterization.polygonMode             = VK_POLYGON_MODE_FILL;
 	ffs.rasterization.lineWidth               = 1.0f;
-	ffs.rasterization.cullMode                = VK_CULL_MODE_BACK_BIT;
-	ffs.rasterization.frontFace               = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	ffs.rasterization.cullMode                = m_State.cullMode;
+	ffs.rasterization.frontFace               = m_State.frontFace;
 	ffs.rasterization.depthBiasEnable         = VK_FALSE;
 	ffs.rasterization.depthBiasConstantFactor = 0.0f;
 	ffs.rasterization.depthBiasClamp          = 0.0f;
@@ -148,14 +224,32 @@ void Pipeline::populateFixedFunctionSetup( FixedFunctionSetup& ffs )
 	ffs.multisampling.alphaToCoverageEnable = VK_FALSE;
 	ffs.multisampling.alphaToOneEnable      = VK_FALSE;
 
+	// ignored by subpasses without a depth attachment
+	ffs.depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	ffs.depthStencil.pNext                 = nullptr;
+	ffs.depthStencil.flags                 = 0;
+	ffs.depthStencil.depthTestEnable       = m_State.depthTestEnable ? VK_TRUE : VK_FALSE;
+	ffs.depthStencil.depthWriteEnable      = m_State.depthWriteEnable ? VK_TRUE : VK_FALSE;
+	ffs.depthStencil.depthCompareOp        = m_State.depthCompareOp;
+	ffs.depthStencil.depthBoundsTestEnable = VK_FALSE;
+	ffs.depthStencil.stencilTestEnable     = VK_FALSE;
+	ffs.depthStencil.front                 = {};
+	ffs.depthStencil.back                  = {};
+	ffs.depthStencil.minDepthBounds        = 0.0f;
+	ffs.depthStencil.maxDepthBounds        = 1.0f;
+
 	ffs.colorBlendAttachmentStates.resize( 1 );
 	ffs.colorBlendAttachmentStates[ 0 ].colorWriteMask      = VK_COLOR_COMPONENT_R_BIT |
 	                                                          VK_COLOR_COMPONENT_G_BIT |
 	                                                          VK_COLOR_COMPONENT_B_BIT |
 	                                                          VK_COLOR_COMPONENT_A_BIT;
-	ffs.colorBlendAttachmentStates[ 0 ].blendEnable         = VK_FALSE;
-	ffs.colorBlendAttachmentStates[ 0 ].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-	ffs.colorBlendAttachmentStates[ 0 ].dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+	ffs.colorBlendAttachmentStates[ 0 ].blendEnable         = m_State.blendEnable ? VK_TRUE : VK_FALSE;
+	ffs.colorBlendAttachmentStates[ 0 ].srcColorBlendFactor = m_State.blendEnable
+	                                                          ? VK_BLEND_FACTOR_SRC_ALPHA
+	                                                          : VK_BLEND_FACTOR_ONE;
+	ffs.colorBlendAttachmentStates[ 0 ].dstColorBlendFactor = m_State.blendEnable
+	                                                          ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA
+	                                                          : VK_BLEND_FACTOR_ZERO;
 	ffs.colorBlendAttachmentStates[ 0 ].colorBlendOp        = VK_BLEND_OP_ADD;
 	ffs.colorBlendAttachmentStates[ 0 ].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
 	ffs.colorBlendAttachmentStates[ 0 ].dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -172,51 +266,50 @@ void Pipeline::populateFixedFunctionSetup( FixedFunctionSetup& ffs )
 	ffs.colorBlend.blendConstants[ 1 ] = 0.0f;
 	ffs.colorBlend.blendConstants[ 2 ] = 0.0f;
 	ffs.colorBlend.blendConstants[ 3 ] = 0.0f;
+
+	return true;
 }
 
-bool Pipeline::createLayout( const std::vector<DescriptorSetLayout*>& descriptorLayouts )
+bool Pipeline::createLayout( const std::vector<Shader*>& shaders )
 {
-	std::vector<VkDescriptorSetLayout> layouts( descriptorLayouts.size() );
-	for( auto i = 0; i < descriptorLayouts.size(); ++i )
-	{
-		layouts[ i ] = descriptorLayouts[ i ]->getNativeHandle();
-	}
-
-	VkPipelineLayoutCreateInfo createInfo{};
-	createInfo.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	createInfo.pNext                  = nullptr;
-	createInfo.flags                  = 0;
-	createInfo.setLayoutCount         = layouts.size();
-	createInfo.pSetLayouts            = ( layouts.empty() ? nullptr : layouts.data() );
-	createInfo.pushConstantRangeCount = 0;
-	createInfo.pPushConstantRanges    = 0;
-
-	VkResult res = vkCreatePipelineLayout( m_pRenderPass->getRenderer().getNativeDeviceHandle(),
-	                                       &createInfo,
-	                                       nullptr,
-	                                       &m_vkLayout );
-
-
-	if( res != VK_SUCCESS )
+	LayoutCache::Layout layout;
+	if( !m_pRenderer->getLayoutCache().getLayout( shaders, layout ) )
 	{
 		log_error( "Cannot create pipeline layout." );
 		return false;
 	}
+
+	m_vkLayout          = layout.vkPipelineLayout;
+	m_DescriptorLayouts = layout.descriptorLayouts;
 	return true;
 }
 
-bool Pipeline::createPipeline( const std::vector<Shader*>& shaders )
+bool Pipeline::createPipeline( RenderPass& renderPass,
+                               const std::vector<Shader*>& shaders,
+                               const std::vector<SpecializationConstants>& specializations,
+                               PipelineCache& pipelineCache )
 {
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+	std::vector<VkSpecializationInfo>            specializationInfos;
 	shaderStages.resize( shaders.size() );
+	specializationInfos.resize( shaders.size() );
 
 	for( auto i = 0; i < shaderStages.size(); ++i )
 	{
-		shaderStages[ i ] = createShaderStageCreateInfo( *shaders[ i ] );
+		const VkSpecializationInfo* specialization = nullptr;
+
+		if( i < specializations.size() && !specializations[ i ].isEmpty() )
+		{
+			specializationInfos[ i ] = specializations[ i ].getInfo();
+			specialization           = &specializationInfos[ i ];
+		}
+
+		shaderStages[ i ] = createShaderStageCreateInfo( *shaders[ i ], specialization );
 	}
 
 	FixedFunctionSetup fixedFunction;
-	populateFixedFunctionSetup( fixedFunction );
+	if( !populateFixedFunctionSetup( fixedFunction, shaders ) )
+		return false;
 
 	std::vector<VkDynamicState> dynamicStates = {
 	    VK_DYNAMIC_STATE_VIEWPORT,
@@ -242,17 +335,17 @@ bool Pipeline::createPipeline( const std::vector<Shader*>& shaders )
 	createInfo.pViewportState      = &fixedFunction.viewport;
 	createInfo.pRasterizationState = &fixedFunction.rasterization;
 	createInfo.pMultisampleState   = &fixedFunction.multisampling;
-	createInfo.pDepthStencilState  = nullptr;
+	createInfo.pDepthStencilState  = &fixedFunction.depthStencil;
 	createInfo.pColorBlendState    = &fixedFunction.colorBlend;
 	createInfo.pDynamicState       = &dynamicState;
 	createInfo.layout              = m_vkLayout;
-	createInfo.renderPass          = m_pRenderPass->getNativeHandle();
-	createInfo.subpass             = 0;
+	createInfo.renderPass          = renderPass.getNativeHandle();
+	createInfo.subpass             = m_State.subpass;
 	createInfo.basePipelineHandle  = VK_NULL_HANDLE;
 	createInfo.basePipelineIndex   = -1;
 
-	VkResult res = vkCreateGraphicsPipelines( m_pRenderPass->getRenderer().getNativeDeviceHandle(),
-	                                          VK_NULL_HANDLE,
+	VkResult res = vkCreateGraphicsPipelines( m_pRenderer->getNativeDeviceHandle(),
+	                                          pipelineCache.getNativeHandle(),
 	                                          1,
 	                                          &createInfo,
 	                                          nullptr,
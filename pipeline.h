@@ -2,6 +2,8 @@
 #define PIPELINE_H
 
 #include "common.h"
+#include "vertex.h"
+#include "specializationconstants.h"
 
 #include <vulkan/vulkan.h>
 #include <vector>
@@ -11,9 +13,37 @@ class Renderer;
 class Shader;
 class RenderPass;
 class DescriptorSetLayout;
+class PipelineCache;
 
 class Pipeline
 {
+public:
+	// vertex stream, attribute locations are assigned consecutively across all bindings;
+	// attributes the vertex shader does not consume are left out of the pipeline
+	struct VertexBinding
+	{
+		uint32_t                           stride;
+		VkVertexInputRate                  inputRate;
+		std::vector<Vertex::AttributeDesc> attributes;
+	};
+
+	// fixed function state not covered by the dynamic viewport and scissor
+	struct State
+	{
+		// filled triangle lists, back face culling, no blending, no depth test; in the
+		// first subpass of the render pass
+		State();
+
+		VkPrimitiveTopology topology;
+		VkCullModeFlags     cullMode;
+		VkFrontFace         frontFace;
+		bool                blendEnable;
+		bool                depthTestEnable;
+		bool                depthWriteEnable;
+		VkCompareOp         depthCompareOp;
+		uint32_t            subpass;
+	};
+
 private:
 	struct FixedFunctionSetup
 	{
@@ -26,15 +56,23 @@ private:
 		std::vector<VkRect2D>                            viewportScissors;
 		VkPipelineRasterizationStateCreateInfo           rasterization;
 		VkPipelineMultisampleStateCreateInfo             multisampling;
+		VkPipelineDepthStencilStateCreateInfo            depthStencil;
 		VkPipelineColorBlendStateCreateInfo              colorBlend;
 		std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachmentStates;
 	};
 
 public:
 	Pipeline();
+	// compiles through the renderer's pipeline cache unless another cache is given; the
+	// pipeline can be used with any render pass compatible with the given one;
+	// specializations are given per shader, missing ones leave the defaults; the layout
+	// is derived from the shaders' reflection and shared through the renderer's cache
 	Pipeline( RenderPass& renderPass,
 	          const std::vector<Shader*>& shaders,
-	          const std::vector<DescriptorSetLayout*>& descriptorLayouts );
+	          const std::vector<VertexBinding>& vertexBindings,
+	          const State& state = State(),
+	          const std::vector<SpecializationConstants>& specializations = {},
+	          PipelineCache* pipelineCache = nullptr );
 	~Pipeline();
 
 	void         destroy();
@@ -48,29 +86,41 @@ public:
 		return ( m_vkPipeline != VK_NULL_HANDLE );
 	}
 
-	RenderPass&  getRenderPass()
+	VkPipelineLayout getLayout()
 	{
-		return *m_pRenderPass;
+		return m_vkLayout;
 	}
 
-	VkPipelineLayout getLayout()
+	// nullptr for sets the shaders do not use
+	DescriptorSetLayout* getDescriptorSetLayout( uint32_t set )
 	{
-		return m_vkLayout;
+		return ( set < m_DescriptorLayouts.size() ? m_DescriptorLayouts[ set ] : nullptr );
 	}
 
 private:
-	static VkPipelineShaderStageCreateInfo createShaderStageCreateInfo( Shader& shader );
+	static VkPipelineShaderStageCreateInfo createShaderStageCreateInfo(
+	        Shader& shader,
+	        const VkSpecializationInfo* specialization );
 
-	void populateFixedFunctionSetup( FixedFunctionSetup& ffs );
+	bool populateFixedFunctionSetup( FixedFunctionSetup& ffs, const std::vector<Shader*>& shaders );
 
-	bool createLayout( const std::vector<DescriptorSetLayout*>& descriptorLayouts );
-	bool createPipeline( const std::vector<Shader*>& shaders );
+	bool createLayout( const std::vector<Shader*>& shaders );
+	bool createPipeline( RenderPass& renderPass,
+	                     const std::vector<Shader*>& shaders,
+	                     const std::vector<SpecializationConstants>& specializations,
+	                     PipelineCache& pipelineCache );
 
 private:
 	VkPipeline       m_vkPipeline;
+	// owned by the renderer's layout cache
 	VkPipelineLayout m_vkLayout;
 
-	RenderPass* m_pRenderPass;
+	Renderer* m_pRenderer;
+
+	std::vector<DescriptorSetLayout*> m_DescriptorLayouts;
+
+	std::vector<VertexBinding> m_VertexBindings;
+	State                      m_State;
 };
 
 #endif // PIPELINE_H
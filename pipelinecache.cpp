@@ -0,0 +1,153 @@
+#include "pipelinecache.h"
+#include "renderer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+
+PipelineCache::PipelineCache( Renderer& renderer )
+    : wrapper_type( renderer.getNativeDeviceHandle() ),
+      m_pRenderer( &renderer ),
+      m_strFilename(),
+      m_bWarm( false )
+{
+	if( !createPipelineCache( {} ) )
+	{
+		destroy();
+	}
+}
+
+PipelineCache::PipelineCache( Renderer& renderer, const std::string& filename )
+    : wrapper_type( renderer.getNativeDeviceHandle() ),
+      m_pRenderer( &renderer ),
+      m_strFilename( filename ),
+      m_bWarm( false )
+{
+	std::vector<char> data;
+
+	std::ifstream file( filename, std::ios::binary | std::ios::ate );
+	if( file.is_open() )
+	{
+		data.resize( file.tellg() );
+		file.seekg( 0 );
+		file.read( data.data(), data.size() );
+
+		if( !file || !isCompatible( data ) )
+		{
+			log_warning( "Discarding incompatible pipeline cache: " + filename );
+			data.clear();
+		}
+	}
+
+	m_bWarm = !data.empty();
+
+	if( !createPipelineCache( data ) )
+	{
+		destroy();
+	}
+}
+
+bool PipelineCache::save()
+{
+	size_t size = 0;
+	if( vkGetPipelineCacheData( m_vkDevice, m_vkHandle, &size, nullptr ) != VK_SUCCESS )
+	{
+		log_error( "Cannot query pipeline cache size." );
+		return false;
+	}
+
+	std::vector<char> data( size );
+	if( vkGetPipelineCacheData( m_vkDevice, m_vkHandle, &size, data.data() ) != VK_SUCCESS )
+	{
+		log_error( "Cannot read pipeline cache data." );
+		return false;
+	}
+
+	std::string temporary = m_strFilename + ".tmp";
+
+	int file = ::open( temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( file < 0 )
+	{
+		log_error( "Cannot create pipeline cache: " + temporary );
+		return false;
+	}
+
+	size_t written = 0;
+	while( written < size )
+	{
+		ssize_t res = ::write( file, data.data() + written, size - written );
+		if( res < 0 && errno == EINTR )
+			continue;
+		if( res <= 0 )
+			break;
+
+		written += res;
+	}
+
+	// the data has to reach the disk before the rename replaces the previous blob
+	bool synced = ( written == size && ::fsync( file ) == 0 );
+	bool closed = ( ::close( file ) == 0 );
+
+	if( !synced || !closed )
+	{
+		log_error( "Cannot write pipeline cache: " + temporary );
+		std::remove( temporary.c_str() );
+		return false;
+	}
+
+	if( std::rename( temporary.c_str(), m_strFilename.c_str() ) != 0 )
+	{
+		log_error( "Cannot replace pipeline cache: " + m_strFilename );
+		std::remove( temporary.c_str() );
+		return false;
+	}
+
+	log_info( "Saved " + std::to_string( size ) + " bytes of pipeline cache." );
+	return true;
+}
+
+bool PipelineCache::isCompatible( const std::vector<char>& data )
+{
+	// VkPipelineCacheHeaderVersionOne, read field by field as the blob is unaligned
+	const size_t headerSize = 4 * sizeof( uint32_t ) + VK_UUID_SIZE;
+
+	if( data.size() < headerSize )
+		return false;
+
+	uint32_t fields[ 4 ];
+	std::memcpy( fields, data.data(), sizeof( fields ) );
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties( m_pRenderer->getNativePhysicalDeviceHandle(), &properties );
+
+	return ( fields[ 0 ] >= headerSize &&
+	         fields[ 1 ] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+	         fields[ 2 ] == properties.vendorID &&
+	         fields[ 3 ] == properties.deviceID &&
+	         std::memcmp( data.data() + sizeof( fields ),
+	                      properties.pipelineCacheUUID,
+	                      VK_UUID_SIZE ) == 0 );
+}
+
+bool PipelineCache::createPipelineCache( const std::vector<char>& data )
+{
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.pNext           = nullptr;
+	createInfo.flags           = 0;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData    = ( data.empty() ? nullptr : data.data() );
+
+	VkResult res = vkCreatePipelineCache( m_vkDevice, &createInfo, nullptr, &m_vkHandle );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot create pipeline cache." );
+		return false;
+	}
+	return true;
+}
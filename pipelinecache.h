@@ -0,0 +1,44 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+#include "common.h"
+#include "vulkanobjectwrapper.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+
+class Renderer;
+
+// Pipeline cache persisted between runs. A blob written by a different driver or device
+// is detected through the cache header and discarded, compilation then starts cold.
+class PipelineCache : public VulkanObjectWrapper<VkPipelineCache, vkDestroyPipelineCache>
+{
+public:
+	PipelineCache() = default;
+	// empty cache, not persisted, e.g. to measure compilation without cache hits
+	PipelineCache( Renderer& renderer );
+	// loads the blob from the file if it exists and matches the device
+	PipelineCache( Renderer& renderer, const std::string& filename );
+
+	// true if the cache was created from a valid blob
+	bool     isWarm()
+	{
+		return m_bWarm;
+	}
+
+	// writes and syncs a temporary file first and renames it, so neither a crash nor a
+	// power loss leaves a truncated blob behind
+	bool     save();
+
+private:
+	bool     isCompatible( const std::vector<char>& data );
+	bool     createPipelineCache( const std::vector<char>& data );
+
+private:
+	Renderer*   m_pRenderer;
+	std::string m_strFilename;
+	bool        m_bWarm;
+};
+
+#endif // PIPELINECACHE_H
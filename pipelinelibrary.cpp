@@ -0,0 +1,279 @@
+#include "pipelinelibrary.h"
+#include "renderer.h"
+#include "renderpass.h"
+#include "shader.h"
+#include "pipelinecache.h"
+#include "jobsystem.h"
+#include "profiler.h"
+
+PipelineLibrary::PipelineLibrary( Renderer& renderer, PipelineCache& pipelineCache )
+    : m_pRenderer( &renderer ),
+      m_pPipelineCache( &pipelineCache ),
+      m_Entries(),
+      m_Queue(),
+      m_uNumPending( 0 ),
+      m_bStop( false )
+{
+}
+
+PipelineLibrary::~PipelineLibrary()
+{
+	destroy();
+}
+
+void PipelineLibrary::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		m_bStop = true;
+	}
+	m_QueueCondition.notify_all();
+
+	if( m_CompileThread.joinable() )
+	{
+		m_CompileThread.join();
+	}
+
+	for( auto& entry : m_Entries )
+	{
+		safe_delete( entry.second->pPipeline );
+		safe_delete( entry.second );
+	}
+	m_Entries.clear();
+	m_Queue.clear();
+	m_uNumPending = 0;
+}
+
+Pipeline* PipelineLibrary::getPipeline( const Desc& desc )
+{
+	Key key = computeKey( desc );
+
+	std::unique_lock<std::mutex> lock( m_Mutex );
+
+	auto it = m_Entries.find( key );
+	if( it != m_Entries.end() )
+	{
+		// possibly requested before, wait for it rather than compiling twice
+		Entry& entry = *it->second;
+		m_ReadyCondition.wait( lock, [ &entry ]() {
+			return ( entry.status.load() != Status::Pending );
+		} );
+		return entry.pPipeline;
+	}
+
+	Entry* entry = createEntry( std::move( key ), desc );
+	lock.unlock();
+
+	// stalls the calling thread, a hitch when it happens during a frame
+	Profiler::addCount( "pipelinelibrary.blocking_compiles" );
+
+	compileEntry( *entry );
+
+	{
+		std::lock_guard<std::mutex> notifyLock( m_Mutex );
+	}
+	m_ReadyCondition.notify_all();
+
+	return entry->pPipeline;
+}
+
+PipelineLibrary::Future PipelineLibrary::requestPipeline( const Desc& desc )
+{
+	Key key = computeKey( desc );
+
+	std::lock_guard<std::mutex> lock( m_Mutex );
+
+	auto it = m_Entries.find( key );
+	if( it != m_Entries.end() )
+		return Future( it->second );
+
+	Entry* entry = createEntry( std::move( key ), desc );
+
+	m_Queue.push_back( entry );
+	++m_uNumPending;
+
+	if( !m_CompileThread.joinable() )
+	{
+		m_CompileThread = std::thread( &PipelineLibrary::compileLoop, this );
+	}
+	m_QueueCondition.notify_one();
+
+	return Future( entry );
+}
+
+Pipeline* PipelineLibrary::release( Pipeline* pipeline )
+{
+	std::lock_guard<std::mutex> lock( m_Mutex );
+
+	for( auto it = m_Entries.begin(); it != m_Entries.end(); ++it )
+	{
+		Entry* entry = it->second;
+
+		if( entry->pPipeline == pipeline && entry->status.load() == Status::Ready )
+		{
+			m_Entries.erase( it );
+			delete entry;
+			return pipeline;
+		}
+	}
+	return nullptr;
+}
+
+void PipelineLibrary::waitIdle()
+{
+	std::unique_lock<std::mutex> lock( m_Mutex );
+	m_ReadyCondition.wait( lock, [ this ]() {
+		return ( m_uNumPending == 0 );
+	} );
+}
+
+bool PipelineLibrary::compile( const std::vector<Desc>& descs, JobSystem& jobSystem )
+{
+	CompileJob job;
+	job.pLibrary = this;
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+
+		for( const auto& desc : descs )
+		{
+			Key key = computeKey( desc );
+
+			if( m_Entries.count( key ) == 0 )
+			{
+				job.entries.push_back( createEntry( std::move( key ), desc ) );
+			}
+		}
+	}
+
+	jobSystem.parallelFor( job.entries.size(), 1, compileRange, &job );
+
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+	}
+	m_ReadyCondition.notify_all();
+
+	bool success = true;
+	for( auto entry : job.entries )
+	{
+		success &= ( entry->status.load() == Status::Ready );
+	}
+	return success;
+}
+
+PipelineLibrary::Key PipelineLibrary::computeKey( const Desc& desc )
+{
+	Key key;
+	key.push_back( desc.pRenderPass->getCompatibilityHash() );
+
+	// counts precede every list, so differently split lists never produce equal keys
+	// the layout is reflected from the code, so it is covered by the code hashes
+	key.push_back( desc.shaders.size() );
+	for( auto shader : desc.shaders )
+	{
+		const std::string& entry = shader->getEntryFunction();
+
+		key.push_back( shader->getStage() );
+		key.push_back( shader->getCodeHash() );
+		key.push_back( hash_bytes( entry.data(), entry.size() ) );
+	}
+
+	key.push_back( desc.vertexBindings.size() );
+	for( const auto& binding : desc.vertexBindings )
+	{
+		key.push_back( binding.stride );
+		key.push_back( binding.inputRate );
+		key.push_back( binding.attributes.size() );
+
+		for( const auto& attribute : binding.attributes )
+		{
+			key.push_back( ( (uint64_t)attribute.format << 32 ) | attribute.offset );
+		}
+	}
+
+	key.push_back( desc.state.topology );
+	key.push_back( desc.state.cullMode );
+	key.push_back( desc.state.frontFace );
+	key.push_back( desc.state.blendEnable );
+	key.push_back( desc.state.depthTestEnable );
+	key.push_back( desc.state.depthWriteEnable );
+	key.push_back( desc.state.depthCompareOp );
+	key.push_back( desc.state.subpass );
+
+	// empty sets equal missing ones, both compile with the shaders' defaults
+	for( auto i = 0; i < desc.shaders.size(); ++i )
+	{
+		bool specialized = ( i < desc.specializations.size() && !desc.specializations[ i ].isEmpty() );
+		key.push_back( specialized ? desc.specializations[ i ].getHash() : 0 );
+	}
+
+	return key;
+}
+
+void PipelineLibrary::compileRange( uint32_t first, uint32_t count, void* userData )
+{
+	CompileJob& job = *reinterpret_cast<CompileJob*>( userData );
+
+	for( auto i = first; i < first + count; ++i )
+	{
+		job.pLibrary->compileEntry( *job.entries[ i ] );
+	}
+}
+
+void PipelineLibrary::compileLoop()
+{
+	std::unique_lock<std::mutex> lock( m_Mutex );
+
+	while( true )
+	{
+		m_QueueCondition.wait( lock, [ this ]() {
+			return ( m_bStop || !m_Queue.empty() );
+		} );
+
+		if( m_bStop )
+			return;
+
+		Entry* entry = m_Queue.front();
+		m_Queue.pop_front();
+
+		lock.unlock();
+		compileEntry( *entry );
+		lock.lock();
+
+		--m_uNumPending;
+		m_ReadyCondition.notify_all();
+	}
+}
+
+PipelineLibrary::Entry* PipelineLibrary::createEntry( Key&& key, const Desc& desc )
+{
+	Entry* entry = new Entry();
+	entry->desc      = desc;
+	entry->pPipeline = nullptr;
+	entry->status.store( Status::Pending );
+
+	m_Entries.emplace( std::move( key ), entry );
+	return entry;
+}
+
+void PipelineLibrary::compileEntry( Entry& entry )
+{
+	Profiler::ScopedTimer timer( "pipelinelibrary.compile" );
+
+	// pipeline caches are internally synchronized; private caches merged afterwards would
+	// miss the entries of a warm cache
+	Pipeline* pipeline = new Pipeline( *entry.desc.pRenderPass,
+	                                   entry.desc.shaders,
+	                                   entry.desc.vertexBindings,
+	                                   entry.desc.state,
+	                                   entry.desc.specializations,
+	                                   m_pPipelineCache );
+
+	if( !pipeline->isValid() )
+	{
+		safe_delete( pipeline );
+	}
+
+	// published by the status, readers poll it without the mutex
+	entry.pPipeline = pipeline;
+	entry.status.store( pipeline != nullptr ? Status::Ready : Status::Failed );
+}
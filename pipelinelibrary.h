@@ -0,0 +1,179 @@
+#ifndef PIPELINELIBRARY_H
+#define PIPELINELIBRARY_H
+
+#include "common.h"
+#include "pipeline.h"
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class Renderer;
+class RenderPass;
+class Shader;
+class PipelineCache;
+class JobSystem;
+
+// Owns pipelines keyed by their full state. The render pass is part of the key only
+// through its compatibility, so a pipeline is shared by all compatible render passes.
+// Pipelines failing to compile are remembered and not compiled again.
+class PipelineLibrary
+{
+public:
+	struct Desc
+	{
+		RenderPass*                          pRenderPass;
+		std::vector<Shader*>                 shaders;
+		std::vector<Pipeline::VertexBinding> vertexBindings;
+		Pipeline::State                      state;
+		// per shader, may be shorter than the shaders
+		std::vector<SpecializationConstants> specializations;
+	};
+
+private:
+	enum class Status
+	{
+		Pending,
+		Ready,
+		Failed
+	};
+
+	struct Entry
+	{
+		// kept for compiling in the background
+		Desc                desc;
+		Pipeline*           pPipeline;
+		std::atomic<Status> status;
+	};
+
+public:
+	// Result of an asynchronous request, polled without blocking from any thread.
+	class Future
+	{
+	friend class PipelineLibrary;
+
+	public:
+		Future()
+		    : m_pEntry( nullptr )
+		{
+		}
+
+		// false for default constructed futures
+		bool      isValid() const
+		{
+			return ( m_pEntry != nullptr );
+		}
+		bool      isReady() const
+		{
+			return ( m_pEntry != nullptr && m_pEntry->status.load() == Status::Ready );
+		}
+		bool      isFailed() const
+		{
+			return ( m_pEntry != nullptr && m_pEntry->status.load() == Status::Failed );
+		}
+
+		// nullptr until the pipeline is ready
+		Pipeline* get() const
+		{
+			return ( isReady() ? m_pEntry->pPipeline : nullptr );
+		}
+
+	private:
+		Future( Entry* entry )
+		    : m_pEntry( entry )
+		{
+		}
+
+	private:
+		Entry* m_pEntry;
+	};
+
+public:
+	PipelineLibrary( Renderer& renderer, PipelineCache& pipelineCache );
+	~PipelineLibrary();
+
+	// stops the compile thread after the pipeline it is working on
+	void      destroy();
+
+	// compiles missing pipelines on the calling thread and waits for pending requests,
+	// nullptr if compilation failed
+	Pipeline* getPipeline( const Desc& desc );
+
+	// queues missing pipelines for the compile thread; the objects referenced by the
+	// description have to stay alive until the request completed
+	Future    requestPipeline( const Desc& desc );
+
+	// removes a compiled pipeline and hands it over to the caller, e.g. to destroy it once
+	// no frame uses it anymore; futures of the pipeline must not be used afterwards.
+	// nullptr if the pipeline is not in the library.
+	Pipeline* release( Pipeline* pipeline );
+
+	// true if no request is waiting for or being compiled
+	bool      isIdle()
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		return ( m_uNumPending == 0 );
+	}
+
+	// blocks until all requests completed, e.g. before destroying a render pass
+	void      waitIdle();
+
+	// compiles all missing pipelines across the job system's threads, returns false if
+	// any pipeline failed to compile
+	bool      compile( const std::vector<Desc>& descs, JobSystem& jobSystem );
+
+	uint32_t  getNumPipelines()
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		return m_Entries.size();
+	}
+
+private:
+	typedef std::vector<uint64_t> Key;
+
+	struct KeyHash
+	{
+		size_t operator()( const Key& key ) const
+		{
+			return hash_bytes( key.data(), key.size() * sizeof( uint64_t ) );
+		}
+	};
+
+	struct CompileJob
+	{
+		PipelineLibrary*    pLibrary;
+		std::vector<Entry*> entries;
+	};
+
+private:
+	static Key  computeKey( const Desc& desc );
+	static void compileRange( uint32_t first, uint32_t count, void* userData );
+
+	void        compileLoop();
+
+	// requires the mutex
+	Entry*      createEntry( Key&& key, const Desc& desc );
+	void        compileEntry( Entry& entry );
+
+private:
+	Renderer*               m_pRenderer;
+	PipelineCache*          m_pPipelineCache;
+
+	std::mutex              m_Mutex;
+	std::unordered_map<Key, Entry*, KeyHash> m_Entries;
+
+	// requests waiting for or being compiled on the compile thread
+	std::thread             m_CompileThread;
+	std::condition_variable m_QueueCondition;
+	std::condition_variable m_ReadyCondition;
+	std::deque<Entry*>      m_Queue;
+	uint32_t                m_uNumPending;
+	bool                    m_bStop;
+};
+
+#endif // PIPELINELIBRARY_H
@@ -0,0 +1,86 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+std::mutex                             Profiler::s_Mutex;
+std::map<std::string, Profiler::Entry> Profiler::s_Counters;
+std::map<std::string, Profiler::Entry> Profiler::s_Timers;
+Profiler::clock_type::time_point       Profiler::s_Start = Profiler::clock_type::now();
+
+void Profiler::addCount( const std::string& name, uint64_t value )
+{
+	std::lock_guard<std::mutex> lock( s_Mutex );
+
+	Entry& entry = s_Counters[ name ];
+	entry.count += value;
+}
+
+void Profiler::addTime( const std::string& name, double milliseconds )
+{
+	std::lock_guard<std::mutex> lock( s_Mutex );
+
+	auto iter = s_Timers.find( name );
+	if( iter == s_Timers.end() )
+	{
+		s_Timers[ name ] = { 1, milliseconds, milliseconds, milliseconds };
+	}
+	else
+	{
+		Entry& entry = iter->second;
+		entry.count += 1;
+		entry.total += milliseconds;
+		entry.min    = std::min( entry.min, milliseconds );
+		entry.max    = std::max( entry.max, milliseconds );
+	}
+}
+
+double Profiler::millisecondsSince( clock_type::time_point start )
+{
+	return std::chrono::duration<double, std::milli>( clock_type::now() - start ).count();
+}
+
+void Profiler::report()
+{
+	std::lock_guard<std::mutex> lock( s_Mutex );
+
+	double seconds = millisecondsSince( s_Start ) / 1000.0;
+
+	char line[ 256 ];
+
+	log_info( "Profiler report (" + std::to_string( seconds ) + " s):" );
+
+	for( const auto& pair : s_Counters )
+	{
+		std::snprintf( line,
+		               sizeof( line ),
+		               "  %-32s %12llu (%.2f/s)",
+		               pair.first.c_str(),
+		               (unsigned long long)pair.second.count,
+		               ( seconds > 0.0 ? pair.second.count / seconds : 0.0 ) );
+		log_info( line );
+	}
+
+	for( const auto& pair : s_Timers )
+	{
+		const Entry& entry = pair.second;
+		std::snprintf( line,
+		               sizeof( line ),
+		               "  %-32s %8llu x avg %.3f ms (min %.3f, max %.3f)",
+		               pair.first.c_str(),
+		               (unsigned long long)entry.count,
+		               entry.total / entry.count,
+		               entry.min,
+		               entry.max );
+		log_info( line );
+	}
+}
+
+void Profiler::reset()
+{
+	std::lock_guard<std::mutex> lock( s_Mutex );
+
+	s_Counters.clear();
+	s_Timers.clear();
+	s_Start = clock_type::now();
+}
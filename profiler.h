@@ -0,0 +1,61 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "common.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+class Profiler
+{
+public:
+	typedef std::chrono::high_resolution_clock clock_type;
+
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer( const std::string& name )
+		    : m_strName( name ),
+		      m_Start( clock_type::now() )
+		{
+		}
+
+		~ScopedTimer()
+		{
+			Profiler::addTime( m_strName, Profiler::millisecondsSince( m_Start ) );
+		}
+
+	private:
+		std::string            m_strName;
+		clock_type::time_point m_Start;
+	};
+
+public:
+	static void   addCount( const std::string& name, uint64_t value = 1 );
+	static void   addTime( const std::string& name, double milliseconds );
+
+	static double millisecondsSince( clock_type::time_point start );
+
+	// logs all counters (with rates over the profiling period) and timers
+	static void   report();
+	static void   reset();
+
+private:
+	struct Entry
+	{
+		uint64_t count;
+		double   total;
+		double   min;
+		double   max;
+	};
+
+private:
+	static std::mutex                   s_Mutex;
+	static std::map<std::string, Entry> s_Counters;
+	static std::map<std::string, Entry> s_Timers;
+	static clock_type::time_point       s_Start;
+};
+
+#endif // PROFILER_H
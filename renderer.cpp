@@ -10,13 +10,22 @@
 #include "commandbuffer.h"
 #include "renderpass.h"
 #include "descriptorsetlayout.h"
-#include "descriptorpool.h"
 #include "descriptorset.h"
+#include "descriptorallocator.h"
+#include "descriptorsetcache.h"
+#include "parallelrecorder.h"
+#include "gpuculler.h"
+#include "pipelinecache.h"
+#include "pipelinelibrary.h"
+#include "profiler.h"
+#include "jobsystem.h"
 
 #include <set>
 #include <unordered_set>
 #include <string>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 
 VkInstance               Renderer::s_VkInstance      = VK_NULL_HANDLE;
 VkDebugReportCallbackEXT Renderer::s_VkDebugCallback = VK_NULL_HANDLE;
@@ -26,51 +35,81 @@ Renderer::Renderer( WindowSurface& surface )
       m_vkDevice( VK_NULL_HANDLE ),
       m_vkGraphicsQueue( VK_NULL_HANDLE ),
       m_vkPresentQueue( VK_NULL_HANDLE ),
-      m_vkFramebuffers(),
-      m_vkImageAvailableSemaphore( VK_NULL_HANDLE ),
-      m_vkRenderFinishedSemaphore( VK_NULL_HANDLE ),
+      m_vkEnabledFeatures(),
+      m_vkLimits(),
+      m_pfnCmdDrawIndirectCount( nullptr ),
+      m_pfnCmdDrawIndexedIndirectCount( nullptr ),
       m_ShaderCache( *this ),
+      m_LayoutCache( *this ),
       m_UsedQueueFamilies(),
       m_pWindowSurface( &surface ),
       m_pSwapchain( nullptr ),
+      m_pPipelineCache( nullptr ),
+      m_pPipelineLibrary( nullptr ),
       m_pDescriptorSetLayout( nullptr ),
-      m_pDescriptorPool( nullptr ),
-      m_pDescriptorSet( nullptr ),
+      m_pDescriptorSetCache( nullptr ),
+      m_pRenderGraph( nullptr ),
+      m_uBackbuffer( RenderGraph::INVALID_HANDLE ),
+      m_uScenePass( RenderGraph::INVALID_HANDLE ),
       m_pRenderPass( nullptr ),
       m_pPipeline( nullptr ),
+      m_PipelineRequest(),
+      m_ReloadRequest(),
+      m_ReplacedShaders(),
+      m_SupersededRequests(),
       m_pHostMemoryPool( nullptr ),
       m_pDeviceMemoryPool( nullptr ),
       m_pGeometryBuffer( nullptr ),
       m_pStagingBuffer( nullptr ),
-      m_pUniformBuffer( nullptr ),
       m_pCommandPool( nullptr ),
-      m_CommandBuffers(),
-      m_TimerStart( std::chrono::high_resolution_clock::now() )
+      m_pTransferCommandBuffer( nullptr ),
+      m_Frames( FRAMES_IN_FLIGHT, Frame{} ),
+      m_uCurrentFrame( 0 ),
+      m_uFrameNumber( 0 ),
+      m_RetiredObjects(),
+      m_pParallelRecorder( nullptr ),
+      m_uNumDraws( 1 ),
+      m_uNumInstances( 1 ),
+      m_pInstanceMemoryPool( nullptr ),
+      m_pInstanceBuffer( nullptr ),
+      m_bIndirectDraws( true ),
+      m_bParallelRecording( false ),
+      m_bRecordingFailed( false ),
+      m_QuadMesh(),
+      m_RenderQueue(),
+      m_uPipelineHandle( RenderQueue::INVALID_HANDLE ),
+      m_uQuadMeshHandle( RenderQueue::INVALID_HANDLE ),
+      m_uSceneSetHandle( RenderQueue::INVALID_HANDLE ),
+      m_ModelMatrix( 1.0f ),
+      m_ModelViewProjection( 1.0f ),
+      m_pGpuCuller( nullptr ),
+      m_pFrameCapture( nullptr ),
+      m_TimerStart( std::chrono::high_resolution_clock::now() ),
+      m_InitStart( Profiler::clock_type::now() ),
+      m_bFirstFramePresented( false )
 {
 	if( selectPhysicalDevice() )
 	{
 		VkPhysicalDeviceProperties properties;
 		vkGetPhysicalDeviceProperties( m_vkPhysicalDevice, &properties );
+		m_vkLimits = properties.limits;
 
 		log_info( std::string( "Creating renderer using device: " ) + properties.deviceName );
 
 		if( !createLogicalDevice() ||
 		    !getQueues() ||
-		    !createSwapchain() ||
-		    !createBuffers() ||
+		    !initialize() ||
 		    !createDescriptors() ||
-		    !createRenderPass() ||
-		    !createPipeline() ||
-		    !createFramebuffers() ||
-		    !createCommandPool() ||
-		    !allocateCommandBuffers() ||
-		    !recordCommandBuffers() ||
-		    !createTransferBuffers() ||
-		    !createSemaphores() ||
-		    !copyStagingBuffer() )
+		    !createRenderQueue() )
 		{
 			destroy();
 		}
+		else
+		{
+			log_info( "Renderer initialized in " +
+			          std::to_string( Profiler::millisecondsSince( m_InitStart ) ) + " ms with " +
+			          ( m_pPipelineCache->isWarm() ? "warm" : "cold" ) + " pipeline cache." );
+		}
 	}
 }
 
@@ -186,21 +225,29 @@ Renderer::QueueFamilies Renderer::queryQueueFamilies( VkPhysicalDevice device, V
 
 void Renderer::destroy()
 {
-	if( m_vkImageAvailableSemaphore != VK_NULL_HANDLE )
-	{
-		vkDestroySemaphore( m_vkDevice, m_vkImageAvailableSemaphore, nullptr );
-		m_vkImageAvailableSemaphore = VK_NULL_HANDLE;
-	}
-	if( m_vkRenderFinishedSemaphore != VK_NULL_HANDLE )
+	safe_delete( m_pFrameCapture );
+	safe_delete( m_pGpuCuller );
+
+	destroyFrames();
+
+	m_pPipeline = nullptr;
+	safe_delete( m_pPipelineLibrary );
+
+	// no compilation refers to replaced shaders once the library is gone
+	for( Shader* shader : m_ReplacedShaders )
 	{
-		vkDestroySemaphore( m_vkDevice, m_vkRenderFinishedSemaphore, nullptr );
-		m_vkRenderFinishedSemaphore = VK_NULL_HANDLE;
+		delete shader;
 	}
+	m_ReplacedShaders.clear();
+	m_ReloadRequest = PipelineLibrary::Future();
+	m_SupersededRequests.clear();
 
-	safe_delete( m_pPipeline );
-	safe_delete( m_pRenderPass );
+	destroyRetiredObjects( true );
+	safe_delete( m_pRenderGraph );
+	m_pRenderPass = nullptr;
 
-	safe_delete( m_pUniformBuffer );
+	safe_delete( m_pInstanceBuffer );
+	safe_delete( m_pInstanceMemoryPool );
 	safe_delete( m_pGeometryBuffer );
 	safe_delete( m_pStagingBuffer );
 
@@ -211,9 +258,17 @@ void Renderer::destroy()
 
 	cleanupSwapchain();
 
-	safe_delete( m_pDescriptorSet );
-	safe_delete( m_pDescriptorPool );
-	safe_delete( m_pDescriptorSetLayout );
+	if( m_pPipelineCache != nullptr && m_pPipelineCache->isValid() )
+	{
+		m_pPipelineCache->save();
+	}
+	safe_delete( m_pPipelineCache );
+
+	safe_delete( m_pDescriptorSetCache );
+	m_pDescriptorSetLayout = nullptr;
+
+	// layouts outlive all pipelines and descriptor sets
+	m_LayoutCache.destroy();
 
 	safe_delete( m_pTransferCommandBuffer );
 	safe_delete( m_pCommandPool );
@@ -226,16 +281,41 @@ void Renderer::destroy()
 }
 
 uint32_t Renderer::renderFrame()
+{
+	return renderFrame( createSnapshot() );
+}
+
+uint32_t Renderer::renderFrame( const FrameSnapshot& snapshot )
 {
 	static const VkPipelineStageFlags waitStages[] = {
 	    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
 	};
 
+	if( m_pFrameCapture != nullptr )
+	{
+		m_pFrameCapture->poll();
+	}
+
+	Frame& frame = m_Frames[ m_uCurrentFrame ];
+
+	// the frame's command buffer, uniforms and semaphores are free for reuse once
+	// the submission that last used them has retired
+	vkWaitForFences( m_vkDevice, 1, &frame.vkFence, VK_TRUE, ~(uint64_t)0 );
+
+	destroyRetiredObjects( false );
+
+	// transient descriptor sets of the retired submission are recycled all at once,
+	// cached sets it used become evictable
+	frame.pDescriptorAllocator->reset();
+	m_pDescriptorSetCache->setFrame( m_uFrameNumber );
+
+	reloadShaders();
+
 	uint32_t imageIndex;
 	VkResult res = vkAcquireNextImageKHR( m_vkDevice,
 	                                      m_pSwapchain->getNativeHandle(),
 	                                      ~(uint64_t)0,
-	                                      m_vkImageAvailableSemaphore,
+	                                      frame.vkImageAvailableSemaphore,
 	                                      VK_NULL_HANDLE,
 	                                      &imageIndex );
 
@@ -246,7 +326,7 @@ uint32_t Renderer::renderFrame()
 		recreateSwapchain();
 
 		// attempt to acquire image after recreating the swap chain
-		imageIndex = renderFrame();
+		imageIndex = renderFrame( snapshot );
 
 		// give up if the attempt failed as well
 		if( imageIndex == INVALID_FRAME )
@@ -266,20 +346,58 @@ uint32_t Renderer::renderFrame()
 		return INVALID_FRAME;
 	}
 
-	VkCommandBuffer commandBuffer = m_CommandBuffers[ imageIndex ]->getNativeHandle();
+	updateUniforms( snapshot );
+
+	// hits in steady state, only the first frames allocate and write their sets
+	frame.vkDescriptorSet = getSceneDescriptorSet( m_uCurrentFrame );
+
+	buildRenderQueue();
+
+	if( frame.vkDescriptorSet == VK_NULL_HANDLE ||
+	    !frame.pCommandPool->reset() ||
+	    !recordCommandBuffer( frame, imageIndex ) )
+	{
+		abandonFrame( frame );
+		return INVALID_FRAME;
+	}
+
+	VkCommandBuffer commandBuffers[ 2 ] = { frame.pCommandBuffer->getNativeHandle() };
+	uint32_t        numCommandBuffers   = 1;
+	VkFence         captureFence        = VK_NULL_HANDLE;
+
+	if( m_pFrameCapture != nullptr )
+	{
+		// the copy is submitted behind the frame, so presentation waits for it as well
+		CommandBuffer* captureCommandBuffer = m_pFrameCapture->capture( imageIndex, captureFence );
+		if( captureCommandBuffer != nullptr )
+		{
+			commandBuffers[ numCommandBuffers++ ] = captureCommandBuffer->getNativeHandle();
+		}
+	}
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.pNext                = nullptr;
 	submitInfo.waitSemaphoreCount   = 1;
-	submitInfo.pWaitSemaphores      = &m_vkImageAvailableSemaphore;
+	submitInfo.pWaitSemaphores      = &frame.vkImageAvailableSemaphore;
 	submitInfo.pWaitDstStageMask    = waitStages;
-	submitInfo.commandBufferCount   = 1;
-	submitInfo.pCommandBuffers      = &commandBuffer;
+	submitInfo.commandBufferCount   = numCommandBuffers;
+	submitInfo.pCommandBuffers      = commandBuffers;
 	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores    = &m_vkRenderFinishedSemaphore;
+	submitInfo.pSignalSemaphores    = &frame.vkRenderFinishedSemaphore;
+
+	// only reset the fence once work is guaranteed to be submitted, otherwise the
+	// next use of this frame would wait forever
+	vkResetFences( m_vkDevice, 1, &frame.vkFence );
+
+	vkQueueSubmit( m_vkGraphicsQueue, 1, &submitInfo, frame.vkFence );
+
+	if( captureFence != VK_NULL_HANDLE )
+	{
+		// an empty submission signals its fence once all previous work has completed
+		vkQueueSubmit( m_vkGraphicsQueue, 0, nullptr, captureFence );
+	}
 
-	vkQueueSubmit( m_vkGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
 	return imageIndex;
 }
 
@@ -291,7 +409,7 @@ void Renderer::presentFrame( uint32_t imageIndex )
 	presentInfo.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.pNext              = nullptr;
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores    = &m_vkRenderFinishedSemaphore;
+	presentInfo.pWaitSemaphores    = &m_Frames[ m_uCurrentFrame ].vkRenderFinishedSemaphore;
 	presentInfo.swapchainCount     = 1;
 	presentInfo.pSwapchains        = swapChains;
 	presentInfo.pImageIndices      = &imageIndex;
@@ -299,6 +417,20 @@ void Renderer::presentFrame( uint32_t imageIndex )
 
 	VkResult res = vkQueuePresentKHR( m_vkPresentQueue, &presentInfo );
 
+	if( !m_bFirstFramePresented && ( res == VK_SUCCESS || res == VK_SUBOPTIMAL_KHR ) )
+	{
+		double timeToFirstFrame = Profiler::millisecondsSince( m_InitStart );
+
+		Profiler::addTime( "renderer.time_to_first_frame", timeToFirstFrame );
+		log_info( "First frame presented " + std::to_string( timeToFirstFrame ) +
+		          " ms after renderer creation." );
+
+		m_bFirstFramePresented = true;
+	}
+
+	m_uCurrentFrame = ( m_uCurrentFrame + 1 ) % FRAMES_IN_FLIGHT;
+	++m_uFrameNumber;
+
 	if( res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR )
 	{
 		log_info( "Recreating out-of-date or suboptimal swap chain." );
@@ -306,34 +438,61 @@ void Renderer::presentFrame( uint32_t imageIndex )
 	}
 }
 
-void Renderer::updateUniforms()
+FrameSnapshot Renderer::createSnapshot() const
 {
 	float t = std::chrono::duration_cast<std::chrono::milliseconds>(
 	              std::chrono::high_resolution_clock::now() - m_TimerStart ).count() / 1000.0f;
 
-	TransformUBO ubo{};
-	ubo.model = glm::rotate( glm::mat4( 1.0f ),
-	                         t * 0.5f * glm::pi<float>(),
-	                         glm::vec3( 0.0f, 0.0f, 1.0f ) );
+	FrameSnapshot snapshot{};
+	snapshot.view  = computeViewMatrix();
+	snapshot.model = glm::rotate( glm::mat4( 1.0f ),
+	                              t * 0.5f * glm::pi<float>(),
+	                              glm::vec3( 0.0f, 0.0f, 1.0f ) );
 
-	ubo.view = glm::lookAt( glm::vec3( 2.0f, 2.0f, 2.0f ),
-	                        glm::vec3( 0.0f, 0.0f, 0.0f ),
-	                        glm::vec3( 0.0f, 0.0f, 1.0f ) );
+	return snapshot;
+}
 
-	VkExtent2D size = m_pSwapchain->getExtent();
-	ubo.proj = glm::perspective( 0.25f * glm::pi<float>(),
-	                             (float)size.width / size.height,
-	                             0.1f,
-	                             10.0f );
-	ubo.proj[ 1 ][ 1 ] *= -1;
+void Renderer::updateUniforms( const FrameSnapshot& snapshot )
+{
+	// the model matrix is pushed per draw, see buildRenderQueue
+	m_ModelMatrix = snapshot.model;
+
+	// the projection depends on the swap chain, which only the rendering thread touches
+	CameraUBO ubo{};
+	ubo.view = snapshot.view;
+	ubo.proj = computeProjectionMatrix();
+
+	// instance transforms are applied before the model matrix
+	m_ModelViewProjection = ubo.proj * ubo.view * m_ModelMatrix;
 
-	//ubo.model = glm::mat4( 1.0f );
 	//ubo.view = glm::mat4( 1.0f );
 	//ubo.proj = glm::mat4( 1.0f );
 
-	void* data = m_pUniformBuffer->map();
-	memcpy( data, &ubo, sizeof( TransformUBO ) );
-	m_pUniformBuffer->unmap();
+	Buffer& uniformBuffer = *m_Frames[ m_uCurrentFrame ].pUniformBuffer;
+
+	void* data = uniformBuffer.map();
+	memcpy( data, &ubo, sizeof( CameraUBO ) );
+	uniformBuffer.unmap();
+}
+
+glm::mat4 Renderer::computeViewMatrix()
+{
+	return glm::lookAt( glm::vec3( 2.0f, 2.0f, 2.0f ),
+	                    glm::vec3( 0.0f, 0.0f, 0.0f ),
+	                    glm::vec3( 0.0f, 0.0f, 1.0f ) );
+}
+
+glm::mat4 Renderer::computeProjectionMatrix()
+{
+	VkExtent2D size = m_pSwapchain->getExtent();
+
+	glm::mat4 proj = glm::perspective( 0.25f * glm::pi<float>(),
+	                                   (float)size.width / size.height,
+	                                   0.1f,
+	                                   10.0f );
+	proj[ 1 ][ 1 ] *= -1;
+
+	return proj;
 }
 
 void Renderer::waitForIdle()
@@ -351,8 +510,15 @@ void Renderer::recreateSwapchain()
 
 	if( recreateRenderPass )
 	{
-		safe_delete( m_pPipeline );
-		safe_delete( m_pRenderPass );
+		// pending requests reference the render pass; pipelines for the old format stay
+		// in the library, switching back reuses them
+		m_pPipelineLibrary->waitIdle();
+		m_pPipeline       = nullptr;
+		m_PipelineRequest = PipelineLibrary::Future();
+		m_ReloadRequest   = PipelineLibrary::Future();
+		m_SupersededRequests.clear();
+		safe_delete( m_pRenderGraph );
+		m_pRenderPass = nullptr;
 	}
 
 	cleanupSwapchain();
@@ -365,12 +531,19 @@ void Renderer::recreateSwapchain()
 		{
 			log_info( "Recreating render pass and pipeline due to swap chain format change." );
 			createRenderPass();
-			createPipeline();
+			requestPipeline();
+			createRenderQueue();
+		}
+		else if( !m_pRenderGraph->resize( m_pSwapchain->getExtent() ) )
+		{
+			log_error( "Cannot resize render graph." );
 		}
 
-		createFramebuffers();
-		allocateCommandBuffers();
-		recordCommandBuffers();
+		if( m_pFrameCapture != nullptr && !m_pFrameCapture->resize() )
+		{
+			log_warning( "Disabling frame capture." );
+			safe_delete( m_pFrameCapture );
+		}
 	}
 	else
 	{
@@ -379,6 +552,105 @@ void Renderer::recreateSwapchain()
 	}
 }
 
+bool Renderer::setNumInstances( uint32_t numInstances )
+{
+	waitForIdle();
+
+	safe_delete( m_pInstanceBuffer );
+	safe_delete( m_pInstanceMemoryPool );
+	m_QuadMesh.pInstanceBuffer = nullptr;
+
+	// the render queue keeps copies of the registered meshes
+	if( !createInstanceBuffer( std::max( numInstances, 1u ) ) ||
+	    !createRenderQueue() )
+	{
+		log_error( "Cannot create instance buffer." );
+		return false;
+	}
+
+	m_uNumInstances = numInstances;
+	return true;
+}
+
+bool Renderer::enableGpuCulling( uint32_t numObjects )
+{
+	// the culler selects each object's instance through the draw's first instance
+	if( !m_vkEnabledFeatures.drawIndirectFirstInstance )
+	{
+		log_error( "GPU culling requires the drawIndirectFirstInstance feature." );
+		return false;
+	}
+
+	// compacted draws are issued by a single call, uncompacted ones are split into calls
+	// of at most maxDrawIndirectCount draws
+	if( supportsDrawIndirectCount() && numObjects > m_vkLimits.maxDrawIndirectCount )
+	{
+		log_error( "GPU culling with draw count compaction supports at most " +
+		           std::to_string( m_vkLimits.maxDrawIndirectCount ) + " objects." );
+		return false;
+	}
+
+	waitForIdle();
+
+	safe_delete( m_pGpuCuller );
+
+	m_pGpuCuller = new GpuCuller( *this,
+	                              m_ShaderCache.getComputeShader( "cull" ),
+	                              FRAMES_IN_FLIGHT,
+	                              numObjects );
+
+	if( !m_pGpuCuller->isValid() )
+	{
+		safe_delete( m_pGpuCuller );
+		return false;
+	}
+
+	// every object is drawn as the instance with the same index
+	if( !setNumInstances( numObjects ) )
+	{
+		safe_delete( m_pGpuCuller );
+		return false;
+	}
+
+	GpuCuller::Object* objects    = m_pGpuCuller->getObjects();
+	glm::mat4*         transforms = m_pGpuCuller->getTransforms();
+
+	for( auto i = 0; i < numObjects; ++i )
+	{
+		objects[ i ].boundingSphere = glm::vec4( 0.0f, 0.0f, 0.0f, 0.71f );
+		objects[ i ].indexCount     = m_QuadMesh.numIndices;
+		objects[ i ].firstIndex     = 0;
+		objects[ i ].vertexOffset   = 0;
+		objects[ i ].padding        = 0;
+
+		transforms[ i ] = computeGridInstance( i, numObjects ).transform;
+	}
+	m_pGpuCuller->setNumObjects( numObjects );
+
+	return true;
+}
+
+bool Renderer::enableFrameCapture( const std::string& directory,
+                                   FrameCapture::Format format,
+                                   uint32_t numSlots )
+{
+	safe_delete( m_pFrameCapture );
+
+	m_pFrameCapture = new FrameCapture( *this, directory, format, numSlots );
+
+	if( !m_pFrameCapture->isValid() )
+	{
+		safe_delete( m_pFrameCapture );
+		return false;
+	}
+	return true;
+}
+
+bool Renderer::enableShaderHotReload()
+{
+	return m_ShaderCache.enableHotReload();
+}
+
 VkBool32 Renderer::vulkanDebugCallback(
         VkDebugReportFlagsEXT      flags,
         VkDebugReportObjectTypeEXT objType,
@@ -484,6 +756,24 @@ bool Renderer::checkDeviceCompatibility( VkPhysicalDevice device, VkSurfaceKHR s
 	         swapChainIsSuitable );
 }
 
+bool Renderer::hasDeviceExtension( VkPhysicalDevice device, const char* name )
+{
+	uint32_t numDeviceExtensions;
+	vkEnumerateDeviceExtensionProperties( device, nullptr, &numDeviceExtensions, nullptr );
+	std::vector<VkExtensionProperties> deviceExtensions( numDeviceExtensions );
+	vkEnumerateDeviceExtensionProperties( device,
+	                                      nullptr,
+	                                      &numDeviceExtensions,
+	                                      deviceExtensions.data() );
+
+	for( const auto& extension : deviceExtensions )
+	{
+		if( std::strcmp( extension.extensionName, name ) == 0 )
+			return true;
+	}
+	return false;
+}
+
 bool Renderer::selectPhysicalDevice()
 {
 	uint32_t numDevices;
@@ -562,10 +852,24 @@ bool Renderer::createLogicalDevice()
 		}
 	}
 
+	// optional features and extensions are enabled when available, users query them
+	// through getEnabledFeatures() and supportsDrawIndirectCount()
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures( m_vkPhysicalDevice, &supportedFeatures );
+
 	VkPhysicalDeviceFeatures deviceFeatures{};
+	deviceFeatures.multiDrawIndirect         = supportedFeatures.multiDrawIndirect;
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
 
 	std::vector<const char*> requiredExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
+	bool drawIndirectCount = hasDeviceExtension( m_vkPhysicalDevice,
+	                                             VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME );
+	if( drawIndirectCount )
+	{
+		requiredExtensions.push_back( VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME );
+	}
+
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.pNext                   = nullptr;
@@ -590,6 +894,18 @@ bool Renderer::createLogicalDevice()
 		log_error( "Cannot create logical device." );
 		return false;
 	}
+
+	m_vkEnabledFeatures = deviceFeatures;
+
+	if( drawIndirectCount )
+	{
+		m_pfnCmdDrawIndirectCount = (PFN_vkCmdDrawIndirectCountKHR)vkGetDeviceProcAddr(
+		                                m_vkDevice,
+		                                "vkCmdDrawIndirectCountKHR" );
+		m_pfnCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+		                                       m_vkDevice,
+		                                       "vkCmdDrawIndexedIndirectCountKHR" );
+	}
 	return true;
 }
 
@@ -616,121 +932,481 @@ bool Renderer::getQueues()
 	return true;
 }
 
+bool Renderer::initialize()
+{
+	// independent branches run concurrently, the steps of a branch in order:
+	//
+	//   swapchain -> render pass ----------.
+	//   pipeline cache -> library ---------+-> pipeline
+	//   shaders ---------------------------'
+	//   geometry upload
+	//   frames
+	//
+	// descriptor sets and the render queue need results of several branches and are
+	// cheap, they are created by the caller once the graph is done; the descriptor set
+	// layout is reflected from the shaders and shared with the pipeline
+	std::atomic<bool> failed( false );
+
+	InitStep swapchain           = { this, &Renderer::createSwapchain,           "swapchain",             &failed };
+	InitStep renderPass          = { this, &Renderer::createRenderPass,          "render_pass",           &failed };
+	InitStep pipelineCache       = { this, &Renderer::createPipelineCache,       "pipeline_cache",        &failed };
+	InitStep pipelineLibrary     = { this, &Renderer::createPipelineLibrary,     "pipeline_library",      &failed };
+	InitStep shaders             = { this, &Renderer::loadShaders,               "shaders",               &failed };
+	InitStep pipeline            = { this, &Renderer::createPipeline,            "pipeline",              &failed };
+	InitStep geometry            = { this, &Renderer::uploadGeometry,            "geometry",              &failed };
+	InitStep frames              = { this, &Renderer::createFrames,              "frames",                &failed };
+
+	// the counters have to outlive the job system, finished jobs still lock them
+	JobSystem::Counter swapchainDone;
+	JobSystem::Counter pipelineCacheDone;
+	JobSystem::Counter pipelineInputsDone;
+	JobSystem::Counter done;
+
+	JobSystem jobSystem( INIT_THREADS );
+
+	jobSystem.run( runInitStep, &swapchain,           &swapchainDone );
+	jobSystem.run( runInitStep, &pipelineCache,       &pipelineCacheDone );
+	jobSystem.run( runInitStep, &renderPass,          &pipelineInputsDone, &swapchainDone );
+	jobSystem.run( runInitStep, &pipelineLibrary,     &pipelineInputsDone, &pipelineCacheDone );
+	jobSystem.run( runInitStep, &shaders,             &pipelineInputsDone );
+	jobSystem.run( runInitStep, &pipeline,            &done, &pipelineInputsDone );
+	jobSystem.run( runInitStep, &geometry,            &done );
+	jobSystem.run( runInitStep, &frames,              &done );
+
+	jobSystem.wait( done );
+
+	return !failed.load();
+}
+
+void Renderer::runInitStep( void* userData )
+{
+	InitStep& step = *reinterpret_cast<InitStep*>( userData );
+
+	// later steps may depend on the objects of the failed one
+	if( step.pFailed->load() )
+		return;
+
+	auto start = Profiler::clock_type::now();
+
+	if( !( step.pRenderer->*step.create )() )
+	{
+		log_error( std::string( "Renderer initialization failed at step: " ) + step.name );
+		step.pFailed->store( true );
+	}
+
+	Profiler::addTime( std::string( "renderer.init." ) + step.name,
+	                   Profiler::millisecondsSince( start ) );
+}
+
 bool Renderer::createSwapchain()
 {
 	m_pSwapchain = new SwapChain( *this );
 	return m_pSwapchain->isValid();
 }
 
-bool Renderer::createDescriptors()
+bool Renderer::createDescriptorSetLayout()
 {
-	DescriptorSetLayout::Composer layoutComposer = DescriptorSetLayout::compose()
-	                                               .stage( VK_SHADER_STAGE_VERTEX_BIT )
-	                                               .uniformBuffer();
+	LayoutCache::Layout layout;
+	if( !m_LayoutCache.getLayout( { &m_ShaderCache.getVertexShader( "vert" ),
+	                                &m_ShaderCache.getFragmentShader( "frag" ) },
+	                              layout ) ||
+	    layout.descriptorLayouts.empty() )
+	{
+		log_error( "Scene shaders declare no descriptor set." );
+		return false;
+	}
 
-	m_pDescriptorSetLayout = new DescriptorSetLayout( *this, layoutComposer );
+	m_pDescriptorSetLayout = layout.descriptorLayouts[ 0 ];
+	return true;
+}
 
-	if( !m_pDescriptorSetLayout->isValid() )
+bool Renderer::createDescriptors()
+{
+	if( !createDescriptorSetLayout() )
 		return false;
 
-	m_pDescriptorPool = new DescriptorPool( *this,
-	                                        {
-	                                            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 }
-	                                        },
-	                                        1 );
+	// the scene's sets are looked up every frame, hits skip allocation and update
+	m_pDescriptorSetCache = new DescriptorSetCache( *this,
+	                                                {
+	                                                    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+	                                                    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f }
+	                                                },
+	                                                DESCRIPTOR_SET_CACHE_SIZE,
+	                                                FRAMES_IN_FLIGHT );
 
-	if( !m_pDescriptorPool->isValid() )
-		return false;
+	return m_pDescriptorSetCache->isValid();
+}
+
+VkDescriptorSet Renderer::getSceneDescriptorSet( uint32_t frame )
+{
+	DescriptorSet::Writer setWriter;
+	setWriter.uniformBuffer( 0, *m_Frames[ frame ].pUniformBuffer, 0, sizeof( CameraUBO ) );
+
+	return m_pDescriptorSetCache->get( *m_pDescriptorSetLayout, setWriter );
+}
+
+bool Renderer::createRenderPass()
+{
+	static const VkClearColorValue clearColor{ { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+	m_pRenderGraph = new RenderGraph( *this );
 
-	m_pDescriptorSet = new DescriptorSet( *m_pDescriptorPool, { m_pDescriptorSetLayout } );
+	m_uBackbuffer = m_pRenderGraph->importImage( "backbuffer",
+	                                             m_pSwapchain->getFormat(),
+	                                             VK_IMAGE_LAYOUT_UNDEFINED,
+	                                             VK_IMAGE_LAYOUT_PRESENT_SRC_KHR );
+	m_pRenderGraph->setOutput( m_uBackbuffer );
 
-	if( !m_pDescriptorSet->isValid() )
+	m_uScenePass = m_pRenderGraph->addPass( "scene", recordSceneCallback, this )
+	                   .colorAttachment( m_uBackbuffer, clearColor )
+	                   .getHandle();
+
+	if( !m_pRenderGraph->compile( m_pSwapchain->getExtent() ) )
+	{
 		return false;
+	}
 
-	DescriptorSet::Writer setWriter( *m_pDescriptorSet );
-	setWriter.uniformBuffer( 0, *m_pUniformBuffer, 0, sizeof( TransformUBO ) );
+	m_pRenderPass = &m_pRenderGraph->getRenderPass( m_uScenePass );
+	return true;
+}
 
-	m_pDescriptorSet->update( setWriter );
+bool Renderer::createPipelineCache()
+{
+	m_pPipelineCache = new PipelineCache( *this, PIPELINE_CACHE_FILENAME );
+	return m_pPipelineCache->isValid();
+}
 
+bool Renderer::createPipelineLibrary()
+{
+	m_pPipelineLibrary = new PipelineLibrary( *this, *m_pPipelineCache );
 	return true;
 }
 
-bool Renderer::createRenderPass()
+PipelineLibrary::Desc Renderer::getPipelineDesc()
 {
-	m_pRenderPass = new RenderPass( *this, m_pSwapchain->getFormat() );
-	return m_pRenderPass->isValid();
+	PipelineLibrary::Desc desc;
+	desc.pRenderPass    = m_pRenderPass;
+	desc.shaders        = {
+	    &m_ShaderCache.getVertexShader( "vert" ),
+	    &m_ShaderCache.getFragmentShader( "frag" )
+	};
+	desc.vertexBindings = {
+	    { sizeof( Vertex ),
+	      VK_VERTEX_INPUT_RATE_VERTEX,
+	      Vertex::getAttributeDescriptions() },
+	    { sizeof( Instance ),
+	      VK_VERTEX_INPUT_RATE_INSTANCE,
+	      Instance::getAttributeDescriptions() }
+	};
+	desc.state.subpass  = m_pRenderGraph->getSubpass( m_uScenePass );
+
+	return desc;
+}
+
+bool Renderer::loadShaders()
+{
+	return ( m_ShaderCache.getVertexShader( "vert" ).isValid() &&
+	         m_ShaderCache.getFragmentShader( "frag" ).isValid() );
 }
 
 bool Renderer::createPipeline()
 {
-	m_pPipeline = new Pipeline( *m_pRenderPass,
-	                            {
-	                                &m_ShaderCache.getVertexShader( "vert" ),
-	                                &m_ShaderCache.getFragmentShader( "frag" )
-	                            },
-	                            {
-	                                m_pDescriptorSetLayout
-	                            } );
-	return m_pPipeline->isValid();
+	auto start = Profiler::clock_type::now();
+
+	m_pPipeline = m_pPipelineLibrary->getPipeline( getPipelineDesc() );
+
+	log_info( "Created pipeline in " + std::to_string( Profiler::millisecondsSince( start ) ) + " ms." );
+
+	return ( m_pPipeline != nullptr );
+}
+
+void Renderer::requestPipeline()
+{
+	m_PipelineRequest = m_pPipelineLibrary->requestPipeline( getPipelineDesc() );
+	m_pPipeline       = m_PipelineRequest.get();
+}
+
+bool Renderer::createCommandPool()
+{
+	m_pCommandPool = new CommandPool( *this, m_UsedQueueFamilies[ QueueFamily::Graphics ].index );
+	return m_pCommandPool->isValid();
 }
 
-bool Renderer::createFramebuffers()
+bool Renderer::createFrames()
 {
-	const auto& swapchainViews = m_pSwapchain->getImageViews();
-	m_vkFramebuffers.resize( swapchainViews.size() );
+	uint32_t queueFamily = m_UsedQueueFamilies[ QueueFamily::Graphics ].index;
 
-	for( auto i = 0; i < swapchainViews.size(); ++i )
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = nullptr;
+	semaphoreInfo.flags = 0;
+
+	// fences start signaled, so the first use of each frame does not wait
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.pNext = nullptr;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for( auto& frame : m_Frames )
 	{
-		VkFramebufferCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		createInfo.pNext           = nullptr;
-		createInfo.flags           = 0;
-		createInfo.renderPass      = m_pPipeline->getRenderPass().getNativeHandle();
-		createInfo.attachmentCount = 1;
-		createInfo.pAttachments    = &swapchainViews[ i ];
-		m_pSwapchain->getExtent( createInfo.width, createInfo.height );
-		createInfo.layers          = 1;
+		// command buffers are re-recorded every frame and recycled by resetting the whole pool
+		frame.pCommandPool = new CommandPool( *this,
+		                                      queueFamily,
+		                                      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT );
 
-		VkResult res = vkCreateFramebuffer( m_vkDevice,
-		                                    &createInfo,
-		                                    nullptr,
-		                                    &m_vkFramebuffers[ i ] );
+		if( !frame.pCommandPool->isValid() )
+			return false;
 
-		if( res != VK_SUCCESS )
+		std::vector<CommandBuffer*> commandBuffers;
+		if( !frame.pCommandPool->allocateBuffers( VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		                                          1,
+		                                          commandBuffers ) )
 		{
-			log_error( "Cannot create framebuffers." );
+			return false;
+		}
+		frame.pCommandBuffer = commandBuffers[ 0 ];
+
+		// transient sets, currently the culler's: one uniform and four storage buffers
+		frame.pDescriptorAllocator = new DescriptorAllocator( *this,
+		                                                      {
+		                                                          { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+		                                                          { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f }
+		                                                      },
+		                                                      FRAME_DESCRIPTOR_SETS_PER_POOL );
+
+		if( vkCreateSemaphore( m_vkDevice,
+		                       &semaphoreInfo,
+		                       nullptr,
+		                       &frame.vkImageAvailableSemaphore ) != VK_SUCCESS ||
+		    vkCreateSemaphore( m_vkDevice,
+		                       &semaphoreInfo,
+		                       nullptr,
+		                       &frame.vkRenderFinishedSemaphore ) != VK_SUCCESS )
+		{
+			log_error( "Cannot create semaphores." );
+			return false;
+		}
+
+		if( vkCreateFence( m_vkDevice, &fenceInfo, nullptr, &frame.vkFence ) != VK_SUCCESS )
+		{
+			log_error( "Cannot create fences." );
 			return false;
 		}
 	}
+
+	// indirect buffers and the parallel recorder are created on first use
 	return true;
 }
 
-bool Renderer::createCommandPool()
+bool Renderer::createParallelRecorder()
 {
-	m_pCommandPool = new CommandPool( *this, m_UsedQueueFamilies[ QueueFamily::Graphics ].index );
-	return m_pCommandPool->isValid();
+	m_pParallelRecorder = new ParallelRecorder( *this, FRAMES_IN_FLIGHT, 0, 64 );
+
+	if( !m_pParallelRecorder->isValid() )
+	{
+		safe_delete( m_pParallelRecorder );
+		return false;
+	}
+
+	log_info( "Recording draws in parallel on " +
+	          std::to_string( m_pParallelRecorder->getNumThreads() ) + " threads." );
+	return true;
 }
 
-bool Renderer::allocateCommandBuffers()
+bool Renderer::createIndirectBuffer( Frame& frame )
 {
-	m_CommandBuffers.resize( m_pSwapchain->getImageViews().size() );
+	frame.pIndirectBuffer = new Buffer( *this,
+	                                    MAX_INDIRECT_DRAWS * sizeof( VkDrawIndexedIndirectCommand ),
+	                                    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT );
 
-	// TODO: implement allocation of multiple command buffers with single call
-	for( auto i = 0; i < m_CommandBuffers.size(); ++i )
+	if( !frame.pIndirectBuffer->isValid() )
 	{
-		m_CommandBuffers[ i ] = new CommandBuffer( *m_pCommandPool );
+		destroyIndirectBuffer( frame );
+		return false;
+	}
+
+	uint32_t typeFilter;
+	uint64_t requiredSize;
+	frame.pIndirectBuffer->getMemoryRequirements( nullptr, &typeFilter, &requiredSize );
+
+	// written by the CPU every frame, so it gets its own persistently mapped allocation
+	frame.pIndirectMemoryPool = new MemoryPool( *this,
+	                                            requiredSize,
+	                                            typeFilter,
+	                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+	                                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+	if( !frame.pIndirectMemoryPool->isValid() ||
+	    !frame.pIndirectBuffer->allocateMemoryFromPool( *frame.pIndirectMemoryPool ) )
+	{
+		destroyIndirectBuffer( frame );
+		return false;
+	}
+
+	frame.pIndirectCommands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(
+	                              frame.pIndirectBuffer->map() );
+
+	if( frame.pIndirectCommands == nullptr )
+	{
+		destroyIndirectBuffer( frame );
+		return false;
+	}
+	return true;
+}
+
+void Renderer::destroyIndirectBuffer( Frame& frame )
+{
+	if( frame.pIndirectCommands != nullptr )
+	{
+		frame.pIndirectBuffer->unmap();
+		frame.pIndirectCommands = nullptr;
+	}
+	safe_delete( frame.pIndirectBuffer );
+	safe_delete( frame.pIndirectMemoryPool );
+}
+
+bool Renderer::recordCommandBuffer( Frame& frame, uint32_t imageIndex )
+{
+	bool parallel = isRecordingParallel();
+
+	CommandBuffer& commandBuffer = *frame.pCommandBuffer;
+
+	if( !commandBuffer.begin( VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT ) )
+		return false;
+
+	commandBuffer.setStateTracking( true );
+
+	// the culling dispatch has to be recorded outside of the render pass
+	if( m_pGpuCuller != nullptr &&
+	    !m_pGpuCuller->cull( commandBuffer,
+	                         m_uCurrentFrame,
+	                         Frustum::fromViewProjection( m_ModelViewProjection ),
+	                         *frame.pDescriptorAllocator ) )
+	{
+		return false;
+	}
+
+	m_pRenderGraph->setImportedView( m_uBackbuffer, m_pSwapchain->getImageViews()[ imageIndex ] );
+	m_pRenderGraph->setPassContents( m_uScenePass,
+	                                 parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	                                          : VK_SUBPASS_CONTENTS_INLINE );
+
+	m_bRecordingFailed = false;
+
+	if( !m_pRenderGraph->execute( commandBuffer ) || m_bRecordingFailed )
+		return false;
+
+	return commandBuffer.end();
+}
+
+bool Renderer::isRecordingParallel()
+{
+	return ( m_pGpuCuller == nullptr &&
+	         !m_bIndirectDraws &&
+	         ( m_bParallelRecording || m_RenderQueue.getNumItems() >= PARALLEL_RECORDING_THRESHOLD ) );
+}
+
+void Renderer::abandonFrame( Frame& frame )
+{
+	static const VkPipelineStageFlags waitStages[] = {
+	    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+	};
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext                = nullptr;
+	submitInfo.waitSemaphoreCount   = 1;
+	submitInfo.pWaitSemaphores      = &frame.vkImageAvailableSemaphore;
+	submitInfo.pWaitDstStageMask    = waitStages;
+	submitInfo.commandBufferCount   = 0;
+	submitInfo.pCommandBuffers      = nullptr;
+	submitInfo.signalSemaphoreCount = 0;
+	submitInfo.pSignalSemaphores    = nullptr;
+
+	vkResetFences( m_vkDevice, 1, &frame.vkFence );
+
+	if( vkQueueSubmit( m_vkGraphicsQueue, 1, &submitInfo, frame.vkFence ) != VK_SUCCESS )
+	{
+		log_error( "Cannot submit batch for abandoned frame." );
+	}
 
-		if( !m_CommandBuffers[ i ]->isValid() )
+	// an acquired image can only be returned by presenting it, which requires rendering
+	log_warning( "Recreating swap chain to release the image of an abandoned frame." );
+	recreateSwapchain();
+}
+
+bool Renderer::recordScene( CommandBuffer& commandBuffer, const RenderGraph::PassContext& context )
+{
+	Frame&   frame    = m_Frames[ m_uCurrentFrame ];
+	uint32_t numDraws = m_RenderQueue.getNumItems();
+
+	if( m_pGpuCuller != nullptr && m_pPipeline == nullptr )
+	{
+		// still compiling
+		Profiler::addCount( "renderer.skipped_draws" );
+	}
+	else if( m_pGpuCuller != nullptr )
+	{
+		setViewportAndScissor( commandBuffer );
+
+		commandBuffer.bindPipeline( VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pPipeline );
+		commandBuffer.bindDescriptorSet( frame.vkDescriptorSet,
+		                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+		                                 *m_pPipeline );
+		commandBuffer.bindMesh( m_QuadMesh );
+
+		ModelPushConstants constants{ m_ModelMatrix };
+		commandBuffer.pushConstants( *m_pPipeline,
+		                             VK_SHADER_STAGE_VERTEX_BIT,
+		                             0,
+		                             sizeof( ModelPushConstants ),
+		                             &constants );
+
+		m_pGpuCuller->draw( commandBuffer, m_uCurrentFrame );
+	}
+	else if( isRecordingParallel() )
+	{
+		if( m_pParallelRecorder == nullptr && !createParallelRecorder() )
 			return false;
+
+		return m_pParallelRecorder->record( m_uCurrentFrame,
+		                                    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		                                    commandBuffer,
+		                                    *context.pRenderPass,
+		                                    context.subpass,
+		                                    context.framebuffer,
+		                                    numDraws,
+		                                    recordDrawsCallback,
+		                                    this );
 	}
+	else if( m_bIndirectDraws )
+	{
+		if( frame.pIndirectCommands == nullptr && !createIndirectBuffer( frame ) )
+			return false;
 
+		setViewportAndScissor( commandBuffer );
+
+		m_RenderQueue.recordIndirect( commandBuffer,
+		                              *frame.pIndirectBuffer,
+		                              frame.pIndirectCommands,
+		                              MAX_INDIRECT_DRAWS );
+	}
+	else
+	{
+		recordDraws( commandBuffer, 0, numDraws );
+	}
 	return true;
 }
 
-bool Renderer::recordCommandBuffers()
+void Renderer::recordDraws( CommandBuffer& commandBuffer, uint32_t first, uint32_t count )
 {
-	static const VkClearValue clearColor{ VkClearColorValue{ { 0.0f, 0.0f, 0.0f, 1.0f } } };
+	setViewportAndScissor( commandBuffer );
+
+	m_RenderQueue.record( commandBuffer, first, count );
+}
 
+void Renderer::setViewportAndScissor( CommandBuffer& commandBuffer )
+{
 	VkRect2D renderArea = { { 0, 0 }, m_pSwapchain->getExtent() };
 
 	VkViewport viewport{};
@@ -741,92 +1417,282 @@ bool Renderer::recordCommandBuffers()
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 
-	for( auto i = 0; i < m_CommandBuffers.size(); ++i )
+	commandBuffer.setViewport( 0, viewport );
+	commandBuffer.setScissor( 0, renderArea );
+}
+
+void Renderer::recordSceneCallback( CommandBuffer& commandBuffer,
+                                    const RenderGraph::PassContext& context,
+                                    void* userData )
+{
+	Renderer& renderer = *reinterpret_cast<Renderer*>( userData );
+
+	if( !renderer.recordScene( commandBuffer, context ) )
 	{
-		CommandBuffer& commandBuffer = *m_CommandBuffers[ i ];
+		renderer.m_bRecordingFailed = true;
+	}
+}
 
-		if( !commandBuffer.begin( VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT ) )
-			return false;
+void Renderer::recordDrawsCallback( CommandBuffer& commandBuffer,
+                                    uint32_t first,
+                                    uint32_t count,
+                                    void* userData )
+{
+	reinterpret_cast<Renderer*>( userData )->recordDraws( commandBuffer, first, count );
+}
 
-		commandBuffer.beginRenderPass( *m_pRenderPass,
-		                               m_vkFramebuffers[ i ],
-		                               renderArea,
-		                               { clearColor } );
+bool Renderer::createRenderQueue()
+{
+	m_RenderQueue.reset();
 
-		commandBuffer.bindPipeline( VK_PIPELINE_BIND_POINT_GRAPHICS, *m_pPipeline );
+	m_uPipelineHandle = ( m_pPipeline != nullptr
+	                      ? m_RenderQueue.registerPipeline( *m_pPipeline )
+	                      : m_RenderQueue.registerPipeline( m_PipelineRequest, nullptr ) );
+	m_uQuadMeshHandle = m_RenderQueue.registerMesh( m_QuadMesh );
 
-		commandBuffer.bindDescriptorSet( *m_pDescriptorSet,
-		                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
-		                                 *m_pPipeline );
+	m_uSceneSetHandle = m_RenderQueue.registerDescriptorSet( VK_NULL_HANDLE );
 
-		commandBuffer.bindVertexBuffers( 0, { m_pGeometryBuffer }, { 0 } );
-		commandBuffer.bindIndexBuffer( *m_pGeometryBuffer, 4 * sizeof( Vertex ), VK_INDEX_TYPE_UINT32 ); // TODO: replace fixed offset !!!!!!!
+	return ( m_uPipelineHandle != RenderQueue::INVALID_HANDLE &&
+	         m_uQuadMeshHandle != RenderQueue::INVALID_HANDLE &&
+	         m_uSceneSetHandle != RenderQueue::INVALID_HANDLE );
+}
 
-		commandBuffer.setViewports( 0, { viewport } );
-		commandBuffer.setScissors( 0, { renderArea } );
+bool Renderer::createInstanceBuffer( uint32_t numInstances )
+{
+	m_pInstanceBuffer = new Buffer( *this,
+	                                numInstances * sizeof( Instance ),
+	                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
 
-		//commandBuffer.draw( 0, m_pGeometryBuffer->getSize() / sizeof( Vertex ), 0, 1 );
-		commandBuffer.drawIndexed( 0, 6, 0, 0, 1 ); // TODO: replace fixed index count !!!!!!!
+	if( !m_pInstanceBuffer->isValid() )
+		return false;
 
-		commandBuffer.endRenderPass();
+	uint32_t typeFilter;
+	uint64_t requiredSize;
+	m_pInstanceBuffer->getMemoryRequirements( nullptr, &typeFilter, &requiredSize );
+
+	// only written when the instance count changes
+	m_pInstanceMemoryPool = new MemoryPool( *this,
+	                                        requiredSize,
+	                                        typeFilter,
+	                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+	                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+	if( !m_pInstanceMemoryPool->isValid() ||
+	    !m_pInstanceBuffer->allocateMemoryFromPool( *m_pInstanceMemoryPool ) )
+	{
+		return false;
+	}
 
-		if( !commandBuffer.end() )
-			return false;
+	Instance* instances = reinterpret_cast<Instance*>( m_pInstanceBuffer->map() );
+
+	if( instances == nullptr )
+		return false;
+
+	for( auto i = 0; i < numInstances; ++i )
+	{
+		instances[ i ] = computeGridInstance( i, numInstances );
 	}
+	m_pInstanceBuffer->unmap();
+
+	m_QuadMesh.pInstanceBuffer = m_pInstanceBuffer;
+	m_QuadMesh.instanceOffset  = 0;
 
 	return true;
 }
 
-bool Renderer::createTransferBuffers()
+Instance Renderer::computeGridInstance( uint32_t index, uint32_t numInstances )
 {
-	m_pTransferCommandBuffer = new CommandBuffer( *m_pCommandPool );
+	// square grid centered on the origin, a single instance stays untransformed
+	uint32_t gridSize = std::max<uint32_t>( std::ceil( std::sqrt( (float)numInstances ) ), 1u );
+	float    spacing  = 8.0f / gridSize;
+	float    scale    = std::min( 1.0f, 0.8f * spacing );
+
+	float u = (float)( index % gridSize );
+	float v = (float)( index / gridSize );
+
+	glm::vec3 position( ( u - 0.5f * ( gridSize - 1 ) ) * spacing,
+	                    ( v - 0.5f * ( gridSize - 1 ) ) * spacing,
+	                    0.0f );
+
+	Instance instance;
+	instance.transform = glm::scale( glm::translate( glm::mat4( 1.0f ), position ),
+	                                 glm::vec3( scale ) );
+	instance.color     = glm::vec4( 1.0f - 0.5f * u / gridSize,
+	                                1.0f - 0.5f * v / gridSize,
+	                                1.0f,
+	                                1.0f );
+	return instance;
+}
 
-	if( !m_pTransferCommandBuffer->isValid() ||
-	    !m_pTransferCommandBuffer->begin( VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT ) )
+void Renderer::buildRenderQueue()
+{
+	if( m_pPipeline == nullptr )
 	{
-		return false;
+		m_pPipeline = m_PipelineRequest.get();
 	}
 
-	VkBufferCopy region{};
-	region.srcOffset = 0;
-	region.dstOffset = 0;
-	region.size      = m_pStagingBuffer->getSize();
+	m_RenderQueue.clear();
+	m_RenderQueue.setDescriptorSet( m_uSceneSetHandle, m_Frames[ m_uCurrentFrame ].vkDescriptorSet );
 
-	m_pTransferCommandBuffer->copyBuffer( *m_pGeometryBuffer, *m_pStagingBuffer, { region } );
+	RenderQueue::DrawItem item{};
+	item.pipeline      = m_uPipelineHandle;
+	item.descriptorSet = m_uSceneSetHandle;
+	item.mesh          = m_uQuadMeshHandle;
+	item.depth         = 0.0f;
+	item.firstInstance = 0;
+	item.numInstances  = m_uNumInstances;
+	item.model         = m_ModelMatrix;
 
-	m_pTransferCommandBuffer->end();
+	for( auto i = 0; i < m_uNumDraws; ++i )
+	{
+		m_RenderQueue.submit( item );
+	}
 
-	return true;
+	m_RenderQueue.sort();
 }
 
-bool Renderer::createSemaphores()
+void Renderer::reloadShaders()
 {
-	VkSemaphoreCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	createInfo.pNext = nullptr;
-	createInfo.flags = 0;
+	if( m_ShaderCache.update() )
+	{
+		// a pending request for earlier changes is released once it completes
+		if( m_ReloadRequest.isValid() )
+		{
+			m_SupersededRequests.push_back( m_ReloadRequest );
+		}
 
-	VkResult res = vkCreateSemaphore( m_vkDevice,
-	                                   &createInfo,
-	                                   nullptr,
-	                                   &m_vkImageAvailableSemaphore );
+		// the GPU culler keeps its compute pipeline, a reloaded culling shader is used
+		// the next time culling is enabled
+		m_ReloadRequest = m_pPipelineLibrary->requestPipeline( getPipelineDesc() );
+	}
 
-	if( res != VK_SUCCESS )
+	releaseSupersededRequests();
+
+	if( m_ReloadRequest.isFailed() )
 	{
-		log_error( "Cannot create semaphores." );
-		return false;
+		log_error( "Cannot compile pipeline for reloaded shaders, keeping the previous one." );
+		m_ShaderCache.revert( m_ReplacedShaders );
+		m_ReloadRequest = PipelineLibrary::Future();
 	}
+	else if( m_ReloadRequest.isReady() )
+	{
+		Pipeline* pipeline = m_ReloadRequest.get();
 
-	res = vkCreateSemaphore( m_vkDevice,
-	                         &createInfo,
-	                         nullptr,
-	                         &m_vkRenderFinishedSemaphore );
+		// the frames' descriptor sets and push constants follow the layout of the first
+		// shaders, layouts are shared by all pipelines declaring the same resources
+		if( m_pPipeline != nullptr && pipeline->getLayout() != m_pPipeline->getLayout() )
+		{
+			log_error( "Reloaded shaders change the pipeline layout, keeping the previous pipeline." );
 
-	if( res != VK_SUCCESS )
+			// not kept in the library, a later reload compiles the shaders again
+			if( m_pPipelineLibrary->release( pipeline ) != nullptr )
+			{
+				retire( pipeline );
+			}
+			m_ShaderCache.revert( m_ReplacedShaders );
+		}
+		else if( pipeline != m_pPipeline )
+		{
+			log_info( "Swapping in pipeline for reloaded shaders." );
+
+			// frames in flight may still use the previous pipeline
+			if( m_pPipeline != nullptr && m_pPipelineLibrary->release( m_pPipeline ) != nullptr )
+			{
+				retire( m_pPipeline );
+			}
+
+			m_pPipeline       = pipeline;
+			m_PipelineRequest = m_ReloadRequest;
+			createRenderQueue();
+		}
+
+		// also if the shaders were changed back to the current ones
+		if( pipeline == m_pPipeline )
+		{
+			m_ShaderCache.commit( m_ReplacedShaders );
+		}
+		m_ReloadRequest = PipelineLibrary::Future();
+	}
+
+	// modules are only read while compiling, any pending request may still use them
+	if( !m_ReplacedShaders.empty() && m_pPipelineLibrary->isIdle() )
+	{
+		for( Shader* shader : m_ReplacedShaders )
+		{
+			retire( shader );
+		}
+		m_ReplacedShaders.clear();
+	}
+}
+
+void Renderer::releaseSupersededRequests()
+{
+	Pipeline* reloaded = ( m_ReloadRequest.isReady() ? m_ReloadRequest.get() : nullptr );
+
+	auto iter = m_SupersededRequests.begin();
+	while( iter != m_SupersededRequests.end() )
+	{
+		if( iter->isReady() )
+		{
+			// requests for equal shaders share the library's pipeline
+			Pipeline* pipeline = iter->get();
+			if( pipeline != m_pPipeline &&
+			    pipeline != reloaded &&
+			    m_pPipelineLibrary->release( pipeline ) != nullptr )
+			{
+				retire( pipeline );
+			}
+			iter = m_SupersededRequests.erase( iter );
+		}
+		else if( iter->isFailed() )
+		{
+			iter = m_SupersededRequests.erase( iter );
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+void Renderer::destroyRetiredObjects( bool all )
+{
+	auto iter = m_RetiredObjects.begin();
+
+	// the fence of the current frame retired every frame up to this one
+	while( iter != m_RetiredObjects.end() )
+	{
+		if( all || iter->frameNumber + FRAMES_IN_FLIGHT <= m_uFrameNumber )
+		{
+			iter->destroy( iter->pObject );
+			iter = m_RetiredObjects.erase( iter );
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+bool Renderer::createTransferBuffers()
+{
+	m_pTransferCommandBuffer = new CommandBuffer( *m_pCommandPool );
+
+	if( !m_pTransferCommandBuffer->isValid() ||
+	    !m_pTransferCommandBuffer->begin( VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT ) )
 	{
-		log_error( "Cannot create semaphores." );
 		return false;
 	}
+
+	VkBufferCopy region{};
+	region.srcOffset = 0;
+	region.dstOffset = 0;
+	region.size      = m_pStagingBuffer->getSize();
+
+	m_pTransferCommandBuffer->copyBuffer( *m_pGeometryBuffer, *m_pStagingBuffer, { region } );
+
+	m_pTransferCommandBuffer->end();
+
 	return true;
 }
 
@@ -896,16 +1762,37 @@ bool Renderer::createBuffers()
 		return false;
 	}
 
-	m_pUniformBuffer = new Buffer( *m_pHostMemoryPool,
-	                               sizeof( TransformUBO ),
-	                               VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT );
+	m_QuadMesh.pVertexBuffer   = m_pGeometryBuffer;
+	m_QuadMesh.vertexOffset    = 0;
+	m_QuadMesh.pInstanceBuffer = nullptr;
+	m_QuadMesh.instanceOffset  = 0;
+	m_QuadMesh.pIndexBuffer    = m_pGeometryBuffer;
+	m_QuadMesh.indexOffset     = vertices.size() * sizeof( Vertex );
+	m_QuadMesh.indexType       = VK_INDEX_TYPE_UINT32;
+	m_QuadMesh.numIndices      = indices.size();
 
-	if( !m_pUniformBuffer->isValid() )
-		return false;
+	for( auto& frame : m_Frames )
+	{
+		frame.pUniformBuffer = new Buffer( *m_pHostMemoryPool,
+		                                   sizeof( CameraUBO ),
+		                                   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT );
+
+		if( !frame.pUniformBuffer->isValid() )
+			return false;
+	}
 
 	return true;
 }
 
+bool Renderer::uploadGeometry()
+{
+	return ( createBuffers() &&
+	         createInstanceBuffer( 1 ) &&
+	         createCommandPool() &&
+	         createTransferBuffers() &&
+	         copyStagingBuffer() );
+}
+
 bool Renderer::copyStagingBuffer()
 {
 	VkCommandBuffer commandBuffer = m_pTransferCommandBuffer->getNativeHandle();
@@ -930,22 +1817,45 @@ bool Renderer::copyStagingBuffer()
 	return true;
 }
 
-void Renderer::cleanupSwapchain()
+void Renderer::destroyFrames()
 {
-	for( auto framebuffer : m_vkFramebuffers )
+	safe_delete( m_pParallelRecorder );
+
+	for( auto& frame : m_Frames )
 	{
-		if( framebuffer != VK_NULL_HANDLE )
+		if( frame.vkFence != VK_NULL_HANDLE )
 		{
-			vkDestroyFramebuffer( m_vkDevice, framebuffer, nullptr );
+			vkDestroyFence( m_vkDevice, frame.vkFence, nullptr );
+			frame.vkFence = VK_NULL_HANDLE;
+		}
+		if( frame.vkImageAvailableSemaphore != VK_NULL_HANDLE )
+		{
+			vkDestroySemaphore( m_vkDevice, frame.vkImageAvailableSemaphore, nullptr );
+			frame.vkImageAvailableSemaphore = VK_NULL_HANDLE;
+		}
+		if( frame.vkRenderFinishedSemaphore != VK_NULL_HANDLE )
+		{
+			vkDestroySemaphore( m_vkDevice, frame.vkRenderFinishedSemaphore, nullptr );
+			frame.vkRenderFinishedSemaphore = VK_NULL_HANDLE;
 		}
-	}
-	m_vkFramebuffers.clear();
 
-	for( auto commandBuffer : m_CommandBuffers )
-	{
-		delete commandBuffer;
+		if( frame.pCommandBuffer != nullptr )
+		{
+			std::vector<CommandBuffer*> commandBuffers = { frame.pCommandBuffer };
+			frame.pCommandPool->freeBuffers( commandBuffers );
+			frame.pCommandBuffer = nullptr;
+		}
+		safe_delete( frame.pCommandPool );
+
+		safe_delete( frame.pDescriptorAllocator );
+		destroyIndirectBuffer( frame );
+
+		frame.vkDescriptorSet = VK_NULL_HANDLE;
+		safe_delete( frame.pUniformBuffer );
 	}
-	m_CommandBuffers.clear();
+}
 
+void Renderer::cleanupSwapchain()
+{
 	safe_delete( m_pSwapchain );
 }
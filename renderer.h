@@ -3,6 +3,14 @@
 
 #include "common.h"
 #include "shadercache.h"
+#include "layoutcache.h"
+#include "framecapture.h"
+#include "renderqueue.h"
+#include "mesh.h"
+#include "vertex.h"
+#include "frustum.h"
+#include "rendergraph.h"
+#include "profiler.h"
 
 #include <vulkan/vulkan.h>
 
@@ -13,7 +21,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <vector>
+#include <string>
 #include <chrono>
+#include <atomic>
 
 class WindowSurface;
 class SwapChain;
@@ -24,16 +34,35 @@ class CommandPool;
 class CommandBuffer;
 class RenderPass;
 class DescriptorSetLayout;
-class DescriptorPool;
+class DescriptorAllocator;
+class DescriptorSetCache;
 class DescriptorSet;
+class ParallelRecorder;
+class GpuCuller;
+class PipelineCache;
+class Shader;
 
-struct TransformUBO
+// per-frame camera data, bound as a uniform buffer
+struct CameraUBO
 {
-	glm::mat4 model;
 	glm::mat4 view;
 	glm::mat4 proj;
 };
 
+// immutable state of the simulated world a frame is rendered from
+struct FrameSnapshot
+{
+	uint64_t  sequence;
+	glm::mat4 view;
+	glm::mat4 model;
+};
+
+// per-draw data, updated through push constants
+struct ModelPushConstants
+{
+	glm::mat4 model;
+};
+
 enum class QueueFamily
 {
 	Graphics = 0,
@@ -48,6 +77,28 @@ class Renderer
 public:
 	static constexpr uint32_t INVALID_FRAME = ~(uint32_t)0;
 
+	// draw counts below this are recorded inline, larger ones across worker threads
+	static constexpr uint32_t PARALLEL_RECORDING_THRESHOLD = 256;
+
+	// number of frames the CPU may record ahead of the GPU
+	static constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+
+	// pipeline cache blob in the working directory, like the shaders
+	static constexpr const char* PIPELINE_CACHE_FILENAME = "pipeline-cache.bin";
+
+	// threads running independent initialization steps, including the constructing thread
+	static constexpr uint32_t INIT_THREADS = 4;
+
+	// capacity of the per-frame indirect argument buffers, the maxDrawIndirectCount
+	// guaranteed with the multiDrawIndirect feature
+	static constexpr uint32_t MAX_INDIRECT_DRAWS = 65535;
+
+	// sets per pool of the per-frame descriptor allocators, more pools are added on demand
+	static constexpr uint32_t FRAME_DESCRIPTOR_SETS_PER_POOL = 1024;
+
+	// sets shared between draws binding the same resources
+	static constexpr uint32_t DESCRIPTOR_SET_CACHE_SIZE = 4096;
+
 	class QueueFamilies
 	{
 	friend class Renderer;
@@ -76,6 +127,41 @@ public:
 		Desc         m_Descriptors[ (size_t)QueueFamily::COUNT ];
 	};
 
+private:
+	// resources used by a single frame in flight, reused once its fence retires
+	struct Frame
+	{
+		CommandPool*                  pCommandPool;
+		CommandBuffer*                pCommandBuffer;
+		Buffer*                       pUniformBuffer;
+		// looked up in the descriptor set cache every frame
+		VkDescriptorSet               vkDescriptorSet;
+		DescriptorAllocator*          pDescriptorAllocator;
+		MemoryPool*                   pIndirectMemoryPool;
+		Buffer*                       pIndirectBuffer;
+		VkDrawIndexedIndirectCommand* pIndirectCommands;
+		VkSemaphore                   vkImageAvailableSemaphore;
+		VkSemaphore                   vkRenderFinishedSemaphore;
+		VkFence                       vkFence;
+	};
+
+	// node of the initialization graph, run as a job once the steps it depends on are done
+	struct InitStep
+	{
+		Renderer*          pRenderer;
+		bool ( Renderer::* create )();
+		const char*        name;
+		std::atomic<bool>* pFailed;
+	};
+
+	// object destroyed once the frames in flight when it was retired have completed
+	struct RetiredObject
+	{
+		uint64_t frameNumber;
+		void*    pObject;
+		void ( * destroy )( void* );
+	};
+
 public:
 	Renderer( WindowSurface& surface );
 	~Renderer();
@@ -93,6 +179,12 @@ public:
 
 	void destroy();
 
+	// false if initialization failed, nothing may be rendered then
+	bool isValid()
+	{
+		return ( m_vkDevice != VK_NULL_HANDLE );
+	}
+
 	VkPhysicalDevice     getNativePhysicalDeviceHandle()
 	{
 		return m_vkPhysicalDevice;
@@ -102,6 +194,29 @@ public:
 		return m_vkDevice;
 	}
 
+	const VkPhysicalDeviceFeatures& getEnabledFeatures()
+	{
+		return m_vkEnabledFeatures;
+	}
+	const VkPhysicalDeviceLimits&   getLimits()
+	{
+		return m_vkLimits;
+	}
+
+	// VK_KHR_draw_indirect_count entry points, nullptr if the extension is unavailable
+	bool                 supportsDrawIndirectCount()
+	{
+		return ( m_pfnCmdDrawIndexedIndirectCount != nullptr );
+	}
+	PFN_vkCmdDrawIndirectCountKHR        getCmdDrawIndirectCount()
+	{
+		return m_pfnCmdDrawIndirectCount;
+	}
+	PFN_vkCmdDrawIndexedIndirectCountKHR getCmdDrawIndexedIndirectCount()
+	{
+		return m_pfnCmdDrawIndexedIndirectCount;
+	}
+
 	WindowSurface&       getWindowSurface()
 	{
 		return *m_pWindowSurface;
@@ -118,16 +233,110 @@ public:
 	{
 		return *m_pPipeline;
 	}
+	PipelineCache&       getPipelineCache()
+	{
+		return *m_pPipelineCache;
+	}
+	LayoutCache&         getLayoutCache()
+	{
+		return m_LayoutCache;
+	}
+	PipelineLibrary&     getPipelineLibrary()
+	{
+		return *m_pPipelineLibrary;
+	}
+	RenderPass&          getRenderPass()
+	{
+		return *m_pRenderPass;
+	}
+	ShaderCache&         getShaderCache()
+	{
+		return m_ShaderCache;
+	}
+	// vertices and indices of the quad drawn by every render queue item
+	const Mesh&          getQuadMesh()
+	{
+		return m_QuadMesh;
+	}
+
+	// transient descriptor sets for the frame being recorded, recycled at once when the
+	// frame is reused
+	DescriptorAllocator& getFrameDescriptorAllocator()
+	{
+		return *m_Frames[ m_uCurrentFrame ].pDescriptorAllocator;
+	}
+	DescriptorSetCache&  getDescriptorSetCache()
+	{
+		return *m_pDescriptorSetCache;
+	}
+	// the cached set binding the uniforms of the given frame in flight, VK_NULL_HANDLE
+	// if the cache is exhausted
+	VkDescriptorSet      getSceneDescriptorSet( uint32_t frame );
+	DescriptorSetLayout& getSceneDescriptorSetLayout()
+	{
+		return *m_pDescriptorSetLayout;
+	}
+	// camera uniforms of the given frame in flight
+	Buffer&              getUniformBuffer( uint32_t frame )
+	{
+		return *m_Frames[ frame ].pUniformBuffer;
+	}
+
+	// camera matrices written to the uniforms, the projection flips y for Vulkan clip space
+	static glm::mat4 computeViewMatrix();
+	glm::mat4        computeProjectionMatrix();
+
+	// transform and color of an instance on the grid set up by setNumInstances()
+	static Instance  computeGridInstance( uint32_t index, uint32_t numInstances );
+
+	// simulates the world at the current time, safe to call from any thread
+	FrameSnapshot createSnapshot() const;
 
 	uint32_t renderFrame();
+	uint32_t renderFrame( const FrameSnapshot& snapshot );
 	void     presentFrame( uint32_t imageIndex );
 
-	void     updateUniforms();
-
 	void     waitForIdle();
 
 	void     recreateSwapchain();
 
+	// number of objects submitted to the render queue each frame
+	void     setNumDraws( uint32_t numDraws )
+	{
+		m_uNumDraws = numDraws;
+	}
+
+	// number of instances drawn by each render queue item, every instance is placed on a
+	// grid with its own transform and color
+	bool     setNumInstances( uint32_t numInstances );
+
+	// submits the render queue through multi-draw indirect commands (default) or
+	// through one draw call per item, recorded in parallel for large queues
+	void     setIndirectDraws( bool enable )
+	{
+		m_bIndirectDraws = enable;
+	}
+
+	// records direct draws in parallel regardless of the render queue's size
+	void     setParallelRecording( bool enable )
+	{
+		m_bParallelRecording = enable;
+	}
+
+	// replaces the render queue by numObjects quads culled against the view frustum in a
+	// compute pass, the surviving draws are submitted through indirect commands; fails
+	// without the drawIndirectFirstInstance feature and, when draw counts are compacted,
+	// for more objects than maxDrawIndirectCount
+	bool     enableGpuCulling( uint32_t numObjects );
+
+	bool     enableFrameCapture( const std::string& directory,
+	                             FrameCapture::Format format,
+	                             uint32_t numSlots );
+
+	// reloads shaders changed on disk; the pipeline is rebuilt in the background and
+	// swapped in at the start of a frame once it is ready
+	bool     enableShaderHotReload();
+
 private:
 	static VKAPI_ATTR VkBool32 VKAPI_CALL vulkanDebugCallback(
 	        VkDebugReportFlagsEXT      flags,
@@ -142,26 +351,86 @@ private:
 	static bool attachDebugCallback();
 	static void detachDebugCallback();
 
+	static void recordDrawsCallback( CommandBuffer& commandBuffer,
+	                                 uint32_t first,
+	                                 uint32_t count,
+	                                 void* userData );
+	static void recordSceneCallback( CommandBuffer& commandBuffer,
+	                                 const RenderGraph::PassContext& context,
+	                                 void* userData );
+
+	static void runInitStep( void* userData );
+
 	static bool checkDeviceCompatibility( VkPhysicalDevice device,
 	                                      VkSurfaceKHR surface );
+	static bool hasDeviceExtension( VkPhysicalDevice device, const char* name );
 
 	bool selectPhysicalDevice();
 	bool createLogicalDevice();
 	bool getQueues();
+	// creates everything up to the first frame except descriptor sets and the render queue,
+	// independent steps run concurrently
+	bool initialize();
 	bool createSwapchain();
+	bool createPipelineCache();
+	bool createPipelineLibrary();
+	bool createDescriptorSetLayout();
 	bool createDescriptors();
 	bool createRenderPass();
+	bool loadShaders();
+	PipelineLibrary::Desc getPipelineDesc();
 	bool createPipeline();
-	bool createFramebuffers();
+	// compiles in the background, draws are skipped until the pipeline is ready
+	void requestPipeline();
 	bool createCommandPool();
-	bool allocateCommandBuffers();
-	bool recordCommandBuffers();
+	bool createFrames();
+	bool createIndirectBuffer( Frame& frame );
+	void destroyIndirectBuffer( Frame& frame );
+	bool createParallelRecorder();
+	bool recordCommandBuffer( Frame& frame, uint32_t imageIndex );
+	// consumes the image available semaphore and signals the fence of a frame that
+	// acquired an image but cannot be submitted, the image is released by recreating
+	// the swap chain
+	void abandonFrame( Frame& frame );
+	bool isRecordingParallel();
+	bool recordScene( CommandBuffer& commandBuffer, const RenderGraph::PassContext& context );
+	void recordDraws( CommandBuffer& commandBuffer, uint32_t first, uint32_t count );
+	void setViewportAndScissor( CommandBuffer& commandBuffer );
 	bool createTransferBuffers();
-	bool createSemaphores();
 	bool createBuffers();
+	bool createRenderQueue();
+	bool createInstanceBuffer( uint32_t numInstances );
+	// creates the geometry and waits until it is copied to device memory
+	bool uploadGeometry();
+
+	void buildRenderQueue();
+
+	// swaps in the pipeline for reloaded shaders, called at the start of a frame
+	void reloadShaders();
+	// releases the pipelines of superseded reload requests once they are compiled
+	void releaseSupersededRequests();
+
+	template<typename T>
+	static void destroyObject( void* object )
+	{
+		delete reinterpret_cast<T*>( object );
+	}
+
+	template<typename T>
+	void retire( T* object )
+	{
+		m_RetiredObjects.push_back( { m_uFrameNumber, object, destroyObject<T> } );
+	}
+
+	// destroys the objects no frame in flight can use, or all of them once the device is idle
+	void destroyRetiredObjects( bool all );
 
 	bool copyStagingBuffer();
 
+	// writes the uniforms of the frame being recorded
+	void updateUniforms( const FrameSnapshot& snapshot );
+
+	void destroyFrames();
 	void cleanupSwapchain();
 
 private:
@@ -172,30 +441,71 @@ private:
 	VkDevice                     m_vkDevice;
 	VkQueue                      m_vkGraphicsQueue;
 	VkQueue                      m_vkPresentQueue;
-	std::vector<VkFramebuffer>   m_vkFramebuffers;
-	VkSemaphore                  m_vkImageAvailableSemaphore;
-	VkSemaphore                  m_vkRenderFinishedSemaphore;
+	VkPhysicalDeviceFeatures     m_vkEnabledFeatures;
+	VkPhysicalDeviceLimits       m_vkLimits;
+
+	PFN_vkCmdDrawIndirectCountKHR        m_pfnCmdDrawIndirectCount;
+	PFN_vkCmdDrawIndexedIndirectCountKHR m_pfnCmdDrawIndexedIndirectCount;
 
 	ShaderCache                  m_ShaderCache;
+	LayoutCache                  m_LayoutCache;
 	QueueFamilies                m_UsedQueueFamilies;
 
 	WindowSurface*               m_pWindowSurface;
 	SwapChain*                   m_pSwapchain;
+	PipelineCache*               m_pPipelineCache;
+	PipelineLibrary*             m_pPipelineLibrary;
+	// owned by the layout cache
 	DescriptorSetLayout*         m_pDescriptorSetLayout;
-	DescriptorPool*              m_pDescriptorPool;
-	DescriptorSet*               m_pDescriptorSet;
+	DescriptorSetCache*          m_pDescriptorSetCache;
+	RenderGraph*                 m_pRenderGraph;
+	RenderGraph::Handle          m_uBackbuffer;
+	RenderGraph::Handle          m_uScenePass;
+	// owned by the render graph
 	RenderPass*                  m_pRenderPass;
+	// owned by the pipeline library
 	Pipeline*                    m_pPipeline;
+	PipelineLibrary::Future      m_PipelineRequest;
+	// pipeline for reloaded shaders and the modules it replaced
+	PipelineLibrary::Future      m_ReloadRequest;
+	std::vector<Shader*>         m_ReplacedShaders;
+	// requests for shaders reloaded again before their pipeline was compiled
+	std::vector<PipelineLibrary::Future> m_SupersededRequests;
 	MemoryPool*                  m_pHostMemoryPool;
 	MemoryPool*                  m_pDeviceMemoryPool;
 	Buffer*                      m_pGeometryBuffer;
 	Buffer*                      m_pStagingBuffer;
-	Buffer*                      m_pUniformBuffer;
 	CommandPool*                 m_pCommandPool;
-	std::vector<CommandBuffer*>  m_CommandBuffers;
 	CommandBuffer*               m_pTransferCommandBuffer;
+	std::vector<Frame>           m_Frames;
+	uint32_t                     m_uCurrentFrame;
+	// number of presented frames
+	uint64_t                     m_uFrameNumber;
+	std::vector<RetiredObject>   m_RetiredObjects;
+	ParallelRecorder*            m_pParallelRecorder;
+	uint32_t                     m_uNumDraws;
+	uint32_t                     m_uNumInstances;
+	MemoryPool*                  m_pInstanceMemoryPool;
+	Buffer*                      m_pInstanceBuffer;
+	bool                         m_bIndirectDraws;
+	bool                         m_bParallelRecording;
+	// set by pass callbacks, which cannot return an error through the render graph
+	bool                         m_bRecordingFailed;
+	Mesh                         m_QuadMesh;
+	RenderQueue                  m_RenderQueue;
+	RenderQueue::Handle          m_uPipelineHandle;
+	RenderQueue::Handle          m_uQuadMeshHandle;
+	// replaced by the current frame's set every frame
+	RenderQueue::Handle          m_uSceneSetHandle;
+	glm::mat4                    m_ModelMatrix;
+	glm::mat4                    m_ModelViewProjection;
+	GpuCuller*                   m_pGpuCuller;
+	FrameCapture*                m_pFrameCapture;
 
 	std::chrono::high_resolution_clock::time_point m_TimerStart;
+
+	Profiler::clock_type::time_point m_InitStart;
+	bool                             m_bFirstFramePresented;
 };
 
 #endif // RENDERER_H
@@ -0,0 +1,863 @@
+#include "rendergraph.h"
+#include "renderer.h"
+#include "renderpass.h"
+#include "commandbuffer.h"
+#include "memorypool.h"
+#include "image.h"
+
+#include <algorithm>
+
+// stages and writes of the previous user of memory backing a graph image, either the
+// previous frame or an aliased image
+static constexpr VkPipelineStageFlags ALIASING_STAGES = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+static constexpr VkAccessFlags        ALIASING_ACCESS = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+static constexpr uint32_t INVALID_INDEX = ~0u;
+
+RenderGraph::PassBuilder::PassBuilder( RenderGraph& graph, Handle pass )
+    : m_pGraph( &graph ),
+      m_uPass( pass )
+{
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::colorAttachment( Handle image )
+{
+	m_pGraph->addAccess( m_uPass, { image, Usage::Color, false, VkClearValue{} } );
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::colorAttachment( Handle image,
+                                                                     const VkClearColorValue& clearValue )
+{
+	VkClearValue value;
+	value.color = clearValue;
+
+	m_pGraph->addAccess( m_uPass, { image, Usage::Color, true, value } );
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::depthAttachment( Handle image )
+{
+	m_pGraph->addAccess( m_uPass, { image, Usage::Depth, false, VkClearValue{} } );
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::depthAttachment( Handle image,
+                                                                     const VkClearDepthStencilValue& clearValue )
+{
+	VkClearValue value;
+	value.depthStencil = clearValue;
+
+	m_pGraph->addAccess( m_uPass, { image, Usage::Depth, true, value } );
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::inputAttachment( Handle image )
+{
+	m_pGraph->addAccess( m_uPass, { image, Usage::Input, false, VkClearValue{} } );
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::sampledImage( Handle image )
+{
+	m_pGraph->addAccess( m_uPass, { image, Usage::Sampled, false, VkClearValue{} } );
+	return *this;
+}
+
+RenderGraph::RenderGraph( Renderer& renderer )
+    : m_pRenderer( &renderer ),
+      m_vkExtent{ 0, 0 },
+      m_bCompiled( false ),
+      m_Images(),
+      m_Passes(),
+      m_PhysicalPasses(),
+      m_pImageMemory( nullptr )
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+	destroy();
+}
+
+void RenderGraph::destroy()
+{
+	destroyFramebuffers();
+
+	for( auto& physicalPass : m_PhysicalPasses )
+	{
+		safe_delete( physicalPass.pRenderPass );
+	}
+	m_PhysicalPasses.clear();
+
+	destroyImages();
+
+	m_bCompiled = false;
+}
+
+RenderGraph::Handle RenderGraph::importImage( const std::string& name,
+                                              VkFormat format,
+                                              VkImageLayout initialLayout,
+                                              VkImageLayout finalLayout )
+{
+	ImageResource image{};
+	image.name          = name;
+	image.format        = format;
+	image.imported      = true;
+	image.output        = false;
+	image.initialLayout = initialLayout;
+	image.finalLayout   = finalLayout;
+	image.vkView        = VK_NULL_HANDLE;
+
+	m_Images.push_back( image );
+	return ( m_Images.size() - 1 );
+}
+
+void RenderGraph::setImportedView( Handle image, VkImageView view )
+{
+	m_Images[ image ].vkView = view;
+}
+
+RenderGraph::Handle RenderGraph::createImage( const std::string& name, VkFormat format )
+{
+	ImageResource image{};
+	image.name          = name;
+	image.format        = format;
+	image.imported      = false;
+	image.output        = false;
+	image.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image.finalLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
+	image.vkView        = VK_NULL_HANDLE;
+
+	m_Images.push_back( image );
+	return ( m_Images.size() - 1 );
+}
+
+void RenderGraph::setOutput( Handle image )
+{
+	m_Images[ image ].output = true;
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass( const std::string& name,
+                                               ExecuteCallback::FunctionPtr callback,
+                                               void* userData )
+{
+	Pass pass{};
+	pass.name         = name;
+	pass.callback     = { callback, userData };
+	pass.contents     = VK_SUBPASS_CONTENTS_INLINE;
+	pass.active       = false;
+	pass.physicalPass = INVALID_INDEX;
+	pass.subpass      = 0;
+
+	m_Passes.push_back( pass );
+	return PassBuilder( *this, m_Passes.size() - 1 );
+}
+
+void RenderGraph::addAccess( Handle pass, const Access& access )
+{
+	m_Passes[ pass ].accesses.push_back( access );
+}
+
+bool RenderGraph::compile( VkExtent2D extent )
+{
+	destroy();
+
+	m_vkExtent = extent;
+
+	for( auto& image : m_Images )
+	{
+		image.usage             = 0;
+		image.firstPhysicalPass = INVALID_INDEX;
+		image.lastPhysicalPass  = 0;
+		image.transient         = !image.imported;
+		image.memoryOffset      = 0;
+	}
+
+	cullPasses();
+	mergePasses();
+
+	std::vector<ImageState> states( m_Images.size() );
+	for( auto i = 0; i < m_Images.size(); ++i )
+	{
+		const ImageResource& image = m_Images[ i ];
+		ImageState&          state = states[ i ];
+
+		if( image.imported )
+		{
+			// the image is acquired by a semaphore wait at the color attachment stage
+			state.layout      = image.initialLayout;
+			state.stages      = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			state.writeAccess = 0;
+			state.valid       = ( image.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED );
+		}
+		else
+		{
+			state.layout      = VK_IMAGE_LAYOUT_UNDEFINED;
+			state.stages      = ALIASING_STAGES;
+			state.writeAccess = ALIASING_ACCESS;
+			state.valid       = false;
+		}
+	}
+
+	for( auto i = 0; i < m_PhysicalPasses.size(); ++i )
+	{
+		if( !createRenderPass( i, states ) )
+		{
+			destroy();
+			return false;
+		}
+	}
+
+	if( !createImages() )
+	{
+		destroy();
+		return false;
+	}
+
+	uint32_t numActive = std::count_if( m_Passes.begin(), m_Passes.end(), []( const Pass& pass ) {
+		return pass.active;
+	} );
+
+	log_info( "Compiled render graph: " + std::to_string( numActive ) + " of " +
+	          std::to_string( m_Passes.size() ) + " passes in " +
+	          std::to_string( m_PhysicalPasses.size() ) + " render passes." );
+
+	m_bCompiled = true;
+	return true;
+}
+
+bool RenderGraph::resize( VkExtent2D extent )
+{
+	m_vkExtent = extent;
+
+	destroyFramebuffers();
+	destroyImages();
+
+	if( !m_bCompiled )
+		return true;
+
+	if( !createImages() )
+	{
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+RenderPass& RenderGraph::getRenderPass( Handle pass )
+{
+	return *m_PhysicalPasses[ m_Passes[ pass ].physicalPass ].pRenderPass;
+}
+
+void RenderGraph::setPassContents( Handle pass, VkSubpassContents contents )
+{
+	m_Passes[ pass ].contents = contents;
+}
+
+bool RenderGraph::execute( CommandBuffer& commandBuffer )
+{
+	if( !m_bCompiled )
+	{
+		log_error( "Cannot execute render graph before it was compiled." );
+		return false;
+	}
+
+	VkRect2D renderArea = { { 0, 0 }, m_vkExtent };
+
+	for( auto& physicalPass : m_PhysicalPasses )
+	{
+		VkFramebuffer framebuffer = getFramebuffer( physicalPass );
+		if( framebuffer == VK_NULL_HANDLE )
+			return false;
+
+		commandBuffer.beginRenderPass( *physicalPass.pRenderPass,
+		                               framebuffer,
+		                               renderArea,
+		                               physicalPass.clearValues.size(),
+		                               physicalPass.clearValues.data(),
+		                               m_Passes[ physicalPass.passes[ 0 ] ].contents );
+
+		for( auto i = 0; i < physicalPass.passes.size(); ++i )
+		{
+			Pass& pass = m_Passes[ physicalPass.passes[ i ] ];
+
+			if( i > 0 )
+			{
+				commandBuffer.nextSubpass( pass.contents );
+			}
+
+			if( pass.callback )
+			{
+				PassContext context{ physicalPass.pRenderPass, pass.subpass, framebuffer, renderArea };
+				pass.callback( commandBuffer, context );
+			}
+		}
+
+		commandBuffer.endRenderPass();
+	}
+	return true;
+}
+
+VkImageLayout RenderGraph::getLayout( Usage usage, VkFormat format )
+{
+	switch( usage )
+	{
+	case Usage::Color:
+		return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	case Usage::Depth:
+		return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	default:
+		return ( Image::isDepthFormat( format ) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+		                                        : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL );
+	}
+}
+
+VkPipelineStageFlags RenderGraph::getStages( Usage usage )
+{
+	switch( usage )
+	{
+	case Usage::Color:
+		return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	case Usage::Depth:
+		return ( VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+		         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT );
+	default:
+		return VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+}
+
+VkAccessFlags RenderGraph::getAccess( Usage usage )
+{
+	switch( usage )
+	{
+	case Usage::Color:
+		return ( VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT );
+	case Usage::Depth:
+		return ( VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+		         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT );
+	case Usage::Input:
+		return VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+	default:
+		return VK_ACCESS_SHADER_READ_BIT;
+	}
+}
+
+VkAccessFlags RenderGraph::getWriteAccess( Usage usage )
+{
+	switch( usage )
+	{
+	case Usage::Color:
+		return VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	case Usage::Depth:
+		return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	default:
+		return 0;
+	}
+}
+
+bool RenderGraph::readsContents( const Access& access )
+{
+	return !access.clear;
+}
+
+bool RenderGraph::isAttachment( Usage usage )
+{
+	return ( usage != Usage::Sampled );
+}
+
+void RenderGraph::cullPasses()
+{
+	// walk backwards from the outputs, a pass is needed if it writes a needed image
+	std::vector<bool> needed( m_Images.size(), false );
+	for( auto i = 0; i < m_Images.size(); ++i )
+	{
+		needed[ i ] = m_Images[ i ].output;
+	}
+
+	for( auto i = m_Passes.size(); i-- > 0; )
+	{
+		Pass& pass = m_Passes[ i ];
+
+		pass.active = std::any_of( pass.accesses.begin(), pass.accesses.end(), [ &needed ]( const Access& access ) {
+			return ( getWriteAccess( access.usage ) != 0 && needed[ access.image ] );
+		} );
+
+		if( !pass.active )
+		{
+			log_info( "Culling render graph pass: " + pass.name );
+			continue;
+		}
+
+		// cleared images do not depend on earlier writers
+		for( const auto& access : pass.accesses )
+		{
+			if( getWriteAccess( access.usage ) != 0 && !readsContents( access ) )
+			{
+				needed[ access.image ] = false;
+			}
+		}
+
+		for( const auto& access : pass.accesses )
+		{
+			if( readsContents( access ) )
+			{
+				needed[ access.image ] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::mergePasses()
+{
+	for( auto i = 0; i < m_Passes.size(); ++i )
+	{
+		Pass& pass = m_Passes[ i ];
+		if( !pass.active )
+			continue;
+
+		bool merge = !m_PhysicalPasses.empty();
+
+		if( merge )
+		{
+			// sampling requires the writer's render pass to end and vice versa
+			for( Handle index : m_PhysicalPasses.back().passes )
+			{
+				for( const auto& previous : m_Passes[ index ].accesses )
+				{
+					for( const auto& access : pass.accesses )
+					{
+						if( previous.image == access.image &&
+						    ( ( access.usage == Usage::Sampled && getWriteAccess( previous.usage ) != 0 ) ||
+						      ( previous.usage == Usage::Sampled && getWriteAccess( access.usage ) != 0 ) ) )
+						{
+							merge = false;
+						}
+					}
+				}
+			}
+		}
+
+		if( !merge )
+		{
+			m_PhysicalPasses.push_back( PhysicalPass{} );
+		}
+
+		PhysicalPass& physicalPass = m_PhysicalPasses.back();
+		physicalPass.passes.push_back( i );
+
+		pass.physicalPass = m_PhysicalPasses.size() - 1;
+		pass.subpass      = physicalPass.passes.size() - 1;
+
+		for( const auto& access : pass.accesses )
+		{
+			ImageResource& image    = m_Images[ access.image ];
+			image.firstPhysicalPass = std::min( image.firstPhysicalPass, pass.physicalPass );
+			image.lastPhysicalPass  = std::max( image.lastPhysicalPass, pass.physicalPass );
+		}
+	}
+
+	// contents of output images are needed after the graph, no later image may alias them
+	for( auto& image : m_Images )
+	{
+		if( image.output && image.firstPhysicalPass != INVALID_INDEX )
+		{
+			image.lastPhysicalPass = m_PhysicalPasses.size() - 1;
+		}
+	}
+}
+
+const RenderGraph::Access* RenderGraph::findNextAccess( Handle image, uint32_t physicalPass )
+{
+	for( auto i = physicalPass + 1; i < m_PhysicalPasses.size(); ++i )
+	{
+		for( Handle index : m_PhysicalPasses[ i ].passes )
+		{
+			for( const auto& access : m_Passes[ index ].accesses )
+			{
+				if( access.image == image )
+				{
+					return &access;
+				}
+			}
+		}
+	}
+	return nullptr;
+}
+
+bool RenderGraph::createRenderPass( uint32_t index, std::vector<ImageState>& states )
+{
+	struct Use
+	{
+		uint32_t      subpass;
+		const Access* pAccess;
+	};
+
+	PhysicalPass& physicalPass = m_PhysicalPasses[ index ];
+	uint32_t      numSubpasses = physicalPass.passes.size();
+
+	for( Handle pass : physicalPass.passes )
+	{
+		for( const auto& access : m_Passes[ pass ].accesses )
+		{
+			if( isAttachment( access.usage ) &&
+			    std::find( physicalPass.attachments.begin(),
+			               physicalPass.attachments.end(),
+			               access.image ) == physicalPass.attachments.end() )
+			{
+				physicalPass.attachments.push_back( access.image );
+			}
+		}
+	}
+
+	uint32_t numAttachments = physicalPass.attachments.size();
+
+	RenderPass::Composer  composer = RenderPass::compose();
+	std::vector<uint32_t> firstSubpasses( numAttachments );
+	std::vector<uint32_t> lastSubpasses( numAttachments );
+
+	physicalPass.clearValues.resize( numAttachments, VkClearValue{} );
+
+	for( auto i = 0; i < numAttachments; ++i )
+	{
+		Handle         handle = physicalPass.attachments[ i ];
+		ImageResource& image  = m_Images[ handle ];
+		ImageState&    state  = states[ handle ];
+
+		std::vector<Use> uses;
+		for( auto subpass = 0; subpass < numSubpasses; ++subpass )
+		{
+			for( const auto& access : m_Passes[ physicalPass.passes[ subpass ] ].accesses )
+			{
+				if( access.image == handle )
+				{
+					uses.push_back( { (uint32_t)subpass, &access } );
+				}
+			}
+		}
+
+		const Access& first = *uses.front().pAccess;
+		const Access& last  = *uses.back().pAccess;
+		const Access* pNext = findNextAccess( handle, index );
+
+		bool load  = ( readsContents( first ) && state.valid );
+		bool store = ( image.output || ( pNext != nullptr && readsContents( *pNext ) ) );
+
+		VkAttachmentLoadOp  loadOp  = first.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
+		                                          : ( load ? VK_ATTACHMENT_LOAD_OP_LOAD
+		                                                   : VK_ATTACHMENT_LOAD_OP_DONT_CARE );
+		VkAttachmentStoreOp storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE
+		                                    : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		VkImageLayout finalLayout = getLayout( last.usage, image.format );
+		if( pNext != nullptr && pNext->usage == Usage::Sampled )
+		{
+			finalLayout = getLayout( Usage::Sampled, image.format );
+		}
+		else if( pNext == nullptr && image.imported && image.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED )
+		{
+			finalLayout = image.finalLayout;
+		}
+
+		composer.attachment( image.format,
+		                     loadOp,
+		                     storeOp,
+		                     load ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED,
+		                     finalLayout );
+
+		if( first.clear )
+		{
+			physicalPass.clearValues[ i ] = first.clearValue;
+		}
+
+		// previous writer or reader, also covers the transition out of the old layout
+		composer.dependency( VK_SUBPASS_EXTERNAL,
+		                     uses.front().subpass,
+		                     state.stages,
+		                     state.writeAccess,
+		                     getStages( first.usage ),
+		                     getAccess( first.usage ) );
+
+		for( auto u = 1; u < uses.size(); ++u )
+		{
+			const Use& previous = uses[ u - 1 ];
+			const Use& current  = uses[ u ];
+
+			if( previous.subpass != current.subpass &&
+			    ( getWriteAccess( previous.pAccess->usage ) != 0 ||
+			      getWriteAccess( current.pAccess->usage ) != 0 ) )
+			{
+				composer.dependency( previous.subpass,
+				                     current.subpass,
+				                     getStages( previous.pAccess->usage ),
+				                     getWriteAccess( previous.pAccess->usage ),
+				                     getStages( current.pAccess->usage ),
+				                     getAccess( current.pAccess->usage ) );
+			}
+		}
+
+		if( pNext != nullptr && pNext->usage == Usage::Sampled )
+		{
+			composer.dependency( uses.back().subpass,
+			                     VK_SUBPASS_EXTERNAL,
+			                     getStages( last.usage ),
+			                     getWriteAccess( last.usage ),
+			                     getStages( Usage::Sampled ),
+			                     getAccess( Usage::Sampled ) );
+		}
+
+		firstSubpasses[ i ] = uses.front().subpass;
+		lastSubpasses[ i ]  = uses.back().subpass;
+
+		if( load || store )
+		{
+			image.transient = false;
+		}
+
+		state.layout      = finalLayout;
+		state.stages      = getStages( last.usage );
+		state.writeAccess = getWriteAccess( last.usage );
+		state.valid       = store;
+	}
+
+	for( auto subpass = 0; subpass < numSubpasses; ++subpass )
+	{
+		const Pass& pass = m_Passes[ physicalPass.passes[ subpass ] ];
+
+		composer.subpass();
+
+		for( const auto& access : pass.accesses )
+		{
+			ImageResource& image = m_Images[ access.image ];
+
+			uint32_t attachment = std::find( physicalPass.attachments.begin(),
+			                                 physicalPass.attachments.end(),
+			                                 access.image ) - physicalPass.attachments.begin();
+
+			switch( access.usage )
+			{
+			case Usage::Color:
+				composer.colorAttachment( attachment );
+				image.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+				break;
+			case Usage::Depth:
+				composer.depthAttachment( attachment );
+				image.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+				break;
+			case Usage::Input:
+				composer.inputAttachment( attachment );
+				image.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+				break;
+			case Usage::Sampled:
+				image.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+				image.transient = false;
+
+				// made visible by the outgoing dependency of the writer's render pass
+				states[ access.image ].stages      = getStages( Usage::Sampled );
+				states[ access.image ].writeAccess = 0;
+				break;
+			}
+		}
+
+		// keep the contents alive through subpasses not using the attachment
+		for( auto i = 0; i < numAttachments; ++i )
+		{
+			bool used = std::any_of( pass.accesses.begin(), pass.accesses.end(), [ & ]( const Access& access ) {
+				return ( access.image == physicalPass.attachments[ i ] );
+			} );
+
+			if( !used && firstSubpasses[ i ] < subpass && subpass < lastSubpasses[ i ] )
+			{
+				composer.preserveAttachment( i );
+			}
+		}
+	}
+
+	physicalPass.pRenderPass = new RenderPass( *m_pRenderer, composer );
+	return physicalPass.pRenderPass->isValid();
+}
+
+bool RenderGraph::createImages()
+{
+	struct Placement
+	{
+		Handle   image;
+		uint64_t size;
+		uint64_t alignment;
+	};
+
+	std::vector<Placement> placements;
+	uint32_t               typeFilter = ~0u;
+
+	for( auto i = 0; i < m_Images.size(); ++i )
+	{
+		ImageResource& image = m_Images[ i ];
+		if( image.imported || image.firstPhysicalPass == INVALID_INDEX )
+			continue;
+
+		VkImageUsageFlags usage = image.usage;
+		if( image.transient )
+		{
+			// contents never leave the render pass, may live in tile memory only
+			usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+
+		image.pImage = new Image( *m_pRenderer, image.format, m_vkExtent, usage );
+		if( !image.pImage->isValid() )
+		{
+			log_error( "Cannot create render graph image: " + image.name );
+			return false;
+		}
+
+		Placement placement{ (Handle)i, 0, 0 };
+		uint32_t  filter;
+		image.pImage->getMemoryRequirements( &placement.alignment, &filter, &placement.size );
+
+		typeFilter &= filter;
+		placements.push_back( placement );
+	}
+
+	if( placements.empty() )
+		return true;
+
+	// largest first, each at the lowest offset not overlapping a placed image whose
+	// lifetime overlaps its own
+	std::sort( placements.begin(), placements.end(), []( const Placement& a, const Placement& b ) {
+		return ( a.size > b.size );
+	} );
+
+	uint64_t memorySize   = 0;
+	uint64_t requiredSize = 0;
+
+	for( auto i = 0; i < placements.size(); ++i )
+	{
+		ImageResource& image  = m_Images[ placements[ i ].image ];
+		uint64_t       size   = placements[ i ].size;
+		uint64_t       offset = 0;
+
+		bool overlaps = true;
+		while( overlaps )
+		{
+			overlaps = false;
+
+			for( auto j = 0; j < i; ++j )
+			{
+				const ImageResource& other     = m_Images[ placements[ j ].image ];
+				uint64_t             otherSize = placements[ j ].size;
+
+				bool alive = ( other.firstPhysicalPass <= image.lastPhysicalPass &&
+				               image.firstPhysicalPass <= other.lastPhysicalPass );
+
+				if( alive && offset < other.memoryOffset + otherSize && other.memoryOffset < offset + size )
+				{
+					uint64_t alignment = placements[ i ].alignment;
+					offset   = ( other.memoryOffset + otherSize + alignment - 1 ) / alignment * alignment;
+					overlaps = true;
+				}
+			}
+		}
+
+		image.memoryOffset = offset;
+		memorySize         = std::max( memorySize, offset + size );
+		requiredSize      += size;
+	}
+
+	m_pImageMemory = new MemoryPool( *m_pRenderer,
+	                                 memorySize,
+	                                 typeFilter,
+	                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+	if( !m_pImageMemory->isValid() )
+	{
+		log_error( "Cannot allocate render graph image memory." );
+		return false;
+	}
+
+	for( const auto& placement : placements )
+	{
+		ImageResource& image = m_Images[ placement.image ];
+		if( !image.pImage->bindMemory( *m_pImageMemory, image.memoryOffset ) )
+		{
+			log_error( "Cannot bind render graph image memory: " + image.name );
+			return false;
+		}
+	}
+
+	log_info( "Render graph images use " + std::to_string( memorySize ) + " of " +
+	          std::to_string( requiredSize ) + " bytes after aliasing." );
+
+	return true;
+}
+
+void RenderGraph::destroyImages()
+{
+	for( auto& image : m_Images )
+	{
+		safe_delete( image.pImage );
+	}
+	safe_delete( m_pImageMemory );
+}
+
+void RenderGraph::destroyFramebuffers()
+{
+	VkDevice device = m_pRenderer->getNativeDeviceHandle();
+
+	for( auto& physicalPass : m_PhysicalPasses )
+	{
+		for( auto& entry : physicalPass.framebuffers )
+		{
+			vkDestroyFramebuffer( device, entry.second, nullptr );
+		}
+		physicalPass.framebuffers.clear();
+	}
+}
+
+VkFramebuffer RenderGraph::getFramebuffer( PhysicalPass& physicalPass )
+{
+	std::vector<VkImageView> views( physicalPass.attachments.size() );
+	for( auto i = 0; i < views.size(); ++i )
+	{
+		const ImageResource& image = m_Images[ physicalPass.attachments[ i ] ];
+
+		views[ i ] = image.imported ? image.vkView : image.pImage->getView();
+		if( views[ i ] == VK_NULL_HANDLE )
+		{
+			log_error( "Render graph image has no view: " + image.name );
+			return VK_NULL_HANDLE;
+		}
+	}
+
+	auto it = physicalPass.framebuffers.find( views );
+	if( it != physicalPass.framebuffers.end() )
+	{
+		return it->second;
+	}
+
+	VkFramebufferCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	createInfo.pNext           = nullptr;
+	createInfo.flags           = 0;
+	createInfo.renderPass      = physicalPass.pRenderPass->getNativeHandle();
+	createInfo.attachmentCount = views.size();
+	createInfo.pAttachments    = views.data();
+	createInfo.width           = m_vkExtent.width;
+	createInfo.height          = m_vkExtent.height;
+	createInfo.layers          = 1;
+
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	VkResult      res         = vkCreateFramebuffer( m_pRenderer->getNativeDeviceHandle(),
+	                                                 &createInfo,
+	                                                 nullptr,
+	                                                 &framebuffer );
+
+	if( res != VK_SUCCESS )
+	{
+		log_error( "Cannot create render graph framebuffer." );
+		return VK_NULL_HANDLE;
+	}
+
+	physicalPass.framebuffers.emplace( views, framebuffer );
+	return framebuffer;
+}
@@ -0,0 +1,222 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include "common.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+#include <string>
+
+class Renderer;
+class RenderPass;
+class CommandBuffer;
+class MemoryPool;
+class Image;
+
+// Frame graph of graphics passes declaring the images they read and write. Compiling
+// the graph
+//  - culls passes that do not contribute to an output image,
+//  - merges consecutive passes into subpasses of one render pass unless a pass samples
+//    an image written within the render pass,
+//  - derives load/store ops, layout transitions and subpass dependencies from the
+//    declared accesses, so no barriers have to be recorded by hand,
+//  - places transient images with disjoint lifetimes in the same memory.
+// All attachments share the extent given to compile().
+class RenderGraph
+{
+public:
+	typedef uint32_t Handle;
+
+	static constexpr Handle INVALID_HANDLE = ~(Handle)0;
+
+	// where the commands of a pass are recorded, e.g. for secondary command buffers
+	struct PassContext
+	{
+		RenderPass*   pRenderPass;
+		uint32_t      subpass;
+		VkFramebuffer framebuffer;
+		VkRect2D      renderArea;
+	};
+
+	// records the commands of a pass inside its subpass
+	typedef PayloadCallback<void*, void, CommandBuffer&, const PassContext&> ExecuteCallback;
+
+	class PassBuilder
+	{
+	friend class RenderGraph;
+
+	public:
+		// attachments without a clear value keep the image's previous contents
+		PassBuilder& colorAttachment( Handle image );
+		PassBuilder& colorAttachment( Handle image, const VkClearColorValue& clearValue );
+		PassBuilder& depthAttachment( Handle image );
+		PassBuilder& depthAttachment( Handle image, const VkClearDepthStencilValue& clearValue );
+
+		// reads the pixel written by an earlier pass at the same location, allows merging
+		PassBuilder& inputAttachment( Handle image );
+		// reads arbitrary pixels in the fragment shader, ends the render pass of the writer
+		PassBuilder& sampledImage( Handle image );
+
+		Handle       getHandle()
+		{
+			return m_uPass;
+		}
+
+	private:
+		PassBuilder( RenderGraph& graph, Handle pass );
+
+	private:
+		RenderGraph* m_pGraph;
+		Handle       m_uPass;
+	};
+
+private:
+	enum class Usage
+	{
+		Color,
+		Depth,
+		Input,
+		Sampled
+	};
+
+	struct Access
+	{
+		Handle       image;
+		Usage        usage;
+		bool         clear;
+		VkClearValue clearValue;
+	};
+
+	struct ImageResource
+	{
+		std::string       name;
+		VkFormat          format;
+		bool              imported;
+		bool              output;
+		VkImageLayout     initialLayout;
+		VkImageLayout     finalLayout;
+		VkImageView       vkView;
+
+		// derived by compile()
+		VkImageUsageFlags usage;
+		uint32_t          firstPhysicalPass;
+		uint32_t          lastPhysicalPass;
+		bool              transient;
+		Image*            pImage;
+		uint64_t          memoryOffset;
+	};
+
+	struct Pass
+	{
+		std::string         name;
+		ExecuteCallback     callback;
+		std::vector<Access> accesses;
+		VkSubpassContents   contents;
+
+		// derived by compile()
+		bool                active;
+		uint32_t            physicalPass;
+		uint32_t            subpass;
+	};
+
+	struct PhysicalPass
+	{
+		std::vector<Handle>       passes;
+		std::vector<Handle>       attachments;
+		std::vector<VkClearValue> clearValues;
+		RenderPass*               pRenderPass;
+
+		// keyed by attachment views, imported views change between frames
+		std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+	};
+
+	// synchronization state of an image between render passes
+	struct ImageState
+	{
+		VkImageLayout        layout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags        writeAccess;
+		bool                 valid;
+	};
+
+public:
+	RenderGraph( Renderer& renderer );
+	~RenderGraph();
+
+	void         destroy();
+
+	// images owned elsewhere, e.g. swap chain images; their view is set per frame
+	Handle       importImage( const std::string& name,
+	                          VkFormat format,
+	                          VkImageLayout initialLayout,
+	                          VkImageLayout finalLayout );
+	void         setImportedView( Handle image, VkImageView view );
+
+	// images owned by the graph
+	Handle       createImage( const std::string& name, VkFormat format );
+
+	// images whose contents are needed after the graph executed
+	void         setOutput( Handle image );
+
+	PassBuilder  addPass( const std::string& name,
+	                      ExecuteCallback::FunctionPtr callback,
+	                      void* userData );
+
+	bool         compile( VkExtent2D extent );
+
+	// recreates the graph's images and drops all framebuffers, has to be called whenever
+	// imported views are destroyed
+	bool         resize( VkExtent2D extent );
+
+	bool         isPassActive( Handle pass )
+	{
+		return m_Passes[ pass ].active;
+	}
+	RenderPass&  getRenderPass( Handle pass );
+	uint32_t     getSubpass( Handle pass )
+	{
+		return m_Passes[ pass ].subpass;
+	}
+
+	// contents of the pass' subpass, may change between executions
+	void         setPassContents( Handle pass, VkSubpassContents contents );
+
+	bool         execute( CommandBuffer& commandBuffer );
+
+private:
+	static VkImageLayout        getLayout( Usage usage, VkFormat format );
+	static VkPipelineStageFlags getStages( Usage usage );
+	static VkAccessFlags        getAccess( Usage usage );
+	static VkAccessFlags        getWriteAccess( Usage usage );
+
+	static bool                 readsContents( const Access& access );
+	static bool                 isAttachment( Usage usage );
+
+	void         addAccess( Handle pass, const Access& access );
+
+	void         cullPasses();
+	void         mergePasses();
+	bool         createRenderPass( uint32_t index, std::vector<ImageState>& states );
+	bool         createImages();
+	void         destroyImages();
+	void         destroyFramebuffers();
+
+	VkFramebuffer getFramebuffer( PhysicalPass& physicalPass );
+
+	// first access to the image in a pass after the given physical pass, nullptr if none
+	const Access* findNextAccess( Handle image, uint32_t physicalPass );
+
+private:
+	Renderer*                  m_pRenderer;
+	VkExtent2D                 m_vkExtent;
+	bool                       m_bCompiled;
+
+	std::vector<ImageResource> m_Images;
+	std::vector<Pass>          m_Passes;
+	std::vector<PhysicalPass>  m_PhysicalPasses;
+
+	MemoryPool*                m_pImageMemory;
+};
+
+#endif // RENDERGRAPH_H
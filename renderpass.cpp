@@ -1,59 +1,335 @@
 #include "renderpass.h"
 #include "renderer.h"
+#include "image.h"
+
+RenderPass::Composer::Composer()
+    : m_vkAttachments(),
+      m_Subpasses(),
+      m_vkSubpasses(),
+      m_vkDependencies(),
+      m_vkCreateInfo{}
+{
+}
+
+RenderPass::Composer& RenderPass::Composer::attachment( VkFormat format,
+                                                        VkAttachmentLoadOp loadOp,
+                                                        VkAttachmentStoreOp storeOp,
+                                                        VkImageLayout initialLayout,
+                                                        VkImageLayout finalLayout )
+{
+	bool stencil = Image::hasStencil( format );
+
+	VkAttachmentDescription attachment{};
+	attachment.flags          = 0;
+	attachment.format         = format;
+	attachment.samples        = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp         = loadOp;
+	attachment.storeOp        = storeOp;
+	attachment.stencilLoadOp  = stencil ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = stencil ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout  = initialLayout;
+	attachment.finalLayout    = finalLayout;
+
+	m_vkAttachments.emplace_back( attachment );
+
+	return *this;
+}
+
+RenderPass::Composer& RenderPass::Composer::transientAttachment( VkFormat format,
+                                                                 VkAttachmentLoadOp loadOp )
+{
+	return attachment( format,
+	                   loadOp,
+	                   VK_ATTACHMENT_STORE_OP_DONT_CARE,
+	                   VK_IMAGE_LAYOUT_UNDEFINED,
+	                   VK_IMAGE_LAYOUT_UNDEFINED );
+}
+
+RenderPass::Composer& RenderPass::Composer::samples( VkSampleCountFlagBits samples )
+{
+	if( m_vkAttachments.empty() )
+	{
+		log_error( "Ignoring sample count declared before any attachment." );
+		return *this;
+	}
+
+	m_vkAttachments.back().samples = samples;
+	return *this;
+}
+
+RenderPass::Composer& RenderPass::Composer::subpass()
+{
+	Subpass subpass{};
+	subpass.hasDepth = false;
+
+	m_Subpasses.emplace_back( subpass );
+
+	return *this;
+}
+
+RenderPass::Composer& RenderPass::Composer::colorAttachment( uint32_t attachment )
+{
+	return colorAttachment( attachment, VK_ATTACHMENT_UNUSED );
+}
+
+RenderPass::Composer& RenderPass::Composer::colorAttachment( uint32_t attachment,
+                                                             uint32_t resolveAttachment )
+{
+	Subpass& subpass = currentSubpass();
+	subpass.colors.push_back( { attachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL } );
+	subpass.resolves.push_back( { resolveAttachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL } );
+
+	return *this;
+}
+
+RenderPass::Composer& RenderPass::Composer::depthAttachment( uint32_t attachment )
+{
+	Subpass& subpass = currentSubpass();
+	subpass.depth    = { attachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+	subpass.hasDepth = true;
+
+	return *this;
+}
+
+RenderPass::Composer& RenderPass::Composer::inputAttachment( uint32_t attachment )
+{
+	VkImageLayout layout = Image::isDepthFormat( m_vkAttachments[ attachment ].format )
+	                       ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+	                       : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	currentSubpass().inputs.push_back( { attachment, layout } );
+
+	return *this;
+}
+
+RenderPass::Composer& RenderPass::Composer::preserveAttachment( uint32_t attachment )
+{
+	currentSubpass().preserves.push_back( attachment );
+	return *this;
+}
+
+RenderPass::Composer& RenderPass::Composer::dependency( uint32_t srcSubpass,
+                                                        uint32_t dstSubpass,
+                                                        VkPipelineStageFlags srcStages,
+                                                        VkAccessFlags srcAccess,
+                                                        VkPipelineStageFlags dstStages,
+                                                        VkAccessFlags dstAccess )
+{
+	for( auto& dependency : m_vkDependencies )
+	{
+		if( dependency.srcSubpass == srcSubpass && dependency.dstSubpass == dstSubpass )
+		{
+			dependency.srcStageMask  |= srcStages;
+			dependency.srcAccessMask |= srcAccess;
+			dependency.dstStageMask  |= dstStages;
+			dependency.dstAccessMask |= dstAccess;
+			return *this;
+		}
+	}
+
+	bool internal = ( srcSubpass != VK_SUBPASS_EXTERNAL && dstSubpass != VK_SUBPASS_EXTERNAL );
+
+	VkSubpassDependency dependency{};
+	dependency.srcSubpass      = srcSubpass;
+	dependency.dstSubpass      = dstSubpass;
+	dependency.srcStageMask    = srcStages;
+	dependency.srcAccessMask   = srcAccess;
+	dependency.dstStageMask    = dstStages;
+	dependency.dstAccessMask   = dstAccess;
+	dependency.dependencyFlags = internal ? VK_DEPENDENCY_BY_REGION_BIT : 0;
+
+	m_vkDependencies.emplace_back( dependency );
+
+	return *this;
+}
+
+RenderPass::Composer::Subpass& RenderPass::Composer::currentSubpass()
+{
+	if( m_Subpasses.empty() )
+	{
+		subpass();
+	}
+	return m_Subpasses.back();
+}
+
+const VkRenderPassCreateInfo& RenderPass::Composer::getCreateInfo()
+{
+	m_vkSubpasses.resize( m_Subpasses.size() );
+
+	for( auto i = 0; i < m_Subpasses.size(); ++i )
+	{
+		Subpass&              subpass     = m_Subpasses[ i ];
+		VkSubpassDescription& description = m_vkSubpasses[ i ];
+
+		bool resolve = false;
+		for( const auto& reference : subpass.resolves )
+		{
+			resolve |= ( reference.attachment != VK_ATTACHMENT_UNUSED );
+		}
+
+		description.flags                   = 0;
+		description.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		description.inputAttachmentCount    = subpass.inputs.size();
+		description.pInputAttachments       = subpass.inputs.data();
+		description.colorAttachmentCount    = subpass.colors.size();
+		description.pColorAttachments       = subpass.colors.data();
+		description.pResolveAttachments     = resolve ? subpass.resolves.data() : nullptr;
+		description.pDepthStencilAttachment = subpass.hasDepth ? &subpass.depth : nullptr;
+		description.preserveAttachmentCount = subpass.preserves.size();
+		description.pPreserveAttachments    = subpass.preserves.data();
+	}
+
+	// later subpasses overwrite the layouts of earlier ones
+	std::vector<VkImageLayout> lastLayouts( m_vkAttachments.size(), VK_IMAGE_LAYOUT_UNDEFINED );
+	for( const auto& subpass : m_Subpasses )
+	{
+		for( const auto& reference : subpass.inputs )
+		{
+			lastLayouts[ reference.attachment ] = reference.layout;
+		}
+		for( const auto& reference : subpass.colors )
+		{
+			lastLayouts[ reference.attachment ] = reference.layout;
+		}
+		for( const auto& reference : subpass.resolves )
+		{
+			if( reference.attachment != VK_ATTACHMENT_UNUSED )
+			{
+				lastLayouts[ reference.attachment ] = reference.layout;
+			}
+		}
+		if( subpass.hasDepth )
+		{
+			lastLayouts[ subpass.depth.attachment ] = subpass.depth.layout;
+		}
+	}
+
+	for( auto i = 0; i < m_vkAttachments.size(); ++i )
+	{
+		if( m_vkAttachments[ i ].finalLayout == VK_IMAGE_LAYOUT_UNDEFINED )
+		{
+			m_vkAttachments[ i ].finalLayout = lastLayouts[ i ];
+		}
+	}
+
+	m_vkCreateInfo = VkRenderPassCreateInfo{};
+	m_vkCreateInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	m_vkCreateInfo.pNext           = nullptr;
+	m_vkCreateInfo.flags           = 0;
+	m_vkCreateInfo.attachmentCount = m_vkAttachments.size();
+	m_vkCreateInfo.pAttachments    = m_vkAttachments.data();
+	m_vkCreateInfo.subpassCount    = m_vkSubpasses.size();
+	m_vkCreateInfo.pSubpasses      = m_vkSubpasses.data();
+	m_vkCreateInfo.dependencyCount = m_vkDependencies.size();
+	m_vkCreateInfo.pDependencies   = m_vkDependencies.data();
+
+	return m_vkCreateInfo;
+}
+
+
+RenderPass::RenderPass()
+    : m_pRenderer( nullptr ),
+      m_uCompatibilityHash( 0 )
+{
+}
 
 RenderPass::RenderPass( Renderer& renderer, VkFormat format )
-    : wrapper_type( renderer.getNativeDeviceHandle() )
-{
-	m_pRenderer = &renderer;
-
-	VkAttachmentDescription colorAttachment{};
-	colorAttachment.flags          = 0;
-	colorAttachment.format         = format;
-	colorAttachment.samples        = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentReference colorAttachmentRef{};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass{};
-	subpass.flags                   = 0;
-	subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.inputAttachmentCount    = 0;
-	subpass.pInputAttachments       = nullptr;
-	subpass.colorAttachmentCount    = 1;
-	subpass.pColorAttachments       = &colorAttachmentRef;
-	subpass.pResolveAttachments     = nullptr;
-	subpass.pDepthStencilAttachment = nullptr;
-	subpass.preserveAttachmentCount = 0;
-	subpass.pPreserveAttachments    = nullptr;
-
-	VkSubpassDependency dependency{}; // TODO: not always required,
-	                                  //       introduce a way to define dependencies
-	dependency.srcSubpass      = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass      = 0;
-	dependency.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask   = 0;
-	dependency.dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
-	                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	dependency.dependencyFlags = 0;
-
-	VkRenderPassCreateInfo createInfo{};
-	createInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	createInfo.pNext           = nullptr;
-	createInfo.flags           = 0;
-	createInfo.attachmentCount = 1;
-	createInfo.pAttachments    = &colorAttachment;
-	createInfo.subpassCount    = 1;
-	createInfo.pSubpasses      = &subpass;
-	createInfo.dependencyCount = 1;
-	createInfo.pDependencies   = &dependency;
+    : wrapper_type( renderer.getNativeDeviceHandle() ),
+      m_pRenderer( &renderer ),
+      m_uCompatibilityHash( 0 )
+{
+	Composer composer = compose()
+	        .attachment( format,
+	                     VK_ATTACHMENT_LOAD_OP_CLEAR,
+	                     VK_ATTACHMENT_STORE_OP_STORE,
+	                     VK_IMAGE_LAYOUT_UNDEFINED,
+	                     VK_IMAGE_LAYOUT_PRESENT_SRC_KHR )
+	        .subpass()
+	        .colorAttachment( 0 )
+	        .dependency( VK_SUBPASS_EXTERNAL,
+	                     0,
+	                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+	                     0,
+	                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+	                     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+	                     VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT );
+
+	if( !createRenderPass( composer.getCreateInfo() ) )
+	{
+		destroy();
+	}
+}
+
+RenderPass::RenderPass( Renderer& renderer, Composer& composer )
+    : wrapper_type( renderer.getNativeDeviceHandle() ),
+      m_pRenderer( &renderer ),
+      m_uCompatibilityHash( 0 )
+{
+	if( !createRenderPass( composer.getCreateInfo() ) )
+	{
+		destroy();
+	}
+}
+
+RenderPass::Composer RenderPass::compose()
+{
+	return Composer();
+}
+
+uint64_t RenderPass::computeCompatibilityHash( const VkRenderPassCreateInfo& createInfo )
+{
+	// references are compatible if the referenced attachments match in format and sample
+	// count, everything else except layouts and load/store ops has to be identical
+	uint64_t hash = hash_bytes( &createInfo.subpassCount, sizeof( createInfo.subpassCount ) );
+
+	auto hashReferences = [ & ]( const VkAttachmentReference* references, uint32_t count ) {
+		hash = hash_bytes( &count, sizeof( count ), hash );
+
+		for( auto i = 0; i < count; ++i )
+		{
+			VkFormat              format  = VK_FORMAT_UNDEFINED;
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+			if( references[ i ].attachment != VK_ATTACHMENT_UNUSED )
+			{
+				format  = createInfo.pAttachments[ references[ i ].attachment ].format;
+				samples = createInfo.pAttachments[ references[ i ].attachment ].samples;
+			}
+
+			hash = hash_bytes( &format, sizeof( format ), hash );
+			hash = hash_bytes( &samples, sizeof( samples ), hash );
+		}
+	};
+
+	for( auto i = 0; i < createInfo.subpassCount; ++i )
+	{
+		const VkSubpassDescription& subpass = createInfo.pSubpasses[ i ];
+
+		hash = hash_bytes( &subpass.flags, sizeof( subpass.flags ), hash );
+		hash = hash_bytes( &subpass.pipelineBindPoint, sizeof( subpass.pipelineBindPoint ), hash );
+
+		hashReferences( subpass.pInputAttachments, subpass.inputAttachmentCount );
+		hashReferences( subpass.pColorAttachments, subpass.colorAttachmentCount );
+		hashReferences( subpass.pResolveAttachments,
+		                subpass.pResolveAttachments != nullptr ? subpass.colorAttachmentCount : 0 );
+		hashReferences( subpass.pDepthStencilAttachment,
+		                subpass.pDepthStencilAttachment != nullptr ? 1 : 0 );
+
+		hash = hash_bytes( subpass.pPreserveAttachments,
+		                   subpass.preserveAttachmentCount * sizeof( uint32_t ),
+		                   hash );
+	}
+
+	hash = hash_bytes( createInfo.pDependencies,
+	                   createInfo.dependencyCount * sizeof( VkSubpassDependency ),
+	                   hash );
+
+	return hash;
+}
+
+bool RenderPass::createRenderPass( const VkRenderPassCreateInfo& createInfo )
+{
+	m_uCompatibilityHash = computeCompatibilityHash( createInfo );
 
 	VkResult res = vkCreateRenderPass( m_vkDevice,
 	                                   &createInfo,
@@ -63,6 +339,7 @@ RenderPass::RenderPass( Renderer& renderer, VkFormat format )
 	if( res != VK_SUCCESS )
 	{
 		log_error( "Cannot create render pass." );
-		destroy();
+		return false;
 	}
+	return true;
 }
@@ -5,22 +5,103 @@
 #include "vulkanobjectwrapper.h"
 
 #include <vulkan/vulkan.h>
+#include <vector>
 
 class Renderer;
 
 class RenderPass : public VulkanObjectWrapper<VkRenderPass, vkDestroyRenderPass>
 {
 public:
-	RenderPass() = default;
+	// Attachments and subpasses are numbered in declaration order. Attachment references
+	// are added to the subpass declared last, or to an implicit first subpass if none was.
+	class Composer
+	{
+	public:
+		Composer();
+
+		// stencil ops follow the given ops for formats with a stencil aspect
+		Composer& attachment( VkFormat format,
+		                      VkAttachmentLoadOp loadOp,
+		                      VkAttachmentStoreOp storeOp,
+		                      VkImageLayout initialLayout,
+		                      VkImageLayout finalLayout );
+
+		// contents only live within the render pass, e.g. G-buffer data consumed by
+		// a later subpass; they are never loaded or stored, so tilers keep them on-chip
+		Composer& transientAttachment( VkFormat format, VkAttachmentLoadOp loadOp );
+
+		// sample count of the attachment declared last
+		Composer& samples( VkSampleCountFlagBits samples );
+
+		Composer& subpass();
+
+		Composer& colorAttachment( uint32_t attachment );
+		// resolves the multisampled color attachment at the end of the subpass
+		Composer& colorAttachment( uint32_t attachment, uint32_t resolveAttachment );
+		Composer& depthAttachment( uint32_t attachment );
+		Composer& inputAttachment( uint32_t attachment );
+		Composer& preserveAttachment( uint32_t attachment );
+
+		// dependencies between the same pair of subpasses are combined, dependencies
+		// between two subpasses are by region
+		Composer& dependency( uint32_t srcSubpass,
+		                      uint32_t dstSubpass,
+		                      VkPipelineStageFlags srcStages,
+		                      VkAccessFlags srcAccess,
+		                      VkPipelineStageFlags dstStages,
+		                      VkAccessFlags dstAccess );
+
+		// final layouts left undefined become the layout of the attachment's last use
+		const VkRenderPassCreateInfo& getCreateInfo();
+
+	private:
+		struct Subpass
+		{
+			std::vector<VkAttachmentReference> colors;
+			std::vector<VkAttachmentReference> resolves;
+			std::vector<VkAttachmentReference> inputs;
+			VkAttachmentReference              depth;
+			bool                               hasDepth;
+			std::vector<uint32_t>              preserves;
+		};
+
+	private:
+		Subpass& currentSubpass();
+
+	private:
+		std::vector<VkAttachmentDescription> m_vkAttachments;
+		std::vector<Subpass>                 m_Subpasses;
+		std::vector<VkSubpassDescription>    m_vkSubpasses;
+		std::vector<VkSubpassDependency>     m_vkDependencies;
+		VkRenderPassCreateInfo               m_vkCreateInfo;
+	};
+
+public:
+	RenderPass();
 	RenderPass( Renderer& renderer, VkFormat format );
+	RenderPass( Renderer& renderer, Composer& composer );
+
+	static Composer compose();
 
 	Renderer& getRenderer()
 	{
 		return *m_pRenderer;
 	}
 
+	// equal for compatible render passes, which can share pipelines and framebuffers
+	uint64_t  getCompatibilityHash()
+	{
+		return m_uCompatibilityHash;
+	}
+
+private:
+	static uint64_t computeCompatibilityHash( const VkRenderPassCreateInfo& createInfo );
+
+	bool createRenderPass( const VkRenderPassCreateInfo& createInfo );
+
 private:
 	Renderer* m_pRenderer;
+	uint64_t  m_uCompatibilityHash;
 };
 
 #endif // RENDERPASS_H
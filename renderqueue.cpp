@@ -0,0 +1,394 @@
+#include "renderqueue.h"
+#include "commandbuffer.h"
+#include "pipeline.h"
+#include "descriptorset.h"
+#include "buffer.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+RenderQueue::RenderQueue()
+    : m_Pipelines(),
+      m_DescriptorSets(),
+      m_Meshes(),
+      m_Items(),
+      m_Keys(),
+      m_Order(),
+      m_TempKeys(),
+      m_TempOrder()
+{
+}
+
+RenderQueue::Handle RenderQueue::registerPipeline( Pipeline& pipeline )
+{
+	if( m_Pipelines.size() >= ( 1u << PIPELINE_BITS ) )
+	{
+		log_error( "Cannot register more pipelines in render queue." );
+		return INVALID_HANDLE;
+	}
+
+	m_Pipelines.push_back( { &pipeline, PipelineLibrary::Future(), nullptr } );
+	return m_Pipelines.size() - 1;
+}
+
+RenderQueue::Handle RenderQueue::registerPipeline( const PipelineLibrary::Future& request,
+                                                   Pipeline* fallback )
+{
+	if( m_Pipelines.size() >= ( 1u << PIPELINE_BITS ) )
+	{
+		log_error( "Cannot register more pipelines in render queue." );
+		return INVALID_HANDLE;
+	}
+
+	Pipeline* pipeline = request.get();
+
+	m_Pipelines.push_back( { pipeline != nullptr ? pipeline : fallback, request, fallback } );
+	return m_Pipelines.size() - 1;
+}
+
+RenderQueue::Handle RenderQueue::registerDescriptorSet( DescriptorSet& set )
+{
+	return registerDescriptorSet( set.getNativeHandle() );
+}
+
+RenderQueue::Handle RenderQueue::registerDescriptorSet( VkDescriptorSet set )
+{
+	if( m_DescriptorSets.size() >= ( 1u << DESCRIPTOR_SET_BITS ) )
+	{
+		log_error( "Cannot register more descriptor sets in render queue." );
+		return INVALID_HANDLE;
+	}
+
+	m_DescriptorSets.push_back( set );
+	return m_DescriptorSets.size() - 1;
+}
+
+void RenderQueue::setDescriptorSet( Handle handle, VkDescriptorSet set )
+{
+	m_DescriptorSets[ handle ] = set;
+}
+
+RenderQueue::Handle RenderQueue::registerMesh( const Mesh& mesh )
+{
+	if( m_Meshes.size() >= ( 1u << MESH_BITS ) )
+	{
+		log_error( "Cannot register more meshes in render queue." );
+		return INVALID_HANDLE;
+	}
+
+	m_Meshes.push_back( mesh );
+	return m_Meshes.size() - 1;
+}
+
+void RenderQueue::reset()
+{
+	m_Pipelines.clear();
+	m_DescriptorSets.clear();
+	m_Meshes.clear();
+
+	clear();
+}
+
+void RenderQueue::clear()
+{
+	m_Items.clear();
+	m_Keys.clear();
+	m_Order.clear();
+}
+
+void RenderQueue::submit( const DrawItem& item )
+{
+	m_Keys.push_back( encodeKey( item ) );
+	m_Order.push_back( m_Items.size() );
+	m_Items.push_back( item );
+}
+
+void RenderQueue::sort()
+{
+	Profiler::ScopedTimer timer( "renderqueue.sort" );
+
+	resolvePipelines();
+
+	m_TempKeys.resize( m_Keys.size() );
+	m_TempOrder.resize( m_Order.size() );
+
+	radixSort( m_Keys.data(),
+	           m_Order.data(),
+	           m_TempKeys.data(),
+	           m_TempOrder.data(),
+	           m_Keys.size() );
+}
+
+void RenderQueue::record( CommandBuffer& commandBuffer, uint32_t first, uint32_t count ) const
+{
+	Handle   pipeline      = INVALID_HANDLE;
+	Handle   descriptorSet = INVALID_HANDLE;
+	Handle   mesh          = INVALID_HANDLE;
+	uint64_t stateChanges  = 0;
+	uint32_t skippedDraws  = 0;
+	uint32_t fallbackDraws = 0;
+
+	for( auto i = first; i < first + count; ++i )
+	{
+		const DrawItem&      item         = m_Items[ m_Order[ i ] ];
+		const PipelineEntry& itemPipeline = m_Pipelines[ item.pipeline ];
+
+		if( itemPipeline.pPipeline == nullptr )
+		{
+			++skippedDraws;
+			continue;
+		}
+		if( itemPipeline.pPipeline == itemPipeline.pFallback )
+		{
+			++fallbackDraws;
+		}
+
+		if( item.pipeline != pipeline )
+		{
+			pipeline = item.pipeline;
+			commandBuffer.bindPipeline( VK_PIPELINE_BIND_POINT_GRAPHICS, *itemPipeline.pPipeline );
+			++stateChanges;
+
+			// rebind the set, the new pipeline may use a different layout
+			descriptorSet = INVALID_HANDLE;
+		}
+
+		if( item.descriptorSet != descriptorSet )
+		{
+			descriptorSet = item.descriptorSet;
+			commandBuffer.bindDescriptorSet( m_DescriptorSets[ descriptorSet ],
+			                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+			                                 *itemPipeline.pPipeline );
+			++stateChanges;
+		}
+
+		const Mesh& itemMesh = m_Meshes[ item.mesh ];
+
+		if( item.mesh != mesh )
+		{
+			mesh = item.mesh;
+			commandBuffer.bindMesh( itemMesh );
+			stateChanges += 2;
+		}
+
+		commandBuffer.pushConstants( *itemPipeline.pPipeline,
+		                             VK_SHADER_STAGE_VERTEX_BIT,
+		                             0,
+		                             sizeof( glm::mat4 ),
+		                             &item.model );
+
+		commandBuffer.drawIndexed( 0,
+		                           itemMesh.numIndices,
+		                           0,
+		                           item.firstInstance,
+		                           item.numInstances );
+	}
+
+	uint32_t numDraws = count - skippedDraws;
+
+	// an unsorted naive submission binds pipeline, set, vertex and index buffer per draw
+	Profiler::addCount( "renderqueue.draws", numDraws );
+	Profiler::addCount( "renderqueue.state_changes", stateChanges );
+	Profiler::addCount( "renderqueue.state_changes_avoided", 4 * (uint64_t)numDraws - stateChanges );
+
+	reportPendingPipelines( skippedDraws, fallbackDraws );
+}
+
+void RenderQueue::recordIndirect( CommandBuffer& commandBuffer,
+                                  Buffer& indirectBuffer,
+                                  VkDrawIndexedIndirectCommand* commands,
+                                  uint32_t maxCommands ) const
+{
+	uint32_t numCommands   = std::min<uint32_t>( m_Items.size(), maxCommands );
+	uint64_t stateChanges  = 0;
+	uint32_t numBatches    = 0;
+	uint32_t skippedDraws  = 0;
+	uint32_t fallbackDraws = 0;
+
+	uint32_t batchStart = 0;
+	while( batchStart < numCommands )
+	{
+		const DrawItem& first = m_Items[ m_Order[ batchStart ] ];
+		const Mesh&     mesh  = m_Meshes[ first.mesh ];
+
+		uint32_t batchEnd = batchStart;
+		while( batchEnd < numCommands )
+		{
+			const DrawItem& item = m_Items[ m_Order[ batchEnd ] ];
+			if( item.pipeline != first.pipeline ||
+			    item.descriptorSet != first.descriptorSet ||
+			    item.mesh != first.mesh ||
+			    std::memcmp( &item.model, &first.model, sizeof( glm::mat4 ) ) != 0 )
+			{
+				break;
+			}
+
+			VkDrawIndexedIndirectCommand& command = commands[ batchEnd ];
+			command.indexCount    = mesh.numIndices;
+			command.instanceCount = item.numInstances;
+			command.firstIndex    = 0;
+			command.vertexOffset  = 0;
+			command.firstInstance = item.firstInstance;
+
+			++batchEnd;
+		}
+
+		const PipelineEntry& batchPipeline = m_Pipelines[ first.pipeline ];
+
+		if( batchPipeline.pPipeline == nullptr )
+		{
+			skippedDraws += batchEnd - batchStart;
+			batchStart    = batchEnd;
+			continue;
+		}
+		if( batchPipeline.pPipeline == batchPipeline.pFallback )
+		{
+			fallbackDraws += batchEnd - batchStart;
+		}
+
+		// the command buffer filters binds that did not change between batches
+		uint32_t skippedBinds = commandBuffer.getNumSkippedBinds();
+
+		commandBuffer.bindPipeline( VK_PIPELINE_BIND_POINT_GRAPHICS, *batchPipeline.pPipeline );
+		commandBuffer.bindDescriptorSet( m_DescriptorSets[ first.descriptorSet ],
+		                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+		                                 *batchPipeline.pPipeline );
+		commandBuffer.bindMesh( mesh );
+
+		stateChanges += 4 - ( commandBuffer.getNumSkippedBinds() - skippedBinds );
+
+		commandBuffer.pushConstants( *batchPipeline.pPipeline,
+		                             VK_SHADER_STAGE_VERTEX_BIT,
+		                             0,
+		                             sizeof( glm::mat4 ),
+		                             &first.model );
+
+		commandBuffer.drawIndexedIndirect( indirectBuffer,
+		                                   batchStart * sizeof( VkDrawIndexedIndirectCommand ),
+		                                   batchEnd - batchStart,
+		                                   sizeof( VkDrawIndexedIndirectCommand ) );
+
+		++numBatches;
+		batchStart = batchEnd;
+	}
+
+	uint32_t numDraws = numCommands - skippedDraws;
+
+	Profiler::addCount( "renderqueue.draws", numDraws );
+	Profiler::addCount( "renderqueue.indirect_batches", numBatches );
+	Profiler::addCount( "renderqueue.state_changes", stateChanges );
+	Profiler::addCount( "renderqueue.state_changes_avoided", 4 * (uint64_t)numDraws - stateChanges );
+
+	reportPendingPipelines( skippedDraws, fallbackDraws );
+
+	if( numCommands < m_Items.size() )
+	{
+		record( commandBuffer, numCommands, m_Items.size() - numCommands );
+	}
+}
+
+void RenderQueue::resolvePipelines()
+{
+	for( auto& entry : m_Pipelines )
+	{
+		if( entry.request.isValid() && entry.pPipeline == entry.pFallback )
+		{
+			Pipeline* pipeline = entry.request.get();
+			if( pipeline != nullptr )
+			{
+				entry.pPipeline = pipeline;
+			}
+		}
+	}
+}
+
+void RenderQueue::reportPendingPipelines( uint32_t skippedDraws, uint32_t fallbackDraws )
+{
+	// every draw here would have stalled the frame on a blocking compile
+	if( skippedDraws > 0 )
+	{
+		Profiler::addCount( "renderqueue.skipped_draws", skippedDraws );
+	}
+	if( fallbackDraws > 0 )
+	{
+		Profiler::addCount( "renderqueue.fallback_draws", fallbackDraws );
+	}
+}
+
+uint64_t RenderQueue::encodeKey( const DrawItem& item )
+{
+	// non-negative floats compare like their bit patterns, keep the high bits
+	float    depth = ( item.depth > 0.0f ? item.depth : 0.0f );
+	uint32_t depthBits;
+	std::memcpy( &depthBits, &depth, sizeof( depthBits ) );
+	depthBits >>= ( 32 - DEPTH_BITS );
+
+	return ( (uint64_t)item.pipeline << ( DESCRIPTOR_SET_BITS + MESH_BITS + DEPTH_BITS ) ) |
+	       ( (uint64_t)item.descriptorSet << ( MESH_BITS + DEPTH_BITS ) ) |
+	       ( (uint64_t)item.mesh << DEPTH_BITS ) |
+	       (uint64_t)depthBits;
+}
+
+void RenderQueue::radixSort( uint64_t* keys,
+                             uint32_t* values,
+                             uint64_t* tempKeys,
+                             uint32_t* tempValues,
+                             uint32_t count )
+{
+	static constexpr uint32_t NUM_PASSES  = sizeof( uint64_t );
+	static constexpr uint32_t NUM_BUCKETS = 256;
+
+	if( count < 2 )
+		return;
+
+	// build the histograms of all passes with a single read of the keys
+	uint32_t histograms[ NUM_PASSES ][ NUM_BUCKETS ] = {};
+	for( auto i = 0; i < count; ++i )
+	{
+		uint64_t key = keys[ i ];
+		for( auto pass = 0; pass < NUM_PASSES; ++pass )
+		{
+			++histograms[ pass ][ ( key >> ( 8 * pass ) ) & 0xff ];
+		}
+	}
+
+	uint64_t* srcKeys   = keys;
+	uint32_t* srcValues = values;
+	uint64_t* dstKeys   = tempKeys;
+	uint32_t* dstValues = tempValues;
+
+	for( auto pass = 0; pass < NUM_PASSES; ++pass )
+	{
+		uint32_t* histogram = histograms[ pass ];
+		uint32_t  shift     = 8 * pass;
+
+		// all keys share this byte, the pass would not change the order
+		if( histogram[ ( srcKeys[ 0 ] >> shift ) & 0xff ] == count )
+			continue;
+
+		uint32_t offset = 0;
+		for( auto bucket = 0; bucket < NUM_BUCKETS; ++bucket )
+		{
+			uint32_t bucketSize = histogram[ bucket ];
+			histogram[ bucket ] = offset;
+			offset += bucketSize;
+		}
+
+		for( auto i = 0; i < count; ++i )
+		{
+			uint32_t target = histogram[ ( srcKeys[ i ] >> shift ) & 0xff ]++;
+			dstKeys[ target ]   = srcKeys[ i ];
+			dstValues[ target ] = srcValues[ i ];
+		}
+
+		std::swap( srcKeys, dstKeys );
+		std::swap( srcValues, dstValues );
+	}
+
+	if( srcKeys != keys )
+	{
+		std::memcpy( keys, srcKeys, count * sizeof( uint64_t ) );
+		std::memcpy( values, srcValues, count * sizeof( uint32_t ) );
+	}
+}
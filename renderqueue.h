@@ -0,0 +1,128 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include "common.h"
+#include "mesh.h"
+#include "pipelinelibrary.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+
+class Pipeline;
+class DescriptorSet;
+class CommandBuffer;
+class Buffer;
+
+// Collects draw items, orders them by 64-bit sort keys and records them with as few
+// state changes as possible. Pipelines, descriptor sets and meshes are registered
+// once and referenced by handle, so the keys can be built from small integers.
+//
+// Key layout, most significant first:
+//   pipeline (12 bits) | descriptor set (12 bits) | mesh (16 bits) | depth (24 bits)
+class RenderQueue
+{
+public:
+	typedef uint32_t Handle;
+
+	static constexpr Handle   INVALID_HANDLE = ~(Handle)0;
+
+	static constexpr uint32_t PIPELINE_BITS       = 12;
+	static constexpr uint32_t DESCRIPTOR_SET_BITS = 12;
+	static constexpr uint32_t MESH_BITS           = 16;
+	static constexpr uint32_t DEPTH_BITS          = 24;
+
+	struct DrawItem
+	{
+		Handle    pipeline;
+		Handle    descriptorSet;
+		Handle    mesh;
+		// view space distance, items sharing state are drawn front to back
+		float     depth;
+		uint32_t  firstInstance;
+		uint32_t  numInstances;
+		// pushed to the vertex stage at offset 0 of the pipeline's push constant range
+		glm::mat4 model;
+	};
+
+public:
+	RenderQueue();
+
+	Handle   registerPipeline( Pipeline& pipeline );
+	// draws use the fallback until the requested pipeline is ready or are skipped without
+	// one; the fallback has to accept the same descriptor sets and push constants
+	Handle   registerPipeline( const PipelineLibrary::Future& request, Pipeline* fallback );
+	Handle   registerDescriptorSet( DescriptorSet& set );
+	Handle   registerDescriptorSet( VkDescriptorSet set );
+	// replaces a registered set, e.g. by the set a DescriptorSetCache returned this frame
+	void     setDescriptorSet( Handle handle, VkDescriptorSet set );
+	Handle   registerMesh( const Mesh& mesh );
+
+	// drops all registrations and items, e.g. after registered objects were recreated
+	void     reset();
+	// drops the submitted items, registrations are kept
+	void     clear();
+	void     submit( const DrawItem& item );
+
+	// sorts the submitted items and picks up pipelines that became ready, has to be called
+	// before recording
+	void     sort();
+
+	// records the sorted items [first, first + count), safe to call concurrently
+	// for disjoint ranges
+	void     record( CommandBuffer& commandBuffer, uint32_t first, uint32_t count ) const;
+
+	// writes the sorted items as indexed indirect commands and records one multi-draw per
+	// run of items sharing pipeline, descriptor set, mesh and model; items beyond maxCommands
+	// are recorded as direct draws
+	void     recordIndirect( CommandBuffer& commandBuffer,
+	                         Buffer& indirectBuffer,
+	                         VkDrawIndexedIndirectCommand* commands,
+	                         uint32_t maxCommands ) const;
+
+	uint32_t getNumItems() const
+	{
+		return m_Items.size();
+	}
+
+	static uint64_t encodeKey( const DrawItem& item );
+
+	// sorts keys and their values with an LSD radix sort over bytes, skipping bytes
+	// that are equal in all keys; the temporary arrays have to be at least as large
+	static void     radixSort( uint64_t* keys,
+	                           uint32_t* values,
+	                           uint64_t* tempKeys,
+	                           uint32_t* tempValues,
+	                           uint32_t count );
+
+private:
+	struct PipelineEntry
+	{
+		// resolved by sort(), nullptr skips the draws
+		Pipeline*               pPipeline;
+		PipelineLibrary::Future request;
+		Pipeline*               pFallback;
+	};
+
+private:
+	void     resolvePipelines();
+
+	static void reportPendingPipelines( uint32_t skippedDraws, uint32_t fallbackDraws );
+
+private:
+	std::vector<PipelineEntry>   m_Pipelines;
+	std::vector<VkDescriptorSet> m_DescriptorSets;
+	std::vector<Mesh>            m_Meshes;
+
+	std::vector<DrawItem>        m_Items;
+	std::vector<uint64_t>        m_Keys;
+	std::vector<uint32_t>        m_Order;
+	std::vector<uint64_t>        m_TempKeys;
+	std::vector<uint32_t>        m_TempOrder;
+};
+
+#endif // RENDERQUEUE_H
@@ -0,0 +1,96 @@
+#include "renderthread.h"
+#include "profiler.h"
+
+RenderThread::RenderThread( Renderer& renderer )
+    : m_pRenderer( &renderer ),
+      m_Mailbox(),
+      m_Thread(),
+      m_bStop( false ),
+      m_uPublished( 0 ),
+      m_uConsumed( 0 ),
+      m_uNumFrames( 0 )
+{
+	m_Thread = std::thread( &RenderThread::threadLoop, this );
+}
+
+RenderThread::~RenderThread()
+{
+	stop();
+}
+
+void RenderThread::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+		m_bStop = true;
+	}
+	m_SnapshotCondition.notify_one();
+
+	if( m_Thread.joinable() )
+	{
+		m_Thread.join();
+	}
+}
+
+void RenderThread::publishSnapshot()
+{
+	m_Mailbox.getWriteSlot().sequence = ++m_uPublished;
+	m_Mailbox.publish();
+
+	// the mailbox itself needs no lock, taking it only orders the wakeup against the
+	// render thread checking for fresh snapshots
+	{
+		std::lock_guard<std::mutex> lock( m_Mutex );
+	}
+	m_SnapshotCondition.notify_one();
+}
+
+void RenderThread::waitForConsumption( std::chrono::milliseconds timeout )
+{
+	std::unique_lock<std::mutex> lock( m_Mutex );
+	m_ConsumedCondition.wait_for( lock, timeout, [ this ]() {
+		return ( m_bStop || m_uConsumed.load() >= m_uPublished );
+	} );
+}
+
+void RenderThread::threadLoop()
+{
+	while( true )
+	{
+		{
+			std::unique_lock<std::mutex> lock( m_Mutex );
+			m_SnapshotCondition.wait( lock, [ this ]() {
+				return ( m_bStop || m_Mailbox.hasFresh() );
+			} );
+
+			if( m_bStop )
+				break;
+		}
+
+		m_Mailbox.acquire();
+		m_uConsumed = m_Mailbox.getReadSlot().sequence;
+
+		{
+			std::lock_guard<std::mutex> lock( m_Mutex );
+		}
+		m_ConsumedCondition.notify_one();
+
+		// the snapshot stays untouched until the next acquire on this thread
+		const FrameSnapshot& snapshot = m_Mailbox.getReadSlot();
+
+		Profiler::ScopedTimer frameTimer( "frame" );
+
+		uint32_t imageIndex = m_pRenderer->renderFrame( snapshot );
+
+		if( imageIndex != Renderer::INVALID_FRAME )
+		{
+			m_pRenderer->presentFrame( imageIndex );
+		}
+		else
+		{
+			log_warning( "Dropping invalid frame." );
+		}
+
+		m_uNumFrames.fetch_add( 1, std::memory_order_relaxed );
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include "common.h"
+#include "mailbox.h"
+#include "renderer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Renders on a dedicated thread, decoupled from the thread polling window events. The
+// owning thread publishes frame snapshots; the render thread renders and presents the
+// latest one whenever a new one arrives, so simulating the next frame overlaps with
+// rendering the current one.
+class RenderThread
+{
+public:
+	RenderThread( Renderer& renderer );
+	~RenderThread();
+
+	// waits for the current frame and joins the thread
+	void           stop();
+
+	// snapshot to fill before publishSnapshot()
+	FrameSnapshot& beginSnapshot()
+	{
+		return m_Mailbox.getWriteSlot();
+	}
+	void           publishSnapshot();
+
+	// blocks until the render thread picked up the last published snapshot or the timeout
+	// expired, keeps the producer at most one frame ahead
+	void           waitForConsumption( std::chrono::milliseconds timeout );
+
+	uint64_t       getNumFrames() const
+	{
+		return m_uNumFrames.load( std::memory_order_relaxed );
+	}
+
+private:
+	void           threadLoop();
+
+private:
+	Renderer*               m_pRenderer;
+	Mailbox<FrameSnapshot>  m_Mailbox;
+
+	std::thread             m_Thread;
+	std::mutex              m_Mutex;
+	std::condition_variable m_SnapshotCondition;
+	std::condition_variable m_ConsumedCondition;
+	bool                    m_bStop;
+
+	// sequence numbers of snapshots, published by the owner and taken by the render thread
+	uint64_t                m_uPublished;
+	std::atomic<uint64_t>   m_uConsumed;
+	std::atomic<uint64_t>   m_uNumFrames;
+};
+
+#endif // RENDERTHREAD_H
@@ -5,16 +5,38 @@ Shader::Shader( Renderer& renderer,
                 const std::vector<char>& code,
                 std::string entryFunc,
                 VkShaderStageFlagBits stage )
+    : Shader( renderer,
+              reinterpret_cast<const uint32_t*>( code.data() ),
+              code.size(),
+              entryFunc,
+              stage )
+{
+}
+
+Shader::Shader( Renderer& renderer,
+                const uint32_t* code,
+                size_t size,
+                std::string entryFunc,
+                VkShaderStageFlagBits stage )
     : wrapper_type( renderer.getNativeDeviceHandle() ),
       m_vkStage( stage ),
+      m_uCodeHash( hash_bytes( code, size ) ),
+      m_Reflection(),
       m_strEntryFunc( entryFunc )
 {
+	// pipeline layouts are derived from the reflection, a module without one is unusable
+	if( !m_Reflection.parse( code, size, stage ) )
+	{
+		log_error( "Cannot reflect shader module." );
+		return;
+	}
+
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.pNext    = nullptr;
 	createInfo.flags    = 0;
 	createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode    = reinterpret_cast<const uint32_t*>( code.data() );
+	createInfo.codeSize = size;
+	createInfo.pCode    = code;
 
 	VkResult res = vkCreateShaderModule( m_vkDevice,
 	                                     &createInfo,
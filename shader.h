@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "vulkanobjectwrapper.h"
+#include "shaderreflection.h"
 
 #include <vulkan/vulkan.h>
 #include <vector>
@@ -18,6 +19,12 @@ public:
 	        const std::vector<char>& code,
 	        std::string entryFunc,
 	        VkShaderStageFlagBits stage );
+	// the code is only read during construction, size in bytes
+	Shader( Renderer& renderer,
+	        const uint32_t* code,
+	        size_t size,
+	        std::string entryFunc,
+	        VkShaderStageFlagBits stage );
 
 	const std::string&    getEntryFunction()
 	{
@@ -29,8 +36,22 @@ public:
 		return m_vkStage;
 	}
 
+	// identifies the SPIR-V code independent of the module handle
+	uint64_t              getCodeHash()
+	{
+		return m_uCodeHash;
+	}
+
+	// resources and inputs declared by the code
+	const ShaderReflection& getReflection()
+	{
+		return m_Reflection;
+	}
+
 private:
 	VkShaderStageFlagBits m_vkStage;
+	uint64_t              m_uCodeHash;
+	ShaderReflection      m_Reflection;
 
 	std::string           m_strEntryFunc;
 };
@@ -1,16 +1,24 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout( binding = 0 ) uniform UniformBufferObject
+layout( binding = 0 ) uniform CameraUniforms
 {
-	mat4 model;
 	mat4 view;
 	mat4 proj;
-} ubo;
+} camera;
+
+layout( push_constant ) uniform ModelConstants
+{
+	mat4 model;
+} object;
 
 layout( location = 0 ) in vec2 inPosition;
 layout( location = 1 ) in vec3 inColor;
 
+// per-instance stream
+layout( location = 2 ) in mat4 inTransform;
+layout( location = 6 ) in vec4 inInstanceColor;
+
 layout( location = 0 ) out vec3 fragColor;
 
 out gl_PerVertex
@@ -20,7 +28,7 @@ out gl_PerVertex
 
 void main()
 {
-	gl_Position = ubo.proj * ubo.view * ubo.model * vec4( inPosition, 0.0, 1.0 );
+	gl_Position = camera.proj * camera.view * object.model * inTransform * vec4( inPosition, 0.0, 1.0 );
 	//gl_Position = vec4( inPosition, 0.0, 1.0 );
-	fragColor = inColor;
+	fragColor = inColor * inInstanceColor.rgb;
 }
@@ -0,0 +1,132 @@
+#include "shaderarchive.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+ShaderArchive::ShaderArchive()
+    : m_pData( nullptr ),
+      m_uSize( 0 ),
+      m_Blobs()
+{
+}
+
+ShaderArchive::ShaderArchive( const std::string& filename )
+    : ShaderArchive()
+{
+	open( filename );
+}
+
+ShaderArchive::~ShaderArchive()
+{
+	destroy();
+}
+
+bool ShaderArchive::open( const std::string& filename )
+{
+	destroy();
+
+	int file = ::open( filename.c_str(), O_RDONLY );
+	if( file < 0 )
+	{
+		if( errno != ENOENT )
+		{
+			log_error( "Cannot open shader archive: " + filename );
+		}
+		return false;
+	}
+
+	struct stat status;
+	if( fstat( file, &status ) == 0 && status.st_size > 0 )
+	{
+		void* data = mmap( nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+		if( data != MAP_FAILED )
+		{
+			m_pData = reinterpret_cast<const char*>( data );
+			m_uSize = status.st_size;
+		}
+	}
+
+	// the mapping stays valid without the descriptor
+	close( file );
+
+	if( m_pData == nullptr )
+	{
+		log_error( "Cannot map shader archive: " + filename );
+		return false;
+	}
+
+	if( !indexEntries() )
+	{
+		log_error( "Invalid shader archive: " + filename );
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+void ShaderArchive::destroy()
+{
+	if( m_pData != nullptr )
+	{
+		munmap( const_cast<char*>( m_pData ), m_uSize );
+		m_pData = nullptr;
+		m_uSize = 0;
+	}
+	m_Blobs.clear();
+}
+
+bool ShaderArchive::find( const std::string& name, Blob& blob ) const
+{
+	auto it = m_Blobs.find( name );
+	if( it == m_Blobs.end() )
+		return false;
+
+	blob = it->second;
+	return true;
+}
+
+bool ShaderArchive::indexEntries()
+{
+	Header header;
+	if( m_uSize < sizeof( header ) )
+		return false;
+
+	std::memcpy( &header, m_pData, sizeof( header ) );
+
+	if( std::memcmp( header.magic, "SPVA", 4 ) != 0 ||
+	    header.version != VERSION ||
+	    header.numEntries > ( m_uSize - sizeof( header ) ) / sizeof( Entry ) )
+	{
+		return false;
+	}
+
+	const Entry* entries = reinterpret_cast<const Entry*>( m_pData + sizeof( header ) );
+
+	for( auto i = 0; i < header.numEntries; ++i )
+	{
+		const Entry& entry = entries[ i ];
+
+		// vkCreateShaderModule reads the code as 32-bit words
+		if( entry.offset > m_uSize ||
+		    entry.size > m_uSize - entry.offset ||
+		    entry.offset % sizeof( uint32_t ) != 0 ||
+		    entry.size % sizeof( uint32_t ) != 0 ||
+		    entry.name[ MAX_NAME_LENGTH - 1 ] != '\0' )
+		{
+			return false;
+		}
+
+		Blob blob;
+		blob.code = reinterpret_cast<const uint32_t*>( m_pData + entry.offset );
+		blob.size = entry.size;
+		blob.hash = entry.hash;
+
+		m_Blobs.emplace( entry.name, blob );
+	}
+	return true;
+}
@@ -0,0 +1,74 @@
+#ifndef SHADERARCHIVE_H
+#define SHADERARCHIVE_H
+
+#include "common.h"
+
+#include <unordered_map>
+#include <string>
+
+// Read-only view of a shader archive written by pack-shaders. The file is mapped once and
+// shader modules are created straight from the mapping.
+//
+// Layout, little endian:
+//   header  { char magic[ 4 ] = "SPVA"; uint32 version; uint32 numEntries; uint32 reserved }
+//   entries { char name[ 48 ]; uint64 hash; uint64 offset; uint64 size } x numEntries
+//   SPIR-V blobs at 16 byte aligned offsets, entries with equal code share a blob
+//
+// The hash is the FNV-1a hash of the blob, the same as hash_bytes().
+class ShaderArchive
+{
+public:
+	static constexpr uint32_t VERSION         = 1;
+	static constexpr uint32_t MAX_NAME_LENGTH = 48;
+
+	struct Blob
+	{
+		const uint32_t* code;
+		size_t          size;
+		uint64_t        hash;
+	};
+
+public:
+	ShaderArchive();
+	ShaderArchive( const std::string& filename );
+	~ShaderArchive();
+
+	// a missing file leaves the archive invalid without an error
+	bool open( const std::string& filename );
+	void destroy();
+
+	bool isValid() const
+	{
+		return ( m_pData != nullptr );
+	}
+
+	// false if the archive has no shader of the name
+	bool find( const std::string& name, Blob& blob ) const;
+
+private:
+	struct Header
+	{
+		char     magic[ 4 ];
+		uint32_t version;
+		uint32_t numEntries;
+		uint32_t reserved;
+	};
+
+	struct Entry
+	{
+		char     name[ MAX_NAME_LENGTH ];
+		uint64_t hash;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+private:
+	bool indexEntries();
+
+private:
+	const char*                           m_pData;
+	size_t                                m_uSize;
+	std::unordered_map<std::string, Blob> m_Blobs;
+};
+
+#endif // SHADERARCHIVE_H
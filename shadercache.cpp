@@ -1,11 +1,37 @@
 #include "shadercache.h"
 
+#ifdef EMBED_SHADERS
+#include "embeddedshaders.h"
+#endif
+
 #include <fstream>
+#include <algorithm>
+
+namespace
+{
+
+// GLSL sources and the shaders they are compiled to, see compile-shaders
+const std::vector<ShaderWatcher::Source> SHADER_SOURCES = {
+    { "shader.vert", "vert" },
+    { "shader.frag", "frag" },
+    { "cull.comp",   "cull" }
+};
+
+constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+} // namespace
 
 ShaderCache::ShaderCache( Renderer& renderer )
     : m_pRenderer( &renderer ),
+      m_Archive(),
+      m_bArchiveOpened( false ),
+      m_pWatcher( nullptr ),
+      m_Modules(),
       m_VertexShaders(),
-      m_FragmentShaders()
+      m_FragmentShaders(),
+      m_ComputeShaders(),
+      m_Replacements(),
+      m_Replaced()
 {
 }
 
@@ -16,8 +42,27 @@ ShaderCache::~ShaderCache()
 
 void ShaderCache::destroy()
 {
-	cleanupMap( m_VertexShaders );
-	cleanupMap( m_FragmentShaders );
+	safe_delete( m_pWatcher );
+
+	for( auto& pair : m_Modules )
+	{
+		delete pair.second;
+	}
+	m_Modules.clear();
+
+	for( Shader* shader : m_Replaced )
+	{
+		delete shader;
+	}
+	m_Replaced.clear();
+	m_Replacements.clear();
+
+	m_VertexShaders.clear();
+	m_FragmentShaders.clear();
+	m_ComputeShaders.clear();
+
+	m_Archive.destroy();
+	m_bArchiveOpened = false;
 }
 
 Shader& ShaderCache::getVertexShader( const std::string& name )
@@ -30,6 +75,217 @@ Shader& ShaderCache::getFragmentShader( const std::string& name )
 	return getShader( name, VK_SHADER_STAGE_FRAGMENT_BIT, m_FragmentShaders );
 }
 
+Shader& ShaderCache::getComputeShader( const std::string& name )
+{
+	return getShader( name, VK_SHADER_STAGE_COMPUTE_BIT, m_ComputeShaders );
+}
+
+bool ShaderCache::enableHotReload()
+{
+	if( m_pWatcher != nullptr )
+		return true;
+
+	m_pWatcher = new ShaderWatcher( SHADER_SOURCES );
+
+	if( !m_pWatcher->isValid() )
+	{
+		safe_delete( m_pWatcher );
+		return false;
+	}
+
+	log_info( "Watching shaders for changes." );
+	return true;
+}
+
+bool ShaderCache::update()
+{
+	std::vector<std::string> names;
+
+	if( m_pWatcher == nullptr || !m_pWatcher->poll( names ) )
+		return false;
+
+	bool updated = false;
+
+	for( const auto& name : names )
+	{
+		updated |= reload( name, VK_SHADER_STAGE_VERTEX_BIT, m_VertexShaders );
+		updated |= reload( name, VK_SHADER_STAGE_FRAGMENT_BIT, m_FragmentShaders );
+		updated |= reload( name, VK_SHADER_STAGE_COMPUTE_BIT, m_ComputeShaders );
+	}
+
+	// modules with equal code are shared between names
+	removeUnreferenced();
+
+	return updated;
+}
+
+void ShaderCache::commit( std::vector<Shader*>& replaced )
+{
+	replaced.insert( replaced.end(), m_Replaced.begin(), m_Replaced.end() );
+	m_Replaced.clear();
+	m_Replacements.clear();
+}
+
+void ShaderCache::revert( std::vector<Shader*>& replaced )
+{
+	for( const auto& replacement : m_Replacements )
+	{
+		Shader* shader = replacement.pPrevious;
+
+		auto iter = std::find( m_Replaced.begin(), m_Replaced.end(), shader );
+		if( iter != m_Replaced.end() )
+		{
+			VkShaderStageFlagBits stage = shader->getStage();
+
+			// a later reload may have created a module for the same code again
+			Shader*& module = m_Modules[ hash_bytes( &stage, sizeof( stage ), shader->getCodeHash() ) ];
+			if( module == nullptr )
+			{
+				module = shader;
+				m_Replaced.erase( iter );
+			}
+			shader = module;
+		}
+
+		( *replacement.pMap )[ replacement.name ] = shader;
+	}
+
+	if( !m_Replacements.empty() )
+	{
+		log_info( "Restored shaders replaced since the last successful reload." );
+	}
+
+	removeUnreferenced();
+	commit( replaced );
+}
+
+bool ShaderCache::reload( const std::string& name,
+                             VkShaderStageFlagBits stage,
+                             map_type& map )
+{
+	auto iter = map.find( name );
+	if( iter == map.end() )
+		return false;
+
+	std::vector<char> code;
+	readFile( name + ".spv", code );
+
+	// the file may still be incomplete if written in place
+	if( code.size() < sizeof( uint32_t ) ||
+	    code.size() % sizeof( uint32_t ) != 0 ||
+	    *reinterpret_cast<const uint32_t*>( code.data() ) != SPIRV_MAGIC )
+	{
+		log_error( "Cannot reload shader, invalid SPIR-V: " + name );
+		return false;
+	}
+
+	uint64_t hash = hash_bytes( code.data(), code.size() );
+
+	// also filters the events of a compiled source and its module
+	if( iter->second->getCodeHash() == hash )
+		return false;
+
+	Shader*& shader = m_Modules[ hash_bytes( &stage, sizeof( stage ), hash ) ];
+	if( shader == nullptr )
+	{
+		shader = new Shader( *m_pRenderer,
+		                     reinterpret_cast<const uint32_t*>( code.data() ),
+		                     code.size(),
+		                     "main",
+		                     stage );
+
+		if( !shader->isValid() )
+		{
+			log_error( "Cannot create module for reloaded shader: " + name );
+			delete shader;
+			m_Modules.erase( hash_bytes( &stage, sizeof( stage ), hash ) );
+			return false;
+		}
+	}
+
+	log_info( "Reloaded shader: " + name );
+
+	// reverting restores the module of the last commit, not of an earlier reload
+	bool replaced = false;
+	for( const auto& replacement : m_Replacements )
+	{
+		replaced |= ( replacement.pMap == &map && replacement.name == name );
+	}
+
+	if( !replaced )
+	{
+		m_Replacements.push_back( { &map, name, iter->second } );
+	}
+
+	iter->second = shader;
+	return true;
+}
+
+bool ShaderCache::isReferenced( Shader* shader )
+{
+	for( const map_type* map : { &m_VertexShaders, &m_FragmentShaders, &m_ComputeShaders } )
+	{
+		for( const auto& pair : *map )
+		{
+			if( pair.second == shader )
+				return true;
+		}
+	}
+	return false;
+}
+
+void ShaderCache::removeUnreferenced()
+{
+	auto iter = m_Modules.begin();
+	while( iter != m_Modules.end() )
+	{
+		if( !isReferenced( iter->second ) )
+		{
+			m_Replaced.push_back( iter->second );
+			iter = m_Modules.erase( iter );
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+bool ShaderCache::findEmbedded( const std::string& name, ShaderArchive::Blob& blob )
+{
+#ifdef EMBED_SHADERS
+	for( const auto& entry : EmbeddedShaders::entries )
+	{
+		if( name == entry.name )
+		{
+			blob.code = entry.code;
+			blob.size = entry.size;
+			blob.hash = entry.hash;
+			return true;
+		}
+	}
+#else
+	(void)name;
+	(void)blob;
+#endif
+	return false;
+}
+
+bool ShaderCache::findInArchive( const std::string& name, ShaderArchive::Blob& blob )
+{
+	if( !m_bArchiveOpened )
+	{
+		m_bArchiveOpened = true;
+
+		if( !m_Archive.open( ARCHIVE_FILENAME ) )
+		{
+			log_info( "No shader archive, loading shaders from individual files." );
+		}
+	}
+
+	return m_Archive.find( name, blob );
+}
+
 void ShaderCache::readFile( const std::string& filename, std::vector<char>& code )
 {
 	std::ifstream file( filename, std::ios::binary | std::ios::ate );
@@ -49,15 +305,6 @@ void ShaderCache::readFile( const std::string& filename, std::vector<char>& code
 	file.close();
 }
 
-void ShaderCache::cleanupMap( map_type& map )
-{
-	for( auto& pair : map )
-	{
-		delete pair.second;
-	}
-	map.clear();
-}
-
 Shader& ShaderCache::getShader( const std::string& name,
                                 VkShaderStageFlagBits stage,
                                 map_type& map )
@@ -69,12 +316,27 @@ Shader& ShaderCache::getShader( const std::string& name,
 	}
 	else
 	{
-		log_info( "Caching shader: " + name );
+		ShaderArchive::Blob blob;
+		std::vector<char>   code;
+
+		if( !findEmbedded( name, blob ) && !findInArchive( name, blob ) )
+		{
+			readFile( name + ".spv", code );
+
+			blob.code = reinterpret_cast<const uint32_t*>( code.data() );
+			blob.size = code.size();
+			blob.hash = hash_bytes( code.data(), code.size() );
+		}
+
+		uint64_t key = hash_bytes( &stage, sizeof( stage ), blob.hash );
 
-		std::vector<char> code;
-		readFile( name + ".spv", code );
+		Shader*& shader = m_Modules[ key ];
+		if( shader == nullptr )
+		{
+			log_info( "Caching shader: " + name );
 
-		Shader* shader = new Shader( *m_pRenderer, code, "main", stage ); // TODO: variable entry func?
+			shader = new Shader( *m_pRenderer, blob.code, blob.size, "main", stage ); // TODO: variable entry func?
+		}
 		map[ name ] = shader;
 
 		return *shader;
@@ -3,16 +3,36 @@
 
 #include "common.h"
 #include "shader.h"
+#include "shaderarchive.h"
+#include "shaderwatcher.h"
 
 #include <vulkan/vulkan.h>
 #include <unordered_map>
 #include <string>
 
+// Shaders are looked up in the shaders embedded at build time (EMBED_SHADERS), then in the
+// shader archive and finally in individual .spv files; the archive is only opened once a
+// shader is not embedded. Modules are keyed by content hash and stage, names with equal
+// code share one.
+//
+// With hot reload enabled, changed shaders are read from their .spv files again, which
+// then take precedence over embedded and archived code.
 class ShaderCache
 {
 private:
 	typedef std::unordered_map<std::string, Shader*> map_type;
 
+	// first replacement of a name lookup since the last commit
+	struct Replacement
+	{
+		map_type*   pMap;
+		std::string name;
+		Shader*     pPrevious;
+	};
+
+public:
+	static constexpr const char* ARCHIVE_FILENAME = "shaders.spva";
+
 public:
 	ShaderCache( Renderer& renderer );
 	~ShaderCache();
@@ -21,19 +41,55 @@ public:
 
 	Shader& getVertexShader( const std::string& name );
 	Shader& getFragmentShader( const std::string& name );
+	Shader& getComputeShader( const std::string& name );
+
+	// watches the shader sources in the working directory, see update()
+	bool    enableHotReload();
+
+	// replaces the modules of shaders changed on disk, the getters return the new modules
+	// afterwards. Replacements accumulate until they are committed or reverted. Returns
+	// false if nothing was replaced.
+	bool    update();
+	// hands the modules replaced since the last commit to the caller, who destroys them
+	// once no pipeline compilation refers to them anymore
+	void    commit( std::vector<Shader*>& replaced );
+	// restores the modules replaced since the last commit, e.g. if the reloaded shaders
+	// do not compile; the reloaded modules are handed to the caller as by commit()
+	void    revert( std::vector<Shader*>& replaced );
 
 private:
 	static void readFile( const std::string& filename, std::vector<char>& code );
+	static bool findEmbedded( const std::string& name, ShaderArchive::Blob& blob );
 
-	void    cleanupMap( map_type& map );
+	bool    findInArchive( const std::string& name, ShaderArchive::Blob& blob );
 
 	Shader& getShader( const std::string& name, VkShaderStageFlagBits stage, map_type& map );
 
+	// returns false if the shader is unknown or unchanged
+	bool    reload( const std::string& name, VkShaderStageFlagBits stage, map_type& map );
+	bool    isReferenced( Shader* shader );
+	// moves modules no name refers to anymore to the replaced ones
+	void    removeUnreferenced();
+
 private:
-	Renderer* m_pRenderer;
+	Renderer*     m_pRenderer;
+
+	ShaderArchive m_Archive;
+	bool          m_bArchiveOpened;
+
+	ShaderWatcher* m_pWatcher;
+
+	// owning, keyed by content hash and stage
+	std::unordered_map<uint64_t, Shader*> m_Modules;
+
+	// name lookups into the modules
+	map_type      m_VertexShaders;
+	map_type      m_FragmentShaders;
+	map_type      m_ComputeShaders;
 
-	map_type  m_VertexShaders;
-	map_type  m_FragmentShaders;
+	std::vector<Replacement> m_Replacements;
+	// owning until committed or reverted
+	std::vector<Shader*>     m_Replaced;
 };
 
 #endif // SHADERCACHE_H
@@ -0,0 +1,595 @@
+#include "shaderreflection.h"
+#include "specializationconstants.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// SPIR-V specification 1.0, only the values needed here
+namespace Spv
+{
+	constexpr uint32_t MAGIC       = 0x07230203;
+	constexpr uint32_t HEADER_SIZE = 5;
+
+	enum Op : uint32_t
+	{
+		OpExecutionMode         = 16,
+		OpTypeBool              = 20,
+		OpTypeInt               = 21,
+		OpTypeFloat             = 22,
+		OpTypeVector            = 23,
+		OpTypeMatrix            = 24,
+		OpTypeImage             = 25,
+		OpTypeSampler           = 26,
+		OpTypeSampledImage      = 27,
+		OpTypeArray             = 28,
+		OpTypeRuntimeArray      = 29,
+		OpTypeStruct            = 30,
+		OpTypePointer           = 32,
+		OpConstant              = 43,
+		OpConstantComposite     = 44,
+		OpSpecConstant          = 50,
+		OpSpecConstantComposite = 51,
+		OpVariable              = 59,
+		OpDecorate              = 71,
+		OpMemberDecorate        = 72,
+		OpExecutionModeId       = 331
+	};
+
+	enum Decoration : uint32_t
+	{
+		SpecId        = 1,
+		BufferBlock   = 3,
+		ArrayStride   = 6,
+		MatrixStride  = 7,
+		BuiltIn       = 11,
+		Location      = 30,
+		Binding       = 33,
+		DescriptorSet = 34,
+		Offset        = 35
+	};
+
+	enum StorageClass : uint32_t
+	{
+		UniformConstant = 0,
+		Input           = 1,
+		Uniform         = 2,
+		PushConstant    = 9,
+		StorageBuffer   = 12
+	};
+
+	enum ExecutionMode : uint32_t
+	{
+		LocalSize   = 17,
+		LocalSizeId = 38
+	};
+
+	enum Dim : uint32_t
+	{
+		DimBuffer      = 5,
+		DimSubpassData = 6
+	};
+
+	constexpr uint32_t BUILTIN_WORKGROUP_SIZE = 25;
+	constexpr uint32_t NONE                   = ~(uint32_t)0;
+}
+
+// 32-bit vertex formats by component type and count
+const VkFormat VERTEX_FORMATS[ 3 ][ 4 ] = {
+    { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+    { VK_FORMAT_R32_SINT,   VK_FORMAT_R32G32_SINT,   VK_FORMAT_R32G32B32_SINT,   VK_FORMAT_R32G32B32A32_SINT },
+    { VK_FORMAT_R32_UINT,   VK_FORMAT_R32G32_UINT,   VK_FORMAT_R32G32B32_UINT,   VK_FORMAT_R32G32B32A32_UINT }
+};
+
+} // namespace
+
+ShaderReflection::ShaderReflection()
+    : m_DescriptorBindings(),
+      m_vkPushConstantRange{},
+      m_VertexInputs(),
+      m_uWorkgroupSize{ 1, 1, 1 },
+      m_uWorkgroupSpecIds{ NO_SPEC_ID, NO_SPEC_ID, NO_SPEC_ID }
+{
+}
+
+bool ShaderReflection::parse( const uint32_t* code, size_t size, VkShaderStageFlagBits stage )
+{
+	*this = ShaderReflection();
+	m_vkPushConstantRange.stageFlags = stage;
+
+	size_t numWords = size / sizeof( uint32_t );
+
+	if( numWords < Spv::HEADER_SIZE || code[ 0 ] != Spv::MAGIC )
+		return false;
+
+	// every id is defined by an instruction of at least one word, a larger bound is corrupt
+	if( code[ 3 ] > numWords )
+		return false;
+
+	// every result id is below the bound
+	Id none{};
+	none.set         = Spv::NONE;
+	none.binding     = Spv::NONE;
+	none.location    = Spv::NONE;
+	none.builtIn     = Spv::NONE;
+	none.specId      = NO_SPEC_ID;
+	none.arrayStride = 0;
+	none.bufferBlock = false;
+
+	std::vector<Id>       ids( code[ 3 ], none );
+	std::vector<uint32_t> variables;
+	uint32_t              localSizeIds[ 3 ] = { 0, 0, 0 };
+
+	auto getId = [ &ids ]( uint32_t id ) -> Id* {
+		return ( id < ids.size() ? &ids[ id ] : nullptr );
+	};
+
+	for( size_t offset = Spv::HEADER_SIZE; offset < numWords; )
+	{
+		uint32_t        opcode      = code[ offset ] & 0xffff;
+		uint32_t        numWordsOp  = code[ offset ] >> 16;
+		const uint32_t* operands    = code + offset + 1;
+		uint32_t        numOperands = numWordsOp - 1;
+
+		if( numWordsOp == 0 || offset + numWordsOp > numWords )
+			return false;
+
+		offset += numWordsOp;
+
+		// types define their result first, constants and variables after the result type
+		uint32_t result = Spv::NONE;
+
+		switch( opcode )
+		{
+		case Spv::OpTypeBool:
+		case Spv::OpTypeInt:
+		case Spv::OpTypeFloat:
+		case Spv::OpTypeVector:
+		case Spv::OpTypeMatrix:
+		case Spv::OpTypeImage:
+		case Spv::OpTypeSampler:
+		case Spv::OpTypeSampledImage:
+		case Spv::OpTypeArray:
+		case Spv::OpTypeRuntimeArray:
+		case Spv::OpTypeStruct:
+		case Spv::OpTypePointer:
+			result = ( numOperands >= 1 ? operands[ 0 ] : Spv::NONE );
+			break;
+		case Spv::OpConstant:
+		case Spv::OpConstantComposite:
+		case Spv::OpSpecConstant:
+		case Spv::OpSpecConstantComposite:
+		case Spv::OpVariable:
+			result = ( numOperands >= 2 ? operands[ 1 ] : Spv::NONE );
+			break;
+		case Spv::OpExecutionMode:
+			if( numOperands >= 5 && operands[ 1 ] == Spv::LocalSize )
+			{
+				std::copy( operands + 2, operands + 5, m_uWorkgroupSize );
+			}
+			break;
+		case Spv::OpExecutionModeId:
+			if( numOperands >= 5 && operands[ 1 ] == Spv::LocalSizeId )
+			{
+				std::copy( operands + 2, operands + 5, localSizeIds );
+			}
+			break;
+		case Spv::OpDecorate:
+			if( numOperands >= 2 && getId( operands[ 0 ] ) != nullptr )
+			{
+				Id&      target = ids[ operands[ 0 ] ];
+				uint32_t value  = ( numOperands >= 3 ? operands[ 2 ] : 0 );
+
+				switch( operands[ 1 ] )
+				{
+				case Spv::SpecId:
+					target.specId = value;
+					break;
+				case Spv::BufferBlock:
+					target.bufferBlock = true;
+					break;
+				case Spv::ArrayStride:
+					target.arrayStride = value;
+					break;
+				case Spv::BuiltIn:
+					target.builtIn = value;
+					break;
+				case Spv::Location:
+					target.location = value;
+					break;
+				case Spv::Binding:
+					target.binding = value;
+					break;
+				case Spv::DescriptorSet:
+					target.set = value;
+					break;
+				}
+			}
+			break;
+		case Spv::OpMemberDecorate:
+			if( numOperands >= 4 && getId( operands[ 0 ] ) != nullptr )
+			{
+				std::vector<Member>& members = ids[ operands[ 0 ] ].members;
+
+				if( members.size() <= operands[ 1 ] )
+				{
+					members.resize( operands[ 1 ] + 1, Member{ 0, 0 } );
+				}
+
+				if( operands[ 2 ] == Spv::Offset )
+				{
+					members[ operands[ 1 ] ].offset = operands[ 3 ];
+				}
+				else if( operands[ 2 ] == Spv::MatrixStride )
+				{
+					members[ operands[ 1 ] ].matrixStride = operands[ 3 ];
+				}
+			}
+			break;
+		}
+
+		if( result != Spv::NONE )
+		{
+			if( getId( result ) == nullptr )
+				return false;
+
+			ids[ result ].opcode      = opcode;
+			ids[ result ].operands    = operands;
+			ids[ result ].numOperands = numOperands;
+
+			if( opcode == Spv::OpVariable )
+			{
+				variables.push_back( result );
+			}
+		}
+	}
+
+	for( auto i = 0; i < 3; ++i )
+	{
+		if( localSizeIds[ i ] != 0 &&
+		    !resolveConstant( ids, localSizeIds[ i ], m_uWorkgroupSize[ i ], m_uWorkgroupSpecIds[ i ] ) )
+		{
+			return false;
+		}
+	}
+
+	// a constant decorated as the workgroup size overrides the execution mode
+	for( const auto& id : ids )
+	{
+		if( id.builtIn == Spv::BUILTIN_WORKGROUP_SIZE &&
+		    ( id.opcode == Spv::OpConstantComposite || id.opcode == Spv::OpSpecConstantComposite ) &&
+		    id.numOperands >= 5 )
+		{
+			for( auto i = 0; i < 3; ++i )
+			{
+				if( !resolveConstant( ids, id.operands[ 2 + i ], m_uWorkgroupSize[ i ], m_uWorkgroupSpecIds[ i ] ) )
+					return false;
+			}
+		}
+	}
+
+	for( uint32_t variableId : variables )
+	{
+		const Id& variable = ids[ variableId ];
+		const Id* pointer  = getId( variable.operands[ 0 ] );
+
+		if( variable.numOperands < 3 ||
+		    pointer == nullptr ||
+		    pointer->opcode != Spv::OpTypePointer ||
+		    pointer->numOperands < 3 ||
+		    getId( pointer->operands[ 2 ] ) == nullptr )
+		{
+			return false;
+		}
+
+		uint32_t storageClass = variable.operands[ 2 ];
+		uint32_t type         = pointer->operands[ 2 ];
+
+		switch( storageClass )
+		{
+		case Spv::UniformConstant:
+		case Spv::Uniform:
+		case Spv::StorageBuffer:
+			if( !reflectDescriptor( ids, variable, type, storageClass ) )
+				return false;
+			break;
+		case Spv::PushConstant:
+			reflectPushConstants( ids, type );
+			break;
+		case Spv::Input:
+			// built-ins like gl_VertexIndex are not fed by vertex buffers
+			if( stage == VK_SHADER_STAGE_VERTEX_BIT &&
+			    variable.builtIn == Spv::NONE &&
+			    variable.location != Spv::NONE )
+			{
+				reflectVertexInput( ids, variable.location, type );
+			}
+			break;
+		}
+	}
+
+	std::sort( m_DescriptorBindings.begin(),
+	           m_DescriptorBindings.end(),
+	           []( const DescriptorBinding& a, const DescriptorBinding& b ) {
+		return ( a.set < b.set || ( a.set == b.set && a.binding < b.binding ) );
+	} );
+
+	std::sort( m_VertexInputs.begin(),
+	           m_VertexInputs.end(),
+	           []( const VertexInput& a, const VertexInput& b ) {
+		return ( a.location < b.location );
+	} );
+
+	return true;
+}
+
+void ShaderReflection::getWorkgroupSize( const SpecializationConstants& specialization,
+                                         uint32_t size[ 3 ] ) const
+{
+	for( auto i = 0; i < 3; ++i )
+	{
+		size[ i ] = m_uWorkgroupSize[ i ];
+
+		if( m_uWorkgroupSpecIds[ i ] != NO_SPEC_ID )
+		{
+			specialization.find( m_uWorkgroupSpecIds[ i ], size[ i ] );
+		}
+	}
+}
+
+bool ShaderReflection::isCompatibleFormat( VkFormat format, VkFormat reflected )
+{
+	if( reflected == VK_FORMAT_UNDEFINED )
+		return true;
+
+	for( const auto& formats : VERTEX_FORMATS )
+	{
+		if( std::find( std::begin( formats ), std::end( formats ), format ) != std::end( formats ) )
+			return ( format == reflected );
+	}
+	return true;
+}
+
+bool ShaderReflection::resolveConstant( const std::vector<Id>& ids,
+                                        uint32_t id,
+                                        uint32_t& value,
+                                        uint32_t& specId )
+{
+	if( id >= ids.size() ||
+	    ( ids[ id ].opcode != Spv::OpConstant && ids[ id ].opcode != Spv::OpSpecConstant ) ||
+	    ids[ id ].numOperands < 3 )
+	{
+		return false;
+	}
+
+	value  = ids[ id ].operands[ 2 ];
+	specId = ( ids[ id ].opcode == Spv::OpSpecConstant ? ids[ id ].specId : NO_SPEC_ID );
+	return true;
+}
+
+uint32_t ShaderReflection::getTypeSize( const std::vector<Id>& ids,
+                                        uint32_t type,
+                                        uint32_t matrixStride )
+{
+	if( type >= ids.size() )
+		return 0;
+
+	const Id& id = ids[ type ];
+
+	switch( id.opcode )
+	{
+	case Spv::OpTypeBool:
+		return sizeof( uint32_t );
+	case Spv::OpTypeInt:
+	case Spv::OpTypeFloat:
+		return ( id.numOperands >= 2 ? id.operands[ 1 ] / 8 : 0 );
+	case Spv::OpTypeVector:
+		return ( id.numOperands >= 3 ? id.operands[ 2 ] * getTypeSize( ids, id.operands[ 1 ], 0 ) : 0 );
+	case Spv::OpTypeMatrix:
+		if( id.numOperands < 3 )
+			return 0;
+		return id.operands[ 2 ] * ( matrixStride != 0 ? matrixStride
+		                                              : getTypeSize( ids, id.operands[ 1 ], 0 ) );
+	case Spv::OpTypeArray:
+	{
+		uint32_t length;
+		uint32_t specId;
+
+		if( id.numOperands < 3 || !resolveConstant( ids, id.operands[ 2 ], length, specId ) )
+			return 0;
+
+		return length * ( id.arrayStride != 0 ? id.arrayStride
+		                                      : getTypeSize( ids, id.operands[ 1 ], matrixStride ) );
+	}
+	case Spv::OpTypeStruct:
+	{
+		uint32_t size = 0;
+
+		for( auto i = 1; i < id.numOperands; ++i )
+		{
+			Member member = ( i - 1 < id.members.size() ? id.members[ i - 1 ] : Member{ 0, 0 } );
+
+			size = std::max( size,
+			                 member.offset + getTypeSize( ids, id.operands[ i ], member.matrixStride ) );
+		}
+		return size;
+	}
+	default:
+		// runtime arrays have no static size
+		return 0;
+	}
+}
+
+VkFormat ShaderReflection::getVertexFormat( const std::vector<Id>& ids, uint32_t type )
+{
+	uint32_t count = 1;
+
+	if( ids[ type ].opcode == Spv::OpTypeVector && ids[ type ].numOperands >= 3 )
+	{
+		count = ids[ type ].operands[ 2 ];
+		type  = ids[ type ].operands[ 1 ];
+
+		if( type >= ids.size() )
+			return VK_FORMAT_UNDEFINED;
+	}
+
+	const Id& scalar = ids[ type ];
+
+	if( count < 1 || count > 4 || scalar.numOperands < 2 || scalar.operands[ 1 ] != 32 )
+		return VK_FORMAT_UNDEFINED;
+
+	if( scalar.opcode == Spv::OpTypeFloat )
+		return VERTEX_FORMATS[ 0 ][ count - 1 ];
+
+	if( scalar.opcode == Spv::OpTypeInt && scalar.numOperands >= 3 )
+		return VERTEX_FORMATS[ scalar.operands[ 2 ] != 0 ? 1 : 2 ][ count - 1 ];
+
+	return VK_FORMAT_UNDEFINED;
+}
+
+bool ShaderReflection::reflectDescriptor( const std::vector<Id>& ids,
+                                          const Id& variable,
+                                          uint32_t type,
+                                          uint32_t storageClass )
+{
+	if( variable.set == Spv::NONE || variable.binding == Spv::NONE )
+		return false;
+
+	DescriptorBinding binding{};
+	binding.set     = variable.set;
+	binding.binding = variable.binding;
+	binding.count   = 1;
+
+	// arrays of descriptors, runtime sized ones are bound as a single descriptor
+	while( ids[ type ].opcode == Spv::OpTypeArray || ids[ type ].opcode == Spv::OpTypeRuntimeArray )
+	{
+		const Id& array = ids[ type ];
+
+		uint32_t length = 1;
+		uint32_t specId;
+
+		if( array.opcode == Spv::OpTypeArray &&
+		    ( array.numOperands < 3 || !resolveConstant( ids, array.operands[ 2 ], length, specId ) ) )
+		{
+			return false;
+		}
+
+		binding.count *= length;
+		type           = array.operands[ 1 ];
+
+		if( type >= ids.size() )
+			return false;
+	}
+
+	const Id& resource = ids[ type ];
+
+	switch( resource.opcode )
+	{
+	case Spv::OpTypeStruct:
+		binding.type = ( storageClass == Spv::StorageBuffer || resource.bufferBlock
+		                 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+		                 : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER );
+		break;
+	case Spv::OpTypeImage:
+	{
+		if( resource.numOperands < 7 )
+			return false;
+
+		// sampled 2 marks images accessed without a sampler
+		uint32_t dim     = resource.operands[ 2 ];
+		bool     storage = ( resource.operands[ 6 ] == 2 );
+
+		if( dim == Spv::DimBuffer )
+		{
+			binding.type = ( storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+			                         : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER );
+		}
+		else if( dim == Spv::DimSubpassData )
+		{
+			binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		}
+		else
+		{
+			binding.type = ( storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+			                         : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE );
+		}
+		break;
+	}
+	case Spv::OpTypeSampledImage:
+		binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		break;
+	case Spv::OpTypeSampler:
+		binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+		break;
+	default:
+		// e.g. extension types, not bound through descriptor sets known here
+		return true;
+	}
+
+	m_DescriptorBindings.push_back( binding );
+	return true;
+}
+
+void ShaderReflection::reflectPushConstants( const std::vector<Id>& ids, uint32_t type )
+{
+	const Id& block = ids[ type ];
+
+	if( block.opcode != Spv::OpTypeStruct || block.numOperands < 2 )
+		return;
+
+	uint32_t first = ~(uint32_t)0;
+	for( auto i = 0; i < block.numOperands - 1; ++i )
+	{
+		first = std::min( first, i < block.members.size() ? block.members[ i ].offset : 0 );
+	}
+
+	uint32_t end = getTypeSize( ids, type, 0 );
+
+	m_vkPushConstantRange.offset = first;
+	m_vkPushConstantRange.size   = ( end > first ? end - first : 0 );
+}
+
+void ShaderReflection::reflectVertexInput( const std::vector<Id>& ids,
+                                           uint32_t location,
+                                           uint32_t type )
+{
+	if( type >= ids.size() )
+		return;
+
+	const Id& input = ids[ type ];
+
+	if( input.opcode == Spv::OpTypeMatrix && input.numOperands >= 3 )
+	{
+		// one location per column
+		for( auto i = 0; i < input.operands[ 2 ]; ++i )
+		{
+			reflectVertexInput( ids, location + i, input.operands[ 1 ] );
+		}
+	}
+	else if( input.opcode == Spv::OpTypeArray && input.numOperands >= 3 )
+	{
+		uint32_t length;
+		uint32_t specId;
+
+		if( input.operands[ 1 ] < ids.size() &&
+		    resolveConstant( ids, input.operands[ 2 ], length, specId ) )
+		{
+			const Id& element = ids[ input.operands[ 1 ] ];
+
+			// arrays of matrices take several locations per element
+			uint32_t stride = ( element.opcode == Spv::OpTypeMatrix && element.numOperands >= 3
+			                    ? element.operands[ 2 ]
+			                    : 1 );
+
+			for( auto i = 0; i < length; ++i )
+			{
+				reflectVertexInput( ids, location + i * stride, input.operands[ 1 ] );
+			}
+		}
+	}
+	else
+	{
+		m_VertexInputs.push_back( { location, getVertexFormat( ids, type ) } );
+	}
+}
@@ -0,0 +1,118 @@
+#ifndef SHADERREFLECTION_H
+#define SHADERREFLECTION_H
+
+#include "common.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+class SpecializationConstants;
+
+// Resources, push constants, vertex inputs and the workgroup size declared by a SPIR-V
+// module, read from its types, variables and decorations. Declarations the entry point
+// does not use are included, glslang only emits what the source declares.
+class ShaderReflection
+{
+public:
+	static constexpr uint32_t NO_SPEC_ID = ~(uint32_t)0;
+
+	struct DescriptorBinding
+	{
+		uint32_t         set;
+		uint32_t         binding;
+		VkDescriptorType type;
+		uint32_t         count;
+	};
+
+	// one per location, matrices and arrays occupy consecutive locations
+	struct VertexInput
+	{
+		uint32_t location;
+		// VK_FORMAT_UNDEFINED for types without a 32-bit vertex format
+		VkFormat format;
+	};
+
+public:
+	ShaderReflection();
+
+	// the code is only read during the call, returns false for malformed modules
+	bool parse( const uint32_t* code, size_t size, VkShaderStageFlagBits stage );
+
+	// sorted by set and binding
+	const std::vector<DescriptorBinding>& getDescriptorBindings() const
+	{
+		return m_DescriptorBindings;
+	}
+
+	// the range's size is 0 without push constants
+	const VkPushConstantRange&            getPushConstantRange() const
+	{
+		return m_vkPushConstantRange;
+	}
+
+	// vertex shaders only, sorted by location
+	const std::vector<VertexInput>&       getVertexInputs() const
+	{
+		return m_VertexInputs;
+	}
+
+	// compute shaders only; components declared through specialization constants take
+	// the given value if there is one, otherwise their default
+	void getWorkgroupSize( const SpecializationConstants& specialization,
+	                       uint32_t size[ 3 ] ) const;
+
+	// false if a 32-bit format does not match the reflected one, other formats are
+	// converted by the vertex fetch and always accepted
+	static bool isCompatibleFormat( VkFormat format, VkFormat reflected );
+
+private:
+	struct Member
+	{
+		uint32_t offset;
+		uint32_t matrixStride;
+	};
+
+	// defining instruction and decorations of a result id, operands point into the code
+	struct Id
+	{
+		uint32_t            opcode;
+		const uint32_t*     operands;
+		uint32_t            numOperands;
+
+		uint32_t            set;
+		uint32_t            binding;
+		uint32_t            location;
+		uint32_t            builtIn;
+		uint32_t            specId;
+		uint32_t            arrayStride;
+		bool                bufferBlock;
+		std::vector<Member> members;
+	};
+
+private:
+	static bool     resolveConstant( const std::vector<Id>& ids,
+	                                 uint32_t id,
+	                                 uint32_t& value,
+	                                 uint32_t& specId );
+	static uint32_t getTypeSize( const std::vector<Id>& ids,
+	                             uint32_t type,
+	                             uint32_t matrixStride );
+	static VkFormat getVertexFormat( const std::vector<Id>& ids, uint32_t type );
+
+	bool reflectDescriptor( const std::vector<Id>& ids,
+	                        const Id& variable,
+	                        uint32_t type,
+	                        uint32_t storageClass );
+	void reflectPushConstants( const std::vector<Id>& ids, uint32_t type );
+	void reflectVertexInput( const std::vector<Id>& ids, uint32_t location, uint32_t type );
+
+private:
+	std::vector<DescriptorBinding> m_DescriptorBindings;
+	VkPushConstantRange            m_vkPushConstantRange;
+	std::vector<VertexInput>       m_VertexInputs;
+
+	uint32_t                       m_uWorkgroupSize[ 3 ];
+	uint32_t                       m_uWorkgroupSpecIds[ 3 ];
+};
+
+#endif // SHADERREFLECTION_H
@@ -0,0 +1,134 @@
+#include "shaderwatcher.h"
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstdlib>
+
+ShaderWatcher::ShaderWatcher( const std::vector<Source>& sources )
+    : m_Sources( sources ),
+      m_iInotify( -1 ),
+      m_WatchThread(),
+      m_bStop( false ),
+      m_Mutex(),
+      m_Changed()
+{
+	m_iInotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( m_iInotify < 0 )
+	{
+		log_error( "Cannot initialize inotify." );
+		return;
+	}
+
+	// editors and compilers often replace files instead of writing them in place, the
+	// directory sees both
+	if( inotify_add_watch( m_iInotify, ".", IN_CLOSE_WRITE | IN_MOVED_TO ) < 0 )
+	{
+		log_error( "Cannot watch shader directory." );
+		destroy();
+		return;
+	}
+
+	m_WatchThread = std::thread( &ShaderWatcher::watchLoop, this );
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	destroy();
+}
+
+void ShaderWatcher::destroy()
+{
+	m_bStop = true;
+
+	if( m_WatchThread.joinable() )
+	{
+		m_WatchThread.join();
+	}
+
+	if( m_iInotify >= 0 )
+	{
+		close( m_iInotify );
+		m_iInotify = -1;
+	}
+
+	m_Changed.clear();
+}
+
+bool ShaderWatcher::poll( std::vector<std::string>& names )
+{
+	std::lock_guard<std::mutex> lock( m_Mutex );
+
+	if( m_Changed.empty() )
+		return false;
+
+	names.assign( m_Changed.begin(), m_Changed.end() );
+	m_Changed.clear();
+	return true;
+}
+
+void ShaderWatcher::watchLoop()
+{
+	alignas( struct inotify_event ) char buffer[ 4096 ];
+
+	pollfd descriptor{};
+	descriptor.fd     = m_iInotify;
+	descriptor.events = POLLIN;
+
+	while( !m_bStop )
+	{
+		if( ::poll( &descriptor, 1, WAKE_INTERVAL_MS ) <= 0 )
+			continue;
+
+		ssize_t size = read( m_iInotify, buffer, sizeof( buffer ) );
+
+		for( ssize_t offset = 0; offset < size; )
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>( buffer + offset );
+
+			if( event->len > 0 )
+			{
+				handleChange( event->name );
+			}
+			offset += sizeof( inotify_event ) + event->len;
+		}
+	}
+}
+
+void ShaderWatcher::handleChange( const std::string& filename )
+{
+	for( const auto& source : m_Sources )
+	{
+		if( filename == source.filename )
+		{
+			// the written module is reported by its own event
+			compile( source );
+			return;
+		}
+		else if( filename == std::string( source.name ) + ".spv" )
+		{
+			log_info( "Shader changed: " + filename );
+
+			std::lock_guard<std::mutex> lock( m_Mutex );
+			m_Changed.insert( source.name );
+			return;
+		}
+	}
+}
+
+bool ShaderWatcher::compile( const Source& source )
+{
+	log_info( std::string( "Compiling changed shader source: " ) + source.filename );
+
+	std::string command = std::string( "glslangValidator -V " ) + source.filename +
+	                      " -o " + source.name + ".spv";
+
+	// compile errors are printed by the compiler itself
+	if( std::system( command.c_str() ) != 0 )
+	{
+		log_error( std::string( "Cannot compile shader source: " ) + source.filename );
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,62 @@
+#ifndef SHADERWATCHER_H
+#define SHADERWATCHER_H
+
+#include "common.h"
+
+#include <vector>
+#include <string>
+#include <set>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Watches the working directory through inotify for changed GLSL sources and SPIR-V
+// files. Changed sources are compiled with glslangValidator on the watcher thread, the
+// names of changed shaders are collected until polled.
+class ShaderWatcher
+{
+public:
+	struct Source
+	{
+		// GLSL source, compiled to <name>.spv
+		const char* filename;
+		const char* name;
+	};
+
+public:
+	ShaderWatcher( const std::vector<Source>& sources );
+	~ShaderWatcher();
+
+	void destroy();
+
+	bool isValid()
+	{
+		return ( m_iInotify >= 0 );
+	}
+
+	// hands over the names of shaders changed since the last poll, never waits on the
+	// watcher thread
+	bool poll( std::vector<std::string>& names );
+
+private:
+	// poll timeout of the watcher thread, bounds the delay of destroy()
+	static constexpr int WAKE_INTERVAL_MS = 250;
+
+private:
+	void watchLoop();
+
+	void handleChange( const std::string& filename );
+	bool compile( const Source& source );
+
+private:
+	std::vector<Source>   m_Sources;
+
+	int                   m_iInotify;
+	std::thread           m_WatchThread;
+	std::atomic<bool>     m_bStop;
+
+	std::mutex            m_Mutex;
+	std::set<std::string> m_Changed;
+};
+
+#endif // SHADERWATCHER_H
@@ -0,0 +1,87 @@
+#include "specializationconstants.h"
+
+#include <algorithm>
+#include <cstring>
+
+SpecializationConstants::SpecializationConstants( std::initializer_list<Constant> constants )
+    : SpecializationConstants( constants.begin(), constants.size() )
+{
+}
+
+SpecializationConstants::SpecializationConstants( const Constant* constants, uint32_t count )
+    : m_vkEntries(),
+      m_Data()
+{
+	for( auto i = 0; i < count; ++i )
+	{
+		set( constants[ i ] );
+	}
+}
+
+SpecializationConstants& SpecializationConstants::set( const Constant& constant )
+{
+	uint32_t bits;
+	std::memcpy( &bits, &constant.value, sizeof( bits ) );
+
+	// kept sorted by id, so equal sets have equal data
+	auto it = std::lower_bound( m_vkEntries.begin(),
+	                            m_vkEntries.end(),
+	                            constant.id,
+	                            []( const VkSpecializationMapEntry& entry, uint32_t id ) {
+		return ( entry.constantID < id );
+	} );
+
+	uint32_t index = it - m_vkEntries.begin();
+
+	if( it != m_vkEntries.end() && it->constantID == constant.id )
+	{
+		m_Data[ index ] = bits;
+		return *this;
+	}
+
+	m_vkEntries.insert( it, { constant.id, 0, sizeof( uint32_t ) } );
+	m_Data.insert( m_Data.begin() + index, bits );
+
+	for( auto i = index; i < m_vkEntries.size(); ++i )
+	{
+		m_vkEntries[ i ].offset = i * sizeof( uint32_t );
+	}
+	return *this;
+}
+
+bool SpecializationConstants::find( uint32_t id, uint32_t& bits ) const
+{
+	auto it = std::lower_bound( m_vkEntries.begin(),
+	                            m_vkEntries.end(),
+	                            id,
+	                            []( const VkSpecializationMapEntry& entry, uint32_t id ) {
+		return ( entry.constantID < id );
+	} );
+
+	if( it == m_vkEntries.end() || it->constantID != id )
+		return false;
+
+	bits = m_Data[ it - m_vkEntries.begin() ];
+	return true;
+}
+
+uint64_t SpecializationConstants::getHash() const
+{
+	uint64_t hash = hash_bytes( m_Data.data(), m_Data.size() * sizeof( uint32_t ) );
+	for( const auto& entry : m_vkEntries )
+	{
+		hash = hash_bytes( &entry.constantID, sizeof( entry.constantID ), hash );
+	}
+	return hash;
+}
+
+VkSpecializationInfo SpecializationConstants::getInfo() const
+{
+	VkSpecializationInfo info{};
+	info.mapEntryCount = m_vkEntries.size();
+	info.pMapEntries   = m_vkEntries.data();
+	info.dataSize      = m_Data.size() * sizeof( uint32_t );
+	info.pData         = m_Data.data();
+
+	return info;
+}
@@ -0,0 +1,94 @@
+#ifndef SPECIALIZATIONCONSTANTS_H
+#define SPECIALIZATIONCONSTANTS_H
+
+#include "common.h"
+
+#include <vulkan/vulkan.h>
+#include <initializer_list>
+#include <vector>
+
+// Values for the constant_id declarations of one shader stage, applied when the pipeline is
+// compiled so the driver can fold them like literals. Constants are 32-bit scalars; they can
+// be declared as constexpr arrays:
+//
+//   static constexpr SpecializationConstants::Constant constants[] = {
+//       { 0, 64u },   // local_size_x_id = 0
+//       { 1, true }   // constant_id = 1, a bool toggle
+//   };
+class SpecializationConstants
+{
+public:
+	struct Constant
+	{
+		constexpr Constant( uint32_t id, uint32_t value )
+		    : id( id ),
+		      value( value )
+		{
+		}
+		constexpr Constant( uint32_t id, int32_t value )
+		    : id( id ),
+		      value( value )
+		{
+		}
+		constexpr Constant( uint32_t id, float value )
+		    : id( id ),
+		      value( value )
+		{
+		}
+		// stored as VkBool32
+		constexpr Constant( uint32_t id, bool value )
+		    : id( id ),
+		      value( value ? (uint32_t)VK_TRUE : (uint32_t)VK_FALSE )
+		{
+		}
+
+		union Value
+		{
+			constexpr Value( uint32_t value ) : u( value ) {}
+			constexpr Value( int32_t value ) : i( value ) {}
+			constexpr Value( float value ) : f( value ) {}
+
+			uint32_t u;
+			int32_t  i;
+			float    f;
+		};
+
+		uint32_t id;
+		Value    value;
+	};
+
+public:
+	SpecializationConstants() = default;
+	SpecializationConstants( std::initializer_list<Constant> constants );
+	SpecializationConstants( const Constant* constants, uint32_t count );
+
+	template<size_t N>
+	SpecializationConstants( const Constant ( &constants )[ N ] )
+	    : SpecializationConstants( constants, N )
+	{
+	}
+
+	// a later value for the same id replaces the earlier one
+	SpecializationConstants& set( const Constant& constant );
+
+	// raw bits of the constant with the given id, false if it is not set
+	bool     find( uint32_t id, uint32_t& bits ) const;
+
+	bool     isEmpty() const
+	{
+		return m_vkEntries.empty();
+	}
+
+	// distinguishes variants, e.g. in pipeline keys; equal sets hash equally regardless
+	// of the order the constants were set in
+	uint64_t getHash() const;
+
+	// points into this object, valid until it is modified or destroyed
+	VkSpecializationInfo getInfo() const;
+
+private:
+	std::vector<VkSpecializationMapEntry> m_vkEntries;
+	std::vector<uint32_t>                 m_Data;
+};
+
+#endif // SPECIALIZATIONCONSTANTS_H
@@ -21,6 +21,7 @@ SwapChain::SwapChain( Renderer& renderer, SwapChain* oldSwapchain )
       m_vkFormat(),
       m_vkExtent(),
       m_vkPresentMode(),
+      m_vkImageUsage( 0 ),
       m_vkImages(),
       m_vkImageViews(),
       m_pRenderer( &renderer )
@@ -153,6 +154,11 @@ bool SwapChain::createSwapchain( SwapChain* oldSwapchain )
 	m_vkExtent = selectSurfaceExtent( capabilities );
 	m_vkPresentMode = selectPresentMode( capabilities );
 
+	// allow frame capture to read back swap chain images where supported
+	m_vkImageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+	                 ( capabilities.capabilities.supportedUsageFlags &
+	                   VK_IMAGE_USAGE_TRANSFER_SRC_BIT );
+
 	numImages = capabilities.capabilities.minImageCount + 1;
 	if( capabilities.capabilities.maxImageCount > 0 && // maxImageCount = 0 means no restriction
 	    numImages > capabilities.capabilities.maxImageCount )
@@ -176,7 +182,7 @@ bool SwapChain::createSwapchain( SwapChain* oldSwapchain )
 	createInfo.imageColorSpace  = m_vkFormat.colorSpace;
 	createInfo.imageExtent      = m_vkExtent;
 	createInfo.imageArrayLayers = 1;
-	createInfo.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	createInfo.imageUsage       = m_vkImageUsage;
 	if( queueFamilies[ QueueFamily::Graphics ].index ==
 	    queueFamilies[ QueueFamily::Present ].index )
 	{
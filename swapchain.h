@@ -44,6 +44,16 @@ public:
 		return m_vkFormat.format;
 	}
 
+	VkImageUsageFlags   getImageUsage()
+	{
+		return m_vkImageUsage;
+	}
+
+	const std::vector<VkImage>& getImages()
+	{
+		return m_vkImages;
+	}
+
 	const std::vector<VkImageView> getImageViews()
 	{
 		return m_vkImageViews;
@@ -64,6 +74,7 @@ private:
 	VkSurfaceFormatKHR         m_vkFormat;
 	VkExtent2D                 m_vkExtent;
 	VkPresentModeKHR           m_vkPresentMode;
+	VkImageUsageFlags          m_vkImageUsage;
 	std::vector<VkImage>       m_vkImages;
 	std::vector<VkImageView>   m_vkImageViews;
 
@@ -4,6 +4,10 @@
 #include <vulkan/vulkan.h>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <vector>
+#include <cstddef>
 
 struct Vertex
 {
@@ -29,4 +33,26 @@ public:
 	}
 };
 
+// Per-instance vertex stream data, advanced once per instance.
+struct Instance
+{
+public:
+	glm::mat4 transform;
+	glm::vec4 color;
+
+public:
+	static const std::vector<Vertex::AttributeDesc>& getAttributeDescriptions()
+	{
+		// a matrix attribute occupies one location per column
+		static const std::vector<Vertex::AttributeDesc> desc = {
+		    { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof( Instance, transform ) },
+		    { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof( Instance, transform ) + sizeof( glm::vec4 ) },
+		    { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof( Instance, transform ) + 2 * sizeof( glm::vec4 ) },
+		    { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof( Instance, transform ) + 3 * sizeof( glm::vec4 ) },
+		    { VK_FORMAT_R32G32B32A32_SFLOAT, offsetof( Instance, color ) }
+		};
+		return desc;
+	}
+};
+
 #endif // VERTEX_H
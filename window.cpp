@@ -4,6 +4,8 @@ Window::Window()
     : m_pWindow( nullptr ),
       m_iWidth( 800 ),
       m_iHeight( 600 ),
+      m_uFramebufferWidth( 0 ),
+      m_uFramebufferHeight( 0 ),
       m_pCallback( nullptr ),
       m_pCallbackUserData( nullptr ),
       m_ResizeCallback()
@@ -15,6 +17,11 @@ Window::Window()
 
 	glfwSetWindowUserPointer( m_pWindow, this );
 	glfwSetWindowSizeCallback( m_pWindow, Window::onResizeStatic );
+	glfwSetFramebufferSizeCallback( m_pWindow, Window::onFramebufferResizeStatic );
+
+	int width, height;
+	glfwGetFramebufferSize( m_pWindow, &width, &height );
+	onFramebufferResizeStatic( m_pWindow, width, height );
 }
 
 Window::~Window()
@@ -57,25 +64,24 @@ void Window::startMainLoop()
 	}
 }
 
-uint32_t Window::getWidth()
+void Window::close()
 {
-	int width;
-	glfwGetFramebufferSize( m_pWindow, &width, nullptr );
-	return width;
+	glfwSetWindowShouldClose( m_pWindow, GLFW_TRUE );
 }
 
-uint32_t Window::getHeight()
-{
-	int height;
-	glfwGetFramebufferSize( m_pWindow, nullptr, &height );
-	return height;
-}
 
 void Window::onResizeStatic( GLFWwindow* window, int width, int height )
 {
 	reinterpret_cast<Window*>( glfwGetWindowUserPointer( window ) )->onResize( width, height );
 }
 
+void Window::onFramebufferResizeStatic( GLFWwindow* window, int width, int height )
+{
+	Window& self = *reinterpret_cast<Window*>( glfwGetWindowUserPointer( window ) );
+	self.m_uFramebufferWidth.store( width, std::memory_order_relaxed );
+	self.m_uFramebufferHeight.store( height, std::memory_order_relaxed );
+}
+
 void Window::onResize( int width, int height )
 {
 	// TODO: remove m_iWidth/Height members?
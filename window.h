@@ -7,6 +7,7 @@
 #include <GLFW/glfw3.h>
 
 #include <vector>
+#include <atomic>
 
 class Window
 {
@@ -30,9 +31,17 @@ public:
 	}
 
 	void     startMainLoop();
+	void     close();
 
-	uint32_t getWidth();
-	uint32_t getHeight();
+	// framebuffer size as of the last event poll, safe to query from any thread
+	uint32_t getWidth()
+	{
+		return m_uFramebufferWidth.load( std::memory_order_relaxed );
+	}
+	uint32_t getHeight()
+	{
+		return m_uFramebufferHeight.load( std::memory_order_relaxed );
+	}
 
 	void     setMainLoopCallback( LoopCallback callback, void* userData )
 	{
@@ -47,6 +56,7 @@ public:
 
 private:
 	static void   onResizeStatic( GLFWwindow* window, int width, int height );
+	static void   onFramebufferResizeStatic( GLFWwindow* window, int width, int height );
 
 	void          onResize( int width, int height );
 
@@ -55,6 +65,10 @@ private:
 	int           m_iWidth;
 	int           m_iHeight;
 
+	// GLFW may only be queried on the main thread
+	std::atomic<uint32_t> m_uFramebufferWidth;
+	std::atomic<uint32_t> m_uFramebufferHeight;
+
 	LoopCallback  m_pCallback;
 	void*         m_pCallbackUserData;
 